@@ -0,0 +1,239 @@
+/**
+ * @file activity_estimator.cpp
+ * @brief Triển khai bộ ước lượng cadence, quãng đường và năng lượng tiêu hao
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#include "activity_estimator.h"
+#include <math.h>
+
+// Thông số ước lượng MET từ nhịp tim (phương pháp %HRR ≈ %VO2R)
+static constexpr float HR_REST_BPM = 60.0f; ///< Nhịp tim nghỉ giả định
+static constexpr float HR_MAX_BPM = 190.0f; ///< Nhịp tim tối đa giả định
+static constexpr float MET_MAX = 10.0f;     ///< MET tối đa (VO2max ≈ 35 ml/kg/phút)
+
+/**
+ * @brief Constructor - khởi tạo với hồ sơ mặc định và bộ đếm bằng 0
+ */
+ActivityEstimator::ActivityEstimator()
+    : lastStepMs_(0),
+      heightM_(USER_DEFAULT_HEIGHT_M), weightKg_(USER_DEFAULT_BMI * USER_DEFAULT_HEIGHT_M * USER_DEFAULT_HEIGHT_M),
+      hr_(0.0f),
+      instCadence_(0.0f), windowCadence_(0.0f), distanceM_(0.0f), energyKcal_(0.0f), met_(1.0f)
+{
+}
+
+/**
+ * @brief Cập nhật chiều cao và cân nặng (cân nặng = BMI × chiều cao²)
+ */
+void ActivityEstimator::setBodyMetrics(float heightM, float bmi)
+{
+    if (heightM > 0.5f && heightM < 2.5f)
+    {
+        heightM_ = heightM;
+    }
+    if (bmi > 5.0f && bmi < 80.0f)
+    {
+        weightKg_ = bmi * heightM_ * heightM_;
+    }
+}
+
+/**
+ * @brief Cập nhật nhịp tim mới nhất
+ */
+void ActivityEstimator::setHeartRate(float hr)
+{
+    hr_ = hr;
+}
+
+/**
+ * @brief Xử lý các bước mới phát hiện
+ *
+ * Nếu nhiều bước đến cùng lúc (đếm theo đợt), khoảng thời gian kể từ bước
+ * trước được chia đều cho các bước đó. Với mỗi đợt:
+ * 1. Cadence tức thời = 60000 / khoảng cách trung bình giữa các bước
+ * 2. Quãng đường += số bước × chiều dài bước
+ * 3. Năng lượng += MET × cân nặng × thời gian (giờ)
+ *
+ * Khoảng cách lớn hơn MAX_STEP_INTERVAL_MS được coi là bắt đầu đi lại,
+ * chỉ cộng quãng đường mà không cộng thời gian vận động.
+ *
+ * @param newSteps Số bước mới
+ * @param nowMs Thời điểm hiện tại (ms)
+ */
+void ActivityEstimator::onSteps(uint32_t newSteps, uint32_t nowMs)
+{
+    if (newSteps == 0)
+        return;
+
+    uint32_t elapsed = (lastStepMs_ != 0) ? (nowMs - lastStepMs_) : 0;
+    uint32_t perStep = elapsed / newSteps;
+    bool walking = (lastStepMs_ != 0) && perStep > 0 && perStep <= MAX_STEP_INTERVAL_MS;
+
+    // Lưu thời điểm các bước (nội suy đều trong đợt) vào vòng đệm
+    uint32_t toStore = (newSteps < STEP_HISTORY) ? newSteps : STEP_HISTORY;
+    for (uint32_t i = toStore; i > 0; i--)
+    {
+        stepTimes_.push(nowMs - (i - 1) * perStep);
+    }
+
+    instCadence_ = walking ? 60000.0f / (float)perStep : 0.0f;
+    recomputeWindowCadence(nowMs);
+
+    // Dùng cadence theo cửa sổ (ổn định hơn) để chọn chiều dài bước
+    float cadence = (windowCadence_ > 0.0f) ? windowCadence_ : instCadence_;
+    float stepLen = stepLengthM(cadence);
+    distanceM_ += stepLen * (float)newSteps;
+
+    if (walking)
+    {
+        float speedMPerMin = stepLen * cadence;
+        met_ = estimateMet(speedMPerMin);
+        float hours = (float)elapsed / 3600000.0f;
+        energyKcal_ += met_ * weightKg_ * hours;
+    }
+
+    lastStepMs_ = nowMs;
+}
+
+/**
+ * @brief Đưa cadence về 0 khi không có bước mới trong một khoảng thời gian
+ */
+void ActivityEstimator::update(uint32_t nowMs)
+{
+    if (lastStepMs_ == 0 || (nowMs - lastStepMs_) <= MAX_STEP_INTERVAL_MS)
+        return;
+
+    instCadence_ = 0.0f;
+    met_ = 1.0f;
+    if (windowCadence_ > 0.0f)
+    {
+        recomputeWindowCadence(nowMs);
+    }
+}
+
+/**
+ * @brief Reset quãng đường, năng lượng và lịch sử bước
+ */
+void ActivityEstimator::reset()
+{
+    stepTimes_.clear();
+    lastStepMs_ = 0;
+    instCadence_ = 0.0f;
+    windowCadence_ = 0.0f;
+    distanceM_ = 0.0f;
+    energyKcal_ = 0.0f;
+    met_ = 1.0f;
+}
+
+float ActivityEstimator::getInstantCadence() const { return instCadence_; }
+
+float ActivityEstimator::getWindowCadence() const { return windowCadence_; }
+
+float ActivityEstimator::getDistanceM() const { return distanceM_; }
+
+float ActivityEstimator::getEnergyKcal() const { return energyKcal_; }
+
+float ActivityEstimator::getMet() const { return met_; }
+
+/**
+ * @brief Đóng gói các giá trị hiện tại thành ActivityFields (có bão hòa)
+ */
+ActivityFields ActivityEstimator::getCompactFields() const
+{
+    ActivityFields f;
+    f.cadence = (uint8_t)fminf(windowCadence_ + 0.5f, 255.0f);
+    f.met_x10 = (uint8_t)fminf(met_ * 10.0f + 0.5f, 255.0f);
+    f.distance_m = (uint16_t)fminf(distanceM_, 65535.0f);
+    f.energy_kcal_x10 = (uint16_t)fminf(energyKcal_ * 10.0f, 65535.0f);
+    return f;
+}
+
+/**
+ * @brief Tính cadence theo cửa sổ từ các bước nằm trong CADENCE_WINDOW_MS gần nhất
+ *
+ * cadence = (số bước - 1) × 60000 / (bước mới nhất - bước cũ nhất trong cửa sổ)
+ * Vòng đệm chỉ có STEP_HISTORY phần tử nên chi phí là hằng số.
+ */
+void ActivityEstimator::recomputeWindowCadence(uint32_t nowMs)
+{
+    if (stepTimes_.empty())
+    {
+        windowCadence_ = 0.0f;
+        return;
+    }
+
+    uint32_t newest = stepTimes_.newest();
+    uint32_t oldest = newest;
+    uint8_t n = 0;
+
+    // Duyệt từ bước mới nhất về cũ hơn
+    for (uint16_t i = stepTimes_.size(); i > 0; i--)
+    {
+        if (nowMs - stepTimes_[i - 1] > CADENCE_WINDOW_MS)
+            break;
+        oldest = stepTimes_[i - 1];
+        n++;
+    }
+
+    if (n < 2 || newest == oldest || (nowMs - newest) > MAX_STEP_INTERVAL_MS)
+    {
+        windowCadence_ = 0.0f;
+        return;
+    }
+
+    windowCadence_ = (float)(n - 1) * 60000.0f / (float)(newest - oldest);
+}
+
+/**
+ * @brief Chiều dài bước theo cadence
+ *
+ * Đi bộ (≤ 120 bước/phút): 0.414 × chiều cao
+ * Chạy (≥ 170 bước/phút): 0.60 × chiều cao
+ * Ở giữa: nội suy tuyến tính
+ */
+float ActivityEstimator::stepLengthM(float cadenceSpm) const
+{
+    const float walkFactor = 0.414f;
+    const float runFactor = 0.60f;
+
+    float factor = walkFactor;
+    if (cadenceSpm >= 170.0f)
+    {
+        factor = runFactor;
+    }
+    else if (cadenceSpm > 120.0f)
+    {
+        factor = walkFactor + (runFactor - walkFactor) * (cadenceSpm - 120.0f) / 50.0f;
+    }
+    return factor * heightM_;
+}
+
+/**
+ * @brief Ước lượng MET
+ *
+ * - Theo tốc độ (ACSM): VO2 = 3.5 + 0.1 × v (đi bộ) hoặc 3.5 + 0.2 × v (chạy, v > 134 m/phút)
+ *   MET = VO2 / 3.5
+ * - Theo nhịp tim: %HRR = (HR - HRrest) / (HRmax - HRrest), MET = 1 + %HRR × (METmax - 1)
+ * - Có nhịp tim hợp lệ: lấy trung bình hai giá trị
+ *
+ * @param speedMPerMin Tốc độ (m/phút)
+ * @return MET (≥ 1)
+ */
+float ActivityEstimator::estimateMet(float speedMPerMin) const
+{
+    float vo2 = (speedMPerMin > 134.0f) ? 3.5f + 0.2f * speedMPerMin
+                                        : 3.5f + 0.1f * speedMPerMin;
+    float metSpeed = vo2 / 3.5f;
+
+    if (hr_ <= HR_REST_BPM || hr_ > 250.0f)
+        return metSpeed;
+
+    float hrr = (hr_ - HR_REST_BPM) / (HR_MAX_BPM - HR_REST_BPM);
+    if (hrr > 1.0f)
+        hrr = 1.0f;
+    float metHr = 1.0f + hrr * (MET_MAX - 1.0f);
+
+    return 0.5f * (metSpeed + metHr);
+}
@@ -0,0 +1,103 @@
+/**
+ * @file activity_estimator.h
+ * @brief Ước lượng nhịp bước (cadence), quãng đường và năng lượng tiêu hao trên thiết bị
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - Nhận sự kiện bước chân từ MPU6050Manager (số bước mới + thời điểm)
+ * - Tính cadence tức thời (từ khoảng cách giữa hai bước) và cadence theo cửa sổ
+ * - Ước lượng quãng đường dựa trên chiều dài bước từ hồ sơ người dùng
+ * - Ước lượng năng lượng tiêu hao theo MET, kết hợp tốc độ và nhịp tim
+ * - Mọi giá trị được cập nhật tăng dần theo từng bước (không duyệt lại lịch sử)
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "ring_buffer.h"
+#include "health_data_packet.h"
+
+/**
+ * @class ActivityEstimator
+ * @brief Bộ ước lượng cadence/quãng đường/năng lượng cập nhật theo từng bước
+ *
+ * Hoạt động:
+ * 1. onSteps() được gọi mỗi khi bộ đếm bước tăng
+ * 2. Lưu thời điểm bước vào một vòng đệm nhỏ để tính cadence theo cửa sổ
+ * 3. Chiều dài bước = chiều cao × hệ số (tăng dần từ đi bộ sang chạy)
+ * 4. MET tính từ tốc độ (công thức ACSM), trộn với MET từ nhịp tim dự trữ (HRR)
+ * 5. Năng lượng của bước = MET × cân nặng × thời gian của bước
+ */
+class ActivityEstimator
+{
+public:
+    /// @brief Constructor - khởi tạo với hồ sơ mặc định
+    ActivityEstimator();
+
+    /// @brief Cập nhật thông số cơ thể từ hồ sơ người dùng
+    /// @param heightM Chiều cao (m)
+    /// @param bmi Chỉ số khối cơ thể (dùng để suy ra cân nặng)
+    void setBodyMetrics(float heightM, float bmi);
+
+    /// @brief Cập nhật nhịp tim mới nhất (0 = không có dữ liệu)
+    /// @param hr Nhịp tim (BPM)
+    void setHeartRate(float hr);
+
+    /// @brief Xử lý các bước mới phát hiện
+    /// @param newSteps Số bước mới kể từ lần gọi trước (có thể > 1 nếu đếm theo đợt)
+    /// @param nowMs Thời điểm hiện tại (ms)
+    void onSteps(uint32_t newSteps, uint32_t nowMs);
+
+    /// @brief Cập nhật theo thời gian để cadence về 0 khi ngừng đi
+    /// @param nowMs Thời điểm hiện tại (ms)
+    void update(uint32_t nowMs);
+
+    /// @brief Reset quãng đường và năng lượng (dùng khi qua ngày mới)
+    void reset();
+
+    /// @brief Cadence tức thời (bước/phút) từ khoảng cách giữa hai bước gần nhất
+    float getInstantCadence() const;
+
+    /// @brief Cadence theo cửa sổ CADENCE_WINDOW_MS (bước/phút)
+    float getWindowCadence() const;
+
+    /// @brief Quãng đường tích lũy (m)
+    float getDistanceM() const;
+
+    /// @brief Năng lượng tiêu hao tích lũy (kcal)
+    float getEnergyKcal() const;
+
+    /// @brief MET của bước gần nhất
+    float getMet() const;
+
+    /// @brief Lấy các trường dạng gọn để lưu/gửi theo batch
+    ActivityFields getCompactFields() const;
+
+private:
+    /// @brief Tính lại cadence theo cửa sổ từ vòng đệm thời điểm bước
+    void recomputeWindowCadence(uint32_t nowMs);
+
+    /// @brief Chiều dài một bước (m) ứng với cadence cho trước
+    float stepLengthM(float cadenceSpm) const;
+
+    /// @brief MET ứng với tốc độ và nhịp tim hiện tại
+    float estimateMet(float speedMPerMin) const;
+
+    static const uint8_t STEP_HISTORY = 16;            ///< Số thời điểm bước lưu lại
+    static const uint32_t CADENCE_WINDOW_MS = 10000;   ///< Cửa sổ tính cadence (ms)
+    static const uint32_t MAX_STEP_INTERVAL_MS = 2000; ///< Khoảng cách tối đa để coi là đang đi
+
+    RingBuffer<uint32_t, STEP_HISTORY> stepTimes_; ///< Thời điểm các bước gần nhất
+    uint32_t lastStepMs_;                          ///< Thời điểm bước cuối cùng (0 = chưa có)
+
+    float heightM_;  ///< Chiều cao (m)
+    float weightKg_; ///< Cân nặng suy ra từ BMI (kg)
+    float hr_;       ///< Nhịp tim mới nhất (BPM)
+
+    float instCadence_;   ///< Cadence tức thời (bước/phút)
+    float windowCadence_; ///< Cadence theo cửa sổ (bước/phút)
+    float distanceM_;     ///< Quãng đường tích lũy (m)
+    float energyKcal_;    ///< Năng lượng tích lũy (kcal)
+    float met_;           ///< MET hiện tại
+};
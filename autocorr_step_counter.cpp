@@ -0,0 +1,231 @@
+/**
+ * @file autocorr_step_counter.cpp
+ * @brief Triển khai bộ đếm bước theo chu kỳ bằng tự tương quan tăng dần
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#include "autocorr_step_counter.h"
+
+static constexpr float MEAN_ALPHA = 0.01f;       ///< Hệ số trung bình trượt bỏ DC (~1 s ở 100 Hz)
+static constexpr int16_t SAMPLE_LIMIT_MG = 4000; ///< Giới hạn mẫu (mili-g) để tổng int32 không tràn
+static constexpr int32_t MIN_ENERGY = 160000;    ///< acf[0] tối thiểu (~50 mg RMS trên cửa sổ)
+static constexpr float MIN_CORRELATION = 0.4f;   ///< acf[lag]/acf[0] tối thiểu để coi là có chu kỳ
+static constexpr float SUBHARMONIC_RATIO = 0.7f; ///< Ngưỡng chọn lag nhỏ hơn cực đại (chu kỳ sải → chu kỳ bước)
+static constexpr int32_t RECENT_ENERGY_DIV = 4;  ///< Năng lượng tối thiểu của khối mới nhất: 1/4 trung bình cửa sổ
+
+/**
+ * @brief Constructor - khởi tạo trạng thái rỗng
+ */
+AutocorrStepCounter::AutocorrStepCounter()
+{
+    reset();
+}
+
+/**
+ * @brief Reset cửa sổ, tự tương quan và trạng thái đợt đi bộ
+ */
+void AutocorrStepCounter::reset()
+{
+    for (uint8_t i = 0; i < HISTORY; i++)
+    {
+        history_[i] = 0;
+    }
+    for (uint8_t k = 0; k <= MAX_LAG; k++)
+    {
+        acf_[k] = 0;
+    }
+    total_ = 0;
+    primed_ = false;
+    mean_ = 0.0f;
+    decimAcc_ = 0.0f;
+    decimCount_ = 0;
+    evalCount_ = 0;
+    period_ = 0;
+    stableEvals_ = 0;
+    walking_ = false;
+    pendingSteps_ = 0.0f;
+}
+
+/**
+ * @brief Xử lý một mẫu độ lớn gia tốc
+ *
+ * Quy trình:
+ * 1. Bỏ DC bằng trung bình trượt
+ * 2. Giảm tần số: trung bình DECIMATION mẫu → 1 mẫu (mili-g)
+ * 3. Cập nhật tự tương quan trượt
+ * 4. Mỗi EVAL_INTERVAL mẫu: đánh giá chu kỳ và phát bước đã xác nhận
+ *
+ * @param magG Độ lớn gia tốc (g)
+ * @return Số bước mới được xác nhận
+ */
+uint32_t AutocorrStepCounter::process(float magG)
+{
+    if (!primed_)
+    {
+        mean_ = magG;
+        primed_ = true;
+    }
+    mean_ += MEAN_ALPHA * (magG - mean_);
+    decimAcc_ += magG - mean_;
+
+    if (++decimCount_ < DECIMATION)
+        return 0;
+
+    float avgMg = decimAcc_ * (1000.0f / DECIMATION);
+    decimAcc_ = 0.0f;
+    decimCount_ = 0;
+
+    if (avgMg > SAMPLE_LIMIT_MG)
+        avgMg = SAMPLE_LIMIT_MG;
+    if (avgMg < -SAMPLE_LIMIT_MG)
+        avgMg = -SAMPLE_LIMIT_MG;
+    push((int16_t)avgMg);
+
+    if (++evalCount_ < EVAL_INTERVAL)
+        return 0;
+    evalCount_ = 0;
+
+    return evaluate();
+}
+
+uint8_t AutocorrStepCounter::getPeriod() const { return walking_ ? period_ : 0; }
+
+bool AutocorrStepCounter::isWalking() const { return walking_; }
+
+/**
+ * @brief Thêm mẫu x[t] và cập nhật tự tương quan trên cửa sổ WINDOW mẫu
+ *
+ * acf[k] = Σ x[n]·x[n-k], n ∈ (t - WINDOW, t]
+ * Cập nhật: acf[k] += x[t]·x[t-k] - x[t-WINDOW]·x[t-WINDOW-k]
+ *
+ * Số hạng bị trừ chính là số hạng đã cộng khi x[t-WINDOW] đến, nên tổng
+ * luôn chính xác (số nguyên).
+ */
+void AutocorrStepCounter::push(int16_t x)
+{
+    const uint8_t mask = HISTORY - 1;
+    uint32_t t = total_;
+    history_[t & mask] = x;
+
+    for (uint8_t k = 0; k <= MAX_LAG; k++)
+    {
+        if (t >= k)
+        {
+            acf_[k] += (int32_t)x * history_[(t - k) & mask];
+        }
+        if (t >= (uint32_t)WINDOW + k)
+        {
+            uint32_t old = t - WINDOW;
+            acf_[k] -= (int32_t)history_[old & mask] * history_[(old - k) & mask];
+        }
+    }
+
+    total_++;
+}
+
+/**
+ * @brief Đánh giá chu kỳ và cập nhật trạng thái đợt đi bộ
+ *
+ * 1. Tìm lag có tự tương quan lớn nhất trong [MIN_LAG, MAX_LAG]
+ * 2. Nếu một lag nhỏ hơn cũng là đỉnh tương quan mạnh → cực đại là bội số của chu kỳ bước, dùng lag nhỏ đó
+ * 3. Chu kỳ hợp lệ khi năng lượng đủ lớn và acf[lag]/acf[0] > MIN_CORRELATION
+ * 4. Chu kỳ ổn định (lệch ≤ ~15% so với lần trước) trong CONFIRM_EVALS lần → xác nhận đợt
+ * 5. Trong đợt: cộng EVAL_INTERVAL / chu kỳ bước nếu khối mẫu mới nhất còn
+ *    năng lượng (không đếm phần đuôi cửa sổ sau khi đã dừng đi), phát phần nguyên
+ *
+ * Đợt chưa được xác nhận mà mất chu kỳ → bỏ các bước đang chờ (cú vung tay, va chạm).
+ *
+ * @return Số bước được xác nhận
+ */
+uint32_t AutocorrStepCounter::evaluate()
+{
+    if (total_ < (uint32_t)WINDOW + MAX_LAG)
+        return 0;
+
+    int32_t r0 = acf_[0];
+    uint8_t best = 0;
+    int32_t bestVal = 0;
+
+    if (r0 >= MIN_ENERGY)
+    {
+        for (uint8_t k = MIN_LAG; k <= MAX_LAG; k++)
+        {
+            if (acf_[k] > bestVal)
+            {
+                bestVal = acf_[k];
+                best = k;
+            }
+        }
+    }
+
+    bool periodic = (best != 0) && ((float)bestVal > MIN_CORRELATION * (float)r0);
+
+    if (periodic)
+    {
+        // Lag nhỏ nhất là đỉnh cục bộ và đủ gần cực đại → chu kỳ bước
+        // (cực đại toàn cục thường rơi vào bội số: 1 sải = 2 bước)
+        for (uint8_t k = MIN_LAG; k < best; k++)
+        {
+            if (acf_[k] >= acf_[k - 1] && acf_[k] >= acf_[k + 1] &&
+                (float)acf_[k] > SUBHARMONIC_RATIO * (float)bestVal)
+            {
+                best = k;
+                break;
+            }
+        }
+    }
+
+    if (!periodic)
+    {
+        // Mất chu kỳ: kết thúc đợt hoặc hủy ứng viên
+        period_ = 0;
+        stableEvals_ = 0;
+        walking_ = false;
+        pendingSteps_ = 0.0f;
+        return 0;
+    }
+
+    uint8_t tolerance = (period_ / 6 > 1) ? period_ / 6 : 1;
+    bool consistent = period_ != 0 &&
+                      ((best > period_) ? (best - period_) : (period_ - best)) <= tolerance;
+
+    if (consistent)
+    {
+        if (stableEvals_ < 255)
+            stableEvals_++;
+    }
+    else if (!walking_)
+    {
+        // Ứng viên mới: các bước đã nằm trong cửa sổ được tính vào đợt.
+        // EVAL_INTERVAL mẫu mới nhất của cửa sổ được cộng ngay bên dưới.
+        stableEvals_ = 1;
+        pendingSteps_ = (float)(WINDOW - EVAL_INTERVAL) / best;
+    }
+
+    period_ = best;
+
+    // Cửa sổ còn giữ chu kỳ ~WINDOW mẫu sau khi dừng đi: chỉ cộng bước cho
+    // EVAL_INTERVAL mẫu mới nhất khi chúng còn năng lượng (RMS ≥ 1/2 RMS cửa sổ)
+    const uint8_t mask = HISTORY - 1;
+    int32_t recent = 0;
+    for (uint8_t i = 1; i <= EVAL_INTERVAL; i++)
+    {
+        int32_t x = history_[(total_ - i) & mask];
+        recent += x * x;
+    }
+    if ((int64_t)recent * WINDOW * RECENT_ENERGY_DIV >= (int64_t)r0 * EVAL_INTERVAL)
+        pendingSteps_ += (float)EVAL_INTERVAL / best;
+
+    if (!walking_ && stableEvals_ >= CONFIRM_EVALS)
+    {
+        walking_ = true;
+    }
+
+    if (!walking_)
+        return 0;
+
+    uint32_t steps = (uint32_t)pendingSteps_;
+    pendingSteps_ -= (float)steps;
+    return steps;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file autocorr_step_counter.h
+ * @brief Đếm bước dựa trên tính chu kỳ (tự tương quan tính tăng dần)
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - Giảm tần số lấy mẫu độ lớn gia tốc (100 Hz → 25 Hz) và loại bỏ thành phần DC
+ * - Duy trì tự tương quan trên cửa sổ trượt với số độ trễ (lag) giới hạn,
+ *   cập nhật tăng dần mỗi mẫu (cộng số hạng mới, trừ số hạng rời cửa sổ)
+ * - Chỉ xác nhận bước khi có chu kỳ ổn định (đi bộ/chạy thật sự)
+ * - Trả về số bước theo đợt khi một đợt đi bộ được xác nhận
+ */
+
+#pragma once
+#include <stdint.h>
+
+/**
+ * @class AutocorrStepCounter
+ * @brief Bộ đếm bước theo chu kỳ
+ *
+ * Khác với phát hiện đỉnh theo ngưỡng, các cú vung tay hay va chạm đơn lẻ
+ * không tạo ra tự tương quan cao nên không được đếm; dáng đi chậm (biên độ
+ * nhỏ) vẫn được đếm nếu đủ đều.
+ *
+ * Tự tương quan dùng số nguyên (mili-g) nên cộng/trừ trượt là chính xác,
+ * không bị trôi số như float. Chi phí mỗi mẫu sau giảm tần số: 2 × MAX_LAG
+ * phép nhân số nguyên.
+ */
+class AutocorrStepCounter
+{
+public:
+    /// @brief Constructor
+    AutocorrStepCounter();
+
+    /// @brief Reset cửa sổ, tự tương quan và trạng thái đợt đi bộ
+    void reset();
+
+    /// @brief Xử lý một mẫu độ lớn gia tốc (gọi ở tần số lấy mẫu gốc ~100 Hz)
+    /// @param magG Độ lớn gia tốc (g)
+    /// @return Số bước mới được xác nhận tại mẫu này (thường là 0)
+    uint32_t process(float magG);
+
+    /// @brief Chu kỳ bước hiện tại (số mẫu sau giảm tần số, 0 = không đi)
+    uint8_t getPeriod() const;
+
+    /// @brief Kiểm tra xem đang trong một đợt đi bộ đã xác nhận không
+    bool isWalking() const;
+
+private:
+    /// @brief Thêm một mẫu đã giảm tần số vào cửa sổ và cập nhật tự tương quan
+    void push(int16_t x);
+
+    /// @brief Tìm chu kỳ tốt nhất và cập nhật trạng thái đợt đi bộ
+    /// @return Số bước được xác nhận
+    uint32_t evaluate();
+
+    static const uint8_t DECIMATION = 4;    ///< 100 Hz → 25 Hz
+    static const uint8_t WINDOW = 64;       ///< Độ dài cửa sổ (mẫu, ~2.5 s)
+    static const uint8_t MIN_LAG = 6;       ///< Chu kỳ ngắn nhất (0.24 s ~ 250 bước/phút)
+    static const uint8_t MAX_LAG = 32;      ///< Chu kỳ dài nhất (1.28 s ~ 47 bước/phút)
+    static const uint8_t HISTORY = 128;     ///< Kích thước lịch sử (> WINDOW + MAX_LAG, lũy thừa 2)
+    static const uint8_t EVAL_INTERVAL = 8; ///< Số mẫu giữa hai lần đánh giá chu kỳ
+    static const uint8_t CONFIRM_EVALS = 6; ///< Số lần đánh giá liên tiếp ổn định để xác nhận (~2 s)
+
+    int16_t history_[HISTORY]; ///< Lịch sử mẫu đã bỏ DC (mili-g)
+    uint32_t total_;           ///< Tổng số mẫu đã nhận (sau giảm tần số)
+    int32_t acf_[MAX_LAG + 1]; ///< Tự tương quan theo lag trên cửa sổ trượt
+
+    bool primed_;        ///< Đã khởi tạo trung bình từ mẫu đầu tiên chưa
+    float mean_;         ///< Trung bình trượt của độ lớn (g) để bỏ DC
+    float decimAcc_;     ///< Tổng tích lũy cho giảm tần số
+    uint8_t decimCount_; ///< Số mẫu gốc trong tổng tích lũy
+    uint8_t evalCount_;  ///< Số mẫu kể từ lần đánh giá trước
+
+    uint8_t period_;      ///< Chu kỳ đang theo dõi (0 = không có)
+    uint8_t stableEvals_; ///< Số lần đánh giá liên tiếp có chu kỳ ổn định
+    bool walking_;        ///< Đợt đi bộ đã được xác nhận
+    float pendingSteps_;  ///< Bước tích lũy (phân số) chưa phát ra
+};
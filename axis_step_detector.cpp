@@ -0,0 +1,181 @@
+/**
+ * @file axis_step_detector.cpp
+ * @brief Triển khai bộ phát hiện bước theo trục chuyển động chính
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#include "axis_step_detector.h"
+#include <math.h>
+
+static constexpr float GRAVITY_ALPHA = 0.02f; ///< Hệ số low-pass trọng lực (~0.3 Hz ở 100 Hz)
+static constexpr float COV_BETA = 0.02f;      ///< Hệ số trượt của hiệp phương sai (~0.5 s)
+static constexpr float SMOOTH_ALPHA = 0.3f;   ///< Hệ số làm mượt tín hiệu chiếu
+
+/**
+ * @brief Constructor - khởi tạo trạng thái mặc định
+ */
+AxisStepDetector::AxisStepDetector()
+    : thresholdG_(0.20f), minIntervalMs_(300), lastStepMs_(0)
+{
+    reset();
+}
+
+/**
+ * @brief Reset bộ lọc trọng lực, hiệp phương sai và trạng thái phát hiện đỉnh
+ */
+void AxisStepDetector::reset()
+{
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        gravity_[i] = 0.0f;
+        axis_[i] = 0.0f;
+    }
+    axis_[2] = 1.0f;
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        cov_[i] = 0.0f;
+    }
+    primed_ = false;
+    samplesSinceAxis_ = 0;
+    projected_ = 0.0f;
+    prevProjected_ = 0.0f;
+    rising_ = false;
+}
+
+/**
+ * @brief Xử lý một mẫu gia tốc
+ *
+ * Quy trình:
+ * 1. g ← g + α(a - g)  (low-pass ước lượng trọng lực)
+ * 2. d = a - g         (gia tốc động)
+ * 3. C ← (1-β)C + β·d·dᵀ
+ * 4. Mỗi AXIS_UPDATE_INTERVAL mẫu: cập nhật trục chính v
+ * 5. p = d·v, làm mượt rồi phát hiện đỉnh (sườn lên → sườn xuống, vượt ngưỡng)
+ *
+ * @return true nếu phát hiện bước
+ */
+bool AxisStepDetector::process(float ax, float ay, float az, uint32_t nowMs)
+{
+    if (!primed_)
+    {
+        gravity_[0] = ax;
+        gravity_[1] = ay;
+        gravity_[2] = az;
+        primed_ = true;
+        return false;
+    }
+
+    gravity_[0] += GRAVITY_ALPHA * (ax - gravity_[0]);
+    gravity_[1] += GRAVITY_ALPHA * (ay - gravity_[1]);
+    gravity_[2] += GRAVITY_ALPHA * (az - gravity_[2]);
+
+    float dx = ax - gravity_[0];
+    float dy = ay - gravity_[1];
+    float dz = az - gravity_[2];
+
+    cov_[0] += COV_BETA * (dx * dx - cov_[0]);
+    cov_[1] += COV_BETA * (dy * dy - cov_[1]);
+    cov_[2] += COV_BETA * (dz * dz - cov_[2]);
+    cov_[3] += COV_BETA * (dx * dy - cov_[3]);
+    cov_[4] += COV_BETA * (dx * dz - cov_[4]);
+    cov_[5] += COV_BETA * (dy * dz - cov_[5]);
+
+    if (++samplesSinceAxis_ >= AXIS_UPDATE_INTERVAL)
+    {
+        updateAxis();
+        samplesSinceAxis_ = 0;
+    }
+
+    float p = dx * axis_[0] + dy * axis_[1] + dz * axis_[2];
+    projected_ += SMOOTH_ALPHA * (p - projected_);
+
+    bool step = false;
+
+    // Phát hiện sườn lên
+    if (projected_ > prevProjected_ && projected_ > 0)
+    {
+        rising_ = true;
+    }
+
+    // Phát hiện đỉnh thật sự (peak)
+    if (rising_ && projected_ < prevProjected_)
+    {
+        if (prevProjected_ > thresholdG_ && (nowMs - lastStepMs_) > minIntervalMs_)
+        {
+            lastStepMs_ = nowMs;
+            step = true;
+        }
+        rising_ = false;
+    }
+
+    prevProjected_ = projected_;
+    return step;
+}
+
+/**
+ * @brief Đặt ngưỡng phát hiện bước và khoảng cách tối thiểu
+ */
+void AxisStepDetector::setThreshold(float thresholdG, uint16_t minIntervalMs)
+{
+    thresholdG_ = thresholdG;
+    minIntervalMs_ = minIntervalMs;
+}
+
+float AxisStepDetector::getProjected() const { return projected_; }
+
+void AxisStepDetector::getAxis(float axis[3]) const
+{
+    axis[0] = axis_[0];
+    axis[1] = axis_[1];
+    axis[2] = axis_[2];
+}
+
+/**
+ * @brief Power iteration: v ← C·v / |C·v|
+ *
+ * Bắt đầu từ trục hiện tại nên chỉ cần vài vòng để hội tụ khi trục thay đổi chậm.
+ * Giữ dấu của trục ổn định (v_mới · v_cũ ≥ 0) để tín hiệu chiếu không bị đảo cực,
+ * tránh tạo ra đỉnh giả khi cập nhật trục.
+ */
+void AxisStepDetector::updateAxis()
+{
+    float v0 = axis_[0], v1 = axis_[1], v2 = axis_[2];
+
+    for (uint8_t it = 0; it < POWER_ITERATIONS; it++)
+    {
+        float w0 = cov_[0] * v0 + cov_[3] * v1 + cov_[4] * v2;
+        float w1 = cov_[3] * v0 + cov_[1] * v1 + cov_[5] * v2;
+        float w2 = cov_[4] * v0 + cov_[5] * v1 + cov_[2] * v2;
+
+        float norm = sqrtf(w0 * w0 + w1 * w1 + w2 * w2);
+        if (norm < 1e-9f)
+        {
+            // Trục hiện tại vuông góc với chuyển động: khởi động lại từ trục
+            // tọa độ có phương sai lớn nhất
+            uint8_t maxIdx = (cov_[0] >= cov_[1]) ? ((cov_[0] >= cov_[2]) ? 0 : 2)
+                                                  : ((cov_[1] >= cov_[2]) ? 1 : 2);
+            if (cov_[maxIdx] < 1e-9f || it > 0)
+                return; // Không có chuyển động - giữ nguyên trục
+            w0 = (maxIdx == 0) ? 1.0f : 0.0f;
+            w1 = (maxIdx == 1) ? 1.0f : 0.0f;
+            w2 = (maxIdx == 2) ? 1.0f : 0.0f;
+            norm = 1.0f;
+        }
+
+        v0 = w0 / norm;
+        v1 = w1 / norm;
+        v2 = w2 / norm;
+    }
+
+    if (v0 * axis_[0] + v1 * axis_[1] + v2 * axis_[2] < 0.0f)
+    {
+        v0 = -v0;
+        v1 = -v1;
+        v2 = -v2;
+    }
+
+    axis_[0] = v0;
+    axis_[1] = v1;
+    axis_[2] = v2;
+}
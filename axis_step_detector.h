@@ -0,0 +1,76 @@
+/**
+ * @file axis_step_detector.h
+ * @brief Phát hiện bước chân không phụ thuộc hướng đeo bằng chiếu lên trục chuyển động chính
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - Ước lượng vector trọng lực bằng bộ lọc low-pass trên từng trục
+ * - Tách gia tốc động (gia tốc - trọng lực)
+ * - Cập nhật ma trận hiệp phương sai 3x3 của gia tốc động theo kiểu trượt mũ
+ * - Tìm trục chuyển động chính bằng power iteration mỗi N mẫu
+ * - Phát hiện đỉnh trên tín hiệu đã chiếu lên trục chính
+ */
+
+#pragma once
+#include <stdint.h>
+
+/**
+ * @class AxisStepDetector
+ * @brief Bộ phát hiện bước trên tín hiệu chiếu lên trục chuyển động chính
+ *
+ * Khác với cách dùng độ lớn 3 trục (mất thông tin hướng, nhạy với xoay cổ tay),
+ * tín hiệu chiếu giữ dấu và tập trung năng lượng của chuyển động lặp lại,
+ * nên ngưỡng phát hiện ổn định hơn khi tay xoay.
+ *
+ * Chi phí mỗi mẫu: ~20 phép nhân/cộng float; power iteration (2 vòng nhân
+ * ma trận 3x3) chỉ chạy mỗi AXIS_UPDATE_INTERVAL mẫu.
+ */
+class AxisStepDetector
+{
+public:
+    /// @brief Constructor - trục mặc định là trục Z
+    AxisStepDetector();
+
+    /// @brief Reset trạng thái bộ lọc và trục chính
+    void reset();
+
+    /// @brief Xử lý một mẫu gia tốc
+    /// @param ax Gia tốc trục X (g)
+    /// @param ay Gia tốc trục Y (g)
+    /// @param az Gia tốc trục Z (g)
+    /// @param nowMs Thời điểm lấy mẫu (ms)
+    /// @return true nếu phát hiện một bước tại mẫu này
+    bool process(float ax, float ay, float az, uint32_t nowMs);
+
+    /// @brief Đặt ngưỡng phát hiện bước (g) và khoảng cách tối thiểu giữa hai bước (ms)
+    void setThreshold(float thresholdG, uint16_t minIntervalMs);
+
+    /// @brief Lấy giá trị tín hiệu đã chiếu gần nhất (g)
+    float getProjected() const;
+
+    /// @brief Lấy trục chuyển động chính hiện tại (vector đơn vị)
+    /// @param axis Mảng 3 phần tử nhận kết quả
+    void getAxis(float axis[3]) const;
+
+private:
+    /// @brief Cập nhật trục chính bằng power iteration trên ma trận hiệp phương sai
+    void updateAxis();
+
+    static const uint8_t AXIS_UPDATE_INTERVAL = 25; ///< Số mẫu giữa hai lần cập nhật trục
+    static const uint8_t POWER_ITERATIONS = 2;      ///< Số vòng power iteration mỗi lần cập nhật
+
+    float gravity_[3]; ///< Ước lượng vector trọng lực (g)
+    float cov_[6];     ///< Hiệp phương sai: xx, yy, zz, xy, xz, yz
+    float axis_[3];    ///< Trục chuyển động chính (đơn vị)
+    bool primed_;      ///< Đã khởi tạo trọng lực từ mẫu đầu tiên chưa
+
+    uint8_t samplesSinceAxis_; ///< Số mẫu kể từ lần cập nhật trục gần nhất
+    float projected_;          ///< Tín hiệu chiếu đã làm mượt
+    float prevProjected_;      ///< Tín hiệu chiếu của mẫu trước
+    bool rising_;              ///< Đang ở sườn lên
+
+    float thresholdG_;       ///< Ngưỡng đỉnh (g)
+    uint16_t minIntervalMs_; ///< Khoảng cách tối thiểu giữa hai bước (ms)
+    uint32_t lastStepMs_;    ///< Thời điểm bước cuối cùng
+};
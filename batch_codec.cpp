@@ -0,0 +1,691 @@
+/**
+ * @file batch_codec.cpp
+ * @brief Triển khai mã hóa/giải mã khung batch theo bảng trường
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#include "batch_codec.h"
+#include <string.h>
+
+static inline void putU16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void putU32(uint8_t *p, uint32_t v)
+{
+    putU16(p, (uint16_t)v);
+    putU16(p + 2, (uint16_t)(v >> 16));
+}
+
+static inline uint16_t getU16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t getU32(const uint8_t *p)
+{
+    return getU16(p) | ((uint32_t)getU16(p + 2) << 16);
+}
+
+static inline bool fitsUnsigned(uint32_t v, uint8_t bits)
+{
+    return bits >= 32 || v < (1u << bits);
+}
+
+static inline bool fitsSigned(int32_t v, uint8_t bits)
+{
+    return bits >= 32 || (v >= -(1 << (bits - 1)) && v < (1 << (bits - 1)));
+}
+
+static inline int32_t signExtend(uint32_t v, uint8_t bits)
+{
+    if (bits < 32 && (v & (1u << (bits - 1))))
+        v |= ~((1u << bits) - 1);
+    return (int32_t)v;
+}
+
+static inline uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static inline uint8_t bitWidth(uint32_t v)
+{
+    return v ? (uint8_t)(32 - __builtin_clz(v)) : 0;
+}
+
+/// @brief Độ dài header (kể cả khối hoạt động nếu có)
+static inline size_t headerSize(bool activity)
+{
+    return BATCH_HEADER_SIZE + (activity ? BATCH_ACTIVITY_SIZE : 0);
+}
+
+/**
+ * @brief Ghi header khung, bảng trường SAMPLE_SCHEMA và khối hoạt động (nếu có)
+ */
+static void putHeader(uint8_t *out, uint8_t flags, uint32_t seq, uint32_t epoch, const ActivityFields *activity)
+{
+    if (activity)
+        flags |= BATCH_FLAG_ACTIVITY;
+    out[0] = BATCH_FRAME_MAGIC;
+    out[1] = BATCH_FRAME_VERSION;
+    putU16(out + 2, 0);
+    out[4] = flags;
+    out[5] = SAMPLE_SCHEMA_VERSION;
+    out[6] = SAMPLE_SCHEMA_FIELDS;
+    putU32(out + 7, seq);
+    putU32(out + 11, epoch);
+    uint8_t *spec = out + BATCH_FIXED_HEADER;
+    for (uint8_t i = 0; i < SAMPLE_SCHEMA_FIELDS; i++, spec += BATCH_FIELD_SPEC_SIZE)
+    {
+        spec[0] = (uint8_t)((SAMPLE_SCHEMA[i].id << 4) | SAMPLE_SCHEMA[i].coding);
+        spec[1] = SAMPLE_SCHEMA[i].baseBits;
+        spec[2] = SAMPLE_SCHEMA[i].bits;
+    }
+    if (activity)
+    {
+        spec[0] = activity->cadence;
+        spec[1] = activity->met_x10;
+        putU16(spec + 2, activity->distance_m);
+        putU16(spec + 4, activity->energy_kcal_x10);
+    }
+}
+
+/**
+ * @brief Giá trị cột của một trường so với mẫu trước
+ * @param delta Vào: delta trước; ra: delta của mẫu này
+ */
+static inline uint32_t columnValue(const FieldSpec &spec, uint32_t value, uint32_t prev, int32_t &delta)
+{
+    int32_t d = (int32_t)(value - prev);
+    int32_t dod = (int32_t)((uint32_t)d - (uint32_t)delta);
+    delta = d;
+    switch (spec.coding)
+    {
+    case CODING_DELTA:
+        return zigzag(d);
+    case CODING_DELTA2:
+        return zigzag(dod);
+    default:
+        return value;
+    }
+}
+
+/// @brief Số byte dữ liệu của một cột n giá trị (không kể byte độ rộng)
+static inline size_t columnBytes(uint8_t baseBits, uint8_t width, uint16_t n)
+{
+    return n ? (baseBits + (size_t)(n - 1) * width + 7) / 8 : 0;
+}
+
+// ==================== BatchEncoder ====================
+
+BatchEncoder::BatchEncoder()
+    : out_(nullptr), capacity_(0), count_(0), seq_(0), epoch_(0), hasSeq_(false), hasActivity_(false)
+{
+    memset(values_, 0, sizeof(values_));
+    memset(deltas_, 0, sizeof(deltas_));
+    memset(&activity_, 0, sizeof(activity_));
+}
+
+void BatchEncoder::begin(uint8_t *out, size_t capacity)
+{
+    out_ = out;
+    capacity_ = capacity;
+    count_ = 0;
+    seq_ = 0;
+    epoch_ = 0;
+    hasSeq_ = false;
+    hasActivity_ = false;
+    memset(values_, 0, sizeof(values_));
+    memset(deltas_, 0, sizeof(deltas_));
+}
+
+void BatchEncoder::begin(uint8_t *out, size_t capacity, uint32_t firstSeq, uint32_t epoch)
+{
+    begin(out, capacity);
+    seq_ = firstSeq;
+    epoch_ = epoch;
+    hasSeq_ = true;
+}
+
+void BatchEncoder::setActivity(const ActivityFields &activity)
+{
+    if (count_ > 0)
+        return; // Header đã ghi
+    activity_ = activity;
+    hasActivity_ = true;
+}
+
+/**
+ * @brief Thêm một mẫu vào khung
+ *
+ * Mã hóa mọi trường trước, chọn bản ghi thường hay đầy đủ, rồi chỉ ghi khi
+ * đủ chỗ cho cả bản ghi, nên khung luôn ở trạng thái hợp lệ.
+ */
+bool BatchEncoder::add(const HealthDataPacket &sample)
+{
+    if (!out_ || count_ == 0xFFFF)
+        return false;
+
+    if (count_ == 0)
+    {
+        size_t header = headerSize(hasActivity_);
+        if (capacity_ < header)
+            return false;
+        putHeader(out_, hasSeq_ ? BATCH_FLAG_SEQUENCE : 0, seq_, epoch_, hasActivity_ ? &activity_ : nullptr);
+        bits_.begin(out_ + header, capacity_ - header);
+    }
+
+    uint32_t values[SAMPLE_SCHEMA_FIELDS];
+    uint32_t coded[SAMPLE_SCHEMA_FIELDS];
+    int32_t deltas[SAMPLE_SCHEMA_FIELDS];
+    bool full = (count_ == 0);
+
+    for (uint8_t i = 0; i < SAMPLE_SCHEMA_FIELDS; i++)
+    {
+        const FieldSpec &spec = SAMPLE_SCHEMA[i];
+        values[i] = sampleFieldGet(sample, spec.id);
+        deltas[i] = count_ ? (int32_t)(values[i] - values_[i]) : 0;
+
+        switch (spec.coding)
+        {
+        case CODING_DELTA:
+            coded[i] = (uint32_t)deltas[i];
+            full = full || !fitsSigned(deltas[i], spec.bits);
+            break;
+        case CODING_DELTA2:
+        {
+            int32_t dod = (int32_t)((uint32_t)deltas[i] - (uint32_t)deltas_[i]);
+            coded[i] = (uint32_t)dod;
+            full = full || !fitsSigned(dod, spec.bits);
+            break;
+        }
+        default:
+            coded[i] = values[i];
+            full = full || !fitsUnsigned(values[i], spec.bits);
+            break;
+        }
+    }
+
+    if (!bits_.fits(sampleRecordBits(full)))
+        return false;
+
+    bits_.write(full ? 1 : 0, 1);
+    for (uint8_t i = 0; i < SAMPLE_SCHEMA_FIELDS; i++)
+    {
+        if (full)
+            bits_.write(values[i], SAMPLE_SCHEMA[i].baseBits);
+        else
+            bits_.write(coded[i], SAMPLE_SCHEMA[i].bits);
+        values_[i] = values[i];
+        deltas_[i] = deltas[i];
+    }
+
+    count_++;
+    return true;
+}
+
+size_t BatchEncoder::finish()
+{
+    if (count_ == 0)
+        return 0;
+    putU16(out_ + 2, count_);
+    return size();
+}
+
+uint16_t BatchEncoder::count() const
+{
+    return count_;
+}
+
+size_t BatchEncoder::size() const
+{
+    return count_ ? headerSize(hasActivity_) + bits_.byteCount() : 0;
+}
+
+// ==================== BatchColumnEncoder ====================
+
+BatchColumnEncoder::BatchColumnEncoder()
+    : out_(nullptr), capacity_(0), count_(0), seq_(0), epoch_(0), hasSeq_(false), hasActivity_(false)
+{
+    memset(widths_, 0, sizeof(widths_));
+    memset(deltas_, 0, sizeof(deltas_));
+    memset(&activity_, 0, sizeof(activity_));
+}
+
+void BatchColumnEncoder::begin(uint8_t *out, size_t capacity)
+{
+    out_ = out;
+    capacity_ = capacity;
+    count_ = 0;
+    seq_ = 0;
+    epoch_ = 0;
+    hasSeq_ = false;
+    hasActivity_ = false;
+    memset(widths_, 0, sizeof(widths_));
+    memset(deltas_, 0, sizeof(deltas_));
+}
+
+void BatchColumnEncoder::begin(uint8_t *out, size_t capacity, uint32_t firstSeq, uint32_t epoch)
+{
+    begin(out, capacity);
+    seq_ = firstSeq;
+    epoch_ = epoch;
+    hasSeq_ = true;
+}
+
+void BatchColumnEncoder::setActivity(const ActivityFields &activity)
+{
+    if (count_ > 0)
+        return; // Độ rộng cột đã tính theo header không có khối hoạt động
+    activity_ = activity;
+    hasActivity_ = true;
+}
+
+/**
+ * @brief Thêm một mẫu: cập nhật độ rộng cột, chỉ nhận khi khung vẫn vừa
+ */
+bool BatchColumnEncoder::add(const HealthDataPacket &sample)
+{
+    if (!out_ || count_ >= BATCH_COLUMN_MAX_SAMPLES)
+        return false;
+
+    uint8_t widths[SAMPLE_SCHEMA_FIELDS];
+    int32_t deltas[SAMPLE_SCHEMA_FIELDS];
+    memcpy(widths, widths_, sizeof(widths));
+    memset(deltas, 0, sizeof(deltas));
+    if (count_ > 0)
+    {
+        const HealthDataPacket &prev = samples_[count_ - 1];
+        for (uint8_t i = 0; i < SAMPLE_SCHEMA_FIELDS; i++)
+        {
+            const FieldSpec &spec = SAMPLE_SCHEMA[i];
+            deltas[i] = deltas_[i];
+            uint32_t v = columnValue(spec, sampleFieldGet(sample, spec.id), sampleFieldGet(prev, spec.id), deltas[i]);
+            uint8_t w = bitWidth(v);
+            if (w > widths[i])
+                widths[i] = w;
+        }
+    }
+
+    if (sizeFor(count_ + 1, widths) > capacity_)
+        return false;
+
+    memcpy(widths_, widths, sizeof(widths_));
+    memcpy(deltas_, deltas, sizeof(deltas_));
+    samples_[count_++] = sample;
+    return true;
+}
+
+size_t BatchColumnEncoder::finish()
+{
+    if (count_ == 0)
+        return 0;
+
+    putHeader(out_, BATCH_FLAG_COLUMNAR | (hasSeq_ ? BATCH_FLAG_SEQUENCE : 0), seq_, epoch_, hasActivity_ ? &activity_ : nullptr);
+    putU16(out_ + 2, count_);
+
+    uint8_t *p = out_ + headerSize(hasActivity_);
+    for (uint8_t i = 0; i < SAMPLE_SCHEMA_FIELDS; i++)
+    {
+        const FieldSpec &spec = SAMPLE_SCHEMA[i];
+        size_t bytes = columnBytes(spec.baseBits, widths_[i], count_);
+        *p++ = widths_[i];
+
+        BitWriter column;
+        column.begin(p, bytes);
+        uint32_t prev = sampleFieldGet(samples_[0], spec.id);
+        int32_t delta = 0;
+        column.write(prev, spec.baseBits);
+        for (uint16_t j = 1; j < count_; j++)
+        {
+            uint32_t value = sampleFieldGet(samples_[j], spec.id);
+            column.write(columnValue(spec, value, prev, delta), widths_[i]);
+            prev = value;
+        }
+        p += bytes;
+    }
+    return size();
+}
+
+uint16_t BatchColumnEncoder::count() const
+{
+    return count_;
+}
+
+size_t BatchColumnEncoder::size() const
+{
+    return count_ ? sizeFor(count_, widths_) : 0;
+}
+
+size_t BatchColumnEncoder::sizeFor(uint16_t n, const uint8_t *widths) const
+{
+    size_t len = headerSize(hasActivity_);
+    for (uint8_t i = 0; i < SAMPLE_SCHEMA_FIELDS; i++)
+        len += 1 + columnBytes(SAMPLE_SCHEMA[i].baseBits, widths[i], n);
+    return len;
+}
+
+// ==================== BatchDecoder ====================
+
+BatchDecoder::BatchDecoder()
+    : fieldCount_(0), count_(0), decoded_(0), seq_(0), epoch_(0), schemaVersion_(0), hasSeq_(false),
+      columnar_(false), hasActivity_(false), error_(false)
+{
+    memset(&activity_, 0, sizeof(activity_));
+    memset(fields_, 0, sizeof(fields_));
+    memset(columnData_, 0, sizeof(columnData_));
+    memset(columnLen_, 0, sizeof(columnLen_));
+    memset(widths_, 0, sizeof(widths_));
+    memset(values_, 0, sizeof(values_));
+    memset(deltas_, 0, sizeof(deltas_));
+    memset(&cur_, 0, sizeof(cur_));
+}
+
+bool BatchDecoder::begin(const uint8_t *data, size_t len)
+{
+    fieldCount_ = 0;
+    count_ = 0;
+    decoded_ = 0;
+    seq_ = 0;
+    epoch_ = 0;
+    schemaVersion_ = 0;
+    hasSeq_ = false;
+    columnar_ = false;
+    hasActivity_ = false;
+    error_ = true;
+    memset(&activity_, 0, sizeof(activity_));
+    memset(values_, 0, sizeof(values_));
+    memset(deltas_, 0, sizeof(deltas_));
+    memset(&cur_, 0, sizeof(cur_));
+
+    if (!data || len < BATCH_FIXED_HEADER || data[0] != BATCH_FRAME_MAGIC || data[1] != BATCH_FRAME_VERSION)
+        return false;
+
+    uint8_t fieldCount = data[6];
+    size_t header = BATCH_FIXED_HEADER + (size_t)fieldCount * BATCH_FIELD_SPEC_SIZE;
+    if (fieldCount == 0 || fieldCount > SAMPLE_SCHEMA_MAX_FIELDS || len < header)
+        return false;
+
+    const uint8_t *spec = data + BATCH_FIXED_HEADER;
+    for (uint8_t i = 0; i < fieldCount; i++, spec += BATCH_FIELD_SPEC_SIZE)
+    {
+        FieldSpec &f = fields_[i];
+        f.id = spec[0] >> 4;
+        f.coding = spec[0] & 0x0F;
+        f.baseBits = spec[1];
+        f.bits = spec[2];
+        if (f.coding > CODING_DELTA2 || f.baseBits < 1 || f.baseBits > 32 || f.bits < 1 || f.bits > 32)
+            return false;
+    }
+
+    if (data[4] & BATCH_FLAG_ACTIVITY)
+    {
+        if (len < header + BATCH_ACTIVITY_SIZE)
+            return false;
+        activity_.cadence = spec[0];
+        activity_.met_x10 = spec[1];
+        activity_.distance_m = getU16(spec + 2);
+        activity_.energy_kcal_x10 = getU16(spec + 4);
+        header += BATCH_ACTIVITY_SIZE;
+    }
+
+    uint16_t count = getU16(data + 2);
+    if (data[4] & BATCH_FLAG_COLUMNAR)
+    {
+        // Kiểm tra mọi cột nằm trong khung trước khi nhận
+        const uint8_t *p = data + header;
+        const uint8_t *end = data + len;
+        for (uint8_t i = 0; i < fieldCount; i++)
+        {
+            if (p >= end || *p > 32)
+                return false;
+            widths_[i] = *p++;
+            size_t bytes = columnBytes(fields_[i].baseBits, widths_[i], count);
+            if ((size_t)(end - p) < bytes)
+                return false;
+            columnData_[i] = p;
+            columnLen_[i] = bytes;
+            columns_[i].begin(p, bytes);
+            p += bytes;
+        }
+        columnar_ = true;
+    }
+    else
+    {
+        bits_.begin(data + header, len - header);
+    }
+
+    fieldCount_ = fieldCount;
+    count_ = count;
+    hasSeq_ = (data[4] & BATCH_FLAG_SEQUENCE) != 0;
+    hasActivity_ = (data[4] & BATCH_FLAG_ACTIVITY) != 0;
+    schemaVersion_ = data[5];
+    seq_ = hasSeq_ ? getU32(data + 7) : 0;
+    epoch_ = hasSeq_ ? getU32(data + 11) : 0;
+    error_ = false;
+    return true;
+}
+
+/**
+ * @brief Giải mã một bản ghi theo bảng trường của khung
+ *
+ * Trường có mã lạ vẫn được đọc (để giữ đồng bộ vị trí bit) nhưng không
+ * được ghi vào mẫu; trường không có trong khung giữ giá trị 0.
+ */
+bool BatchDecoder::next(HealthDataPacket &out)
+{
+    if (error_ || decoded_ >= count_)
+        return false;
+
+    if (columnar_)
+        return nextColumnar(out);
+
+    uint32_t flag;
+    if (!bits_.read(flag, 1))
+    {
+        error_ = true;
+        return false;
+    }
+
+    for (uint8_t i = 0; i < fieldCount_; i++)
+    {
+        const FieldSpec &f = fields_[i];
+        uint32_t raw;
+        if (!bits_.read(raw, flag ? f.baseBits : f.bits))
+        {
+            error_ = true;
+            return false;
+        }
+
+        uint32_t value;
+        int32_t delta;
+        if (flag || f.coding == CODING_ABSOLUTE)
+        {
+            value = raw;
+            delta = decoded_ ? (int32_t)(value - values_[i]) : 0;
+        }
+        else if (f.coding == CODING_DELTA)
+        {
+            delta = signExtend(raw, f.bits);
+            value = values_[i] + (uint32_t)delta;
+        }
+        else
+        {
+            delta = (int32_t)((uint32_t)deltas_[i] + (uint32_t)signExtend(raw, f.bits));
+            value = values_[i] + (uint32_t)delta;
+        }
+
+        values_[i] = value;
+        deltas_[i] = delta;
+        sampleFieldSet(cur_, f.id, value);
+    }
+
+    decoded_++;
+    out = cur_;
+    return true;
+}
+
+/**
+ * @brief Giải mã mẫu kế tiếp từ các cột (một giá trị mỗi cột)
+ */
+bool BatchDecoder::nextColumnar(HealthDataPacket &out)
+{
+    for (uint8_t i = 0; i < fieldCount_; i++)
+    {
+        const FieldSpec &f = fields_[i];
+        uint32_t raw;
+        if (!columns_[i].read(raw, decoded_ ? widths_[i] : f.baseBits))
+        {
+            error_ = true;
+            return false;
+        }
+
+        uint32_t value;
+        int32_t delta;
+        if (decoded_ == 0 || f.coding == CODING_ABSOLUTE)
+        {
+            value = raw;
+            delta = decoded_ ? (int32_t)(value - values_[i]) : 0;
+        }
+        else if (f.coding == CODING_DELTA)
+        {
+            delta = unzigzag(raw);
+            value = values_[i] + (uint32_t)delta;
+        }
+        else
+        {
+            delta = (int32_t)((uint32_t)deltas_[i] + (uint32_t)unzigzag(raw));
+            value = values_[i] + (uint32_t)delta;
+        }
+
+        values_[i] = value;
+        deltas_[i] = delta;
+        sampleFieldSet(cur_, f.id, value);
+    }
+
+    decoded_++;
+    out = cur_;
+    return true;
+}
+
+/**
+ * @brief Giải mã cả một cột bằng hai vòng lặp không rẽ nhánh
+ *
+ * Vòng 1 giải nén các giá trị w bit (đọc 8 byte little-endian rồi dịch),
+ * vòng 2 cộng dồn theo coding. Giá trị cuối cột dùng đường chậm để không
+ * đọc quá khung.
+ */
+uint16_t BatchDecoder::decodeColumn(uint8_t index, uint32_t *out, uint16_t maxCount) const
+{
+    if (!columnar_ || error_ || index >= fieldCount_ || count_ == 0)
+        return 0;
+
+    const FieldSpec &f = fields_[index];
+    const uint8_t *data = columnData_[index];
+    size_t len = columnLen_[index];
+    uint8_t width = widths_[index];
+    uint16_t n = count_ < maxCount ? count_ : maxCount;
+    if (n == 0)
+        return 0;
+
+    BitReader head;
+    head.begin(data, len);
+    head.read(out[0], f.baseBits);
+
+    uint64_t mask = (width == 32) ? 0xFFFFFFFFull : ((1ull << width) - 1);
+    size_t bit = f.baseBits;
+    uint16_t j = 1;
+    for (; j < n && (bit >> 3) + 8 <= len; j++, bit += width)
+    {
+        uint64_t word;
+        memcpy(&word, data + (bit >> 3), sizeof(word));
+        out[j] = (uint32_t)((word >> (bit & 7)) & mask);
+    }
+    for (; j < n; j++, bit += width)
+    {
+        uint64_t word = 0;
+        for (size_t b = bit >> 3, k = 0; b < len && k < 8; b++, k++)
+            word |= (uint64_t)data[b] << (8 * k);
+        out[j] = (uint32_t)((word >> (bit & 7)) & mask);
+    }
+
+    if (f.coding == CODING_DELTA)
+    {
+        for (j = 1; j < n; j++)
+            out[j] = out[j - 1] + (uint32_t)unzigzag(out[j]);
+    }
+    else if (f.coding == CODING_DELTA2)
+    {
+        uint32_t delta = 0;
+        for (j = 1; j < n; j++)
+        {
+            delta += (uint32_t)unzigzag(out[j]);
+            out[j] = out[j - 1] + delta;
+        }
+    }
+    return n;
+}
+
+uint8_t BatchDecoder::fieldId(uint8_t index) const
+{
+    return index < fieldCount_ ? fields_[index].id : 0xFF;
+}
+
+uint8_t BatchDecoder::fieldCount() const
+{
+    return fieldCount_;
+}
+
+bool BatchDecoder::columnar() const
+{
+    return columnar_;
+}
+
+uint16_t BatchDecoder::count() const
+{
+    return count_;
+}
+
+bool BatchDecoder::hasSequence() const
+{
+    return hasSeq_;
+}
+
+uint32_t BatchDecoder::sequence() const
+{
+    return seq_;
+}
+
+uint32_t BatchDecoder::epoch() const
+{
+    return epoch_;
+}
+
+uint8_t BatchDecoder::schemaVersion() const
+{
+    return schemaVersion_;
+}
+
+bool BatchDecoder::hasActivity() const
+{
+    return hasActivity_;
+}
+
+const ActivityFields &BatchDecoder::activity() const
+{
+    return activity_;
+}
+
+bool BatchDecoder::error() const
+{
+    return error_;
+}
@@ -0,0 +1,250 @@
+/**
+ * @file batch_codec.h
+ * @brief Mã hóa/giải mã khung batch HealthDataPacket theo bảng trường (bit-packed)
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Khung phiên bản 4 (little-endian):
+ * - Header: magic 0xA5, version, count (u16), flags (bit0 = có số thứ tự),
+ *   phiên bản schema, số trường F, số thứ tự mẫu đầu (u32, 0 nếu không có),
+ *   epoch đồng bộ (u32, 0 nếu không có), rồi F mô tả trường 3 byte:
+ *   (id << 4 | coding), baseBits, bits
+ * - Nếu flags bit2: khối hoạt động 6 byte ngay sau các mô tả trường: cadence
+ *   (u8, bước/phút), MET × 10 (u8), quãng đường trong ngày (u16, m), năng
+ *   lượng trong ngày (u16, kcal × 10) - giá trị lúc mã hóa khung, để chế độ
+ *   batch không cần stream thời gian thực mới có số liệu hoạt động
+ * - Bản ghi nối tiếp nhau theo bit (LSB trước), không căn byte:
+ *   1 bit cờ rồi các trường theo thứ tự trong header
+ *   - Cờ = 1 (bản ghi đầy đủ): mỗi trường tuyệt đối, baseBits bit. Luôn dùng
+ *     cho mẫu đầu và khi một trường không vừa độ rộng delta (nhảy thời gian,
+ *     reset bước...)
+ *   - Cờ = 0: mỗi trường theo coding của nó, bits bit (delta có dấu bù 2)
+ * - Mẫu thứ i của khung đồng bộ có số thứ tự seq + i. Số thứ tự bắt đầu lại
+ *   từ 1 mỗi lần khởi động; epoch là số ngẫu nhiên chọn lúc khởi động, nên
+ *   bên nhận so (epoch, seq) chứ không chỉ seq: epoch khác với lần trước thì
+ *   bỏ con trỏ đã nhận và bắt đầu lại từ seq của khung
+ *
+ * Với SAMPLE_SCHEMA hiện tại, mẫu thông thường tốn 17 bit. Bộ giải mã đọc bảng
+ * trường từ header nên không giả định định dạng; trường có mã lạ được đọc rồi
+ * bỏ qua. Bộ mã hóa làm việc theo luồng: thêm từng mẫu cho đến khi khung đầy.
+ *
+ * Bố cục cột (flags bit1, BatchColumnEncoder): cùng header, sau đó mỗi trường
+ * là một khối cột liền nhau, căn byte, theo thứ tự trong header:
+ * - Độ rộng w (u8, 0..32) chung cho cả cột
+ * - Giá trị đầu tuyệt đối (baseBits bit)
+ * - count - 1 giá trị w bit: zigzag của delta / delta-of-delta theo coding
+ *   (trường CODING_ABSOLUTE: giá trị tuyệt đối)
+ * Mỗi cột có độ rộng cố định nên bên nhận giải nén và cộng dồn từng cột bằng
+ * vòng lặp không rẽ nhánh (vector hóa được), và các giá trị giống nhau nằm
+ * liền nhau cho bộ nén phía sau.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "health_data_packet.h"
+#include "sample_schema.h"
+
+#define BATCH_FRAME_MAGIC 0xA5      ///< Byte đầu khung
+#define BATCH_FRAME_VERSION 4       ///< Phiên bản định dạng (bảng trường + khối hoạt động)
+#define BATCH_FLAG_SEQUENCE 0x01    ///< Khung có số thứ tự (giao thức đồng bộ)
+#define BATCH_FLAG_COLUMNAR 0x02    ///< Bố cục cột
+#define BATCH_FLAG_ACTIVITY 0x04    ///< Có khối hoạt động sau các mô tả trường
+#define BATCH_ACTIVITY_SIZE 6       ///< Kích thước khối hoạt động
+#define BATCH_COLUMN_MAX_SAMPLES 64 ///< Số mẫu tối đa của một khung cột
+#define BATCH_FIXED_HEADER 15       ///< Phần header trước các mô tả trường
+#define BATCH_FIELD_SPEC_SIZE 3     ///< Kích thước mô tả một trường
+
+/// @brief Header khung mã hóa bằng SAMPLE_SCHEMA
+#define BATCH_HEADER_SIZE (BATCH_FIXED_HEADER + SAMPLE_SCHEMA_FIELDS * BATCH_FIELD_SPEC_SIZE)
+
+/// @brief Kích thước khung đủ cho n mẫu trong trường hợp xấu nhất (mọi bản ghi đầy đủ, có khối hoạt động)
+#define BATCH_FRAME_CAPACITY(n) (BATCH_HEADER_SIZE + BATCH_ACTIVITY_SIZE + ((n) * sampleRecordBits(true) + 7) / 8)
+
+/**
+ * @class BatchEncoder
+ * @brief Mã hóa luồng mẫu vào một khung có kích thước giới hạn
+ */
+class BatchEncoder
+{
+public:
+    BatchEncoder();
+
+    /// @brief Bắt đầu khung mới
+    /// @param out Bộ đệm khung
+    /// @param capacity Kích thước bộ đệm (>= BATCH_HEADER_SIZE + một bản ghi đầy đủ)
+    void begin(uint8_t *out, size_t capacity);
+
+    /// @brief Bắt đầu khung đồng bộ (có số thứ tự)
+    /// @param out Bộ đệm khung
+    /// @param capacity Kích thước bộ đệm (>= BATCH_HEADER_SIZE + một bản ghi đầy đủ)
+    /// @param firstSeq Số thứ tự của mẫu đầu tiên
+    /// @param epoch Epoch đồng bộ của lần khởi động hiện tại
+    void begin(uint8_t *out, size_t capacity, uint32_t firstSeq, uint32_t epoch = 0);
+
+    /// @brief Gửi kèm khối hoạt động (gọi sau begin(), trước mẫu đầu tiên)
+    void setActivity(const ActivityFields &activity);
+
+    /// @brief Thêm một mẫu
+    /// @return false nếu khung không còn chỗ (mẫu chưa được thêm)
+    bool add(const HealthDataPacket &sample);
+
+    /// @brief Đóng khung (ghi số mẫu vào header)
+    /// @return Độ dài khung (0 nếu chưa có mẫu)
+    size_t finish();
+
+    /// @brief Số mẫu trong khung
+    uint16_t count() const;
+
+    /// @brief Số byte đã dùng
+    size_t size() const;
+
+private:
+    uint8_t *out_;                          ///< Bộ đệm khung
+    size_t capacity_;                       ///< Kích thước bộ đệm
+    BitWriter bits_;                        ///< Ghi bản ghi sau header
+    uint16_t count_;                        ///< Số mẫu
+    uint32_t values_[SAMPLE_SCHEMA_FIELDS]; ///< Giá trị trước của từng trường
+    int32_t deltas_[SAMPLE_SCHEMA_FIELDS];  ///< Delta trước (trường delta-of-delta)
+    uint32_t seq_;                          ///< Số thứ tự mẫu đầu
+    uint32_t epoch_;                        ///< Epoch đồng bộ
+    bool hasSeq_;                           ///< Khung có số thứ tự
+    ActivityFields activity_;               ///< Khối hoạt động
+    bool hasActivity_;                      ///< Khung có khối hoạt động
+};
+
+/**
+ * @class BatchColumnEncoder
+ * @brief Mã hóa khung bố cục cột
+ *
+ * Cùng giao diện với BatchEncoder. Độ rộng mỗi cột phụ thuộc mọi mẫu trong
+ * khung nên mẫu được giữ lại (tối đa BATCH_COLUMN_MAX_SAMPLES) và các cột
+ * chỉ được ghi khi finish().
+ */
+class BatchColumnEncoder
+{
+public:
+    BatchColumnEncoder();
+
+    /// @brief Bắt đầu khung mới
+    void begin(uint8_t *out, size_t capacity);
+
+    /// @brief Bắt đầu khung đồng bộ (có số thứ tự và epoch)
+    void begin(uint8_t *out, size_t capacity, uint32_t firstSeq, uint32_t epoch = 0);
+
+    /// @brief Gửi kèm khối hoạt động (gọi sau begin(), trước mẫu đầu tiên)
+    void setActivity(const ActivityFields &activity);
+
+    /// @brief Thêm một mẫu
+    /// @return false nếu khung không còn chỗ hoặc đã đủ BATCH_COLUMN_MAX_SAMPLES
+    bool add(const HealthDataPacket &sample);
+
+    /// @brief Ghi header và các cột
+    /// @return Độ dài khung (0 nếu chưa có mẫu)
+    size_t finish();
+
+    /// @brief Số mẫu trong khung
+    uint16_t count() const;
+
+    /// @brief Độ dài khung khi finish()
+    size_t size() const;
+
+private:
+    /// @brief Độ dài khung với n mẫu và độ rộng cột widths
+    size_t sizeFor(uint16_t n, const uint8_t *widths) const;
+
+    uint8_t *out_;                                       ///< Bộ đệm khung
+    size_t capacity_;                                    ///< Kích thước bộ đệm
+    HealthDataPacket samples_[BATCH_COLUMN_MAX_SAMPLES]; ///< Mẫu chờ ghi
+    uint16_t count_;                                     ///< Số mẫu
+    uint8_t widths_[SAMPLE_SCHEMA_FIELDS];               ///< Độ rộng từng cột
+    int32_t deltas_[SAMPLE_SCHEMA_FIELDS];               ///< Delta trước (trường delta-of-delta)
+    uint32_t seq_;                                       ///< Số thứ tự mẫu đầu
+    uint32_t epoch_;                                     ///< Epoch đồng bộ
+    bool hasSeq_;                                        ///< Khung có số thứ tự
+    ActivityFields activity_;                            ///< Khối hoạt động
+    bool hasActivity_;                                   ///< Khung có khối hoạt động
+};
+
+/**
+ * @class BatchDecoder
+ * @brief Giải mã khung batch cả hai bố cục (dùng trên điện thoại/host)
+ */
+class BatchDecoder
+{
+public:
+    BatchDecoder();
+
+    /// @brief Kiểm tra header, đọc bảng trường và chuẩn bị giải mã
+    /// @return false nếu sai magic/phiên bản, bảng trường không hợp lệ hoặc khung quá ngắn
+    bool begin(const uint8_t *data, size_t len);
+
+    /// @brief Giải mã mẫu kế tiếp
+    /// @return false khi hết mẫu hoặc khung bị cắt cụt
+    bool next(HealthDataPacket &out);
+
+    /// @brief Số mẫu khai báo trong header
+    uint16_t count() const;
+
+    /// @brief Khung có số thứ tự
+    bool hasSequence() const;
+
+    /// @brief Số thứ tự của mẫu đầu tiên (0 nếu không có)
+    uint32_t sequence() const;
+
+    /// @brief Epoch đồng bộ (0 nếu không có); đổi epoch nghĩa là thiết bị đã khởi động lại
+    uint32_t epoch() const;
+
+    /// @brief Khung bố cục cột
+    bool columnar() const;
+
+    /// @brief Giải mã cả một cột (chỉ khung cột)
+    /// @param index Vị trí trường trong header
+    /// @param out Mảng giá trị đầu ra (tối đa count() phần tử)
+    /// @param maxCount Kích thước mảng
+    /// @return Số giá trị đã ghi (0 nếu không phải khung cột hoặc index sai)
+    uint16_t decodeColumn(uint8_t index, uint32_t *out, uint16_t maxCount) const;
+
+    /// @brief Mã trường (SampleFieldId) ở vị trí index trong header
+    uint8_t fieldId(uint8_t index) const;
+
+    /// @brief Số trường trong header
+    uint8_t fieldCount() const;
+
+    /// @brief Phiên bản schema ghi trong header
+    uint8_t schemaVersion() const;
+
+    /// @brief Khung có khối hoạt động
+    bool hasActivity() const;
+
+    /// @brief Khối hoạt động (0 hết nếu không có)
+    const ActivityFields &activity() const;
+
+    /// @brief Khung bị cắt cụt/hỏng khi giải mã
+    bool error() const;
+
+private:
+    /// @brief Giải mã mẫu kế tiếp từ khung bố cục cột
+    bool nextColumnar(HealthDataPacket &out);
+
+    FieldSpec fields_[SAMPLE_SCHEMA_MAX_FIELDS];          ///< Bảng trường đọc từ header
+    uint32_t values_[SAMPLE_SCHEMA_MAX_FIELDS];           ///< Giá trị trước của từng trường
+    int32_t deltas_[SAMPLE_SCHEMA_MAX_FIELDS];            ///< Delta trước (trường delta-of-delta)
+    uint8_t fieldCount_;                                  ///< Số trường
+    BitReader bits_;                                      ///< Đọc bản ghi sau header (bố cục hàng)
+    BitReader columns_[SAMPLE_SCHEMA_MAX_FIELDS];         ///< Đọc từng cột (bố cục cột)
+    const uint8_t *columnData_[SAMPLE_SCHEMA_MAX_FIELDS]; ///< Đầu dữ liệu cột (sau byte độ rộng)
+    size_t columnLen_[SAMPLE_SCHEMA_MAX_FIELDS];          ///< Độ dài dữ liệu cột (bytes)
+    uint8_t widths_[SAMPLE_SCHEMA_MAX_FIELDS];            ///< Độ rộng từng cột
+    HealthDataPacket cur_;                                ///< Mẫu vừa giải mã
+    ActivityFields activity_;                             ///< Khối hoạt động
+    uint16_t count_;                                      ///< Số mẫu khai báo
+    uint16_t decoded_;                                    ///< Số mẫu đã giải mã
+    uint32_t seq_;                                        ///< Số thứ tự mẫu đầu
+    uint32_t epoch_;                                      ///< Epoch đồng bộ
+    uint8_t schemaVersion_;                               ///< Phiên bản schema
+    bool hasSeq_;                                         ///< Khung có số thứ tự
+    bool columnar_;                                       ///< Khung bố cục cột
+    bool hasActivity_;                                    ///< Khung có khối hoạt động
+    bool error_;                                          ///< Khung hỏng
+};
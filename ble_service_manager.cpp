@@ -6,22 +6,50 @@
  */
 
 #include "ble_service_manager.h"
+#include "board_config.h"
 #include <sys/time.h>
 #include <time.h>
 
+BLEServiceManager *BLEServiceManager::instance_ = nullptr;
+
+// Dữ liệu WRITE từ ứng dụng: little-endian, không giả định căn chỉnh
+static inline uint32_t getU32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline float getF32(const uint8_t *p)
+{
+    uint32_t bits = getU32(p);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
 /**
  * @brief Constructor - khởi tạo các biến thành viên và giá trị mặc định
  */
-BLEServiceManager::BLEServiceManager()
-    : pServer_(nullptr), pUserProfileService_(nullptr), pHealthDataService_(nullptr),
-      pBatteryService_(nullptr), pBmiChar_(nullptr), pStepCountEnabledChar_(nullptr),
+BLEServiceManager::BLEServiceManager(hal::Clock &clock, hal::Logger &log)
+    : clock_(clock), log_(log), pServer_(nullptr), pUserProfileService_(nullptr), pHealthDataService_(nullptr),
+      pBatteryService_(nullptr), pBmiChar_(nullptr), pHeightChar_(nullptr), pStepCountEnabledChar_(nullptr),
       pHealthDataBatchChar_(nullptr), pMLEnabledChar_(nullptr), pBatteryLevelChar_(nullptr),
-      pTimeSyncChar_(nullptr), pDataTransmissionModeChar_(nullptr),
+      pTimeSyncChar_(nullptr), pDataTransmissionModeChar_(nullptr), pStepDetectorChar_(nullptr),
+      pDeadbandChar_(nullptr),
+      pI2CTraceChar_(nullptr), pRollupChar_(nullptr), pSyncControlChar_(nullptr),
       clientConnected_(false), stepCountEnabled_(true), mlEnabled_(true),
-      dataTransmissionMode_(MODE_REALTIME), lastActivityMs_(0)
+      dataTransmissionMode_(MODE_REALTIME), stepDetectorMode_(STEP_DETECTOR_MAGNITUDE),
+      rollupRequested_(false), rollupLevel_(ROLLUP_MINUTE), syncAckPending_(false), syncAckSeq_(0), syncEpoch_(0),
+      lastActivityMs_(0), notifyStatus_(SUCCESS_NOTIFY), pacer_(*this, clock, log), bulkTransfer_(false),
+      writeRouteCount_(0)
 {
+    memset(peerAddr_, 0, sizeof(peerAddr_));
+    memset(&link_, 0, sizeof(link_));
+
     // Khởi tạo hồ sơ người dùng mặc định
-    userProfile_.bmi = 25.003625;
+    userProfile_.bmi = USER_DEFAULT_BMI;
+
+    // Cấu hình deadband mặc định (board_config.h)
+    deadbandConfig_ = DeadbandFilter().config();
 }
 
 /**
@@ -39,7 +67,7 @@ BLEServiceManager::BLEServiceManager()
  */
 bool BLEServiceManager::begin(const char *deviceName)
 {
-    Serial.println("[BLE] Initializing BLE...");
+    log_.println("[BLE] Initializing BLE...");
 
     // Khởi tạo thiết bị BLE
     BLEDevice::init(deviceName);
@@ -48,6 +76,12 @@ bool BLEServiceManager::begin(const char *deviceName)
     pServer_ = BLEDevice::createServer();
     pServer_->setCallbacks(this);
 
+    // Sự kiện nghẽn hàng đợi notification và tham số kết nối được cấp không có
+    // callback riêng trong thư viện
+    instance_ = this;
+    BLEDevice::setCustomGattsHandler(gattsEventHandler);
+    BLEDevice::setCustomGapHandler(gapEventHandler);
+
     // === Tạo User Profile Service ===
     pUserProfileService_ = pServer_->createService(USER_PROFILE_SERVICE_UUID);
 
@@ -55,15 +89,23 @@ bool BLEServiceManager::begin(const char *deviceName)
     pBmiChar_ = pUserProfileService_->createCharacteristic(
         BMI_CHAR_UUID,
         BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE);
-    pBmiChar_->setCallbacks(this);
+    addWriteRoute(pBmiChar_, &BLEServiceManager::onBmiWrite, sizeof(float));
     float defaultBmi = userProfile_.bmi;
     pBmiChar_->setValue((uint8_t *)&defaultBmi, sizeof(float));
 
+    // Characteristic: Chiều cao (m) (READ + WRITE)
+    pHeightChar_ = pUserProfileService_->createCharacteristic(
+        HEIGHT_CHAR_UUID,
+        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE);
+    addWriteRoute(pHeightChar_, &BLEServiceManager::onHeightWrite, sizeof(float));
+    float defaultHeight = userProfile_.height_m;
+    pHeightChar_->setValue((uint8_t *)&defaultHeight, sizeof(float));
+
     // Characteristic: Bật/tắt đếm bước (READ + WRITE)
     pStepCountEnabledChar_ = pUserProfileService_->createCharacteristic(
         STEP_COUNT_ENABLED_CHAR_UUID,
         BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE);
-    pStepCountEnabledChar_->setCallbacks(this);
+    addWriteRoute(pStepCountEnabledChar_, &BLEServiceManager::onStepCountEnabledWrite, 1);
     uint8_t defaultStepEnabled = stepCountEnabled_ ? 1 : 0;
     pStepCountEnabledChar_->setValue(&defaultStepEnabled, 1);
 
@@ -71,7 +113,7 @@ bool BLEServiceManager::begin(const char *deviceName)
     pMLEnabledChar_ = pUserProfileService_->createCharacteristic(
         ML_ENABLED_CHAR_UUID,
         BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE);
-    pMLEnabledChar_->setCallbacks(this);
+    addWriteRoute(pMLEnabledChar_, &BLEServiceManager::onMLEnabledWrite, 1);
     uint8_t defaultMLEnabled = mlEnabled_ ? 1 : 0;
     pMLEnabledChar_->setValue(&defaultMLEnabled, 1);
 
@@ -79,16 +121,31 @@ bool BLEServiceManager::begin(const char *deviceName)
     pTimeSyncChar_ = pUserProfileService_->createCharacteristic(
         TIME_SYNC_CHAR_UUID,
         BLECharacteristic::PROPERTY_WRITE);
-    pTimeSyncChar_->setCallbacks(this);
+    addWriteRoute(pTimeSyncChar_, &BLEServiceManager::onTimeSyncWrite, sizeof(uint32_t));
 
     // Characteristic: Chế độ truyền dữ liệu (READ + WRITE)
     pDataTransmissionModeChar_ = pUserProfileService_->createCharacteristic(
         DATA_TRANSMISSION_MODE_CHAR_UUID,
         BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE);
-    pDataTransmissionModeChar_->setCallbacks(this);
+    addWriteRoute(pDataTransmissionModeChar_, &BLEServiceManager::onTransmissionModeWrite, 1);
     uint8_t defaultMode = (uint8_t)dataTransmissionMode_;
     pDataTransmissionModeChar_->setValue(&defaultMode, 1);
 
+    // Characteristic: Thuật toán đếm bước (READ + WRITE)
+    pStepDetectorChar_ = pUserProfileService_->createCharacteristic(
+        STEP_DETECTOR_CHAR_UUID,
+        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE);
+    addWriteRoute(pStepDetectorChar_, &BLEServiceManager::onStepDetectorWrite, 1);
+    uint8_t defaultDetector = (uint8_t)stepDetectorMode_;
+    pStepDetectorChar_->setValue(&defaultDetector, 1);
+
+    // Characteristic: Cấu hình deadband (READ + WRITE)
+    pDeadbandChar_ = pUserProfileService_->createCharacteristic(
+        DEADBAND_CHAR_UUID,
+        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE);
+    addWriteRoute(pDeadbandChar_, &BLEServiceManager::onDeadbandWrite, sizeof(DeadbandConfig));
+    pDeadbandChar_->setValue((uint8_t *)&deadbandConfig_, sizeof(DeadbandConfig));
+
     pUserProfileService_->start();
 
     // === Tạo Health Data Service ===
@@ -99,8 +156,28 @@ bool BLEServiceManager::begin(const char *deviceName)
     pHealthDataBatchChar_ = pHealthDataService_->createCharacteristic(
         HEALTH_DATA_BATCH_CHAR_UUID,
         BLECharacteristic::PROPERTY_NOTIFY);
+    pHealthDataBatchChar_->setCallbacks(this);
     pHealthDataBatchChar_->addDescriptor(new BLE2902());
 
+    // Characteristic: Vết giao dịch I2C (READ) - chẩn đoán tốc độ bus / chu kỳ xả FIFO
+    pI2CTraceChar_ = pHealthDataService_->createCharacteristic(
+        I2C_TRACE_CHAR_UUID,
+        BLECharacteristic::PROPERTY_READ);
+
+    // Characteristic: Tổng hợp phút/giờ (WRITE yêu cầu + NOTIFY kết quả)
+    pRollupChar_ = pHealthDataService_->createCharacteristic(
+        ROLLUP_CHAR_UUID,
+        BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_NOTIFY);
+    addWriteRoute(pRollupChar_, &BLEServiceManager::onRollupWrite, 1);
+    pRollupChar_->addDescriptor(new BLE2902());
+
+    // Characteristic: Điều khiển đồng bộ batch (WRITE ack + READ trạng thái)
+    pSyncControlChar_ = pHealthDataService_->createCharacteristic(
+        SYNC_CONTROL_CHAR_UUID,
+        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE);
+    addWriteRoute(pSyncControlChar_, &BLEServiceManager::onSyncAckWrite, sizeof(uint32_t));
+    updateSyncState(0, 1, 1);
+
     pHealthDataService_->start();
 
     // === Battery Service ===
@@ -121,12 +198,13 @@ bool BLEServiceManager::begin(const char *deviceName)
     pAdvertising->addServiceUUID(HEALTH_DATA_SERVICE_UUID);
     pAdvertising->addServiceUUID(BATTERY_SERVICE_UUID);
     pAdvertising->setScanResponse(true);
-    pAdvertising->setMinPreferred(0x06); // Cải thiện tương thích với iPhone
-    pAdvertising->setMinPreferred(0x12);
+    // Khoảng kết nối ưu tiên quảng cáo trong scan response (iPhone dùng khi kết nối)
+    pAdvertising->setMinPreferred(BLE_CONN_REALTIME_MIN_INTERVAL);
+    pAdvertising->setMaxPreferred(BLE_CONN_REALTIME_MAX_INTERVAL);
     BLEDevice::startAdvertising();
 
-    Serial.println("[BLE] BLE initialized and advertising started.");
-    Serial.printf("[BLE] Device Name: %s\n", deviceName);
+    log_.println("[BLE] BLE initialized and advertising started.");
+    log_.printf("[BLE] Device Name: %s\n", deviceName);
 
     return true;
 }
@@ -135,21 +213,65 @@ bool BLEServiceManager::begin(const char *deviceName)
  * @brief Callback được gọi khi ứng dụng di động kết nối
  *
  * Xử lý:
- * 1. Cập nhật cờ kết nối
- * 2. Tăng MTU (Maximum Transmission Unit) lên 512 bytes
- *    để có thể gửi các dữ liệu JSON dài mà không cần phân chia
+ * 1. Cập nhật cờ kết nối, bắt đầu phiên đo thông lượng mới
+ * 2. Đề nghị MTU 512 bytes. Đây chỉ là yêu cầu: MTU thực tế do điện thoại
+ *    chọn và được báo qua onMtuChanged(); đến lúc đó mảnh dùng MTU 23
  *
  * @param pServer Con trỏ BLE Server
  */
 void BLEServiceManager::onConnect(BLEServer *pServer)
 {
+    memset(&link_, 0, sizeof(link_));
+    link_.txPhy = ESP_BLE_GAP_PHY_1M;
+    link_.rxPhy = ESP_BLE_GAP_PHY_1M;
+    link_.txOctets = BLE_DEFAULT_DATA_LEN;
+    link_.rxOctets = BLE_DEFAULT_DATA_LEN;
+    pacer_.onConnect();
     clientConnected_ = true;
-    Serial.println("[BLE] Client connected!");
+    log_.println("[BLE] Client connected!");
+
+    pServer->updatePeerMTU(pServer->getConnId(), BLE_REQUESTED_MTU);
+    log_.printf("[BLE] MTU %d requested\n", BLE_REQUESTED_MTU);
+}
+
+/**
+ * @brief Callback kết nối kèm tham số (thư viện gọi ngay sau onConnect(pServer))
+ *
+ * Lưu địa chỉ điện thoại để yêu cầu tham số kết nối theo chế độ hiện tại,
+ * 2M PHY và độ dài dữ liệu tối đa.
+ */
+void BLEServiceManager::onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
+{
+    memcpy(peerAddr_, param->connect.remote_bda, sizeof(peerAddr_));
+    requestConnParams();
+    requestLinkUpgrade();
+}
 
-    // Tăng MTU lên 512 bytes (mặc định là 23)
-    // Điều này cho phép gửi chuỗi JSON dài mà không cần chia nhỏ
-    pServer->updatePeerMTU(pServer->getConnId(), 512);
-    Serial.println("[BLE] MTU set to 512 bytes");
+/**
+ * @brief Đề nghị 2M PHY và DLE
+ *
+ * Mặc định mỗi PDU tầng liên kết chỉ mang 27 byte trên 1M PHY, nên một
+ * notification MTU 512 bị chia thành ~20 gói. Với DLE 251 byte trên 2M PHY,
+ * một khung lịch sử đi hết trong ít sự kiện kết nối hơn nhiều và radio tắt sớm.
+ * Controller tự thương lượng với điện thoại; kết quả (kể cả khi điện thoại chỉ
+ * hỗ trợ 1M hoặc 27 byte) đến qua gapEventHandler().
+ */
+void BLEServiceManager::requestLinkUpgrade()
+{
+#if BLE_PREFER_2M_PHY
+    esp_ble_gap_phy_mask_t phys = ESP_BLE_GAP_PHY_1M_PREF_MASK | ESP_BLE_GAP_PHY_2M_PREF_MASK;
+    esp_err_t err = esp_ble_gap_set_prefered_phy(peerAddr_, 0, phys, phys, ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
+    if (err != ESP_OK)
+        log_.printf("[BLE] 2M PHY request failed (%d), staying on 1M\n", (int)err);
+#endif
+
+    if (BLE_DATA_LENGTH > BLE_DEFAULT_DATA_LEN)
+    {
+        esp_err_t err = esp_ble_gap_set_pkt_data_len(peerAddr_, BLE_DATA_LENGTH);
+        if (err != ESP_OK)
+            log_.printf("[BLE] Data length request failed (%d), staying at %u bytes\n", (int)err,
+                        (unsigned)BLE_DEFAULT_DATA_LEN);
+    }
 }
 
 /**
@@ -164,84 +286,355 @@ void BLEServiceManager::onConnect(BLEServer *pServer)
 void BLEServiceManager::onDisconnect(BLEServer *pServer)
 {
     clientConnected_ = false;
-    Serial.println("[BLE] Client disconnected. Restarting advertising...");
+    pacer_.onDisconnect();
+    bulkTransfer_ = false;
+    link_.profile = LINK_PROFILE_NONE;
+    log_.println("[BLE] Client disconnected. Restarting advertising...");
     BLEDevice::startAdvertising();
 }
 
 /**
- * @brief Callback được gọi khi ứng dụng di động ghi dữ liệu vào một Characteristic
+ * @brief Ghi nhận MTU đã thương lượng (mảnh kế tiếp dùng kích thước mới)
+ */
+void BLEServiceManager::onMtuChanged(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
+{
+    pacer_.onMtuChanged(param->mtu.mtu);
+    uint16_t mtu = pacer_.mtu();
+    log_.printf("[BLE] MTU negotiated: %u (chunk payload %u bytes)\n", (unsigned)mtu,
+                (unsigned)(mtu - BLE_ATT_HEADER_SIZE - BLE_CHUNK_HEADER_SIZE));
+}
+
+/**
+ * @brief Ghi nhận kết quả notify (thư viện gọi ngay trong notify())
+ */
+void BLEServiceManager::onStatus(BLECharacteristic *pCharacteristic, Status status, uint32_t code)
+{
+    notifyStatus_ = status;
+}
+
+/**
+ * @brief Theo dõi ESP_GATTS_CONGEST_EVT (hàng đợi notification đầy/đã thoát) và
+ *        ESP_GATTS_CONF_EVT (một notification đã được stack gửi xong)
+ */
+void BLEServiceManager::gattsEventHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf,
+                                          esp_ble_gatts_cb_param_t *param)
+{
+    if (!instance_)
+        return;
+    if (event == ESP_GATTS_CONGEST_EVT)
+        instance_->pacer_.onCongestion(param->congest.congested);
+    else if (event == ESP_GATTS_CONF_EVT)
+        instance_->pacer_.onConfirm();
+}
+
+/**
+ * @brief Ghi nhận tham số liên kết thực tế (do ta hoặc điện thoại yêu cầu)
  *
- * Xử lý cập nhật hồ sơ người dùng từ ứng dụng:
- * - BMI
- * - Bật/tắt đếm bước
- * - Bật/tắt ML
- * - Đồng bộ thời gian hệ thống
+ * Khi thương lượng PHY/DLE thất bại, giữ giá trị mặc định 1M/27 byte đã đặt
+ * lúc kết nối.
+ */
+void BLEServiceManager::gapEventHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    if (!instance_)
+        return;
+
+    BLEServiceManager &self = *instance_;
+    switch (event)
+    {
+    case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+        if (param->update_conn_params.status != ESP_BT_STATUS_SUCCESS)
+        {
+            self.log_.printf("[BLE] Conn params update failed (status %d)\n", (int)param->update_conn_params.status);
+            break;
+        }
+        self.link_.interval = param->update_conn_params.conn_int;
+        self.link_.latency = param->update_conn_params.latency;
+        self.link_.timeout = param->update_conn_params.timeout;
+        self.log_.printf("[BLE] Conn params granted: interval %.2f ms, latency %u, timeout %u ms\n",
+                         self.link_.interval * 1.25f, (unsigned)self.link_.latency, (unsigned)self.link_.timeout * 10);
+        break;
+
+    case ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT:
+        if (param->phy_update.status != ESP_BT_STATUS_SUCCESS)
+        {
+            self.log_.printf("[BLE] PHY update failed (status %d), staying on 1M\n", (int)param->phy_update.status);
+            break;
+        }
+        self.link_.txPhy = param->phy_update.tx_phy;
+        self.link_.rxPhy = param->phy_update.rx_phy;
+        self.log_.printf("[BLE] PHY granted: TX %s, RX %s (requested %s)\n",
+                         self.link_.txPhy == ESP_BLE_GAP_PHY_2M ? "2M" : "1M",
+                         self.link_.rxPhy == ESP_BLE_GAP_PHY_2M ? "2M" : "1M", BLE_PREFER_2M_PHY ? "2M" : "1M");
+        break;
+
+    case ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT:
+        if (param->pkt_data_length_cmpl.status != ESP_BT_STATUS_SUCCESS)
+        {
+            self.log_.printf("[BLE] Data length update failed (status %d), staying at %u bytes\n",
+                             (int)param->pkt_data_length_cmpl.status, (unsigned)BLE_DEFAULT_DATA_LEN);
+            break;
+        }
+        self.link_.txOctets = param->pkt_data_length_cmpl.params.tx_len;
+        self.link_.rxOctets = param->pkt_data_length_cmpl.params.rx_len;
+        self.log_.printf("[BLE] Data length granted: TX %u, RX %u bytes (requested %u)\n",
+                         (unsigned)self.link_.txOctets, (unsigned)self.link_.rxOctets, (unsigned)BLE_DATA_LENGTH);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Yêu cầu tham số kết nối theo trạng thái hiện tại
  *
- * @param pCharacteristic Con trỏ đến Characteristic được ghi
+ * Gửi bù lịch sử > realtime > batch nhàn rỗi. Điện thoại có thể cấp giá trị
+ * khác; giá trị thực tế được ghi nhận trong gapEventHandler().
+ */
+void BLEServiceManager::requestConnParams()
+{
+    if (!clientConnected_ || !pServer_)
+        return;
+
+    BleLinkProfile profile = bulkTransfer_                              ? LINK_PROFILE_BULK
+                             : dataTransmissionMode_ == MODE_REALTIME ? LINK_PROFILE_REALTIME
+                                                                      : LINK_PROFILE_IDLE;
+    if (profile == link_.profile)
+        return;
+    link_.profile = profile;
+
+    uint16_t minInterval, maxInterval, latency, timeout;
+    switch (profile)
+    {
+    case LINK_PROFILE_BULK:
+        minInterval = BLE_CONN_BULK_MIN_INTERVAL;
+        maxInterval = BLE_CONN_BULK_MAX_INTERVAL;
+        latency = BLE_CONN_BULK_LATENCY;
+        timeout = BLE_CONN_BULK_TIMEOUT;
+        break;
+    case LINK_PROFILE_REALTIME:
+        minInterval = BLE_CONN_REALTIME_MIN_INTERVAL;
+        maxInterval = BLE_CONN_REALTIME_MAX_INTERVAL;
+        latency = BLE_CONN_REALTIME_LATENCY;
+        timeout = BLE_CONN_REALTIME_TIMEOUT;
+        break;
+    default:
+        minInterval = BLE_CONN_IDLE_MIN_INTERVAL;
+        maxInterval = BLE_CONN_IDLE_MAX_INTERVAL;
+        latency = BLE_CONN_IDLE_LATENCY;
+        timeout = BLE_CONN_IDLE_TIMEOUT;
+        break;
+    }
+
+    pServer_->updateConnParams(peerAddr_, minInterval, maxInterval, latency, timeout);
+    log_.printf("[BLE] Conn params requested (%s): interval %.2f-%.2f ms, latency %u, timeout %u ms\n",
+                profile == LINK_PROFILE_BULK ? "bulk" : profile == LINK_PROFILE_REALTIME ? "realtime" : "idle",
+                minInterval * 1.25f, maxInterval * 1.25f, (unsigned)latency, (unsigned)timeout * 10);
+}
+
+/**
+ * @brief Báo trạng thái gửi bù lịch sử
+ */
+void BLEServiceManager::setBulkTransfer(bool active)
+{
+    if (bulkTransfer_ == active)
+        return;
+    bulkTransfer_ = active;
+    requestConnParams();
+}
+
+/**
+ * @brief Lấy tham số liên kết được cấp gần nhất
+ */
+const BleLinkParams &BLEServiceManager::getLinkParams() const
+{
+    return link_;
+}
+
+/**
+ * @brief Đăng ký characteristic nhận WRITE
+ *
+ * Con trỏ characteristic lấy ngay lúc tạo là khóa tra cứu: onWrite() không
+ * phải dựng chuỗi UUID (cấp phát heap) rồi so sánh với từng UUID 36 ký tự
+ * trên task BLE.
+ */
+void BLEServiceManager::addWriteRoute(BLECharacteristic *pCharacteristic, WriteHandler handler, uint8_t minLen)
+{
+    pCharacteristic->setCallbacks(this);
+    if (writeRouteCount_ >= BLE_WRITE_ROUTES)
+    {
+        log_.println("[BLE] Write route table full - increase BLE_WRITE_ROUTES");
+        return;
+    }
+    WriteRoute &route = writeRoutes_[writeRouteCount_++];
+    route.characteristic = pCharacteristic;
+    route.handler = handler;
+    route.minLen = minLen;
+}
+
+/**
+ * @brief Callback được gọi khi ứng dụng di động ghi dữ liệu vào một Characteristic
+ *
+ * Chạy trên task BLE: chỉ tra bảng và kiểm tra độ dài, việc giải mã nằm
+ * trong bộ xử lý của từng characteristic.
  */
 void BLEServiceManager::onWrite(BLECharacteristic *pCharacteristic)
 {
-    lastActivityMs_ = millis(); // Cập nhật thời điểm hoạt động cuối cùng
+    lastActivityMs_ = clock_.millis(); // Cập nhật thời điểm hoạt động cuối cùng
+
+    for (uint8_t i = 0; i < writeRouteCount_; i++)
+    {
+        const WriteRoute &route = writeRoutes_[i];
+        if (route.characteristic != pCharacteristic)
+            continue;
+
+        size_t len = pCharacteristic->getLength();
+        if (len < route.minLen)
+        {
+            log_.printf("[BLE] Write ignored: %u bytes, need %u\n", (unsigned)len, (unsigned)route.minLen);
+            return;
+        }
+        (this->*route.handler)(pCharacteristic->getData(), len);
+        return;
+    }
+}
+
+/**
+ * @brief Cập nhật BMI
+ */
+void BLEServiceManager::onBmiWrite(const uint8_t *data, size_t len)
+{
+    float bmi = getF32(data);
+    userProfile_.bmi = bmi;
+    log_.printf("[BLE] Updated BMI: %.2f\n", bmi);
+}
+
+/**
+ * @brief Cập nhật chiều cao
+ */
+void BLEServiceManager::onHeightWrite(const uint8_t *data, size_t len)
+{
+    float height = getF32(data);
+    userProfile_.height_m = height;
+    log_.printf("[BLE] Updated height: %.2f m\n", height);
+}
+
+/**
+ * @brief Cập nhật bật/tắt đếm bước
+ */
+void BLEServiceManager::onStepCountEnabledWrite(const uint8_t *data, size_t len)
+{
+    stepCountEnabled_ = (data[0] != 0);
+    log_.printf("[BLE] Step count enabled: %s\n", stepCountEnabled_ ? "YES" : "NO");
+}
+
+/**
+ * @brief Cập nhật bật/tắt ML
+ */
+void BLEServiceManager::onMLEnabledWrite(const uint8_t *data, size_t len)
+{
+    mlEnabled_ = (data[0] != 0);
+    log_.printf("[BLE] ML enabled: %s\n", mlEnabled_ ? "YES" : "NO");
+}
 
-    std::string uuid = pCharacteristic->getUUID().toString().c_str();
+/**
+ * @brief Cập nhật thời gian hệ thống
+ */
+void BLEServiceManager::onTimeSyncWrite(const uint8_t *data, size_t len)
+{
+    uint32_t timestamp = getU32(data);
+    struct timeval tv;
+    tv.tv_sec = timestamp;
+    tv.tv_usec = 0;
+    settimeofday(&tv, NULL);
+
+    time_t now = time(NULL);
+    struct tm *t = localtime(&now);
+    log_.printf("[BLE] Time synced: %02d:%02d:%02d %02d/%02d/%04d (TS: %u)\n",
+                t->tm_hour, t->tm_min, t->tm_sec,
+                t->tm_mday, t->tm_mon + 1, t->tm_year + 1900,
+                timestamp);
+}
 
-    // Cập nhật BMI
-    if (uuid == BMI_CHAR_UUID)
+/**
+ * @brief Cập nhật chế độ truyền dữ liệu và tham số kết nối tương ứng
+ */
+void BLEServiceManager::onTransmissionModeWrite(const uint8_t *data, size_t len)
+{
+    uint8_t mode = data[0];
+    if (mode == 0)
     {
-        float bmi = *(float *)pCharacteristic->getData();
-        userProfile_.bmi = bmi;
-        Serial.printf("[BLE] Updated BMI: %.2f\n", bmi);
+        dataTransmissionMode_ = MODE_REALTIME;
+        log_.println("[BLE] Mode switched to REALTIME");
     }
-    // Cập nhật bật/tắt đếm bước
-    else if (uuid == STEP_COUNT_ENABLED_CHAR_UUID)
+    else if (mode == 1)
     {
-        uint8_t enabled = *(uint8_t *)pCharacteristic->getData();
-        stepCountEnabled_ = (enabled != 0);
-        Serial.printf("[BLE] Step count enabled: %s\n", stepCountEnabled_ ? "YES" : "NO");
+        dataTransmissionMode_ = MODE_BATCH;
+        log_.println("[BLE] Mode switched to BATCH");
     }
-    // Cập nhật bật/tắt ML
-    else if (uuid == ML_ENABLED_CHAR_UUID)
+    requestConnParams();
+}
+
+/**
+ * @brief Cập nhật thuật toán đếm bước
+ */
+void BLEServiceManager::onStepDetectorWrite(const uint8_t *data, size_t len)
+{
+    uint8_t detector = data[0];
+    if (detector <= STEP_DETECTOR_AUTOCORR)
     {
-        uint8_t enabled = *(uint8_t *)pCharacteristic->getData();
-        mlEnabled_ = (enabled != 0);
-        Serial.printf("[BLE] ML enabled: %s\n", mlEnabled_ ? "YES" : "NO");
+        stepDetectorMode_ = (StepDetectorMode)detector;
+        log_.printf("[BLE] Step detector set to %d\n", detector);
     }
-    // Cập nhật thời gian hệ thống
-    else if (uuid == TIME_SYNC_CHAR_UUID)
+}
+
+/**
+ * @brief Cập nhật cấu hình deadband
+ */
+void BLEServiceManager::onDeadbandWrite(const uint8_t *data, size_t len)
+{
+    DeadbandConfig config;
+    memcpy(&config, data, sizeof(config));
+    if (config.maxHoldS > 0)
     {
-        if (pCharacteristic->getLength() >= 4)
-        {
-            uint32_t timestamp = *(uint32_t *)pCharacteristic->getData();
-            struct timeval tv;
-            tv.tv_sec = timestamp;
-            tv.tv_usec = 0;
-            settimeofday(&tv, NULL);
-
-            time_t now = time(NULL);
-            struct tm *t = localtime(&now);
-            Serial.printf("[BLE] Time synced: %02d:%02d:%02d %02d/%02d/%04d (TS: %u)\n",
-                          t->tm_hour, t->tm_min, t->tm_sec,
-                          t->tm_mday, t->tm_mon + 1, t->tm_year + 1900,
-                          timestamp);
-        }
+        deadbandConfig_ = config;
+        log_.printf("[BLE] Deadband %s: HR±%d SpO2±%d steps±%d hold %us\n",
+                    config.enabled ? "on" : "off", config.hrTol, config.spo2Tol,
+                    config.stepsTol, (unsigned)config.maxHoldS);
     }
-    // Cập nhật chế độ truyền dữ liệu
-    else if (uuid == DATA_TRANSMISSION_MODE_CHAR_UUID)
+}
+
+/**
+ * @brief Yêu cầu khung tổng hợp theo phút/giờ
+ */
+void BLEServiceManager::onRollupWrite(const uint8_t *data, size_t len)
+{
+    uint8_t level = data[0];
+    if (level <= ROLLUP_HOUR)
     {
-        uint8_t mode = *(uint8_t *)pCharacteristic->getData();
-        if (mode == 0)
-        {
-            dataTransmissionMode_ = MODE_REALTIME;
-            Serial.println("[BLE] Mode switched to REALTIME");
-        }
-        else if (mode == 1)
-        {
-            dataTransmissionMode_ = MODE_BATCH;
-            Serial.println("[BLE] Mode switched to BATCH");
-        }
+        rollupLevel_ = (RollupLevel)level;
+        rollupRequested_ = true;
+        log_.printf("[BLE] Rollup requested: %s\n", level == ROLLUP_HOUR ? "hour" : "minute");
     }
 }
 
+/**
+ * @brief Ack đồng bộ: số thứ tự liên tục cao nhất ứng dụng đã nhận
+ *
+ * Ack 8 byte kèm epoch mà ứng dụng đã thấy; ack ghi trước khi ứng dụng biết
+ * thiết bị vừa khởi động lại (epoch cũ) sẽ giải phóng nhầm mẫu mới nên bị bỏ.
+ */
+void BLEServiceManager::onSyncAckWrite(const uint8_t *data, size_t len)
+{
+    if (len >= 2 * sizeof(uint32_t) && getU32(data + sizeof(uint32_t)) != syncEpoch_)
+    {
+        log_.printf("[BLE] Sync ack for stale epoch %08X ignored\n", (unsigned)getU32(data + sizeof(uint32_t)));
+        return;
+    }
+    syncAckSeq_ = getU32(data);
+    syncAckPending_ = true;
+}
+
 /**
  * @brief Gửi dữ liệu sức khỏe hiện tại đến ứng dụng di động (Binary)
  *
@@ -262,16 +655,14 @@ void BLEServiceManager::notifyHealthData(float hr, float spo2, uint32_t steps)
     packet.spo2 = (uint8_t)spo2;
     packet.steps = steps;
     
-    time_t now;
-    time(&now);
-    packet.timestamp = (uint32_t)now;
+    packet.timestamp = clock_.unixTime();
 
-    // Cập nhật giá trị của Characteristic (10 bytes)
-    pHealthDataBatchChar_->setValue((uint8_t *)&packet, sizeof(packet));
-    pHealthDataBatchChar_->notify();
+    // Khung một mảnh (10 bytes dữ liệu)
+    if (!enqueue(NOTIFY_REALTIME, BLE_TARGET_HEALTH_DATA, (const uint8_t *)&packet, sizeof(packet)))
+        return;
 
-    Serial.printf("[BLE] Notified binary data: HR=%d, SpO2=%d, Steps=%d, TS=%u\n",
-                  packet.hr, packet.spo2, packet.steps, packet.timestamp);
+    log_.printf("[BLE] Queued binary data: HR=%d, SpO2=%d, Steps=%u, TS=%u\n",
+                packet.hr, packet.spo2, packet.steps, packet.timestamp);
 }
 
 /**
@@ -300,44 +691,129 @@ void BLEServiceManager::notifyHealthDataWithAlert(float hr, float spo2, uint32_t
     packet->spo2 = (uint8_t)spo2;
     packet->steps = steps;
     
-    time_t now;
-    time(&now);
-    packet->timestamp = (uint32_t)now;
+    packet->timestamp = clock_.unixTime();
 
     // Copy alert score float to the end of buffer
     memcpy(buffer + sizeof(HealthDataPacket), &alertScore, sizeof(float));
 
-    // Cập nhật giá trị của Characteristic
-    pHealthDataBatchChar_->setValue(buffer, sizeof(buffer));
-
-    // Gửi thông báo đến ứng dụng
-    pHealthDataBatchChar_->notify();
+    // Gửi thông báo đến ứng dụng (khung một mảnh, ưu tiên cao nhất)
+    if (!enqueue(NOTIFY_ALERT, BLE_TARGET_HEALTH_DATA, buffer, sizeof(buffer)))
+    {
+        log_.printf("[BLE] Alert dropped - notification queue full (Score=%.4f)\n", alertScore);
+        return;
+    }
 
-    Serial.printf("[BLE] Notified binary data WITH ALERT: Score=%.4f\n", alertScore);
+    log_.printf("[BLE] Queued binary data WITH ALERT: Score=%.4f\n", alertScore);
 }
 
 /**
- * @brief Gửi batch dữ liệu HR/SpO2 qua BLE (Binary Array)
+ * @brief Đưa batch dữ liệu HR/SpO2 vào hàng đợi notification (lớp batch)
  */
-bool BLEServiceManager::notifyHealthDataBatch(uint8_t *data, size_t len)
+bool BLEServiceManager::notifyHealthDataBatch(uint8_t *data, size_t len, uint32_t *ticket)
 {
     if (!clientConnected_)
     {
-        Serial.println("[BLE] Cannot send batch - not connected");
+        log_.println("[BLE] Cannot send batch - not connected");
         return false;
     }
 
-    Serial.printf("[BLE] Sending binary batch data: %d bytes\n", len);
-
-    // Gửi toàn bộ dữ liệu một lần bằng uint8_t array
-    // setValue với uint8_t* và length sẽ gửi toàn bộ data
-    pHealthDataBatchChar_->setValue(data, len);
-    pHealthDataBatchChar_->notify();
+    if (!enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, data, len, ticket))
+    {
+        log_.printf("[BLE] Batch %u bytes deferred - notification queue full\n", (unsigned)len);
+        return false;
+    }
 
-    lastActivityMs_ = millis();
+    log_.printf("[BLE] Batch %u bytes queued (MTU %u), %u B/s this connection\n",
+                (unsigned)len, (unsigned)pacer_.mtu(), (unsigned)pacer_.stats().bytesPerSec);
     return true;
 }
 
+/**
+ * @brief Đưa khung vào hàng đợi notification và đẩy mảnh ngay nếu được
+ */
+bool BLEServiceManager::enqueue(NotifyClass cls, uint8_t target, const uint8_t *data, size_t len, uint32_t *ticket)
+{
+    uint32_t frames = pacer_.stats().frames;
+    bool queued = pacer_.enqueue(cls, target, data, len, ticket);
+    if (pacer_.stats().frames != frames)
+        lastActivityMs_ = clock_.millis();
+    return queued;
+}
+
+/**
+ * @brief Đẩy mảnh từ hàng đợi notification (nhịp gửi: NotifyPacer::service())
+ */
+void BLEServiceManager::service()
+{
+    uint32_t frames = pacer_.stats().frames;
+    pacer_.service();
+    if (pacer_.stats().frames != frames)
+        lastActivityMs_ = clock_.millis();
+}
+
+/**
+ * @brief Notify một mảnh lên characteristic của đích
+ *
+ * Thư viện báo kết quả qua onStatus() ngay trong notify(). Lỗi GATT (hàng đợi
+ * stack đầy) là tạm thời; chưa bật notify hoặc mất client thì khung bị bỏ.
+ */
+NotifyTxResult BLEServiceManager::notifyChunk(uint8_t target, const uint8_t *chunk, uint16_t len)
+{
+    BLECharacteristic *pCharacteristic = (target == BLE_TARGET_ROLLUP) ? pRollupChar_ : pHealthDataBatchChar_;
+    if (!pCharacteristic)
+        return NOTIFY_TX_DISABLED;
+
+    notifyStatus_ = SUCCESS_NOTIFY;
+    pCharacteristic->setValue(const_cast<uint8_t *>(chunk), len);
+    pCharacteristic->notify();
+    Status status = notifyStatus_;
+    if (status == SUCCESS_NOTIFY)
+        return NOTIFY_TX_OK;
+    if (status == ERROR_NOTIFY_DISABLED || status == ERROR_NO_CLIENT)
+        return NOTIFY_TX_DISABLED;
+    return NOTIFY_TX_BUSY;
+}
+
+/**
+ * @brief Lớp batch còn chỗ cho khung len byte
+ */
+bool BLEServiceManager::canQueueBatch(size_t len) const
+{
+    return pacer_.queue().canPush(NOTIFY_BATCH, len);
+}
+
+/**
+ * @brief Hàng đợi notification đã gửi hết
+ */
+bool BLEServiceManager::isNotifyQueueEmpty() const
+{
+    return pacer_.queue().empty();
+}
+
+/**
+ * @brief Trạng thái khung batch theo ticket
+ */
+NotifyFrameStatus BLEServiceManager::getBatchFrameStatus(uint32_t ticket) const
+{
+    return pacer_.queue().status(NOTIFY_BATCH, ticket);
+}
+
+/**
+ * @brief Lấy thống kê hàng đợi notification
+ */
+const NotifyQueueStats &BLEServiceManager::getQueueStats() const
+{
+    return pacer_.queue().stats();
+}
+
+/**
+ * @brief Lấy thống kê truyền theo mảnh
+ */
+const BleTransferStats &BLEServiceManager::getTransferStats() const
+{
+    return pacer_.stats();
+}
+
 /**
  * @brief Cập nhật và gửi mức pin
  */
@@ -348,9 +824,76 @@ void BLEServiceManager::notifyBatteryLevel(uint8_t batteryPercent)
     if (clientConnected_)
     {
         pBatteryLevelChar_->notify();
-        lastActivityMs_ = millis();
-        Serial.printf("[BLE] Battery level notified: %d%%\n", batteryPercent);
+        lastActivityMs_ = clock_.millis();
+        log_.printf("[BLE] Battery level notified: %d%%\n", batteryPercent);
+    }
+}
+
+/**
+ * @brief Cập nhật vết giao dịch I2C (ứng dụng đọc khi cần, không notify)
+ */
+void BLEServiceManager::updateI2CTrace(const uint8_t *data, size_t len)
+{
+    if (!pI2CTraceChar_)
+        return;
+    pI2CTraceChar_->setValue((uint8_t *)data, len);
+}
+
+/**
+ * @brief Lấy yêu cầu tổng hợp đang chờ
+ */
+bool BLEServiceManager::takeRollupRequest(RollupLevel &level)
+{
+    if (!rollupRequested_)
+        return false;
+    level = rollupLevel_;
+    rollupRequested_ = false;
+    return true;
+}
+
+/**
+ * @brief Gửi khung tổng hợp qua notification của ROLLUP_CHAR_UUID
+ */
+bool BLEServiceManager::notifyRollups(const uint8_t *data, size_t len)
+{
+    if (!clientConnected_ || !pRollupChar_)
+        return false;
+
+    if (!enqueue(NOTIFY_BATCH, BLE_TARGET_ROLLUP, data, len))
+        return false;
+
+    log_.printf("[BLE] Rollup frame queued: %u bytes\n", (unsigned)len);
+    return true;
+}
+
+/**
+ * @brief Lấy ack đồng bộ mới nhất
+ */
+bool BLEServiceManager::takeSyncAck(uint32_t &seq)
+{
+    if (!syncAckPending_)
+        return false;
+    syncAckPending_ = false;
+    seq = syncAckSeq_;
+    return true;
+}
+
+/**
+ * @brief Cập nhật giá trị đọc của characteristic đồng bộ (12 byte little-endian: epoch, firstSeq, nextSeq)
+ */
+void BLEServiceManager::updateSyncState(uint32_t epoch, uint32_t firstSeq, uint32_t nextSeq)
+{
+    syncEpoch_ = epoch;
+    if (!pSyncControlChar_)
+        return;
+    uint8_t state[12];
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        state[i] = (uint8_t)(epoch >> (8 * i));
+        state[4 + i] = (uint8_t)(firstSeq >> (8 * i));
+        state[8 + i] = (uint8_t)(nextSeq >> (8 * i));
     }
+    pSyncControlChar_->setValue(state, sizeof(state));
 }
 
 /**
@@ -392,4 +935,14 @@ bool BLEServiceManager::isMLEnabled() const
 DataTransmissionMode BLEServiceManager::getDataTransmissionMode() const
 {
     return dataTransmissionMode_;
+}
+
+StepDetectorMode BLEServiceManager::getStepDetectorMode() const
+{
+    return stepDetectorMode_;
+}
+
+const DeadbandConfig &BLEServiceManager::getDeadbandConfig() const
+{
+    return deadbandConfig_;
 }
\ No newline at end of file
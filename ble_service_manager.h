@@ -11,6 +11,21 @@
  *   2. Health Data Service: Gửi dữ liệu sức khỏe thực thời đến ứng dụng di động
  * - Xử lý kết nối/ngắt kết nối từ ứng dụng di động
  * - Cập nhật dữ liệu sức khỏe thông qua BLE Notify
+ * - Theo dõi MTU đã thương lượng; khung lớn hơn MTU được chia thành các mảnh
+ *   có header {số thứ tự, cờ đầu/cuối}, gửi theo nhịp hàng đợi notification
+ * - Mọi khung notify đi qua NotifyQueue (cảnh báo > thời gian thực > batch);
+ *   service() trong loop() đẩy mảnh qua NotifyPacer (notify_pacer.h) khi
+ *   stack không nghẽn và số mảnh chưa được báo gửi xong (ESP_GATTS_CONF_EVT)
+ *   dưới BLE_NOTIFY_WINDOW. Khung đang gửi dở luôn được gửi hết trước khi
+ *   chuyển sang khung ưu tiên cao hơn. Lớp này chỉ là NotifyTransport: đưa
+ *   mảnh lên characteristic và chuyển sự kiện của stack cho NotifyPacer
+ *
+ * Mảnh (mọi notification trên HEALTH_DATA_BATCH_CHAR_UUID và ROLLUP_CHAR_UUID):
+ * - [0] số thứ tự mảnh (u8, mỗi characteristic một bộ đếm, tăng liên tục qua các khung)
+ * - [1] cờ: BLE_CHUNK_FIRST, BLE_CHUNK_LAST (khung một mảnh có cả hai)
+ * - [2..] dữ liệu, tối đa MTU - 3 - 2 byte
+ * Điện thoại nối các mảnh từ FIRST đến LAST; thiếu số thứ tự thì bỏ khung
+ * đang ghép (khung đồng bộ được gửi lại nhờ ack, xem DataBuffer).
  */
 
 #pragma once
@@ -20,56 +35,75 @@
 #include <BLEUtils.h>
 #include <BLE2902.h>
 #include "max30102_manager.h"
+#include "mpu6050_manager.h"
+#include "health_data_packet.h"
+#include "rollup.h"
+#include "deadband.h"
+#include "notify_pacer.h"
+#include "hal.h"
 
 // === UUID của User Profile Service ===
 // Dịch vụ này chứa các thông tin cá nhân từ ứng dụng di động
 #define USER_PROFILE_SERVICE_UUID "0000181C-0000-1000-8000-00805F9B34FB"
 #define BMI_CHAR_UUID "00002A98-0000-1000-8000-00805F9B34FB"                    ///< Chỉ số khối cơ thể (BMI)
+#define HEIGHT_CHAR_UUID "00002A8E-0000-1000-8000-00805F9B34FB"                 ///< Chiều cao (m - float)
 #define STEP_COUNT_ENABLED_CHAR_UUID "00002A81-0000-1000-8000-00805F9B34FB"     ///< Bật/tắt đếm bước (1=bật, 0=tắt)
 #define ML_ENABLED_CHAR_UUID "00002A99-0000-1000-8000-00805F9B34FB"             ///< Bật/tắt ML (1=bật, 0=tắt)
 #define TIME_SYNC_CHAR_UUID "00002A2B-0000-1000-8000-00805F9B34FB"              ///< Đồng bộ thời gian (Unix timestamp - uint32)
 #define DATA_TRANSMISSION_MODE_CHAR_UUID "00002A9A-0000-1000-8000-00805F9B34FB" ///< Chế độ truyền dữ liệu (0=Realtime, 1=Batch)
+#define STEP_DETECTOR_CHAR_UUID "00002A9B-0000-1000-8000-00805F9B34FB"          ///< Thuật toán đếm bước (0=Magnitude, 1=Axis, 2=Autocorr)
+#define DEADBAND_CHAR_UUID "00002A9F-0000-1000-8000-00805F9B34FB"               ///< Cấu hình deadband (DeadbandConfig 6 byte)
 
 // === UUID của Health Data Service ===
 // Dịch vụ này cung cấp dữ liệu sức khỏe theo thời gian thực
 #define HEALTH_DATA_SERVICE_UUID "0000180D-0000-1000-8000-00805F9B34FB"
-#define HEALTH_DATA_BATCH_CHAR_UUID "00002A37-0000-1000-8000-00805F9B34FB" ///< Dữ liệu sức khỏe (JSON)
+#define HEALTH_DATA_BATCH_CHAR_UUID "00002A37-0000-1000-8000-00805F9B34FB" ///< Dữ liệu sức khỏe (khung nén batch_codec.h)
+#define I2C_TRACE_CHAR_UUID "00002A9C-0000-1000-8000-00805F9B34FB"         ///< Vết giao dịch I2C (READ, mảng I2CTraceEntry 10 byte)
+#define ROLLUP_CHAR_UUID "00002A9D-0000-1000-8000-00805F9B34FB"            ///< Tổng hợp phút/giờ (WRITE tầng 0/1, NOTIFY khung rollup.h)
+#define SYNC_CONTROL_CHAR_UUID "00002A9E-0000-1000-8000-00805F9B34FB"      ///< Đồng bộ batch (WRITE ack u32 [+ epoch u32], READ epoch/firstSeq/nextSeq u32)
 
-// === UUID cho Battery Service ===
-
-#define BATTERY_SERVICE_UUID "0000180F-0000-1000-8000-00805F9B34FB"
-
-#define BATTERY_LEVEL_CHAR_UUID "00002A19-0000-1000-8000-00805F9B34FB"
-
-enum DataTransmissionMode
+#define BLE_DEFAULT_DATA_LEN 27 ///< Độ dài PDU tầng liên kết khi không có DLE
+#define BLE_WRITE_ROUTES 10     ///< Số characteristic nhận WRITE (kích thước bảng điều phối)
 
+/// @brief Bộ tham số kết nối đang yêu cầu (board_config.h)
+enum BleLinkProfile : uint8_t
 {
-
-    MODE_REALTIME = 0,
-
-    MODE_BATCH = 1
-
+    LINK_PROFILE_NONE = 0, ///< Chưa yêu cầu (chưa kết nối)
+    LINK_PROFILE_REALTIME, ///< Khoảng ngắn, không latency
+    LINK_PROFILE_IDLE,     ///< Chế độ batch nhàn rỗi: khoảng dài, latency cao
+    LINK_PROFILE_BULK      ///< Đang gửi bù lịch sử: khoảng ngắn nhất
 };
 
 /**
+ * @struct BleLinkParams
+ * @brief Tham số liên kết hiện tại (giá trị được cấp, không phải giá trị yêu cầu)
+ */
+struct BleLinkParams
+{
+    uint16_t interval; ///< Khoảng kết nối (đơn vị 1.25 ms, 0 = chưa biết)
+    uint16_t latency;  ///< Slave latency (số sự kiện được bỏ)
+    uint16_t timeout;  ///< Supervision timeout (đơn vị 10 ms)
+    uint8_t profile;   ///< BleLinkProfile đã yêu cầu
+    uint8_t txPhy;     ///< PHY phát (ESP_BLE_GAP_PHY_1M/2M)
+    uint8_t rxPhy;     ///< PHY thu
+    uint16_t txOctets; ///< Độ dài PDU phát tối đa (27 = không DLE)
+    uint16_t rxOctets; ///< Độ dài PDU thu tối đa
+};
 
- * @struct HealthDataPacket
+// === UUID cho Battery Service ===
 
- * @brief Cấu trúc gói tin binary (8 bytes)
+#define BATTERY_SERVICE_UUID "0000180F-0000-1000-8000-00805F9B34FB"
 
- */
+#define BATTERY_LEVEL_CHAR_UUID "00002A19-0000-1000-8000-00805F9B34FB"
 
-struct __attribute__((packed)) HealthDataPacket
+enum DataTransmissionMode
 
 {
 
-    uint32_t timestamp; // 4 bytes
-
-    uint16_t steps; // 2 bytes
+    MODE_REALTIME = 0,
 
-    uint8_t hr; // 1 byte
+    MODE_BATCH = 1
 
-    uint8_t spo2; // 1 byte
 };
 
 /**
@@ -98,14 +132,19 @@ struct __attribute__((packed)) HealthDataPacket
 
  */
 
-class BLEServiceManager : public BLEServerCallbacks, public BLECharacteristicCallbacks
+class BLEServiceManager : public BLEServerCallbacks, public BLECharacteristicCallbacks, public NotifyTransport
 
 {
 
 public:
     /// @brief Constructor - khởi tạo các biến thành viên
 
-    BLEServiceManager();
+    /// @param clock Đồng hồ (timestamp gói tin, thời điểm hoạt động)
+
+    /// @param log Đầu ra log
+
+    explicit BLEServiceManager(hal::Clock &clock = hal::defaultClock(),
+                               hal::Logger &log = hal::defaultLogger());
 
     /// @brief Khởi tạo BLE Server với tên thiết bị
 
@@ -137,15 +176,19 @@ public:
 
     void notifyHealthDataWithAlert(float hr, float spo2, uint32_t steps, float alertScore);
 
-    /// @brief Gửi batch dữ liệu HR/SpO2 (Binary Array)
+    /// @brief Gửi batch dữ liệu HR/SpO2 (khung nén BatchEncoder), chia mảnh theo MTU
 
     /// @param data Con trỏ đến dữ liệu binary
 
     /// @param len Độ dài dữ liệu (bytes)
 
-    /// @return true nếu gửi thành công
+    /// @param ticket Nếu khác nullptr: nhận ticket để hỏi getBatchFrameStatus()
+
+    /// @return true nếu khung đã vào hàng đợi notification (false: đầy hoặc chưa kết nối, thử lại sau)
 
-    bool notifyHealthDataBatch(uint8_t *data, size_t len);
+    /// @note Khung đã vào hàng đợi vẫn có thể bị bỏ (mất kết nối, hết thời gian gửi)
+
+    bool notifyHealthDataBatch(uint8_t *data, size_t len, uint32_t *ticket = nullptr);
 
     /// @brief Cập nhật và gửi mức pin
 
@@ -153,6 +196,82 @@ public:
 
     void notifyBatteryLevel(uint8_t batteryPercent);
 
+    /// @brief Cập nhật giá trị vết giao dịch I2C để ứng dụng đọc (chẩn đoán)
+
+    /// @param data Các bản ghi I2CTraceEntry (tối đa 512 byte)
+
+    /// @param len Độ dài dữ liệu (bytes)
+
+    void updateI2CTrace(const uint8_t *data, size_t len);
+
+    /// @brief Lấy yêu cầu tổng hợp đang chờ (ứng dụng ghi tầng vào ROLLUP_CHAR_UUID)
+
+    /// @param level Tầng được yêu cầu
+
+    /// @return true nếu có yêu cầu (yêu cầu được xóa sau khi lấy)
+
+    bool takeRollupRequest(RollupLevel &level);
+
+    /// @brief Gửi khung tổng hợp (chia mảnh theo MTU)
+
+    /// @param data Khung rollup (DataBuffer::getRollups)
+
+    /// @param len Độ dài khung (bytes)
+
+    /// @return true nếu khung đã vào hàng đợi notification
+
+    bool notifyRollups(const uint8_t *data, size_t len);
+
+    /// @brief Đẩy mảnh từ hàng đợi notification theo nhịp của stack (gọi mỗi vòng loop)
+
+    void service();
+
+    /// @brief Lớp batch còn chỗ cho một khung len byte (kiểm tra trước khi mã hóa khung lớn)
+
+    bool canQueueBatch(size_t len) const;
+
+    /// @brief Hàng đợi notification đã gửi hết
+
+    bool isNotifyQueueEmpty() const;
+
+    /// @brief Trạng thái khung batch đã nhận ticket từ notifyHealthDataBatch()
+
+    NotifyFrameStatus getBatchFrameStatus(uint32_t ticket) const;
+
+    /// @brief Thống kê hàng đợi notification theo lớp ưu tiên
+
+    const NotifyQueueStats &getQueueStats() const;
+
+    /// @brief Lấy ack đồng bộ đang chờ (ứng dụng ghi số thứ tự vào SYNC_CONTROL_CHAR_UUID)
+
+    /// @param seq Số thứ tự liên tục cao nhất ứng dụng đã nhận
+
+    /// @return true nếu có ack mới (ack tích lũy: chỉ giữ giá trị mới nhất)
+
+    bool takeSyncAck(uint32_t &seq);
+
+    /// @brief Cập nhật trạng thái đồng bộ để ứng dụng đọc khi kết nối lại
+
+    /// @param epoch Epoch đồng bộ của lần khởi động này; khác giá trị ứng dụng đã lưu thì ứng dụng bỏ con trỏ ack cũ
+
+    /// @param firstSeq Số thứ tự mẫu cũ nhất chưa được xác nhận
+
+    /// @param nextSeq Số thứ tự sẽ gán cho mẫu kế tiếp
+
+    void updateSyncState(uint32_t epoch, uint32_t firstSeq, uint32_t nextSeq);
+
+    /// @brief Báo đang/hết gửi bù lịch sử (yêu cầu tham số kết nối nhanh nhất khi đang gửi)
+
+    void setBulkTransfer(bool active);
+
+    /// @brief Tham số liên kết được cấp gần nhất
+
+    const BleLinkParams &getLinkParams() const;
+
+    /// @brief Thống kê truyền theo mảnh
+
+    const BleTransferStats &getTransferStats() const;
+
     /// @brief Kiểm tra xem ứng dụng di động có kết nối không
 
     /// @return true nếu có khách hàng BLE đang kết nối
@@ -181,21 +300,130 @@ public:
 
     DataTransmissionMode getDataTransmissionMode() const;
 
+    /// @brief Lấy thuật toán đếm bước được chọn từ ứng dụng
+
+    StepDetectorMode getStepDetectorMode() const;
+
+    /// @brief Lấy cấu hình deadband do ứng dụng đặt
+
+    const DeadbandConfig &getDeadbandConfig() const;
+
 private:
     /// @brief Callback được gọi khi ứng dụng kết nối
 
     void onConnect(BLEServer *pServer) override;
 
+    /// @brief Callback kết nối kèm tham số (lấy địa chỉ điện thoại, yêu cầu tham số kết nối)
+
+    void onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param) override;
+
     /// @brief Callback được gọi khi ứng dụng ngắt kết nối
 
     void onDisconnect(BLEServer *pServer) override;
 
+    /// @brief Callback khi MTU được thương lượng xong
+
+    void onMtuChanged(BLEServer *pServer, esp_ble_gatts_cb_param_t *param) override;
+
+    /// @brief Callback kết quả notify (gọi đồng bộ trong notify())
+
+    void onStatus(BLECharacteristic *pCharacteristic, Status status, uint32_t code) override;
+
+    /// @brief Sự kiện GATTS thô (theo dõi nghẽn hàng đợi notification)
+
+    static void gattsEventHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf, esp_ble_gatts_cb_param_t *param);
+
+    /// @brief Sự kiện GAP thô (tham số kết nối, PHY, độ dài dữ liệu được cấp)
+
+    static void gapEventHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+
+    /// @brief Yêu cầu tham số kết nối theo chế độ truyền và trạng thái gửi bù (bỏ qua nếu không đổi)
+
+    void requestConnParams();
+
+    /// @brief Đề nghị 2M PHY và độ dài dữ liệu tối đa cho kết nối mới
+
+    void requestLinkUpgrade();
+
+    /// @brief Đưa khung vào hàng đợi notification rồi đẩy mảnh ngay nếu được
+
+    bool enqueue(NotifyClass cls, uint8_t target, const uint8_t *data, size_t len, uint32_t *ticket = nullptr);
+
+    /// @brief Notify một mảnh lên characteristic của đích (NotifyTransport, gọi từ NotifyPacer)
+
+    /// @return Kết quả notify của stack
+
+    NotifyTxResult notifyChunk(uint8_t target, const uint8_t *chunk, uint16_t len) override;
+
     /// @brief Callback được gọi khi ứng dụng ghi dữ liệu vào một Characteristic
 
-    /// Xử lý cập nhật hồ sơ người dùng từ ứng dụng
+    /// Tra bảng điều phối theo con trỏ characteristic (không so sánh UUID, không cấp phát)
 
     void onWrite(BLECharacteristic *pCharacteristic) override;
 
+    /// @brief Bộ xử lý WRITE (dữ liệu đã đủ độ dài tối thiểu của route)
+
+    typedef void (BLEServiceManager::*WriteHandler)(const uint8_t *data, size_t len);
+
+    /**
+     * @struct WriteRoute
+     * @brief Một mục của bảng điều phối WRITE
+     */
+    struct WriteRoute
+    {
+        BLECharacteristic *characteristic; ///< Con trỏ lấy lúc tạo characteristic
+        WriteHandler handler;              ///< Bộ xử lý
+        uint8_t minLen;                    ///< Độ dài dữ liệu tối thiểu (ngắn hơn thì bỏ qua)
+    };
+
+    /// @brief Đăng ký characteristic nhận WRITE (đặt callback và thêm vào bảng điều phối)
+
+    void addWriteRoute(BLECharacteristic *pCharacteristic, WriteHandler handler, uint8_t minLen);
+
+    /// @brief BMI (float32 LE)
+
+    void onBmiWrite(const uint8_t *data, size_t len);
+
+    /// @brief Chiều cao (float32 LE, mét)
+
+    void onHeightWrite(const uint8_t *data, size_t len);
+
+    /// @brief Bật/tắt đếm bước (u8)
+
+    void onStepCountEnabledWrite(const uint8_t *data, size_t len);
+
+    /// @brief Bật/tắt ML (u8)
+
+    void onMLEnabledWrite(const uint8_t *data, size_t len);
+
+    /// @brief Đồng bộ thời gian (Unix timestamp u32 LE)
+
+    void onTimeSyncWrite(const uint8_t *data, size_t len);
+
+    /// @brief Chế độ truyền (u8: 0 = realtime, 1 = batch)
+
+    void onTransmissionModeWrite(const uint8_t *data, size_t len);
+
+    /// @brief Thuật toán đếm bước (u8 StepDetectorMode)
+
+    void onStepDetectorWrite(const uint8_t *data, size_t len);
+
+    /// @brief Cấu hình deadband (DeadbandConfig)
+
+    void onDeadbandWrite(const uint8_t *data, size_t len);
+
+    /// @brief Yêu cầu tổng hợp (u8 RollupLevel)
+
+    void onRollupWrite(const uint8_t *data, size_t len);
+
+    /// @brief Ack đồng bộ (u32 LE, có thể kèm epoch u32; ack của epoch khác bị bỏ qua)
+
+    void onSyncAckWrite(const uint8_t *data, size_t len);
+
+    hal::Clock &clock_; ///< Đồng hồ
+
+    hal::Logger &log_; ///< Đầu ra log
+
     BLEServer *pServer_; ///< Con trỏ BLE Server
 
     BLEService *pUserProfileService_;
@@ -208,6 +436,8 @@ private:
 
     BLECharacteristic *pBmiChar_; ///< Chỉ số khối cơ thể (BMI)
 
+    BLECharacteristic *pHeightChar_; ///< Chiều cao
+
     BLECharacteristic *pStepCountEnabledChar_; ///< Bật/tắt đếm bước
 
     BLECharacteristic *pMLEnabledChar_; ///< Bật/tắt ML
@@ -216,10 +446,20 @@ private:
 
     BLECharacteristic *pDataTransmissionModeChar_; ///< Chế độ truyền dữ liệu
 
+    BLECharacteristic *pStepDetectorChar_; ///< Thuật toán đếm bước
+
+    BLECharacteristic *pDeadbandChar_; ///< Cấu hình deadband
+
     // Các Characteristic của Health Data Service
 
     BLECharacteristic *pHealthDataBatchChar_; ///< Dữ liệu sức khỏe (Binary)
 
+    BLECharacteristic *pI2CTraceChar_; ///< Vết giao dịch I2C
+
+    BLECharacteristic *pRollupChar_; ///< Tổng hợp phút/giờ
+
+    BLECharacteristic *pSyncControlChar_; ///< Điều khiển đồng bộ batch
+
     BLECharacteristic *pBatteryLevelChar_; ///< Mức pin
 
     bool clientConnected_; ///< Cờ: ứng dụng di động có kết nối hay không?
@@ -230,7 +470,37 @@ private:
 
     DataTransmissionMode dataTransmissionMode_; ///< Chế độ truyền dữ liệu (Realtime/Batch)
 
+    StepDetectorMode stepDetectorMode_; ///< Thuật toán đếm bước
+
+    DeadbandConfig deadbandConfig_; ///< Cấu hình deadband
+
+    volatile bool rollupRequested_; ///< Cờ: ứng dụng vừa yêu cầu khung tổng hợp
+
+    RollupLevel rollupLevel_; ///< Tầng được yêu cầu
+
+    volatile bool syncAckPending_; ///< Cờ: có ack đồng bộ chưa xử lý
+
+    volatile uint32_t syncAckSeq_; ///< Số thứ tự được ack gần nhất
+
+    volatile uint32_t syncEpoch_; ///< Epoch đồng bộ hiện tại (kiểm tra ack)
+
     UserProfile userProfile_; ///< Hồ sơ người dùng hiện tại
 
     unsigned long lastActivityMs_;
+
+    volatile Status notifyStatus_; ///< Kết quả notify gần nhất
+
+    NotifyPacer pacer_; ///< Hàng đợi notification và máy trạng thái gửi mảnh
+
+    esp_bd_addr_t peerAddr_; ///< Địa chỉ điện thoại đang kết nối
+
+    volatile bool bulkTransfer_; ///< Đang gửi bù lịch sử
+
+    BleLinkParams link_; ///< Tham số liên kết được cấp
+
+    WriteRoute writeRoutes_[BLE_WRITE_ROUTES]; ///< Bảng điều phối WRITE
+
+    uint8_t writeRouteCount_; ///< Số mục đã đăng ký
+
+    static BLEServiceManager *instance_; ///< Đối tượng nhận sự kiện GATTS/GAP thô
 };
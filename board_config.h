@@ -16,13 +16,74 @@
 #define I2C_SDA_MPU6050 8
 #define I2C_SCL_MPU6050 9
 
+// === Lập lịch bus I2C dùng chung ===
+#define I2C_BUS_CLOCK_HZ 400000         // Fast-mode, cả hai cảm biến đều hỗ trợ
+#define MAX30102_DRAIN_PERIOD_MS 40     // Xả FIFO khi còn dư một nửa
+#define MAX30102_FIFO_DEADLINE_MS 80    // FIFO 32 mẫu ở 400 Hz tràn sau 80 ms
+#define MPU6050_SAMPLE_PERIOD_MS 10     // 100 Hz
+#define MPU6050_SAMPLE_DEADLINE_MS 20   // Bỏ lỡ tối đa 1 mẫu
+#define I2C_STATS_INTERVAL_MS 60000     // In thống kê bus mỗi 1 phút
+#define MAX30102_STALL_TIMEOUT_MS 200   // FIFO không có mẫu mới quá lâu → bus/cảm biến treo
+#define I2C_TRACE_ENABLED 0             // 1 = ghi vết giao dịch, in qua Serial và đưa lên BLE
+
 // === Battery ADC pin ===
 #define BATTERY_ADC_PIN 0 // GPIO0 (ADC1_CH0) - kết nối với voltage divider
 
 // === Buffer và timing ===
-#define HR_BUFFER_SIZE 10           // 100 samples = 50 giây (2 sample/giây)
+#define HR_BUFFER_SIZE 64           // 64 samples = 32 giây (2 sample/giây, lũy thừa của 2), giữ mẫu chờ ack
 #define HR_SAMPLE_INTERVAL_MS 500   // Đọc HR mỗi 0.5 giây
 #define DATA_SEND_INTERVAL_MS 60000 // Gửi dữ liệu mỗi 1 phút (60000ms)
+#define SAMPLE_QUEUE_SIZE 16        // Hàng đợi thu thập → lưu trữ (lũy thừa của 2, 8 giây ở 2 Hz)
+#define SYNC_BATCH_SAMPLES 16       // Gửi khi có 16 mẫu chưa gửi; khung đủ chỗ cho 16 mẫu xấu nhất
+#define SYNC_ACK_TIMEOUT_MS 5000    // Không nhận ack sau thời gian này thì gửi lại từ mẫu chưa xác nhận
+#define SYNC_BATCH_COLUMNAR 0       // 1 = khung đồng bộ bố cục cột (batch_codec.h) cho gateway giải mã theo cột
+
+// === Lưu theo thay đổi (deadband.h), ứng dụng đổi được qua BLE ===
+#define DEADBAND_ENABLED 0          // Mặc định tắt: ứng dụng bật khi có bộ khôi phục chuỗi
+#define DEADBAND_HR_TOLERANCE 2     // Lưu khi HR lệch > 2 BPM
+#define DEADBAND_SPO2_TOLERANCE 1   // Lưu khi SpO2 lệch > 1%
+#define DEADBAND_STEPS_TOLERANCE 0  // Lưu khi có bước mới
+#define DEADBAND_MAX_HOLD_S 30      // Luôn lưu ít nhất một mẫu mỗi 30 giây
+
+// === Lịch sử nén trong RAM (history_store.h) ===
+#define HISTORY_SAMPLE_INTERVAL_S 2  // Lưu 1 mẫu lịch sử mỗi 2 giây
+#define HISTORY_BLOCK_SIZE 512       // Kích thước một khối (bytes)
+#define HISTORY_BLOCK_COUNT 192      // 96 KB ≈ 47000 mẫu x 2 byte ≈ 26 giờ (trường hợp xấu, không tính mẫu tuyệt đối)
+#define HISTORY_FRAME_BYTES 2048     // Kích thước khung nén gửi bù (~950 mẫu, chia mảnh theo MTU)
+#define HISTORY_SEND_INTERVAL_MS 20  // Khoảng cách giữa hai khung gửi bù (1 ngày ≈ 46 khung)
+
+// === Truyền BLE ===
+#define BLE_CHUNK_TIMEOUT_MS 1000      // Bỏ khung nếu không gửi được mảnh nào trong khoảng này
+#define BLE_PREFER_2M_PHY 1            // Đề nghị LE 2M PHY sau khi kết nối (giữ 1M nếu điện thoại không hỗ trợ)
+#define BLE_DATA_LENGTH 251            // Độ dài PDU tầng liên kết đề nghị (DLE, 27 = tắt)
+#define BLE_QUEUE_ALERT_BYTES 64       // Hàng đợi notification lớp cảnh báo (lũy thừa của 2, ~3 khung)
+#define BLE_QUEUE_REALTIME_BYTES 128   // Lớp thời gian thực (~9 mẫu; đầy thì bỏ mẫu cũ nhất)
+#define BLE_QUEUE_BATCH_BYTES 8192     // Lớp batch/lịch sử/rollup (đủ cho 2 khung lịch sử + khung batch)
+#define BLE_NOTIFY_WINDOW 8            // Số mảnh tối đa đã notify mà stack chưa báo gửi xong (ESP_GATTS_CONF_EVT)
+#define BLE_NOTIFY_CONF_TIMEOUT_MS 200 // Không nhận CONF trong khoảng này thì bỏ cửa sổ (chỉ dựa vào nghẽn)
+
+// === Tham số kết nối BLE theo trạng thái (khoảng kết nối: đơn vị 1.25 ms, timeout: đơn vị 10 ms) ===
+// Giữ trong giới hạn của iOS: interval x (latency + 1) <= 2 s, timeout <= 6 s
+#define BLE_CONN_REALTIME_MIN_INTERVAL 24 // 30 ms: gửi mẫu thời gian thực ngay
+#define BLE_CONN_REALTIME_MAX_INTERVAL 40 // 50 ms
+#define BLE_CONN_REALTIME_LATENCY 0
+#define BLE_CONN_REALTIME_TIMEOUT 400     // 4 s
+#define BLE_CONN_IDLE_MIN_INTERVAL 320    // 400 ms: chế độ batch, radio gần như tắt giữa các khung
+#define BLE_CONN_IDLE_MAX_INTERVAL 400    // 500 ms
+#define BLE_CONN_IDLE_LATENCY 3           // Được bỏ 3 sự kiện khi không có gì gửi (tối đa 2 s)
+#define BLE_CONN_IDLE_TIMEOUT 600         // 6 s
+#define BLE_CONN_BULK_MIN_INTERVAL 12     // 15 ms: gửi bù lịch sử nhanh nhất có thể
+#define BLE_CONN_BULK_MAX_INTERVAL 24     // 30 ms
+#define BLE_CONN_BULK_LATENCY 0
+#define BLE_CONN_BULK_TIMEOUT 400         // 4 s
+
+// === Tổng hợp theo phút/giờ (rollup.h) ===
+#define ROLLUP_MINUTE_COUNT 64 // Số khoảng phút đã đóng giữ lại (lũy thừa của 2, ~1 giờ)
+#define ROLLUP_HOUR_COUNT 32   // Số khoảng giờ đã đóng giữ lại (lũy thừa của 2, > 1 ngày)
+#define ROLLUP_FRAME_BYTES 512 // Khung rollup tối đa (giới hạn thuộc tính BLE)
+
+// === Nhật ký mẫu trên flash (flash_log.h, phân vùng samplelog trong partitions.csv) ===
+#define FLASH_LOG_PREPARE_PAGES 2 // Xóa trước sector kế tiếp khi sector đang ghi còn <= 2 trang trống
 
 // === Battery voltage thresholds ===
 #define BATTERY_FULL_VOLTAGE 4.2  // Voltage khi pin đầy (Li-Po)
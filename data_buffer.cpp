@@ -6,15 +6,26 @@
  */
 
 #include "data_buffer.h"
-#include <time.h>
+#include "flash_log.h"
+#include "batch_codec.h"
+#include <string.h>
+
+// Vòng mẫu là mảng phẳng + 2 chỉ số: getBinaryData()/getSpans() dựa vào bố cục này
+static_assert(sizeof(RingBuffer<HealthDataPacket, HR_BUFFER_SIZE>) ==
+                  HR_BUFFER_SIZE * sizeof(HealthDataPacket) + 2 * sizeof(uint16_t),
+              "Unexpected RingBuffer layout");
 
 /**
  * @brief Constructor - khởi tạo buffer rỗng
  */
-DataBuffer::DataBuffer()
-    : count_(0), head_(0), lastSendMs_(0), firstSampleMs_(0)
+DataBuffer::DataBuffer(hal::Clock &clock, hal::Logger &log)
+    : clock_(clock), log_(log), lastSendMs_(0), firstSampleMs_(0),
+      firstSeq_(1), epoch_(0), sentCount_(0), resend_(false), dropped_(0), lastHistoryTs_(0), hasHistory_(false), flashLog_(nullptr),
+      minuteRollups_(60), hourRollups_(3600), lastSteps_(0), hasSteps_(false)
 {
-    memset(buffer_, 0, sizeof(buffer_));
+    // Số thứ tự bắt đầu lại từ 1 sau mỗi lần reset: epoch mới cho điện thoại biết để không coi là trùng
+    while (epoch_ == 0)
+        epoch_ = hal::randomU32();
 }
 
 /**
@@ -27,36 +38,182 @@ DataBuffer::DataBuffer()
  */
 bool DataBuffer::addSample(float hr, float spo2, uint32_t steps)
 {
+    return addSample(makeSample(hr, spo2, steps));
+}
+
+/**
+ * @brief Thêm một mẫu đã đóng timestamp (ví dụ lấy từ hàng đợi thu thập)
+ */
+bool DataBuffer::addSample(const HealthDataPacket &sample)
+{
+    updateRollups(sample);
+    appendHistory(sample);
+
+    // Deadband: mẫu không đổi quá dung sai không vào buffer batch
+    if (!deadband_.accept(sample))
+        return isFull();
+
     // Ghi nhận thời điểm mẫu đầu tiên
-    if (count_ == 0)
+    if (getUnsentCount() == 0)
     {
-        firstSampleMs_ = millis();
+        firstSampleMs_ = clock_.millis();
     }
 
-    // Tạo mẫu mới
-    HealthDataPacket sample;
-    sample.hr = (uint8_t)constrain(hr, 0, 255);
-    sample.spo2 = (uint8_t)constrain(spo2, 0, 100);
-    sample.steps = steps;
-    
-    // Sử dụng Unix timestamp thực tế
-    time_t now;
-    time(&now);
-    sample.timestamp = (uint32_t)now;
+    // Buffer đầy: mẫu cũ nhất (chưa được xác nhận) bị ghi đè
+    if (samples_.full())
+    {
+        firstSeq_++;
+        if (sentCount_ > 0)
+            sentCount_--;
+        dropped_++;
+    }
+    samples_.push(sample);
+
+    log_.printf("[Buffer] Added sample: HR=%d, SpO2=%d, Steps=%u, Count=%d/%d, TS=%u\n",
+                sample.hr, sample.spo2, sample.steps, samples_.size(), HR_BUFFER_SIZE, sample.timestamp);
+
+    return isFull();
+}
+
+/**
+ * @brief Đổi cấu hình deadband
+ */
+void DataBuffer::setDeadband(const DeadbandConfig &config)
+{
+    const DeadbandConfig &cur = deadband_.config();
+    if (memcmp(&cur, &config, sizeof(config)) == 0)
+        return;
+    deadband_.configure(config);
+    log_.printf("[Buffer] Deadband %s: HR±%d SpO2±%d steps±%d hold %us\n",
+                config.enabled ? "on" : "off", config.hrTol, config.spo2Tol, config.stepsTol,
+                (unsigned)config.maxHoldS);
+}
+
+const DeadbandFilter &DataBuffer::deadband() const
+{
+    return deadband_;
+}
+
+/**
+ * @brief Chỉ ghi mẫu vào lịch sử
+ */
+void DataBuffer::recordHistory(float hr, float spo2, uint32_t steps)
+{
+    recordHistory(makeSample(hr, spo2, steps));
+}
+
+void DataBuffer::recordHistory(const HealthDataPacket &sample)
+{
+    updateRollups(sample);
+    appendHistory(sample);
+}
+
+/**
+ * @brief Lịch sử nén
+ */
+const HistoryStore &DataBuffer::history() const
+{
+    return history_;
+}
+
+/**
+ * @brief Xuất tầng tổng hợp thành khung rollup
+ */
+size_t DataBuffer::getRollups(RollupLevel level, uint8_t *output, size_t maxLen) const
+{
+    if (level == ROLLUP_HOUR)
+        return hourRollups_.encode(level, output, maxLen);
+    return minuteRollups_.encode(ROLLUP_MINUTE, output, maxLen);
+}
+
+const RollupTier<ROLLUP_MINUTE_COUNT> &DataBuffer::minuteRollups() const
+{
+    return minuteRollups_;
+}
 
-    // Thêm vào buffer
-    buffer_[head_] = sample;
-    head_ = (head_ + 1) % HR_BUFFER_SIZE;
+const RollupTier<ROLLUP_HOUR_COUNT> &DataBuffer::hourRollups() const
+{
+    return hourRollups_;
+}
 
-    if (count_ < HR_BUFFER_SIZE)
+/**
+ * @brief Gắn nhật ký flash
+ */
+void DataBuffer::attachFlashLog(FlashLog *log)
+{
+    flashLog_ = log;
+}
+
+/**
+ * @brief Nạp lại lịch sử từ nhật ký flash sau reset/mất điện
+ *
+ * Mẫu đọc lại đi vào vòng lịch sử và các tầng tổng hợp nhưng không được ghi
+ * lại xuống flash. Nhật ký dài hơn vòng RAM thì chỉ phần mới nhất còn lại.
+ */
+uint32_t DataBuffer::restoreHistory(FlashLog &log)
+{
+    FlashLogReader reader(log);
+    HealthDataPacket sample;
+    uint32_t count = 0;
+    while (reader.next(sample))
     {
-        count_++;
+        updateRollups(sample);
+        history_.append(sample);
+        lastHistoryTs_ = sample.timestamp;
+        hasHistory_ = true;
+        count++;
     }
+    return count;
+}
+
+/**
+ * @brief Tạo mẫu với Unix timestamp thực tế
+ */
+HealthDataPacket DataBuffer::makeSample(float hr, float spo2, uint32_t steps) const
+{
+    HealthDataPacket sample;
+    sample.hr = (uint8_t)(hr < 0 ? 0 : (hr > 255 ? 255 : hr));
+    sample.spo2 = (uint8_t)(spo2 < 0 ? 0 : (spo2 > 100 ? 100 : spo2));
+    sample.steps = steps;
+    sample.timestamp = clock_.unixTime();
+    return sample;
+}
 
-    Serial.printf("[Buffer] Added sample: HR=%d, SpO2=%d, Steps=%u, Count=%d/%d, TS=%u\n",
-                  sample.hr, sample.spo2, sample.steps, count_, HR_BUFFER_SIZE, sample.timestamp);
+/**
+ * @brief Thêm vào lịch sử, hạ tần số xuống HISTORY_SAMPLE_INTERVAL_S
+ *
+ * Timestamp lùi (sau khi đồng bộ thời gian) cũng được ghi ngay.
+ */
+void DataBuffer::appendHistory(const HealthDataPacket &sample)
+{
+    int32_t sinceLast = (int32_t)(sample.timestamp - lastHistoryTs_);
+    if (hasHistory_ && sinceLast >= 0 && sinceLast < HISTORY_SAMPLE_INTERVAL_S)
+        return;
 
-    return isFull();
+    history_.append(sample);
+    lastHistoryTs_ = sample.timestamp;
+    hasHistory_ = true;
+
+    if (flashLog_)
+        flashLog_->append(sample);
+}
+
+/**
+ * @brief Cộng mẫu vào tầng phút và tầng giờ
+ *
+ * Số bước tăng thêm tính từ mẫu trước; bộ đếm giảm (reset qua ngày) thì
+ * toàn bộ giá trị mới được tính là bước tăng thêm.
+ */
+void DataBuffer::updateRollups(const HealthDataPacket &sample)
+{
+    uint32_t stepDelta = 0;
+    if (hasSteps_)
+        stepDelta = (sample.steps >= lastSteps_) ? sample.steps - lastSteps_ : sample.steps;
+    lastSteps_ = sample.steps;
+    hasSteps_ = true;
+
+    minuteRollups_.add(sample, stepDelta);
+    hourRollups_.add(sample, stepDelta);
 }
 
 /**
@@ -64,7 +221,7 @@ bool DataBuffer::addSample(float hr, float spo2, uint32_t steps)
  */
 bool DataBuffer::isFull() const
 {
-    return (count_ >= HR_BUFFER_SIZE);
+    return samples_.full();
 }
 
 /**
@@ -74,19 +231,24 @@ bool DataBuffer::shouldSend() const
 {
     // Cần ít nhất 10 samples để gửi (tránh gửi dữ liệu quá ít)
     const uint16_t MIN_SAMPLES_TO_SEND = 10;
+    uint16_t unsent = getUnsentCount();
+
+    // Đang gửi lại sau khi mất ack/kết nối lại
+    if (resend_ && unsent > 0)
+        return true;
 
-    if (count_ < MIN_SAMPLES_TO_SEND)
+    if (unsent < MIN_SAMPLES_TO_SEND)
         return false;
 
-    // Buffer đầy
-    if (isFull())
+    // Đủ một khung hoặc buffer đầy
+    if (unsent >= SYNC_BATCH_SAMPLES || isFull())
         return true;
 
-    // Đã quá DATA_SEND_INTERVAL_MS kể từ mẫu đầu tiên
-    if (millis() - firstSampleMs_ >= DATA_SEND_INTERVAL_MS)
+    // Đã quá DATA_SEND_INTERVAL_MS kể từ mẫu chưa gửi đầu tiên
+    if (clock_.millis() - firstSampleMs_ >= DATA_SEND_INTERVAL_MS)
     {
-        Serial.printf("[Buffer] Time to send: %d samples after %lu ms\n",
-                      count_, millis() - firstSampleMs_);
+        log_.printf("[Buffer] Time to send: %d samples after %lu ms\n",
+                    unsent, clock_.millis() - firstSampleMs_);
         return true;
     }
 
@@ -98,13 +260,118 @@ bool DataBuffer::shouldSend() const
  */
 uint16_t DataBuffer::getCount() const
 {
-    return count_;
+    return samples_.size();
+}
+
+uint16_t DataBuffer::getUnsentCount() const
+{
+    return samples_.size() - sentCount_;
+}
+
+uint32_t DataBuffer::firstSequence() const
+{
+    return firstSeq_;
+}
+
+uint32_t DataBuffer::nextSequence() const
+{
+    return firstSeq_ + samples_.size();
+}
+
+uint32_t DataBuffer::epoch() const
+{
+    return epoch_;
+}
+
+uint32_t DataBuffer::droppedCount() const
+{
+    return dropped_;
+}
+
+/**
+ * @brief Giải phóng các mẫu đã gửi có số thứ tự <= seq
+ *
+ * Ack cũ (seq < firstSeq_) hoặc vượt quá phần đã gửi được bỏ qua/giới hạn,
+ * nên điện thoại có thể ack lại an toàn sau khi kết nối lại.
+ */
+uint16_t DataBuffer::acknowledge(uint32_t seq)
+{
+    int32_t n = (int32_t)(seq - firstSeq_) + 1;
+    if (n <= 0)
+        return 0;
+    if (n > sentCount_)
+        n = sentCount_;
+
+    samples_.drop(n);
+    firstSeq_ += n;
+    sentCount_ -= n;
+    lastSendMs_ = clock_.millis();
+
+    if (n > 0)
+    {
+        log_.printf("[Buffer] Ack seq %u: released %d samples, %d awaiting ack, %d unsent\n",
+                    seq, (int)n, sentCount_, getUnsentCount());
+    }
+    return (uint16_t)n;
+}
+
+/**
+ * @brief Chuyển n mẫu từ chưa gửi sang chờ xác nhận
+ */
+void DataBuffer::markSent(uint16_t n)
+{
+    uint16_t unsent = getUnsentCount();
+    sentCount_ += (n < unsent) ? n : unsent;
+    lastSendMs_ = clock_.millis();
+    firstSampleMs_ = clock_.millis();
+    if (getUnsentCount() == 0)
+        resend_ = false;
+}
+
+/**
+ * @brief Go-back-N: mọi mẫu chưa xác nhận trở thành chưa gửi
+ */
+void DataBuffer::rewindUnacked()
+{
+    if (sentCount_ == 0)
+        return;
+    log_.printf("[Buffer] Resending from seq %u (%d samples)\n", firstSeq_, sentCount_);
+    sentCount_ = 0;
+    resend_ = true;
+}
+
+bool DataBuffer::ackTimedOut() const
+{
+    return sentCount_ > 0 && clock_.millis() - lastSendMs_ >= SYNC_ACK_TIMEOUT_MS;
+}
+
+/**
+ * @brief Nội dung buffer dưới dạng các dãy liên tiếp
+ */
+uint8_t DataBuffer::getSpans(SampleSpan spans[2]) const
+{
+    return samples_.spans(spans);
+}
+
+/**
+ * @brief Bỏ các mẫu cũ nhất
+ */
+void DataBuffer::release(uint16_t n)
+{
+    if (n >= samples_.size())
+    {
+        clear();
+        return;
+    }
+    samples_.drop(n);
+    firstSeq_ += n;
+    sentCount_ = (sentCount_ > n) ? sentCount_ - n : 0;
 }
 
 /**
  * @brief Lấy dữ liệu binary để gửi qua BLE
  *
- * Chỉ đơn giản là copy các struct HealthDataPacket từ buffer vòng vào output buffer.
+ * Chép từng span bằng một memcpy (không chia lấy dư theo từng phần tử).
  *
  * @param output Buffer đầu ra
  * @param maxLen Kích thước tối đa của buffer đầu ra
@@ -112,40 +379,87 @@ uint16_t DataBuffer::getCount() const
  */
 size_t DataBuffer::getBinaryData(uint8_t *output, size_t maxLen)
 {
-    size_t packetSize = sizeof(HealthDataPacket);
-    size_t totalSize = count_ * packetSize;
+    size_t totalSize = samples_.size() * sizeof(HealthDataPacket);
 
     if (totalSize > maxLen)
     {
-        Serial.println("[Buffer] Output buffer too small!");
+        log_.println("[Buffer] Output buffer too small!");
         return 0;
     }
 
-    // Duyệt buffer và copy vào output
-    // Lưu ý buffer là circular, nên cần duyệt từ phần tử cũ nhất
-    uint16_t startIdx = (count_ >= HR_BUFFER_SIZE) ? head_ : 0;
-    
-    for (uint16_t i = 0; i < count_; i++)
+    SampleSpan spans[2];
+    uint8_t n = getSpans(spans);
+    size_t offset = 0;
+    for (uint8_t i = 0; i < n; i++)
     {
-        uint16_t idx = (startIdx + i) % HR_BUFFER_SIZE;
-        memcpy(output + (i * packetSize), &buffer_[idx], packetSize);
+        size_t bytes = spans[i].count * sizeof(HealthDataPacket);
+        memcpy(output + offset, spans[i].data, bytes);
+        offset += bytes;
     }
 
-    Serial.printf("[Buffer] Prepared binary data: %d samples (%d bytes)\n", count_, totalSize);
+    log_.printf("[Buffer] Prepared binary data: %d samples (%u bytes)\n", samples_.size(), (unsigned)totalSize);
 
     return totalSize;
 }
 
+/**
+ * @brief Lấy dữ liệu dạng khung nén
+ *
+ * Mẫu đều đặn tốn 17 bit thay vì 10 byte (xem batch_codec.h). Bộ mã hóa đọc
+ * trực tiếp từ các span của vòng, bắt đầu từ mẫu chưa gửi đầu tiên, và dừng
+ * khi khung đầy; phần còn lại đi trong khung sau. SYNC_BATCH_COLUMNAR chọn
+ * bố cục cột thay cho bố cục hàng.
+ */
+size_t DataBuffer::getEncodedData(uint8_t *output, size_t maxLen, uint16_t *encoded, const ActivityFields *activity)
+{
+#if SYNC_BATCH_COLUMNAR
+    BatchColumnEncoder encoder;
+#else
+    BatchEncoder encoder;
+#endif
+    encoder.begin(output, maxLen, firstSeq_ + sentCount_, epoch_);
+    if (activity)
+        encoder.setActivity(*activity);
+
+    SampleSpan spans[2];
+    uint8_t n = samples_.spans(spans, sentCount_);
+    bool full = false;
+    for (uint8_t s = 0; s < n && !full; s++)
+    {
+        for (uint16_t i = 0; i < spans[s].count; i++)
+        {
+            if (!encoder.add(spans[s].data[i]))
+            {
+                full = true;
+                break;
+            }
+        }
+    }
+
+    size_t len = encoder.finish();
+    if (encoded)
+        *encoded = encoder.count();
+    if (len > 0)
+    {
+        log_.printf("[Buffer] Encoded frame: seq %u, %d samples (%u bytes, raw %u)\n",
+                    firstSeq_ + sentCount_, encoder.count(), (unsigned)len,
+                    (unsigned)(encoder.count() * sizeof(HealthDataPacket)));
+    }
+    return len;
+}
+
 /**
  * @brief Xóa buffer sau khi đã gửi thành công
  */
 void DataBuffer::clear()
 {
-    count_ = 0;
-    head_ = 0;
+    firstSeq_ += samples_.size();
+    sentCount_ = 0;
+    resend_ = false;
+    samples_.clear();
     firstSampleMs_ = 0;
-    lastSendMs_ = millis();
-    Serial.println("[Buffer] Buffer cleared");
+    lastSendMs_ = clock_.millis();
+    log_.println("[Buffer] Buffer cleared");
 }
 
 /**
@@ -153,7 +467,7 @@ void DataBuffer::clear()
  */
 void DataBuffer::resetSendTimer()
 {
-    lastSendMs_ = millis();
+    lastSendMs_ = clock_.millis();
 }
 
 /**
@@ -161,12 +475,11 @@ void DataBuffer::resetSendTimer()
  */
 HealthDataPacket DataBuffer::getLatestSample() const
 {
-    if (count_ == 0)
+    if (samples_.empty())
     {
         HealthDataPacket empty = {0, 0, 0, 0};
         return empty;
     }
 
-    uint16_t lastIdx = (head_ == 0) ? (HR_BUFFER_SIZE - 1) : (head_ - 1);
-    return buffer_[lastIdx];
+    return samples_.newest();
 }
\ No newline at end of file
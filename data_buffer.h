@@ -8,22 +8,47 @@
  * - Lưu trữ dữ liệu HR/SpO2 mỗi giây
  * - Tự động gửi khi buffer đầy hoặc sau 5 phút
  * - Nén dữ liệu để gửi qua BLE
+ * - Lưu lịch sử nén nhiều giờ (HistoryStore) để gửi bù khi điện thoại kết nối lại
+ * - Ghi lịch sử xuống flash (FlashLog) để không mất khi reset/mất điện
+ * - Tổng hợp min/avg/max theo phút và theo giờ (rollup.h) cho mọi mẫu
+ * - Đồng bộ có xác nhận: mỗi mẫu batch có số thứ tự tăng dần, được giữ lại
+ *   đến khi điện thoại ack số thứ tự liên tục cao nhất đã nhận; mất ack hoặc
+ *   kết nối lại thì gửi tiếp từ mẫu chưa xác nhận (go-back-N)
+ *   Số thứ tự bắt đầu lại từ 1 mỗi lần khởi động; epoch ngẫu nhiên chọn lúc
+ *   khởi động đi kèm mỗi khung và trạng thái đồng bộ để điện thoại nhận ra
+ *   lần khởi động mới thay vì bỏ mẫu mới vì trùng số thứ tự cũ
+ *   Mẫu chưa xác nhận bị ghi đè khi buffer đầy: firstSequence() vượt quá ack
+ *   của điện thoại, khoảng trống đó chỉ còn trong lịch sử
+ * - Chế độ deadband (deadband.h): chỉ đưa vào buffer batch mẫu có thay đổi;
+ *   tổng hợp và lịch sử vẫn nhận mọi mẫu
  */
 
 #pragma once
-#include <Arduino.h>
+#include "hal.h"
 #include "board_config.h"
-#include "ble_service_manager.h" // Để sử dụng HealthDataPacket
+#include "health_data_packet.h"
+#include "history_store.h"
+#include "ring_buffer.h"
+#include "rollup.h"
+#include "deadband.h"
+
+class FlashLog;
+
+/// @brief Dãy mẫu liên tiếp trong bộ nhớ (không sở hữu dữ liệu)
+typedef RingSpan<HealthDataPacket> SampleSpan;
 
 /**
  * @class DataBuffer
- * @brief Buffer circular để lưu trữ dữ liệu HR/SpO2
+ * @brief Buffer circular để lưu trữ dữ liệu HR/SpO2 (trên RingBuffer)
  */
 class DataBuffer
 {
 public:
     /// @brief Constructor
-    DataBuffer();
+    /// @param clock Đồng hồ (millis và Unix timestamp cho mẫu)
+    /// @param log Đầu ra log
+    explicit DataBuffer(hal::Clock &clock = hal::defaultClock(),
+                        hal::Logger &log = hal::defaultLogger());
 
     /// @brief Thêm một mẫu dữ liệu vào buffer
     /// @param hr Nhịp tim (BPM)
@@ -32,24 +57,121 @@ public:
     /// @return true nếu buffer đầy sau khi thêm
     bool addSample(float hr, float spo2, uint32_t steps);
 
+    /// @brief Thêm một mẫu đã đóng timestamp
+    /// @param sample Mẫu (tạo bằng makeSample() tại thời điểm đo)
+    /// @return true nếu buffer đầy sau khi thêm
+    /// @note Ở chế độ deadband, mẫu không đổi chỉ vào tổng hợp và lịch sử
+    bool addSample(const HealthDataPacket &sample);
+
+    /// @brief Đổi cấu hình deadband (mẫu kế tiếp luôn được lưu)
+    void setDeadband(const DeadbandConfig &config);
+
+    /// @brief Bộ lọc deadband (cấu hình, số mẫu đã bỏ)
+    const DeadbandFilter &deadband() const;
+
+    /// @brief Chỉ ghi mẫu vào lịch sử (dùng ở chế độ Realtime)
+    /// @param hr Nhịp tim (BPM)
+    /// @param spo2 Độ bão hòa oxy (%)
+    /// @param steps Số bước chân hiện tại
+    void recordHistory(float hr, float spo2, uint32_t steps);
+
+    /// @brief Chỉ ghi mẫu đã đóng timestamp vào lịch sử
+    void recordHistory(const HealthDataPacket &sample);
+
+    /// @brief Tạo mẫu với timestamp hiện tại, giới hạn HR 0-255 và SpO2 0-100
+    HealthDataPacket makeSample(float hr, float spo2, uint32_t steps) const;
+
+    /// @brief Lịch sử nén (đọc bằng HistoryReader)
+    const HistoryStore &history() const;
+
+    /// @brief Xuất tầng tổng hợp thành khung rollup (các khoảng mới nhất vừa bộ đệm)
+    /// @param level Tầng phút hoặc giờ
+    /// @param output Buffer đầu ra
+    /// @param maxLen Kích thước tối đa của buffer đầu ra
+    /// @return Độ dài khung (0 nếu chưa có dữ liệu)
+    size_t getRollups(RollupLevel level, uint8_t *output, size_t maxLen) const;
+
+    /// @brief Tầng tổng hợp theo phút
+    const RollupTier<ROLLUP_MINUTE_COUNT> &minuteRollups() const;
+
+    /// @brief Tầng tổng hợp theo giờ
+    const RollupTier<ROLLUP_HOUR_COUNT> &hourRollups() const;
+
+    /// @brief Ghi thêm mọi mẫu lịch sử vào nhật ký flash
+    /// @param log Nhật ký đã begin() thành công (nullptr để tắt)
+    void attachFlashLog(FlashLog *log);
+
+    /// @brief Nạp lại lịch sử và tầng tổng hợp từ nhật ký flash (gọi một lần khi khởi động)
+    /// @param log Nhật ký đã begin() thành công
+    /// @return Số mẫu đã nạp
+    uint32_t restoreHistory(FlashLog &log);
+
     /// @brief Kiểm tra xem buffer có đầy không
-    /// @return true nếu buffer đầy
+    /// @return true nếu buffer đầy (mẫu kế tiếp sẽ ghi đè mẫu chưa xác nhận cũ nhất)
     bool isFull() const;
 
     /// @brief Kiểm tra xem có nên gửi dữ liệu không
-    /// @return true nếu đủ điều kiện gửi (đầy hoặc timeout)
+    /// @return true nếu đủ mẫu chưa gửi (SYNC_BATCH_SAMPLES, đầy hoặc timeout) hoặc cần gửi lại
     bool shouldSend() const;
 
-    /// @brief Lấy số lượng mẫu trong buffer
+    /// @brief Lấy số lượng mẫu trong buffer (gồm cả mẫu đã gửi chờ xác nhận)
     /// @return Số mẫu hiện có
     uint16_t getCount() const;
 
+    /// @brief Số mẫu chưa gửi
+    uint16_t getUnsentCount() const;
+
+    /// @brief Số thứ tự của mẫu cũ nhất còn giữ (= ack gần nhất + 1)
+    uint32_t firstSequence() const;
+
+    /// @brief Số thứ tự sẽ gán cho mẫu kế tiếp
+    uint32_t nextSequence() const;
+
+    /// @brief Epoch đồng bộ của lần khởi động này (ngẫu nhiên, khác 0)
+    uint32_t epoch() const;
+
+    /// @brief Số mẫu chưa xác nhận bị ghi đè vì buffer đầy
+    uint32_t droppedCount() const;
+
+    /// @brief Điện thoại xác nhận đã nhận liên tục đến số thứ tự seq
+    /// @param seq Số thứ tự cao nhất đã nhận liên tục (ack tích lũy)
+    /// @return Số mẫu được giải phóng
+    uint16_t acknowledge(uint32_t seq);
+
+    /// @brief Đánh dấu n mẫu chưa gửi cũ nhất là đã gửi (chờ xác nhận)
+    void markSent(uint16_t n);
+
+    /// @brief Gửi lại từ mẫu chưa xác nhận cũ nhất (kết nối lại hoặc hết hạn chờ ack)
+    void rewindUnacked();
+
+    /// @brief Đã quá SYNC_ACK_TIMEOUT_MS kể từ lần gửi/ack cuối mà vẫn còn mẫu chờ xác nhận
+    bool ackTimedOut() const;
+
+    /// @brief Nội dung buffer dưới dạng tối đa hai dãy liên tiếp (hai nửa của vòng)
+    /// @param spans Mảng đầu ra, theo thứ tự từ mẫu cũ nhất
+    /// @return Số span hợp lệ (0, 1 hoặc 2)
+    /// @note Span chỉ còn hợp lệ đến lần addSample()/release()/acknowledge()/clear() kế tiếp
+    uint8_t getSpans(SampleSpan spans[2]) const;
+
+    /// @brief Bỏ n mẫu cũ nhất (không chờ xác nhận)
+    /// @param n Số mẫu
+    void release(uint16_t n);
+
     /// @brief Lấy dữ liệu binary để gửi qua BLE
     /// @param output Buffer đầu ra
     /// @param maxLen Kích thước tối đa của buffer đầu ra
     /// @return Số bytes đã ghi vào output
     size_t getBinaryData(uint8_t *output, size_t maxLen);
 
+    /// @brief Mã hóa các mẫu chưa gửi thành khung đồng bộ (batch_codec.h, có số thứ tự)
+    /// @param output Buffer đầu ra
+    /// @param maxLen Kích thước tối đa của buffer đầu ra
+    /// @param encoded Số mẫu đã đưa vào khung (truyền cho markSent() khi gửi thành công)
+    /// @param activity Khối hoạt động gửi kèm (nullptr = không gửi)
+    /// @return Độ dài khung (0 nếu không có mẫu chưa gửi)
+    size_t getEncodedData(uint8_t *output, size_t maxLen, uint16_t *encoded = nullptr,
+                          const ActivityFields *activity = nullptr);
+
     /// @brief Xóa buffer sau khi đã gửi
     void clear();
 
@@ -61,9 +183,29 @@ public:
     HealthDataPacket getLatestSample() const;
 
 private:
-    HealthDataPacket buffer_[HR_BUFFER_SIZE]; ///< Buffer lưu trữ (dùng struct chung)
-    uint16_t count_;                          ///< Số mẫu hiện có
-    uint16_t head_;                           ///< Vị trí ghi tiếp theo
-    unsigned long lastSendMs_;                ///< Thời điểm gửi lần cuối
-    unsigned long firstSampleMs_;             ///< Thời điểm mẫu đầu tiên
+    /// @brief Thêm mẫu vào lịch sử nếu đã qua HISTORY_SAMPLE_INTERVAL_S
+    void appendHistory(const HealthDataPacket &sample);
+
+    /// @brief Cộng mẫu vào các tầng tổng hợp
+    void updateRollups(const HealthDataPacket &sample);
+
+    hal::Clock &clock_;                                    ///< Đồng hồ
+    hal::Logger &log_;                                     ///< Đầu ra log
+    RingBuffer<HealthDataPacket, HR_BUFFER_SIZE> samples_; ///< Vòng mẫu chờ gửi
+    unsigned long lastSendMs_;                             ///< Thời điểm gửi hoặc nhận ack lần cuối
+    unsigned long firstSampleMs_;                          ///< Thời điểm mẫu chưa gửi đầu tiên
+    uint32_t firstSeq_;                                    ///< Số thứ tự của samples_[0]
+    uint32_t epoch_;                                       ///< Epoch đồng bộ (chọn ngẫu nhiên khi khởi động)
+    uint16_t sentCount_;                                   ///< Số mẫu cũ nhất đã gửi, chờ xác nhận
+    bool resend_;                                          ///< Đã quay lại gửi lại, gửi ngay không chờ đủ mẫu
+    uint32_t dropped_;                                     ///< Mẫu chưa xác nhận bị ghi đè
+    HistoryStore history_;                                 ///< Lịch sử nén nhiều giờ
+    uint32_t lastHistoryTs_;                               ///< Timestamp mẫu lịch sử gần nhất
+    bool hasHistory_;                                      ///< Đã có mẫu lịch sử nào chưa
+    FlashLog *flashLog_;                                   ///< Nhật ký flash (có thể nullptr)
+    RollupTier<ROLLUP_MINUTE_COUNT> minuteRollups_;        ///< Tổng hợp theo phút
+    RollupTier<ROLLUP_HOUR_COUNT> hourRollups_;            ///< Tổng hợp theo giờ
+    uint32_t lastSteps_;                                   ///< Bộ đếm bước ở mẫu trước (tính số bước tăng thêm)
+    bool hasSteps_;                                        ///< Đã có mẫu trước chưa
+    DeadbandFilter deadband_;                              ///< Bộ lọc deadband cho buffer batch
 };
\ No newline at end of file
@@ -0,0 +1,115 @@
+/**
+ * @file deadband.cpp
+ * @brief Triển khai bộ lọc deadband và bộ khôi phục chuỗi
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#include "deadband.h"
+#include "board_config.h"
+#include <string.h>
+
+static inline uint32_t absDiff(uint32_t a, uint32_t b)
+{
+    return (a > b) ? (a - b) : (b - a);
+}
+
+// ==================== DeadbandFilter ====================
+
+DeadbandFilter::DeadbandFilter()
+    : hasRef_(false), suppressed_(0)
+{
+    config_.enabled = DEADBAND_ENABLED;
+    config_.hrTol = DEADBAND_HR_TOLERANCE;
+    config_.spo2Tol = DEADBAND_SPO2_TOLERANCE;
+    config_.stepsTol = DEADBAND_STEPS_TOLERANCE;
+    config_.maxHoldS = DEADBAND_MAX_HOLD_S;
+    memset(&ref_, 0, sizeof(ref_));
+}
+
+void DeadbandFilter::configure(const DeadbandConfig &config)
+{
+    config_ = config;
+    hasRef_ = false;
+}
+
+const DeadbandConfig &DeadbandFilter::config() const
+{
+    return config_;
+}
+
+/**
+ * @brief Lưu khi lệch quá dung sai, hết thời gian giữ, hoặc timestamp lùi
+ */
+bool DeadbandFilter::accept(const HealthDataPacket &sample)
+{
+    if (config_.enabled && hasRef_)
+    {
+        int32_t held = (int32_t)(sample.timestamp - ref_.timestamp);
+        bool steady = held >= 0 && held < config_.maxHoldS &&
+                      absDiff(sample.hr, ref_.hr) <= config_.hrTol &&
+                      absDiff(sample.spo2, ref_.spo2) <= config_.spo2Tol &&
+                      absDiff(sample.steps, ref_.steps) <= config_.stepsTol;
+        if (steady)
+        {
+            suppressed_++;
+            return false;
+        }
+    }
+
+    ref_ = sample;
+    hasRef_ = true;
+    return true;
+}
+
+void DeadbandFilter::reset()
+{
+    hasRef_ = false;
+}
+
+uint32_t DeadbandFilter::suppressed() const
+{
+    return suppressed_;
+}
+
+// ==================== DeadbandExpander ====================
+
+DeadbandExpander::DeadbandExpander(uint16_t maxHoldS)
+    : maxHoldS_(maxHoldS), hasPrev_(false)
+{
+    memset(&prev_, 0, sizeof(prev_));
+}
+
+/**
+ * @brief Điền các giây trống bằng giá trị bản ghi trước
+ *
+ * Khoảng trống dài hơn maxHoldS không được điền (không có dữ liệu).
+ */
+size_t DeadbandExpander::add(const HealthDataPacket &record, HealthDataPacket *out, size_t maxOut)
+{
+    size_t n = 0;
+    if (hasPrev_)
+    {
+        uint32_t gap = record.timestamp - prev_.timestamp;
+        if (gap > 1 && gap <= (uint32_t)maxHoldS_ + 1)
+        {
+            HealthDataPacket held = prev_;
+            for (uint32_t t = 1; t < gap && n < maxOut; t++)
+            {
+                held.timestamp = prev_.timestamp + t;
+                out[n++] = held;
+            }
+        }
+    }
+
+    if (n < maxOut)
+        out[n++] = record;
+    prev_ = record;
+    hasPrev_ = true;
+    return n;
+}
+
+void DeadbandExpander::reset()
+{
+    hasPrev_ = false;
+}
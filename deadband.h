@@ -0,0 +1,94 @@
+/**
+ * @file deadband.h
+ * @brief Lưu mẫu theo thay đổi (deadband) và khôi phục chuỗi dày phía điện thoại
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - DeadbandFilter: chỉ giữ mẫu khi HR/SpO2/bước lệch khỏi mẫu được giữ gần
+ *   nhất quá dung sai, hoặc đã quá thời gian giữ tối đa (maxHoldS)
+ * - DeadbandExpander: khôi phục chuỗi 1 mẫu/giây bằng cách giữ giá trị của
+ *   bản ghi trước cho các giây bị bỏ (dùng trên điện thoại/host)
+ *
+ * So sánh với mẫu được giữ (không phải mẫu vừa thấy) nên thay đổi chậm không
+ * trôi dần qua dung sai mà không bị ghi. Khoảng trống dài hơn maxHoldS giữa
+ * hai bản ghi nghĩa là không có dữ liệu (tháo thiết bị, tắt chế độ batch...).
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "health_data_packet.h"
+
+/**
+ * @struct DeadbandConfig
+ * @brief Cấu hình deadband (giá trị trên BLE: 6 byte theo đúng thứ tự này, little-endian)
+ */
+struct __attribute__((packed)) DeadbandConfig
+{
+    uint8_t enabled;   ///< 0 = lưu mọi mẫu, 1 = chỉ lưu khi thay đổi
+    uint8_t hrTol;     ///< Dung sai HR (BPM)
+    uint8_t spo2Tol;   ///< Dung sai SpO2 (%)
+    uint8_t stepsTol;  ///< Dung sai số bước
+    uint16_t maxHoldS; ///< Thời gian giữ tối đa (giây), sau đó luôn lưu một mẫu
+};
+
+/**
+ * @class DeadbandFilter
+ * @brief Quyết định mẫu nào được lưu
+ */
+class DeadbandFilter
+{
+public:
+    DeadbandFilter();
+
+    /// @brief Đổi cấu hình (mẫu kế tiếp luôn được lưu)
+    void configure(const DeadbandConfig &config);
+
+    /// @brief Cấu hình hiện tại
+    const DeadbandConfig &config() const;
+
+    /// @brief Mẫu có cần lưu không; nếu có thì trở thành mẫu tham chiếu
+    bool accept(const HealthDataPacket &sample);
+
+    /// @brief Quên mẫu tham chiếu (mẫu kế tiếp luôn được lưu)
+    void reset();
+
+    /// @brief Số mẫu đã bỏ
+    uint32_t suppressed() const;
+
+private:
+    DeadbandConfig config_; ///< Cấu hình
+    HealthDataPacket ref_;  ///< Mẫu được lưu gần nhất
+    bool hasRef_;           ///< Đã có mẫu tham chiếu
+    uint32_t suppressed_;   ///< Số mẫu đã bỏ
+};
+
+/**
+ * @class DeadbandExpander
+ * @brief Khôi phục chuỗi dày từ các bản ghi deadband (phía điện thoại/host)
+ *
+ * Cho bản ghi theo thứ tự; mỗi lần add() trả về các mẫu giữ giá trị cho
+ * những giây giữa bản ghi trước và bản ghi này, rồi chính bản ghi này.
+ */
+class DeadbandExpander
+{
+public:
+    /// @param maxHoldS Thời gian giữ tối đa đã cấu hình trên thiết bị
+    explicit DeadbandExpander(uint16_t maxHoldS);
+
+    /// @brief Thêm một bản ghi
+    /// @param record Bản ghi kế tiếp (timestamp không giảm)
+    /// @param out Mảng đầu ra (cần tối đa maxHoldS + 1 phần tử)
+    /// @param maxOut Kích thước mảng đầu ra
+    /// @return Số mẫu đã ghi
+    size_t add(const HealthDataPacket &record, HealthDataPacket *out, size_t maxOut);
+
+    /// @brief Quên bản ghi trước (bắt đầu chuỗi mới)
+    void reset();
+
+private:
+    uint16_t maxHoldS_;     ///< Thời gian giữ tối đa (giây)
+    HealthDataPacket prev_; ///< Bản ghi trước
+    bool hasPrev_;          ///< Đã có bản ghi trước
+};
@@ -0,0 +1,532 @@
+/**
+ * @file dsp_filters.h
+ * @brief Thư viện lọc số header-only: biquad, FIR, tổng trượt, chặn DC
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - Các bộ lọc template theo kiểu mẫu: int16_t, int32_t, q15_t, float
+ * - Hệ số được thiết kế bằng hàm constexpr từ tần số cắt và tần số lấy mẫu
+ *   (tính lúc biên dịch, không tốn CPU lúc chạy), bằng double để hệ số Q28
+ *   giữ đủ độ chính xác cho bộ lọc tần số cắt thấp
+ * - Kiểu số nguyên dùng hệ số cố định Q28 và bộ tích lũy 64-bit
+ *   (ESP32-C3 không có FPU nên đường số nguyên nhanh hơn float nhiều lần)
+ * - Bộ lọc hồi quy kiểu số nguyên mang phần dư làm tròn sang mẫu sau (error
+ *   feedback bậc 1) nên không có vùng chết/lệch DC khi cực gần vòng tròn đơn vị
+ *
+ * Ví dụ:
+ * @code
+ * static constexpr dsp::BiquadCoeffs kLp = dsp::designLowPass(5.0f, 100.0f);
+ * dsp::Biquad<int16_t> lp(kLp);
+ * int16_t y = lp.process(x);
+ * @endcode
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+namespace dsp
+{
+
+// =====================================================================
+// Toán học constexpr (dùng cho thiết kế hệ số lúc biên dịch)
+// =====================================================================
+
+static constexpr double kPi = 3.14159265358979323846;
+
+/// @brief sin(x) constexpr - chuỗi Taylor sau khi đưa x về [-π, π]
+constexpr double cSin(double x)
+{
+    while (x > kPi)
+        x -= 2.0 * kPi;
+    while (x < -kPi)
+        x += 2.0 * kPi;
+
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 14; n++)
+    {
+        term *= -x * x / (double)((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+/// @brief cos(x) constexpr
+constexpr double cCos(double x)
+{
+    return cSin(x + kPi / 2.0);
+}
+
+// =====================================================================
+// Kiểu mẫu và đặc tính số học
+// =====================================================================
+
+/**
+ * @struct q15_t
+ * @brief Số cố định Q15 (int16, 1 = 32768) - phân biệt với int16_t thô về mặt kiểu
+ */
+struct q15_t
+{
+    int16_t raw;
+
+    /// @brief Chuyển từ float [-1, 1) sang Q15 (có bão hòa)
+    static constexpr q15_t fromFloat(float f)
+    {
+        return q15_t{(int16_t)(f >= 0.99997f ? 32767 : (f <= -1.0f ? -32768 : (int32_t)(f * 32768.0f)))};
+    }
+
+    /// @brief Chuyển Q15 sang float
+    constexpr float toFloat() const { return (float)raw / 32768.0f; }
+};
+
+/// @brief Số bit phần thập phân của hệ số cho kiểu số nguyên
+static constexpr int COEFF_SHIFT = 28;
+
+/// @brief Bão hòa giá trị 64-bit vào khoảng [lo, hi]
+constexpr int64_t clamp64(int64_t v, int64_t lo, int64_t hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+/**
+ * @struct SampleTraits
+ * @brief Đặc tính số học theo kiểu mẫu
+ *
+ * - coeff_t: kiểu hệ số (float hoặc Q28 int32)
+ * - state_t: kiểu lưu trạng thái bộ lọc (mẫu đã mở rộng)
+ * - acc_t:   kiểu bộ tích lũy tích hệ số × mẫu
+ * - sum_t:   kiểu tổng cho MovingSum
+ *
+ * narrowShaped() lượng tử hóa bộ tích lũy có cộng phần dư của lần trước
+ * (residue): sai số làm tròn bị đẩy lên tần số cao thay vì tích lũy ở DC.
+ */
+template <typename T>
+struct SampleTraits;
+
+template <>
+struct SampleTraits<float>
+{
+    typedef float coeff_t;
+    typedef float state_t;
+    typedef float acc_t;
+    typedef float sum_t;
+
+    static constexpr coeff_t coeff(double c) { return (float)c; }
+    static constexpr state_t widen(float x) { return x; }
+    static constexpr acc_t mul(coeff_t c, state_t x) { return c * x; }
+    static constexpr float narrow(acc_t a) { return a; }
+    static float narrowShaped(acc_t a, acc_t &) { return a; }
+    static constexpr float fromState(state_t s) { return s; }
+};
+
+/// @brief Cơ sở chung cho các kiểu số nguyên (hệ số Q28, tích lũy 64-bit)
+template <typename T, int64_t LO, int64_t HI>
+struct IntegerTraits
+{
+    typedef int32_t coeff_t;
+    typedef int32_t state_t;
+    typedef int64_t acc_t;
+    typedef int64_t sum_t;
+
+    static constexpr coeff_t coeff(double c)
+    {
+        return (coeff_t)(c * (double)(1L << COEFF_SHIFT) + (c >= 0 ? 0.5 : -0.5));
+    }
+    static constexpr acc_t mul(coeff_t c, state_t x) { return (acc_t)c * (acc_t)x; }
+    static constexpr state_t narrowState(acc_t a)
+    {
+        return (state_t)clamp64((a + ((acc_t)1 << (COEFF_SHIFT - 1))) >> COEFF_SHIFT, LO, HI);
+    }
+
+    /// @brief Làm tròn a + residue, giữ phần dư cho mẫu sau (bỏ phần dư khi bão hòa)
+    static state_t narrowStateShaped(acc_t a, acc_t &residue)
+    {
+        a += residue;
+        acc_t y = (a + ((acc_t)1 << (COEFF_SHIFT - 1))) >> COEFF_SHIFT;
+        if (y < LO || y > HI)
+        {
+            residue = 0;
+            return (state_t)clamp64(y, LO, HI);
+        }
+        residue = a - y * ((acc_t)1 << COEFF_SHIFT);
+        return (state_t)y;
+    }
+};
+
+template <>
+struct SampleTraits<int16_t> : IntegerTraits<int16_t, INT16_MIN, INT16_MAX>
+{
+    static constexpr state_t widen(int16_t x) { return x; }
+    static constexpr int16_t narrow(acc_t a) { return (int16_t)narrowState(a); }
+    static int16_t narrowShaped(acc_t a, acc_t &r) { return (int16_t)narrowStateShaped(a, r); }
+    static constexpr int16_t fromState(state_t s) { return (int16_t)s; }
+};
+
+template <>
+struct SampleTraits<q15_t> : IntegerTraits<q15_t, INT16_MIN, INT16_MAX>
+{
+    static constexpr state_t widen(q15_t x) { return x.raw; }
+    static constexpr q15_t narrow(acc_t a) { return q15_t{(int16_t)narrowState(a)}; }
+    static q15_t narrowShaped(acc_t a, acc_t &r) { return q15_t{(int16_t)narrowStateShaped(a, r)}; }
+    static constexpr q15_t fromState(state_t s) { return q15_t{(int16_t)s}; }
+};
+
+template <>
+struct SampleTraits<int32_t> : IntegerTraits<int32_t, INT32_MIN, INT32_MAX>
+{
+    static constexpr state_t widen(int32_t x) { return x; }
+    static constexpr int32_t narrow(acc_t a) { return narrowState(a); }
+    static int32_t narrowShaped(acc_t a, acc_t &r) { return narrowStateShaped(a, r); }
+    static constexpr int32_t fromState(state_t s) { return s; }
+};
+
+// =====================================================================
+// Thiết kế hệ số (constexpr)
+// =====================================================================
+
+/**
+ * @struct BiquadCoeffs
+ * @brief Hệ số biquad đã chuẩn hóa (a0 = 1)
+ *
+ * y[n] = b0·x[n] + b1·x[n-1] + b2·x[n-2] - a1·y[n-1] - a2·y[n-2]
+ */
+struct BiquadCoeffs
+{
+    double b0, b1, b2, a1, a2;
+};
+
+/// @brief Low-pass bậc 2 (RBJ cookbook)
+/// @param fc Tần số cắt (Hz)
+/// @param fs Tần số lấy mẫu (Hz)
+/// @param q Hệ số phẩm chất (0.7071 = Butterworth)
+constexpr BiquadCoeffs designLowPass(double fc, double fs, double q = 0.7071067811865476)
+{
+    double w0 = 2.0 * kPi * fc / fs;
+    double cw = cCos(w0);
+    double alpha = cSin(w0) / (2.0 * q);
+    double a0 = 1.0 + alpha;
+    return BiquadCoeffs{(1.0 - cw) / 2.0 / a0, (1.0 - cw) / a0, (1.0 - cw) / 2.0 / a0,
+                        -2.0 * cw / a0, (1.0 - alpha) / a0};
+}
+
+/// @brief High-pass bậc 2 (RBJ cookbook)
+constexpr BiquadCoeffs designHighPass(double fc, double fs, double q = 0.7071067811865476)
+{
+    double w0 = 2.0 * kPi * fc / fs;
+    double cw = cCos(w0);
+    double alpha = cSin(w0) / (2.0 * q);
+    double a0 = 1.0 + alpha;
+    return BiquadCoeffs{(1.0 + cw) / 2.0 / a0, -(1.0 + cw) / a0, (1.0 + cw) / 2.0 / a0,
+                        -2.0 * cw / a0, (1.0 - alpha) / a0};
+}
+
+/// @brief Band-pass bậc 2, độ lợi đỉnh 0 dB (RBJ cookbook)
+/// @param fc Tần số trung tâm (Hz)
+constexpr BiquadCoeffs designBandPass(double fc, double fs, double q)
+{
+    double w0 = 2.0 * kPi * fc / fs;
+    double cw = cCos(w0);
+    double alpha = cSin(w0) / (2.0 * q);
+    double a0 = 1.0 + alpha;
+    return BiquadCoeffs{alpha / a0, 0.0, -alpha / a0, -2.0 * cw / a0, (1.0 - alpha) / a0};
+}
+
+/// @brief Hệ số high-pass một cực (RC): α = RC / (RC + dt)
+/// @param fc Tần số cắt (Hz)
+/// @param fs Tần số lấy mẫu (Hz)
+constexpr double designDcBlocker(double fc, double fs)
+{
+    return (1.0 / (2.0 * kPi * fc)) / ((1.0 / (2.0 * kPi * fc)) + 1.0 / fs);
+}
+
+/**
+ * @struct FirCoeffs
+ * @brief Hệ số FIR N tap
+ */
+template <size_t N>
+struct FirCoeffs
+{
+    double h[N];
+};
+
+/// @brief FIR low-pass bằng sinc có cửa sổ Hamming, độ lợi DC = 1
+template <size_t N>
+constexpr FirCoeffs<N> designLowPassFir(double fc, double fs)
+{
+    FirCoeffs<N> c{};
+    double wc = 2.0 * kPi * fc / fs;
+    double mid = (double)(N - 1) / 2.0;
+    double sum = 0.0;
+    for (size_t i = 0; i < N; i++)
+    {
+        double m = (double)i - mid;
+        double sinc = (m == 0.0) ? wc / kPi : cSin(wc * m) / (kPi * m);
+        double window = (N > 1) ? 0.54 - 0.46 * cCos(2.0 * kPi * (double)i / (double)(N - 1)) : 1.0;
+        c.h[i] = sinc * window;
+        sum += c.h[i];
+    }
+    for (size_t i = 0; i < N; i++)
+    {
+        c.h[i] /= sum;
+    }
+    return c;
+}
+
+// =====================================================================
+// Các kernel lọc
+// =====================================================================
+
+/**
+ * @class Biquad
+ * @brief Bộ lọc biquad Direct Form I (ổn định với số cố định)
+ */
+template <typename T>
+class Biquad
+{
+    typedef SampleTraits<T> Tr;
+
+public:
+    Biquad() : b0_(0), b1_(0), b2_(0), a1_(0), a2_(0) { reset(); }
+
+    explicit Biquad(const BiquadCoeffs &c) { setCoeffs(c); reset(); }
+
+    /// @brief Nạp hệ số (chuyển sang kiểu hệ số của T)
+    /// @note b1 lấy từ tổng tử số đã lượng tử hóa: b0 + b1 + b2 giữ đúng (bằng 0
+    ///       với high-pass), nếu không sai số 1 LSB qua cực gần 1 thành lệch DC
+    void setCoeffs(const BiquadCoeffs &c)
+    {
+        b0_ = Tr::coeff(c.b0);
+        b2_ = Tr::coeff(c.b2);
+        b1_ = Tr::coeff(c.b0 + c.b1 + c.b2) - b0_ - b2_;
+        a1_ = Tr::coeff(c.a1);
+        a2_ = Tr::coeff(c.a2);
+    }
+
+    /// @brief Xóa trạng thái
+    void reset()
+    {
+        x1_ = x2_ = y1_ = y2_ = 0;
+        residue_ = 0;
+    }
+
+    /// @brief Lọc một mẫu
+    T process(T x)
+    {
+        typename Tr::state_t xi = Tr::widen(x);
+        typename Tr::acc_t acc = Tr::mul(b0_, xi) + Tr::mul(b1_, x1_) + Tr::mul(b2_, x2_) -
+                                 Tr::mul(a1_, y1_) - Tr::mul(a2_, y2_);
+        T y = Tr::narrowShaped(acc, residue_);
+        x2_ = x1_;
+        x1_ = xi;
+        y2_ = y1_;
+        y1_ = Tr::widen(y);
+        return y;
+    }
+
+private:
+    typename Tr::coeff_t b0_, b1_, b2_, a1_, a2_;
+    typename Tr::state_t x1_, x2_, y1_, y2_;
+    typename Tr::acc_t residue_; ///< Phần dư làm tròn mang sang mẫu sau
+};
+
+/**
+ * @class BiquadCascade
+ * @brief Chuỗi N biquad nối tiếp (bộ lọc bậc 2N)
+ */
+template <typename T, size_t N>
+class BiquadCascade
+{
+public:
+    BiquadCascade() {}
+
+    /// @brief Nạp hệ số cho từng tầng
+    void setCoeffs(const BiquadCoeffs (&c)[N])
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            stages_[i].setCoeffs(c[i]);
+        }
+    }
+
+    void reset()
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            stages_[i].reset();
+        }
+    }
+
+    T process(T x)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            x = stages_[i].process(x);
+        }
+        return x;
+    }
+
+private:
+    Biquad<T> stages_[N];
+};
+
+/**
+ * @class Fir
+ * @brief Bộ lọc FIR N tap với đường trễ vòng
+ */
+template <typename T, size_t N>
+class Fir
+{
+    typedef SampleTraits<T> Tr;
+
+public:
+    Fir() : pos_(0)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            h_[i] = 0;
+        }
+        reset();
+    }
+
+    explicit Fir(const FirCoeffs<N> &c) : pos_(0)
+    {
+        setCoeffs(c);
+        reset();
+    }
+
+    void setCoeffs(const FirCoeffs<N> &c)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            h_[i] = Tr::coeff(c.h[i]);
+        }
+    }
+
+    void reset()
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            delay_[i] = 0;
+        }
+        pos_ = 0;
+    }
+
+    /// @brief Lọc một mẫu: y = Σ h[k]·x[n-k]
+    T process(T x)
+    {
+        delay_[pos_] = Tr::widen(x);
+
+        typename Tr::acc_t acc = 0;
+        size_t idx = pos_;
+        for (size_t k = 0; k < N; k++)
+        {
+            acc += Tr::mul(h_[k], delay_[idx]);
+            idx = (idx == 0) ? N - 1 : idx - 1;
+        }
+
+        pos_ = (pos_ + 1 == N) ? 0 : pos_ + 1;
+        return Tr::narrow(acc);
+    }
+
+private:
+    typename Tr::coeff_t h_[N];
+    typename Tr::state_t delay_[N];
+    size_t pos_;
+};
+
+/**
+ * @class MovingSum
+ * @brief Tổng trượt N mẫu, cập nhật O(1) mỗi mẫu
+ */
+template <typename T, size_t N>
+class MovingSum
+{
+    typedef SampleTraits<T> Tr;
+
+public:
+    MovingSum() { reset(); }
+
+    void reset()
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            ring_[i] = 0;
+        }
+        sum_ = 0;
+        pos_ = 0;
+        count_ = 0;
+    }
+
+    /// @brief Thêm một mẫu, trả về tổng hiện tại
+    typename Tr::sum_t process(T x)
+    {
+        typename Tr::state_t xi = Tr::widen(x);
+        sum_ += (typename Tr::sum_t)xi - (typename Tr::sum_t)ring_[pos_];
+        ring_[pos_] = xi;
+        pos_ = (pos_ + 1 == N) ? 0 : pos_ + 1;
+        if (count_ < N)
+            count_++;
+        return sum_;
+    }
+
+    typename Tr::sum_t sum() const { return sum_; }
+
+    /// @brief Trung bình trên các mẫu đã nhận (tối đa N)
+    T mean() const
+    {
+        return (count_ == 0) ? Tr::fromState(0) : Tr::fromState((typename Tr::state_t)(sum_ / (typename Tr::sum_t)count_));
+    }
+
+    /// @brief Đã đủ N mẫu chưa
+    bool full() const { return count_ == N; }
+
+private:
+    typename Tr::state_t ring_[N];
+    typename Tr::sum_t sum_;
+    size_t pos_;
+    size_t count_;
+};
+
+/**
+ * @class DcBlocker
+ * @brief High-pass một cực (loại bỏ DC): y[n] = α·(y[n-1] + x[n] - x[n-1])
+ */
+template <typename T>
+class DcBlocker
+{
+    typedef SampleTraits<T> Tr;
+
+public:
+    DcBlocker() : alpha_(0) { reset(); }
+
+    /// @param alpha Hệ số từ designDcBlocker()
+    explicit DcBlocker(double alpha) : alpha_(Tr::coeff(alpha)) { reset(); }
+
+    void setAlpha(double alpha) { alpha_ = Tr::coeff(alpha); }
+
+    /// @brief Xóa trạng thái; x0 là mẫu đầu tiên để tránh bước nhảy khởi động
+    void reset(T x0 = T())
+    {
+        x1_ = Tr::widen(x0);
+        y1_ = 0;
+        residue_ = 0;
+    }
+
+    T process(T x)
+    {
+        typename Tr::state_t xi = Tr::widen(x);
+        T y = Tr::narrowShaped(Tr::mul(alpha_, y1_ + xi - x1_), residue_);
+        x1_ = xi;
+        y1_ = Tr::widen(y);
+        return y;
+    }
+
+private:
+    typename Tr::coeff_t alpha_;
+    typename Tr::state_t x1_, y1_;
+    typename Tr::acc_t residue_; ///< Phần dư làm tròn mang sang mẫu sau
+};
+
+} // namespace dsp
@@ -0,0 +1,417 @@
+/**
+ * @file flash_log.cpp
+ * @brief Triển khai nhật ký mẫu trên flash
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#include "flash_log.h"
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * @brief Constructor - chưa truy cập flash cho đến begin()
+ */
+FlashLog::FlashLog(hal::Flash &flash, hal::Logger &log)
+    : flash_(flash), log_(log), sectorCount_(0), headSector_(0), headSeq_(0), headSlot_(1),
+      nextPrepared_(false), ready_(false), nextIndex_(0)
+{
+    memset(&page_, 0xFF, sizeof(page_));
+    page_.count = 0;
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+/**
+ * @brief Mở phân vùng và khôi phục vị trí ghi
+ *
+ * Chỉ đọc header 16 byte của mỗi sector và các trang của sector mới nhất,
+ * không quét toàn bộ phân vùng.
+ */
+bool FlashLog::begin()
+{
+    ready_ = false;
+    if (!flash_.begin())
+    {
+        log_.println("[FlashLog] Partition not found");
+        return false;
+    }
+
+    uint32_t sectors = flash_.size() / hal::Flash::SECTOR_SIZE;
+    if (sectors < 2 || sectors > 0xFFFF)
+    {
+        log_.println("[FlashLog] Partition size not supported");
+        return false;
+    }
+    sectorCount_ = (uint16_t)sectors;
+
+    // 1. Sector có số thứ tự lớn nhất là sector đang ghi
+    bool found = false;
+    for (uint16_t s = 0; s < sectorCount_; s++)
+    {
+        SectorHeader hdr;
+        if (!readHeader(s, hdr))
+            continue;
+        if (hdr.eraseCount > stats_.maxEraseCount)
+            stats_.maxEraseCount = hdr.eraseCount;
+        if (!found || (int32_t)(hdr.seq - headSeq_) > 0)
+        {
+            headSector_ = s;
+            headSeq_ = hdr.seq;
+            found = true;
+        }
+    }
+
+    nextPrepared_ = false;
+    if (!found)
+    {
+        // Flash mới hoặc đã xóa: bắt đầu từ sector 0
+        if (!prepareSector(0, 1))
+            return false;
+        headSector_ = 0;
+        headSeq_ = 1;
+        headSlot_ = 1;
+        nextIndex_ = 0;
+        ready_ = true;
+        log_.println("[FlashLog] Formatted empty log");
+        return true;
+    }
+
+    // 2. Trang trống đầu tiên trong sector đang ghi; trang ghi dở (CRC sai) bị bỏ qua
+    headSlot_ = PAGES_PER_SECTOR;
+    for (uint8_t slot = 1; slot < PAGES_PER_SECTOR; slot++)
+    {
+        if (pageErased(headSector_, slot))
+        {
+            headSlot_ = slot;
+            break;
+        }
+        Page page;
+        if (!readPage(headSector_, slot, page))
+            stats_.badPages++;
+    }
+
+    // 3. Chỉ số tuyệt đối tiếp tục từ trang hợp lệ cuối cùng
+    recoverNextIndex();
+
+    ready_ = true;
+    log_.printf("[FlashLog] Recovered: sector %u seq %u slot %u, next index %u, %u bad pages\n",
+                (unsigned)headSector_, (unsigned)headSeq_, (unsigned)headSlot_,
+                (unsigned)nextIndex_, (unsigned)stats_.badPages);
+    return true;
+}
+
+/**
+ * @brief Thêm một mẫu vào trang đang gom
+ */
+bool FlashLog::append(const HealthDataPacket &sample)
+{
+    if (!ready_)
+        return false;
+
+    // Trang đầy từ lần ghi thất bại trước: thử lại, nếu vẫn lỗi thì bỏ mẫu
+    if (page_.count == SAMPLES_PER_PAGE && !writePage())
+        return false;
+
+    if (page_.count == 0)
+        page_.firstIndex = nextIndex_;
+
+    page_.samples[page_.count++] = sample;
+    nextIndex_++;
+
+    if (page_.count == SAMPLES_PER_PAGE)
+        return writePage();
+    return true;
+}
+
+/**
+ * @brief Ghi ngay trang đang gom
+ */
+bool FlashLog::flush()
+{
+    if (!ready_ || page_.count == 0)
+        return ready_;
+    return writePage();
+}
+
+/**
+ * @brief Xóa trước sector kế tiếp
+ *
+ * Lệnh xóa sector mất hàng chục ms; làm ở đây (khi sector hiện tại còn ít
+ * trang trống) thay vì trong append() để việc ghi trang luôn ngắn.
+ */
+void FlashLog::service()
+{
+    if (!ready_ || nextPrepared_)
+        return;
+    if (headSlot_ + FLASH_LOG_PREPARE_PAGES < PAGES_PER_SECTOR)
+        return;
+
+    uint16_t next = (headSector_ + 1) % sectorCount_;
+    nextPrepared_ = prepareSector(next, headSeq_ + 1);
+}
+
+uint32_t FlashLog::nextIndex() const
+{
+    return nextIndex_;
+}
+
+uint16_t FlashLog::pendingSamples() const
+{
+    return page_.count;
+}
+
+const FlashLogStats &FlashLog::getStats() const
+{
+    return stats_;
+}
+
+/**
+ * @brief In trạng thái nhật ký
+ */
+void FlashLog::printStats()
+{
+    if (!ready_)
+    {
+        log_.println("[FlashLog] Not available");
+        return;
+    }
+    log_.printf("[FlashLog] Sector %u/%u (seq %u) page %u, next index %u, %u pending\n",
+                (unsigned)headSector_, (unsigned)sectorCount_, (unsigned)headSeq_,
+                (unsigned)headSlot_, (unsigned)nextIndex_, (unsigned)page_.count);
+    log_.printf("[FlashLog] Pages written %u, sectors erased %u, errors %u, max erase count %u\n",
+                (unsigned)stats_.pagesWritten, (unsigned)stats_.sectorsErased,
+                (unsigned)stats_.writeErrors, (unsigned)stats_.maxEraseCount);
+}
+
+/**
+ * @brief Đọc header sector; hợp lệ khi đúng magic và CRC
+ */
+bool FlashLog::readHeader(uint16_t sector, SectorHeader &hdr)
+{
+    if (!flash_.read(pageAddr(sector, 0), &hdr, sizeof(hdr)))
+        return false;
+    return hdr.magic == SECTOR_MAGIC && hdr.crc == crc32(&hdr, offsetof(SectorHeader, crc));
+}
+
+/**
+ * @brief Đọc trang và kiểm tra CRC
+ */
+bool FlashLog::readPage(uint16_t sector, uint8_t slot, Page &page)
+{
+    if (!flash_.read(pageAddr(sector, slot), &page, sizeof(page)))
+        return false;
+    return page.count > 0 && page.count <= SAMPLES_PER_PAGE &&
+           page.crc == crc32(&page, offsetof(Page, crc));
+}
+
+/**
+ * @brief Trang chưa từng được ghi
+ */
+bool FlashLog::pageErased(uint16_t sector, uint8_t slot)
+{
+    uint32_t words[PAGE_SIZE / 4];
+    if (!flash_.read(pageAddr(sector, slot), words, sizeof(words)))
+        return false;
+    for (uint16_t i = 0; i < PAGE_SIZE / 4; i++)
+    {
+        if (words[i] != 0xFFFFFFFF)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Xóa sector và ghi header mới (tăng số lần xóa)
+ */
+bool FlashLog::prepareSector(uint16_t sector, uint32_t seq)
+{
+    SectorHeader hdr;
+    uint32_t eraseCount = readHeader(sector, hdr) ? hdr.eraseCount + 1 : 1;
+
+    if (!flash_.eraseSector(pageAddr(sector, 0)))
+    {
+        stats_.writeErrors++;
+        log_.printf("[FlashLog] Erase failed at sector %u\n", (unsigned)sector);
+        return false;
+    }
+    stats_.sectorsErased++;
+
+    hdr.magic = SECTOR_MAGIC;
+    hdr.seq = seq;
+    hdr.eraseCount = eraseCount;
+    hdr.crc = crc32(&hdr, offsetof(SectorHeader, crc));
+    if (!flash_.write(pageAddr(sector, 0), &hdr, sizeof(hdr)))
+    {
+        stats_.writeErrors++;
+        return false;
+    }
+
+    if (eraseCount > stats_.maxEraseCount)
+        stats_.maxEraseCount = eraseCount;
+    return true;
+}
+
+/**
+ * @brief Ghi trang đang gom; chuyển sang sector kế tiếp khi sector hiện tại đầy
+ */
+bool FlashLog::writePage()
+{
+    if (headSlot_ >= PAGES_PER_SECTOR)
+    {
+        uint16_t next = (headSector_ + 1) % sectorCount_;
+        if (!nextPrepared_ && !prepareSector(next, headSeq_ + 1))
+            return false;
+        headSector_ = next;
+        headSeq_++;
+        headSlot_ = 1;
+        nextPrepared_ = false;
+    }
+
+    page_.reserved = 0xFFFF;
+    page_.pad = 0xFFFFFFFF;
+    page_.crc = crc32(&page_, offsetof(Page, crc));
+
+    uint8_t slot = headSlot_++;
+    if (!flash_.write(pageAddr(headSector_, slot), &page_, sizeof(page_)))
+    {
+        // Trang có thể đã bị ghi một phần: bỏ qua, giữ dữ liệu để ghi lại ở trang sau
+        stats_.writeErrors++;
+        log_.printf("[FlashLog] Page write failed at sector %u page %u\n",
+                    (unsigned)headSector_, (unsigned)slot);
+        return false;
+    }
+
+    stats_.pagesWritten++;
+    memset(&page_, 0xFF, sizeof(page_));
+    page_.count = 0;
+    return true;
+}
+
+/**
+ * @brief Tìm trang hợp lệ mới nhất (lùi dần từ vị trí ghi)
+ */
+void FlashLog::recoverNextIndex()
+{
+    nextIndex_ = 0;
+    for (uint16_t back = 0; back < sectorCount_; back++)
+    {
+        uint16_t sector = (headSector_ + sectorCount_ - back) % sectorCount_;
+        SectorHeader hdr;
+        if (!readHeader(sector, hdr) || hdr.seq != headSeq_ - back)
+            continue;
+
+        uint8_t slot = (back == 0) ? headSlot_ : PAGES_PER_SECTOR;
+        while (slot > 1)
+        {
+            slot--;
+            Page page;
+            if (readPage(sector, slot, page))
+            {
+                nextIndex_ = page.firstIndex + page.count;
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * @brief CRC-32 (IEEE 802.3, đa thức đảo 0xEDB88320)
+ */
+uint32_t FlashLog::crc32(const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= p[i];
+        for (uint8_t b = 0; b < 8; b++)
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+// ==================== FlashLogReader ====================
+
+FlashLogReader::FlashLogReader(FlashLog &log)
+    : log_(log), seq_(0), slot_(1), pos_(0), loaded_(false)
+{
+    rewind();
+}
+
+/**
+ * @brief Về sector cũ nhất còn nằm trong vòng
+ */
+void FlashLogReader::rewind()
+{
+    uint32_t span = retainedSpan();
+    seq_ = log_.headSeq_ > span ? log_.headSeq_ - span : 1;
+    slot_ = 1;
+    pos_ = 0;
+    loaded_ = false;
+}
+
+/**
+ * @brief Số sector cũ hơn sector đang ghi còn giữ dữ liệu
+ *
+ * Sector kế tiếp đã xóa trước chính là sector cũ nhất của vòng.
+ */
+uint32_t FlashLogReader::retainedSpan() const
+{
+    if (log_.sectorCount_ < 2)
+        return 0;
+    return log_.sectorCount_ - 1u - (log_.nextPrepared_ ? 1u : 0u);
+}
+
+/**
+ * @brief Đọc mẫu kế tiếp; sector bị ghi đè hoặc hỏng và trang CRC sai bị bỏ qua
+ */
+bool FlashLogReader::next(HealthDataPacket &out, uint32_t *index)
+{
+    if (!log_.ready_)
+        return false;
+
+    while (true)
+    {
+        if (loaded_ && pos_ < page_.count)
+        {
+            if (index)
+                *index = page_.firstIndex + pos_;
+            out = page_.samples[pos_++];
+            return true;
+        }
+        loaded_ = false;
+
+        // Sector đang đọc đã bị ghi đè (kể cả sector được xóa trước) → về cũ nhất
+        if (log_.headSeq_ - seq_ > retainedSpan())
+        {
+            rewind();
+        }
+
+        if (seq_ == log_.headSeq_ && slot_ >= log_.headSlot_)
+            return false;
+
+        if (slot_ >= FlashLog::PAGES_PER_SECTOR)
+        {
+            seq_++;
+            slot_ = 1;
+            continue;
+        }
+
+        uint16_t sector = (log_.headSector_ + log_.sectorCount_ -
+                           (log_.headSeq_ - seq_) % log_.sectorCount_) %
+                          log_.sectorCount_;
+        if (slot_ == 1)
+        {
+            FlashLog::SectorHeader hdr;
+            if (!log_.readHeader(sector, hdr) || hdr.seq != seq_)
+            {
+                // Sector hỏng (xóa dở) hoặc chưa dùng: bỏ qua cả sector
+                seq_++;
+                continue;
+            }
+        }
+
+        loaded_ = log_.readPage(sector, slot_++, page_);
+        pos_ = 0;
+    }
+}
@@ -0,0 +1,184 @@
+/**
+ * @file flash_log.h
+ * @brief Nhật ký mẫu sức khỏe bền vững trên phân vùng flash riêng
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - Ghi nối tiếp (append-only) theo trang 256 byte, mỗi trang có CRC32
+ * - Các sector được dùng vòng tròn nên mọi sector bị xóa đều nhau (cân bằng
+ *   hao mòn); header sector lưu số thứ tự và số lần xóa
+ * - Gom mẫu trong RAM, chỉ lập trình flash khi đủ một trang; sector kế tiếp
+ *   được xóa trước trong service() để append() không bị chặn bởi lệnh xóa
+ * - Khởi động: đọc header từng sector (16 byte) để tìm sector mới nhất, rồi
+ *   chỉ quét các trang của sector đó để tìm vị trí ghi
+ *
+ * An toàn khi mất điện: trang ghi dở có CRC sai và bị bỏ qua; sector xóa dở
+ * có header sai và được coi là trống. Mẫu còn trong RAM (tối đa một trang)
+ * bị mất nếu chưa flush().
+ */
+
+#pragma once
+#include "hal.h"
+#include "board_config.h"
+#include "health_data_packet.h"
+
+/**
+ * @struct FlashLogStats
+ * @brief Thống kê nhật ký flash
+ */
+struct FlashLogStats
+{
+    uint32_t pagesWritten;  ///< Số trang đã ghi từ khi khởi động
+    uint32_t sectorsErased; ///< Số sector đã xóa từ khi khởi động
+    uint32_t writeErrors;   ///< Số lần ghi/xóa flash thất bại
+    uint32_t badPages;      ///< Số trang CRC sai gặp khi khôi phục
+    uint32_t maxEraseCount; ///< Số lần xóa lớn nhất của một sector (hao mòn)
+};
+
+class FlashLogReader;
+
+/**
+ * @class FlashLog
+ * @brief Nhật ký append-only trên flash NOR, chịu được mất điện
+ */
+class FlashLog
+{
+public:
+    static const uint16_t PAGE_SIZE = 256;                                        ///< Kích thước trang (bytes)
+    static const uint16_t SAMPLES_PER_PAGE = 24;                                  ///< Số mẫu mỗi trang
+    static const uint16_t PAGES_PER_SECTOR = hal::Flash::SECTOR_SIZE / PAGE_SIZE; ///< Trang 0 là header sector
+
+    /// @brief Constructor
+    /// @param flash Phân vùng flash
+    /// @param log Đầu ra log
+    explicit FlashLog(hal::Flash &flash = hal::defaultFlash(),
+                      hal::Logger &log = hal::defaultLogger());
+
+    /// @brief Mở phân vùng và khôi phục vị trí ghi
+    /// @return false nếu không có phân vùng hoặc phân vùng quá nhỏ
+    bool begin();
+
+    /// @brief Thêm một mẫu (chỉ ghi flash khi đủ một trang)
+    /// @return false nếu ghi trang thất bại
+    bool append(const HealthDataPacket &sample);
+
+    /// @brief Ghi ngay trang đang gom (kể cả chưa đầy), ví dụ khi pin yếu
+    bool flush();
+
+    /// @brief Xóa trước sector kế tiếp khi sector hiện tại sắp đầy; gọi từ loop()
+    void service();
+
+    /// @brief Chỉ số tuyệt đối của mẫu kế tiếp (tăng liên tục qua các lần khởi động)
+    uint32_t nextIndex() const;
+
+    /// @brief Số mẫu đang chờ trong RAM
+    uint16_t pendingSamples() const;
+
+    /// @brief Thống kê
+    const FlashLogStats &getStats() const;
+
+    /// @brief In trạng thái ra log
+    void printStats();
+
+private:
+    friend class FlashLogReader;
+
+    static const uint32_t SECTOR_MAGIC = 0x32474C53; ///< "SLG2" (mẫu 10 byte; sector "SLOG" cũ coi như trống)
+
+    /**
+     * @struct SectorHeader
+     * @brief Đầu mỗi sector (trang 0)
+     */
+    struct SectorHeader
+    {
+        uint32_t magic;      ///< SECTOR_MAGIC
+        uint32_t seq;        ///< Số thứ tự sector, tăng liên tục
+        uint32_t eraseCount; ///< Số lần sector này đã bị xóa
+        uint32_t crc;        ///< CRC32 của 12 byte đầu
+    };
+
+    /**
+     * @struct Page
+     * @brief Một trang dữ liệu (ghi nguyên khối một lần)
+     */
+    struct __attribute__((packed)) Page
+    {
+        uint32_t firstIndex;                        ///< Chỉ số tuyệt đối của mẫu đầu
+        uint16_t count;                             ///< Số mẫu hợp lệ
+        uint16_t reserved;                          ///< 0xFFFF
+        HealthDataPacket samples[SAMPLES_PER_PAGE]; ///< Các mẫu
+        uint32_t crc;                               ///< CRC32 của các trường trên
+        uint32_t pad;                               ///< 0xFFFFFFFF
+    };
+
+    static_assert(sizeof(Page) == PAGE_SIZE, "Page must fill one flash page");
+    static_assert(sizeof(SectorHeader) == 16, "SectorHeader must be 16 bytes");
+
+    /// @brief Đọc và kiểm tra header sector
+    bool readHeader(uint16_t sector, SectorHeader &hdr);
+
+    /// @brief Đọc trang; false nếu lỗi đọc hoặc CRC sai
+    bool readPage(uint16_t sector, uint8_t slot, Page &page);
+
+    /// @brief Trang còn nguyên trạng thái đã xóa (toàn 0xFF)
+    bool pageErased(uint16_t sector, uint8_t slot);
+
+    /// @brief Xóa sector và ghi header với số thứ tự seq
+    bool prepareSector(uint16_t sector, uint32_t seq);
+
+    /// @brief Ghi trang đang gom vào vị trí ghi
+    bool writePage();
+
+    /// @brief Tìm mẫu cuối cùng đã ghi để tiếp tục chỉ số tuyệt đối
+    void recoverNextIndex();
+
+    static uint32_t crc32(const void *data, size_t len);
+
+    uint32_t pageAddr(uint16_t sector, uint8_t slot) const
+    {
+        return (uint32_t)sector * hal::Flash::SECTOR_SIZE + (uint32_t)slot * PAGE_SIZE;
+    }
+
+    hal::Flash &flash_;    ///< Phân vùng flash
+    hal::Logger &log_;     ///< Đầu ra log
+    uint16_t sectorCount_; ///< Số sector của phân vùng
+    uint16_t headSector_;  ///< Sector đang ghi
+    uint32_t headSeq_;     ///< Số thứ tự của sector đang ghi
+    uint8_t headSlot_;     ///< Trang trống kế tiếp trong sector đang ghi
+    bool nextPrepared_;    ///< Sector kế tiếp đã được xóa sẵn
+    bool ready_;           ///< begin() thành công
+    uint32_t nextIndex_;   ///< Chỉ số của mẫu kế tiếp
+    Page page_;            ///< Trang đang gom trong RAM
+    FlashLogStats stats_;  ///< Thống kê
+};
+
+/**
+ * @class FlashLogReader
+ * @brief Đọc tuần tự nhật ký flash từ sector cũ nhất, bỏ qua trang hỏng
+ */
+class FlashLogReader
+{
+public:
+    explicit FlashLogReader(FlashLog &log);
+
+    /// @brief Về mẫu cũ nhất
+    void rewind();
+
+    /// @brief Đọc mẫu kế tiếp đã ghi xuống flash
+    /// @param out Mẫu
+    /// @param index Chỉ số tuyệt đối của mẫu (có thể nullptr)
+    /// @return false nếu hết
+    bool next(HealthDataPacket &out, uint32_t *index = nullptr);
+
+private:
+    /// @brief Số sector cũ hơn sector đang ghi còn giữ dữ liệu
+    uint32_t retainedSpan() const;
+
+    FlashLog &log_;       ///< Nhật ký
+    uint32_t seq_;        ///< Số thứ tự sector đang đọc
+    uint8_t slot_;        ///< Trang đang đọc
+    uint8_t pos_;         ///< Vị trí mẫu trong trang
+    bool loaded_;         ///< page_ chứa trang hợp lệ
+    FlashLog::Page page_; ///< Trang đang đọc
+};
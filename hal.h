@@ -0,0 +1,61 @@
+/**
+ * @file hal.h
+ * @brief Lớp trừu tượng phần cứng: đồng hồ, log, ADC và bus thanh ghi I2C
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Các manager nhận đối tượng HAL qua constructor thay vì gọi trực tiếp
+ * millis(), Serial, analogRead hay Wire. Kiểu cụ thể được chọn lúc biên dịch:
+ * - Trên ESP32 (ARDUINO): hal_arduino.h - lớp final, hàm inline gọi thẳng API
+ *   Arduino nên không tốn chi phí so với gọi trực tiếp
+ * - Trên host: hal_host.h - bộ giả lập trong bộ nhớ (đồng hồ điều khiển được,
+ *   log ra stdout, ADC và thanh ghi I2C đặt giá trị tùy ý, flash ghi ra file
+ *   và giả lập mất điện)
+ *
+ * Giao diện chung (duck typing, không có lớp cơ sở ảo):
+ * - hal::Clock: millis(), micros(), unixTime(), delayMs(), delayUs()
+ * - hal::Logger: printf(), println()
+ * - hal::Adc: begin(pin), read(pin)
+ * - hal::Flash: begin(), size(), read(), write(), eraseSector() (ngữ nghĩa NOR)
+ * - hal::RegisterBus: writeReg(), readRegs(), startTransfer(), addRecoveryHandler()
+ * - hal::randomU32(): số ngẫu nhiên 32-bit (epoch đồng bộ mỗi lần khởi động)
+ */
+
+#pragma once
+
+#ifdef ARDUINO
+#include "hal_arduino.h"
+#else
+#include "hal_host.h"
+#endif
+
+namespace hal
+{
+    /// @brief Đồng hồ mặc định dùng chung cho các manager
+    inline Clock &defaultClock()
+    {
+        static Clock clock;
+        return clock;
+    }
+
+    /// @brief Log mặc định dùng chung cho các manager
+    inline Logger &defaultLogger()
+    {
+        static Logger logger;
+        return logger;
+    }
+
+    /// @brief ADC mặc định
+    inline Adc &defaultAdc()
+    {
+        static Adc adc;
+        return adc;
+    }
+
+    /// @brief Flash dữ liệu mặc định (phân vùng samplelog)
+    inline Flash &defaultFlash()
+    {
+        static Flash flash;
+        return flash;
+    }
+}
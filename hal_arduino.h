@@ -0,0 +1,126 @@
+/**
+ * @file hal_arduino.h
+ * @brief Triển khai HAL trên ESP32 Arduino (chỉ include qua hal.h)
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <stdarg.h>
+#include <time.h>
+#include <esp_partition.h>
+#include <esp_random.h>
+
+class I2CBusManager;
+
+namespace hal
+{
+    /**
+     * @class Clock
+     * @brief Đồng hồ hệ thống (millis/micros) và thời gian thực (sau đồng bộ BLE)
+     */
+    class Clock final
+    {
+    public:
+        uint32_t millis() const { return ::millis(); }
+        uint32_t micros() const { return ::micros(); }
+
+        /// @brief Unix timestamp hiện tại (giây)
+        uint32_t unixTime() const { return (uint32_t)::time(nullptr); }
+
+        void delayMs(uint32_t ms) const { ::delay(ms); }
+        void delayUs(uint32_t us) const { ::delayMicroseconds(us); }
+    };
+
+    /**
+     * @class Logger
+     * @brief Log qua Serial
+     */
+    class Logger final
+    {
+    public:
+        void printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+        {
+            char buf[192];
+            va_list args;
+            va_start(args, fmt);
+            int n = vsnprintf(buf, sizeof(buf), fmt, args);
+            va_end(args);
+            if (n > 0)
+            {
+                Serial.write((const uint8_t *)buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+            }
+        }
+
+        void println(const char *msg) { Serial.println(msg); }
+    };
+
+    /**
+     * @class Adc
+     * @brief ADC 12-bit của ESP32-C3
+     */
+    class Adc final
+    {
+    public:
+        /// @brief Cấu hình chân: 12-bit, suy giảm 11 dB (đọc đến ~3.3 V)
+        void begin(uint8_t pin)
+        {
+            pinMode(pin, INPUT);
+            analogReadResolution(12);
+            analogSetAttenuation(ADC_11db);
+        }
+
+        /// @brief Giá trị thô 0-4095
+        uint16_t read(uint8_t pin) { return (uint16_t)analogRead(pin); }
+    };
+
+    /// @brief Số ngẫu nhiên 32-bit từ bộ sinh phần cứng (esp_random)
+    inline uint32_t randomU32() { return esp_random(); }
+
+    /**
+     * @class Flash
+     * @brief Phân vùng flash dữ liệu (partitions.csv) qua esp_partition
+     *
+     * Ngữ nghĩa NOR: xóa theo sector (về 0xFF), ghi chỉ đổi bit 1 → 0.
+     */
+    class Flash final
+    {
+    public:
+        static const uint32_t SECTOR_SIZE = 4096; ///< Đơn vị xóa
+
+        /// @param label Tên phân vùng trong partitions.csv
+        explicit Flash(const char *label = "samplelog") : label_(label), part_(nullptr) {}
+
+        /// @brief Tìm phân vùng; false nếu bảng phân vùng không có
+        bool begin()
+        {
+            part_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label_);
+            return part_ != nullptr;
+        }
+
+        uint32_t size() const { return part_ ? part_->size : 0; }
+
+        bool read(uint32_t addr, void *buf, size_t len)
+        {
+            return part_ && esp_partition_read(part_, addr, buf, len) == ESP_OK;
+        }
+
+        bool write(uint32_t addr, const void *buf, size_t len)
+        {
+            return part_ && esp_partition_write(part_, addr, buf, len) == ESP_OK;
+        }
+
+        bool eraseSector(uint32_t addr)
+        {
+            return part_ && esp_partition_erase_range(part_, addr, SECTOR_SIZE) == ESP_OK;
+        }
+
+    private:
+        const char *label_;
+        const esp_partition_t *part_;
+    };
+
+    /// @brief Bus thanh ghi trên target là bus I2C dùng chung
+    typedef ::I2CBusManager RegisterBus;
+}
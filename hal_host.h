@@ -0,0 +1,336 @@
+/**
+ * @file hal_host.h
+ * @brief HAL giả lập trên host (Linux) cho kiểm thử và đo hiệu năng không cần phần cứng
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chỉ include qua hal.h khi không biên dịch cho Arduino.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include "i2c_transfer.h"
+
+namespace hal
+{
+    /**
+     * @class Clock
+     * @brief Đồng hồ giả: thời gian chỉ tăng khi gọi advance*() hoặc delay*()
+     */
+    class Clock final
+    {
+    public:
+        uint32_t millis() const { return (uint32_t)(nowUs_ / 1000); }
+        uint32_t micros() const { return (uint32_t)nowUs_; }
+        uint32_t unixTime() const { return unixBase_ + (uint32_t)(nowUs_ / 1000000); }
+
+        void delayMs(uint32_t ms) { nowUs_ += (uint64_t)ms * 1000; }
+        void delayUs(uint32_t us) { nowUs_ += us; }
+
+        /// @brief Tiến đồng hồ (ms)
+        void advanceMs(uint32_t ms) { delayMs(ms); }
+
+        /// @brief Đặt Unix timestamp tại thời điểm 0 của đồng hồ
+        void setUnixBase(uint32_t base) { unixBase_ = base; }
+
+    private:
+        uint64_t nowUs_ = 0;
+        uint32_t unixBase_ = 0;
+    };
+
+    /**
+     * @class Logger
+     * @brief Log ra stdout; tắt được để đo hiệu năng
+     */
+    class Logger final
+    {
+    public:
+        void printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+        {
+            if (!enabled_)
+                return;
+            va_list args;
+            va_start(args, fmt);
+            vprintf(fmt, args);
+            va_end(args);
+        }
+
+        void println(const char *msg)
+        {
+            if (enabled_)
+                puts(msg);
+        }
+
+        void setEnabled(bool enabled) { enabled_ = enabled; }
+
+    private:
+        bool enabled_ = true;
+    };
+
+    /**
+     * @class Adc
+     * @brief ADC giả: trả về giá trị đặt trước cho từng chân
+     */
+    class Adc final
+    {
+    public:
+        void begin(uint8_t) {}
+        uint16_t read(uint8_t pin) { return pin < MAX_PINS ? raw_[pin] : 0; }
+
+        /// @brief Đặt giá trị thô (0-4095) cho một chân
+        void setRaw(uint8_t pin, uint16_t value)
+        {
+            if (pin < MAX_PINS)
+                raw_[pin] = value;
+        }
+
+    private:
+        static const uint8_t MAX_PINS = 22;
+        uint16_t raw_[MAX_PINS] = {0};
+    };
+
+    /// @brief Số ngẫu nhiên 32-bit giả (xorshift32): mỗi lần gọi một giá trị khác, tái lập được giữa các lần chạy
+    inline uint32_t randomU32()
+    {
+        static uint32_t state = 0x9E3779B9;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    /**
+     * @class Flash
+     * @brief Flash NOR giả trong bộ nhớ, ghi xuyên xuống file (nếu có)
+     *
+     * Xóa đưa sector về 0xFF, ghi chỉ xóa bit (AND) như flash thật.
+     * cutPowerAfter(n) mô phỏng mất điện sau đúng n byte được ghi/xóa: thao
+     * tác đang dở chỉ có n byte đầu có hiệu lực, mọi thao tác sau trả về
+     * false cho đến khi powerCycle().
+     */
+    class Flash final
+    {
+    public:
+        static const uint32_t SECTOR_SIZE = 4096; ///< Đơn vị xóa
+
+        /// @param size Dung lượng (bội số của SECTOR_SIZE)
+        /// @param path File lưu nội dung qua các lần chạy (nullptr = chỉ RAM)
+        explicit Flash(uint32_t size = 16 * SECTOR_SIZE, const char *path = nullptr)
+            : size_(size), path_(path), mem_(nullptr), file_(nullptr) {}
+
+        ~Flash()
+        {
+            if (file_)
+                fclose(file_);
+            free(mem_);
+        }
+
+        Flash(const Flash &) = delete;
+        Flash &operator=(const Flash &) = delete;
+
+        /// @brief Nạp nội dung từ file (hoặc tạo flash trống toàn 0xFF ở lần đầu)
+        ///
+        /// Gọi lại begin() (khởi động lại sau mất điện) giữ nguyên nội dung như flash thật.
+        bool begin()
+        {
+            if (!mem_)
+            {
+                mem_ = (uint8_t *)malloc(size_);
+                if (!mem_)
+                    return false;
+                memset(mem_, 0xFF, size_);
+            }
+            if (path_)
+            {
+                if (file_)
+                    fclose(file_);
+                file_ = fopen(path_, "r+b");
+                if (file_)
+                {
+                    size_t n = fread(mem_, 1, size_, file_);
+                    (void)n;
+                }
+                else
+                {
+                    file_ = fopen(path_, "w+b");
+                }
+                if (!file_)
+                    return false;
+                sync(0, size_);
+            }
+            return true;
+        }
+
+        uint32_t size() const { return mem_ ? size_ : 0; }
+
+        bool read(uint32_t addr, void *buf, size_t len)
+        {
+            if (powerLost_ || !inRange(addr, len))
+                return false;
+            memcpy(buf, mem_ + addr, len);
+            return true;
+        }
+
+        bool write(uint32_t addr, const void *buf, size_t len)
+        {
+            if (powerLost_ || !inRange(addr, len))
+                return false;
+            size_t n = consume(len);
+            const uint8_t *src = (const uint8_t *)buf;
+            for (size_t i = 0; i < n; i++)
+                mem_[addr + i] &= src[i];
+            sync(addr, n);
+            return n == len;
+        }
+
+        bool eraseSector(uint32_t addr)
+        {
+            if (powerLost_ || addr % SECTOR_SIZE != 0 || !inRange(addr, SECTOR_SIZE))
+                return false;
+            size_t n = consume(SECTOR_SIZE);
+            memset(mem_ + addr, 0xFF, n);
+            sync(addr, n);
+            eraseCount_++;
+            return n == SECTOR_SIZE;
+        }
+
+        /// @brief Mất điện sau n byte ghi/xóa nữa
+        void cutPowerAfter(uint32_t bytes)
+        {
+            budget_ = bytes;
+            armed_ = true;
+        }
+
+        /// @brief Cấp điện lại (nội dung flash giữ nguyên)
+        void powerCycle()
+        {
+            powerLost_ = false;
+            armed_ = false;
+        }
+
+        bool powerLost() const { return powerLost_; }
+
+        /// @brief Tổng số lần xóa sector (đo hao mòn)
+        uint32_t eraseCount() const { return eraseCount_; }
+
+    private:
+        bool inRange(uint32_t addr, size_t len) const
+        {
+            return mem_ && addr <= size_ && len <= size_ - addr;
+        }
+
+        /// @brief Số byte thực sự được ghi trước khi mất điện
+        size_t consume(size_t len)
+        {
+            if (!armed_)
+                return len;
+            if (len <= budget_)
+            {
+                budget_ -= len;
+                return len;
+            }
+            size_t n = budget_;
+            budget_ = 0;
+            powerLost_ = true;
+            return n;
+        }
+
+        void sync(uint32_t addr, size_t len)
+        {
+            if (!file_ || len == 0)
+                return;
+            fseek(file_, addr, SEEK_SET);
+            fwrite(mem_ + addr, 1, len, file_);
+            fflush(file_);
+        }
+
+        uint32_t size_;
+        const char *path_;
+        uint8_t *mem_;
+        FILE *file_;
+        uint32_t budget_ = 0;
+        uint32_t eraseCount_ = 0;
+        bool armed_ = false;
+        bool powerLost_ = false;
+    };
+
+    /**
+     * @class RegisterBus
+     * @brief Bus I2C giả: bảng thanh ghi trong bộ nhớ cho một thiết bị
+     *
+     * Giao dịch bất đồng bộ hoàn tất ngay trong startTransfer() (như khi bus
+     * manager không có cổng bất đồng bộ). failNext() mô phỏng bus lỗi.
+     */
+    class RegisterBus final
+    {
+    public:
+        typedef bool (*RecoveryFn)(void *ctx);
+
+        bool writeReg(uint8_t addr, uint8_t reg, uint8_t val)
+        {
+            return writeRegs(addr, reg, &val, 1);
+        }
+
+        bool readRegs(uint8_t addr, uint8_t reg, uint8_t *buf, size_t len)
+        {
+            if (!accept(addr) || reg + len > sizeof(regs_))
+                return false;
+            memcpy(buf, &regs_[reg], len);
+            return true;
+        }
+
+        bool startTransfer(I2CTransfer &xfer)
+        {
+            if (xfer.busy())
+                return false;
+            bool ok = xfer.write ? writeRegs(xfer.addr, xfer.reg, xfer.data, xfer.len)
+                                 : readRegs(xfer.addr, xfer.reg, xfer.data, xfer.len);
+            xfer.durationUs = 0;
+            xfer.state = ok ? I2C_XFER_DONE : I2C_XFER_ERROR;
+            if (xfer.done)
+                xfer.done(xfer);
+            return true;
+        }
+
+        bool addRecoveryHandler(const char *, RecoveryFn, void *) { return true; }
+
+        /// @brief Địa chỉ thiết bị giả
+        void setDevice(uint8_t addr) { addr_ = addr; }
+
+        /// @brief Đặt trực tiếp giá trị thanh ghi (ví dụ mẫu gia tốc)
+        void setReg(uint8_t reg, uint8_t val) { regs_[reg] = val; }
+
+        uint8_t getReg(uint8_t reg) const { return regs_[reg]; }
+
+        /// @brief n giao dịch tiếp theo thất bại
+        void failNext(uint8_t n) { failCount_ = n; }
+
+    private:
+        bool writeRegs(uint8_t addr, uint8_t reg, const uint8_t *buf, size_t len)
+        {
+            if (!accept(addr) || reg + len > sizeof(regs_))
+                return false;
+            memcpy(&regs_[reg], buf, len);
+            return true;
+        }
+
+        bool accept(uint8_t addr)
+        {
+            if (failCount_ > 0)
+            {
+                failCount_--;
+                return false;
+            }
+            return addr == addr_;
+        }
+
+        uint8_t regs_[256] = {0};
+        uint8_t addr_ = 0x68;
+        uint8_t failCount_ = 0;
+    };
+}
@@ -0,0 +1,52 @@
+/**
+ * @file health_data_packet.h
+ * @brief Gói dữ liệu sức khỏe dùng chung giữa DataBuffer và BLE
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#pragma once
+#include <stdint.h>
+
+#define USER_DEFAULT_BMI 25.003625f ///< BMI khi chưa có hồ sơ (trung bình tập huấn luyện mô hình)
+#define USER_DEFAULT_HEIGHT_M 1.70f ///< Chiều cao khi chưa có hồ sơ (m)
+
+/**
+ * @struct HealthDataPacket
+ * @brief Cấu trúc gói tin binary (10 bytes)
+ *
+ * Định dạng batch/khung không dùng trực tiếp cấu trúc này mà mô tả từng
+ * trường qua SAMPLE_SCHEMA (sample_schema.h).
+ */
+struct __attribute__((packed)) HealthDataPacket
+{
+    uint32_t timestamp; // 4 bytes
+    uint32_t steps;     // 4 bytes
+    uint8_t hr;         // 1 byte
+    uint8_t spo2;       // 1 byte
+};
+
+/**
+ * @struct ActivityFields
+ * @brief Các trường hoạt động dạng gọn (6 bytes) gửi kèm khung batch
+ *
+ * Trong khung batch được ghi tường minh theo little-endian (batch_codec.h),
+ * không sao chép nguyên cấu trúc.
+ */
+struct __attribute__((packed)) ActivityFields
+{
+    uint8_t cadence;          ///< Cadence theo cửa sổ (bước/phút)
+    uint8_t met_x10;          ///< MET hiện tại × 10
+    uint16_t distance_m;      ///< Quãng đường tích lũy (m)
+    uint16_t energy_kcal_x10; ///< Năng lượng tiêu hao tích lũy (kcal × 10)
+};
+
+/**
+ * @struct UserProfile
+ * @brief Cấu trúc lưu trữ hồ sơ người dùng để tính toán calo và BMI
+ */
+struct UserProfile
+{
+    float bmi = USER_DEFAULT_BMI;           ///< Chỉ số BMI
+    float height_m = USER_DEFAULT_HEIGHT_M; ///< Chiều cao (m) - dùng ước lượng chiều dài bước
+};
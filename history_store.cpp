@@ -0,0 +1,378 @@
+/**
+ * @file history_store.cpp
+ * @brief Triển khai lịch sử nén theo khối
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#include "history_store.h"
+#include <string.h>
+
+/// @brief Mở rộng dấu cho số bits-bit (bù hai)
+static inline int8_t signExtend(uint8_t value, uint8_t bits)
+{
+    uint8_t shift = 8 - bits;
+    return (int8_t)(uint8_t)(value << shift) >> shift;
+}
+
+// ==================== HistoryStore ====================
+
+/**
+ * @brief Constructor - vòng khối rỗng
+ */
+HistoryStore::HistoryStore(uint8_t intervalS)
+    : oldestSeq_(0), headSeq_(0), blockCount_(0), stored_(0), nextIndex_(0),
+      lastRepeat_(-1), intervalS_(intervalS > 0 ? intervalS : 1)
+{
+    memset(&prev_, 0, sizeof(prev_));
+}
+
+/**
+ * @brief Thêm một mẫu
+ *
+ * Mẫu không đổi so với mẫu trước (cách đúng dt danh định) được gộp vào bản
+ * ghi lặp cuối khối; các mẫu khác mã hóa delta 1/2 byte hoặc tuyệt đối 9 byte.
+ * Khi khối đang ghi không đủ chỗ, mẫu trở thành mẫu gốc của khối mới.
+ */
+void HistoryStore::append(const HealthDataPacket &sample)
+{
+    if (blockCount_ == 0)
+    {
+        startBlock(sample);
+        return;
+    }
+
+    Block &b = blockAt(headSeq_);
+
+    bool unchanged = sample.timestamp == prev_.timestamp + intervalS_ &&
+                     sample.steps == prev_.steps &&
+                     sample.hr == prev_.hr &&
+                     sample.spo2 == prev_.spo2;
+
+    if (unchanged && lastRepeat_ >= 0 && (b.data[lastRepeat_] & 0x1F) < MAX_REPEAT - 1)
+    {
+        // Tăng n của bản ghi lặp tại chỗ
+        b.data[lastRepeat_]++;
+    }
+    else
+    {
+        uint8_t rec[1 + sizeof(HealthDataPacket)];
+        uint8_t len = 1;
+        if (unchanged)
+        {
+            rec[0] = TAG_REPEAT;
+        }
+        else
+        {
+            len = encode(sample, rec);
+        }
+
+        if ((size_t)b.used + len > sizeof(b.data))
+        {
+            startBlock(sample);
+            return;
+        }
+
+        memcpy(&b.data[b.used], rec, len);
+        lastRepeat_ = unchanged ? (int16_t)b.used : -1;
+        b.used += len;
+    }
+
+    b.count++;
+    stored_++;
+    nextIndex_++;
+    prev_ = sample;
+}
+
+/**
+ * @brief Mã hóa delta so với mẫu trước
+ */
+uint8_t HistoryStore::encode(const HealthDataPacket &sample, uint8_t *out) const
+{
+    int32_t dt = (int32_t)(sample.timestamp - prev_.timestamp);
+    int16_t dHr = (int16_t)sample.hr - prev_.hr;
+    int16_t dSpo2 = (int16_t)sample.spo2 - prev_.spo2;
+    uint32_t dSteps = sample.steps - prev_.steps;
+
+    if (dt == intervalS_ && dSpo2 == 0 && dHr >= -4 && dHr <= 3 && dSteps <= 15)
+    {
+        out[0] = (uint8_t)(((dHr & 0x07) << 4) | dSteps);
+        return 1;
+    }
+
+    int32_t tt = dt - (intervalS_ - 1);
+    if (tt >= 0 && tt <= 3 && dHr >= -8 && dHr <= 7 && dSpo2 >= -8 && dSpo2 <= 7 && dSteps <= 15)
+    {
+        out[0] = (uint8_t)(0x80 | (tt << 4) | (dHr & 0x0F));
+        out[1] = (uint8_t)((dSteps << 4) | (dSpo2 & 0x0F));
+        return 2;
+    }
+
+    out[0] = TAG_ESCAPE;
+    memcpy(&out[1], &sample, sizeof(sample));
+    return 1 + sizeof(sample);
+}
+
+/**
+ * @brief Mở khối mới; khi vòng đầy, khối cũ nhất bị ghi đè
+ */
+void HistoryStore::startBlock(const HealthDataPacket &sample)
+{
+    if (blockCount_ == 0)
+    {
+        oldestSeq_ = headSeq_;
+        blockCount_ = 1;
+    }
+    else
+    {
+        headSeq_++;
+        if (blockCount_ == BLOCK_COUNT)
+        {
+            stored_ -= blockAt(oldestSeq_).count;
+            oldestSeq_++;
+        }
+        else
+        {
+            blockCount_++;
+        }
+    }
+
+    Block &b = blockAt(headSeq_);
+    b.firstIndex = nextIndex_;
+    b.base = sample;
+    b.count = 1;
+    b.used = 0;
+    lastRepeat_ = -1;
+
+    stored_++;
+    nextIndex_++;
+    prev_ = sample;
+}
+
+/**
+ * @brief Xóa lịch sử; chỉ số tuyệt đối vẫn tăng tiếp để reader nhận ra
+ */
+void HistoryStore::clear()
+{
+    if (blockCount_ > 0)
+    {
+        headSeq_++;
+    }
+    oldestSeq_ = headSeq_;
+    blockCount_ = 0;
+    stored_ = 0;
+    lastRepeat_ = -1;
+}
+
+uint32_t HistoryStore::sampleCount() const
+{
+    return stored_;
+}
+
+uint32_t HistoryStore::totalAppended() const
+{
+    return nextIndex_;
+}
+
+uint32_t HistoryStore::oldestIndex() const
+{
+    return blockCount_ > 0 ? blockAt(oldestSeq_).firstIndex : nextIndex_;
+}
+
+uint32_t HistoryStore::bytesUsed() const
+{
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < blockCount_; i++)
+    {
+        bytes += (BLOCK_SIZE - sizeof(Block::data)) + blockAt(oldestSeq_ + i).used;
+    }
+    return bytes;
+}
+
+uint32_t HistoryStore::capacityBytes()
+{
+    return (uint32_t)sizeof(Block) * BLOCK_COUNT;
+}
+
+HealthDataPacket HistoryStore::latest() const
+{
+    if (blockCount_ == 0)
+    {
+        HealthDataPacket empty = {0, 0, 0, 0};
+        return empty;
+    }
+    return prev_;
+}
+
+// ==================== HistoryReader ====================
+
+/**
+ * @brief Constructor - đọc từ mẫu cũ nhất
+ */
+HistoryReader::HistoryReader(const HistoryStore &store)
+    : store_(&store), seq_(0), index_(0), lost_(0), offset_(0), runOffset_(-1), runDone_(0), baseDone_(false)
+{
+    memset(&cur_, 0, sizeof(cur_));
+    rewind();
+}
+
+void HistoryReader::enterBlock(uint32_t seq)
+{
+    seq_ = seq;
+    index_ = store_->blockAt(seq).firstIndex;
+    offset_ = 0;
+    runOffset_ = -1;
+    runDone_ = 0;
+    baseDone_ = false;
+}
+
+void HistoryReader::rewind()
+{
+    if (store_->blockCount_ > 0)
+    {
+        enterBlock(store_->oldestSeq_);
+        return;
+    }
+
+    // Rỗng: chờ khối kế tiếp
+    seq_ = store_->headSeq_;
+    index_ = store_->nextIndex_;
+    offset_ = 0;
+    runOffset_ = -1;
+    runDone_ = 0;
+    baseDone_ = false;
+}
+
+void HistoryReader::seekEnd()
+{
+    if (store_->blockCount_ == 0)
+    {
+        rewind();
+        return;
+    }
+
+    // Giải mã phần còn lại của khối đang ghi (tối đa một khối)
+    if (index_ < store_->blockAt(store_->headSeq_).firstIndex || index_ > store_->nextIndex_)
+    {
+        enterBlock(store_->headSeq_);
+    }
+    HealthDataPacket skipped;
+    while (next(skipped))
+    {
+    }
+}
+
+/**
+ * @brief Đọc mẫu kế tiếp
+ *
+ * Bản ghi lặp được đọc theo giá trị n hiện tại trong khối, nên các mẫu được
+ * gộp thêm vào bản ghi sau lần đọc trước vẫn không bị bỏ sót.
+ */
+bool HistoryReader::next(HealthDataPacket &out)
+{
+    const HistoryStore &s = *store_;
+
+    if (index_ >= s.nextIndex_)
+        return false;
+
+    if (index_ < s.oldestIndex())
+    {
+        // Khối đang đọc đã bị ghi đè hoặc lịch sử bị xóa
+        lost_ += s.oldestIndex() - index_;
+        rewind();
+        if (s.blockCount_ == 0)
+            return false;
+    }
+
+    while (true)
+    {
+        const HistoryStore::Block &b = s.blockAt(seq_);
+
+        if (!baseDone_)
+        {
+            cur_ = b.base;
+            baseDone_ = true;
+            break;
+        }
+
+        if (runOffset_ >= 0)
+        {
+            uint8_t runLen = (b.data[runOffset_] & 0x1F) + 1;
+            if (runDone_ < runLen)
+            {
+                runDone_++;
+                cur_.timestamp += s.intervalS_;
+                break;
+            }
+            runOffset_ = -1;
+        }
+
+        if (offset_ >= b.used)
+        {
+            // Hết khối: sang khối kế tiếp (chắc chắn tồn tại vì index_ < nextIndex_)
+            enterBlock(seq_ + 1);
+            continue;
+        }
+
+        uint8_t tag = b.data[offset_];
+        if ((tag & 0x80) == 0)
+        {
+            cur_.timestamp += s.intervalS_;
+            cur_.hr = (uint8_t)(cur_.hr + signExtend((tag >> 4) & 0x07, 3));
+            cur_.steps += tag & 0x0F;
+            offset_ += 1;
+        }
+        else if ((tag & 0xC0) == 0x80)
+        {
+            uint8_t b2 = b.data[offset_ + 1];
+            cur_.timestamp += s.intervalS_ - 1 + ((tag >> 4) & 0x03);
+            cur_.hr = (uint8_t)(cur_.hr + signExtend(tag & 0x0F, 4));
+            cur_.steps += b2 >> 4;
+            cur_.spo2 = (uint8_t)(cur_.spo2 + signExtend(b2 & 0x0F, 4));
+            offset_ += 2;
+        }
+        else if ((tag & 0xE0) == HistoryStore::TAG_REPEAT)
+        {
+            cur_.timestamp += s.intervalS_;
+            runOffset_ = (int16_t)offset_;
+            runDone_ = 1;
+            offset_ += 1;
+        }
+        else
+        {
+            memcpy(&cur_, &b.data[offset_ + 1], sizeof(cur_));
+            offset_ += 1 + sizeof(cur_);
+        }
+        break;
+    }
+
+    index_++;
+    out = cur_;
+    return true;
+}
+
+size_t HistoryReader::read(HealthDataPacket *out, size_t maxCount)
+{
+    size_t n = 0;
+    while (n < maxCount && next(out[n]))
+    {
+        n++;
+    }
+    return n;
+}
+
+uint32_t HistoryReader::position() const
+{
+    return index_;
+}
+
+uint32_t HistoryReader::pending() const
+{
+    uint32_t from = index_ > store_->oldestIndex() ? index_ : store_->oldestIndex();
+    return store_->nextIndex_ - from;
+}
+
+uint32_t HistoryReader::lost() const
+{
+    return lost_;
+}
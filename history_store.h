@@ -0,0 +1,162 @@
+/**
+ * @file history_store.h
+ * @brief Lưu lịch sử HR/SpO2/bước chân nhiều giờ trong RAM, nén theo khối
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - Vòng các khối kích thước cố định; khi đầy, khối cũ nhất bị ghi đè
+ * - Mỗi khối có mẫu gốc (timestamp, steps, HR, SpO2 tuyệt đối); các mẫu sau
+ *   được mã hóa delta so với mẫu liền trước
+ * - Thêm mẫu O(1); đọc tuần tự bằng HistoryReader để truyền qua BLE
+ *
+ * Mã hóa bản ghi (dt danh định = khoảng lấy mẫu lịch sử, tính bằng giây):
+ * - 0hhhssss            : dt danh định, dHR -4..3, dSteps 0..15, dSpO2 = 0
+ * - 10tthhhh ssssppp p  : dt = danh định - 1 + tt, dHR -8..7, dSteps 0..15, dSpO2 -8..7
+ * - 110nnnnn            : n + 1 mẫu (1..32) không đổi, cách nhau dt danh định
+ *                         (bản ghi cuối được tăng n tại chỗ khi thêm mẫu không đổi)
+ * - 111xxxxx + 10 byte  : mẫu tuyệt đối HealthDataPacket (nhảy thời gian, reset bước...)
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "board_config.h"
+#include "health_data_packet.h"
+
+class HistoryReader;
+
+/**
+ * @class HistoryStore
+ * @brief Vòng khối nén lưu lịch sử mẫu sức khỏe
+ */
+class HistoryStore
+{
+public:
+    /// @brief Constructor
+    /// @param intervalS Khoảng cách danh định giữa hai mẫu (giây)
+    explicit HistoryStore(uint8_t intervalS = HISTORY_SAMPLE_INTERVAL_S);
+
+    /// @brief Thêm một mẫu (O(1); có thể ghi đè khối cũ nhất)
+    /// @param sample Mẫu cần lưu
+    void append(const HealthDataPacket &sample);
+
+    /// @brief Xóa toàn bộ lịch sử
+    void clear();
+
+    /// @brief Số mẫu hiện còn lưu
+    uint32_t sampleCount() const;
+
+    /// @brief Tổng số mẫu đã thêm từ khi khởi tạo (chỉ số của mẫu kế tiếp)
+    uint32_t totalAppended() const;
+
+    /// @brief Chỉ số tuyệt đối của mẫu cũ nhất còn lưu
+    uint32_t oldestIndex() const;
+
+    /// @brief Số byte đã dùng (header + dữ liệu) trong các khối còn lưu
+    uint32_t bytesUsed() const;
+
+    /// @brief Dung lượng RAM của vùng lưu trữ (bytes)
+    static uint32_t capacityBytes();
+
+    /// @brief Mẫu mới nhất (toàn 0 nếu rỗng)
+    HealthDataPacket latest() const;
+
+private:
+    friend class HistoryReader;
+
+    static const uint16_t BLOCK_SIZE = HISTORY_BLOCK_SIZE;   ///< Kích thước một khối (bytes)
+    static const uint16_t BLOCK_COUNT = HISTORY_BLOCK_COUNT; ///< Số khối trong vòng
+
+    static const uint8_t TAG_REPEAT = 0xC0; ///< 110nnnnn
+    static const uint8_t TAG_ESCAPE = 0xE0; ///< 111xxxxx
+    static const uint8_t MAX_REPEAT = 32;   ///< Số mẫu tối đa của một bản ghi lặp
+
+    /**
+     * @struct Block
+     * @brief Một khối: mẫu gốc + chuỗi bản ghi delta
+     */
+    struct Block
+    {
+        uint32_t firstIndex;   ///< Chỉ số tuyệt đối của mẫu gốc
+        HealthDataPacket base; ///< Mẫu gốc (giá trị tuyệt đối)
+        uint16_t count;        ///< Số mẫu trong khối (kể cả mẫu gốc)
+        uint16_t used;         ///< Số byte đã dùng trong data
+        uint8_t data[BLOCK_SIZE - 8 - sizeof(HealthDataPacket)];
+    };
+
+    static_assert(sizeof(Block) == BLOCK_SIZE, "Block must not need padding");
+
+    /// @brief Mã hóa delta của sample so với prev_ vào out
+    /// @return Số byte (1, 2 hoặc 11)
+    uint8_t encode(const HealthDataPacket &sample, uint8_t *out) const;
+
+    /// @brief Mở khối mới với sample làm mẫu gốc (ghi đè khối cũ nhất nếu vòng đầy)
+    void startBlock(const HealthDataPacket &sample);
+
+    Block &blockAt(uint32_t seq) { return blocks_[seq % BLOCK_COUNT]; }
+    const Block &blockAt(uint32_t seq) const { return blocks_[seq % BLOCK_COUNT]; }
+
+    Block blocks_[BLOCK_COUNT]; ///< Vòng khối
+    uint32_t oldestSeq_;        ///< Số thứ tự khối cũ nhất còn lưu
+    uint32_t headSeq_;          ///< Số thứ tự khối đang ghi
+    uint32_t blockCount_;       ///< Số khối đang dùng (0 nếu rỗng)
+    uint32_t stored_;           ///< Số mẫu còn lưu
+    uint32_t nextIndex_;        ///< Chỉ số tuyệt đối của mẫu kế tiếp
+    HealthDataPacket prev_;     ///< Mẫu vừa thêm (gốc của delta kế tiếp)
+    int16_t lastRepeat_;        ///< Offset bản ghi lặp cuối trong khối đang ghi (-1 nếu không có)
+    uint8_t intervalS_;         ///< dt danh định (giây)
+};
+
+/**
+ * @class HistoryReader
+ * @brief Con trỏ đọc tuần tự HistoryStore
+ *
+ * Có thể sao chép: tạo bản sao để đọc thử, chỉ gán lại khi gửi thành công.
+ * Nếu khối đang đọc bị ghi đè, reader nhảy tới mẫu cũ nhất và cộng dồn số
+ * mẫu bị mất vào lost().
+ */
+class HistoryReader
+{
+public:
+    /// @brief Constructor - bắt đầu từ mẫu cũ nhất
+    explicit HistoryReader(const HistoryStore &store);
+
+    /// @brief Về mẫu cũ nhất còn lưu
+    void rewind();
+
+    /// @brief Bỏ qua mọi mẫu hiện có (chỉ đọc mẫu thêm sau này)
+    void seekEnd();
+
+    /// @brief Đọc mẫu kế tiếp
+    /// @param out Mẫu giải mã
+    /// @return false nếu đã đọc hết
+    bool next(HealthDataPacket &out);
+
+    /// @brief Đọc tối đa maxCount mẫu liên tiếp
+    /// @return Số mẫu đã đọc
+    size_t read(HealthDataPacket *out, size_t maxCount);
+
+    /// @brief Chỉ số tuyệt đối của mẫu sẽ đọc tiếp
+    uint32_t position() const;
+
+    /// @brief Số mẫu chưa đọc
+    uint32_t pending() const;
+
+    /// @brief Số mẫu bị ghi đè trước khi kịp đọc
+    uint32_t lost() const;
+
+private:
+    /// @brief Đặt con trỏ về đầu khối seq
+    void enterBlock(uint32_t seq);
+
+    const HistoryStore *store_; ///< Kho lịch sử
+    uint32_t seq_;              ///< Khối đang đọc
+    uint32_t index_;            ///< Chỉ số tuyệt đối của mẫu kế tiếp
+    uint32_t lost_;             ///< Số mẫu bị mất do ghi đè
+    HealthDataPacket cur_;      ///< Mẫu vừa giải mã
+    uint16_t offset_;           ///< Offset bản ghi kế tiếp trong khối
+    int16_t runOffset_;         ///< Offset bản ghi lặp đang đọc (-1 nếu không có)
+    uint8_t runDone_;           ///< Số mẫu đã đọc từ bản ghi lặp
+    bool baseDone_;             ///< Đã đọc mẫu gốc của khối
+};
@@ -0,0 +1,150 @@
+/**
+ * @file i2c_async.cpp
+ * @brief Triển khai cổng I2C bất đồng bộ trên task FreeRTOS
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#include "i2c_async.h"
+#include <freertos/task.h>
+
+/**
+ * @brief Constructor - chưa có hàng đợi và task
+ */
+WireAsyncPort::WireAsyncPort()
+    : wire_(nullptr), profiler_(nullptr), queue_(nullptr), busyUs_(0),
+      executing_(false), errors_(0)
+{
+}
+
+/**
+ * @brief Tạo hàng đợi giao dịch và task I2C
+ *
+ * Hàng đợi chỉ chứa con trỏ: dữ liệu giao dịch nằm trong bộ nhớ của người gọi.
+ */
+bool WireAsyncPort::begin(TwoWire &wire, I2CProfiler *profiler)
+{
+    wire_ = &wire;
+    profiler_ = profiler;
+
+    queue_ = xQueueCreate(QUEUE_DEPTH, sizeof(I2CTransfer *));
+    if (!queue_)
+    {
+        Serial.println("[I2C] ERROR: Cannot create async queue");
+        return false;
+    }
+
+    if (xTaskCreate(taskEntry, "i2c_async", TASK_STACK, this, TASK_PRIORITY, nullptr) != pdPASS)
+    {
+        Serial.println("[I2C] ERROR: Cannot create async task");
+        vQueueDelete(queue_);
+        queue_ = nullptr;
+        return false;
+    }
+
+    Serial.println("[I2C] Async port started");
+    return true;
+}
+
+/**
+ * @brief Đưa giao dịch vào hàng đợi của task I2C, không chờ
+ */
+bool WireAsyncPort::start(I2CTransfer &xfer)
+{
+    if (!queue_ || xfer.busy())
+        return false;
+
+    xfer.state = I2C_XFER_PENDING;
+    xfer.durationUs = 0;
+
+    I2CTransfer *p = &xfer;
+    if (xQueueSend(queue_, &p, 0) != pdTRUE)
+    {
+        xfer.state = I2C_XFER_IDLE;
+        return false;
+    }
+    return true;
+}
+
+uint32_t WireAsyncPort::totalBusyUs() const
+{
+    return busyUs_;
+}
+
+bool WireAsyncPort::idle() const
+{
+    return !executing_ && (!queue_ || uxQueueMessagesWaiting(queue_) == 0);
+}
+
+uint32_t WireAsyncPort::consecutiveErrors() const { return errors_; }
+
+void WireAsyncPort::clearErrors()
+{
+    errors_ = 0;
+}
+
+/**
+ * @brief Thân task I2C
+ *
+ * Chờ giao dịch (không tốn CPU khi hàng đợi rỗng), thực thi, ghi thời gian
+ * rồi mới đặt trạng thái DONE/ERROR để loop() thấy kết quả đầy đủ.
+ */
+void WireAsyncPort::taskEntry(void *arg)
+{
+    WireAsyncPort *self = static_cast<WireAsyncPort *>(arg);
+    I2CTransfer *xfer = nullptr;
+
+    while (true)
+    {
+        if (xQueueReceive(self->queue_, &xfer, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        self->executing_ = true;
+        uint32_t startUs = micros();
+        bool ok = self->execute(*xfer);
+        uint32_t elapsed = micros() - startUs;
+        self->executing_ = false;
+
+        self->busyUs_ += elapsed;
+        self->errors_ = ok ? 0 : self->errors_ + 1;
+        xfer->durationUs = elapsed;
+        if (self->profiler_)
+        {
+            self->profiler_->record(xfer->addr, xfer->reg, xfer->len, xfer->write, startUs, elapsed, ok);
+        }
+        xfer->state = ok ? I2C_XFER_DONE : I2C_XFER_ERROR;
+
+        if (xfer->done)
+        {
+            xfer->done(*xfer);
+        }
+    }
+}
+
+/**
+ * @brief Thực thi một giao dịch Wire (đọc dùng repeated start)
+ */
+bool WireAsyncPort::execute(I2CTransfer &xfer)
+{
+    wire_->beginTransmission(xfer.addr);
+    wire_->write(xfer.reg);
+
+    if (xfer.write)
+    {
+        wire_->write(xfer.data, xfer.len);
+        return wire_->endTransmission() == 0;
+    }
+
+    if (wire_->endTransmission(false) != 0)
+        return false;
+
+    size_t n = wire_->requestFrom((int)xfer.addr, (int)xfer.len);
+    if (n != xfer.len)
+        return false;
+
+    for (uint8_t i = 0; i < xfer.len; i++)
+    {
+        xfer.data[i] = wire_->read();
+    }
+    return true;
+}
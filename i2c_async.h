@@ -0,0 +1,71 @@
+/**
+ * @file i2c_async.h
+ * @brief Giao dịch I2C bất đồng bộ cho các sensor manager
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - I2CTransfer, AsyncI2CPort (i2c_transfer.h): mô tả giao dịch kiêm "future"
+ *   và giao diện cổng bất đồng bộ, không phụ thuộc Arduino
+ * - WireAsyncPort: triển khai AsyncI2CPort trên ESP32 bằng một task FreeRTOS
+ *   thực thi giao dịch Wire; task chờ ngắt của driver I2C nên CPU được
+ *   nhường cho loop() (xử lý DSP) trong suốt thời gian truyền byte trên bus
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "i2c_profiler.h"
+#include "i2c_transfer.h"
+
+/**
+ * @class WireAsyncPort
+ * @brief Cổng bất đồng bộ trên ESP32: task FreeRTOS thực thi giao dịch Wire
+ *
+ * Driver I2C của ESP32 chờ ngắt hoàn tất bằng semaphore, nên task I2C bị
+ * chặn (không chiếm CPU) trong lúc truyền; loop() tiếp tục chạy.
+ * Wire tự khóa theo từng giao dịch nên có thể dùng song song với các
+ * driver blocking (thư viện MAX30105) trên cùng bus.
+ */
+class WireAsyncPort final : public AsyncI2CPort
+{
+public:
+    /// @brief Constructor
+    WireAsyncPort();
+
+    /// @brief Tạo hàng đợi và task I2C
+    /// @param wire Bus I2C đã khởi tạo
+    /// @param profiler Bộ đo giao dịch (có thể nullptr)
+    /// @return true nếu tạo task thành công
+    bool begin(TwoWire &wire, I2CProfiler *profiler = nullptr);
+
+    bool start(I2CTransfer &xfer) override;
+
+    uint32_t totalBusyUs() const override;
+
+    bool idle() const override;
+
+    uint32_t consecutiveErrors() const override;
+
+    void clearErrors() override;
+
+private:
+    /// @brief Thân task: nhận giao dịch từ hàng đợi và thực thi
+    static void taskEntry(void *arg);
+
+    /// @brief Thực thi một giao dịch (blocking trong task I2C)
+    bool execute(I2CTransfer &xfer);
+
+    static const uint8_t QUEUE_DEPTH = 8;    ///< Số giao dịch chờ tối đa
+    static const uint32_t TASK_STACK = 2048; ///< Stack của task I2C (bytes)
+    static const uint8_t TASK_PRIORITY = 3;  ///< Cao hơn loopTask (1) để bus không rảnh
+
+    TwoWire *wire_;            ///< Bus I2C
+    I2CProfiler *profiler_;    ///< Bộ đo giao dịch (có thể nullptr)
+    QueueHandle_t queue_;      ///< Hàng đợi con trỏ I2CTransfer*
+    volatile uint32_t busyUs_; ///< Tổng thời gian bận (chỉ task I2C ghi)
+    volatile bool executing_;  ///< Task I2C đang thực thi một giao dịch
+    volatile uint32_t errors_; ///< Số lỗi liên tiếp
+};
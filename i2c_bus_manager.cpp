@@ -0,0 +1,583 @@
+/**
+ * @file i2c_bus_manager.cpp
+ * @brief Triển khai quản lý và lập lịch bus I2C dùng chung
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#include "i2c_bus_manager.h"
+
+/**
+ * @brief Constructor - bảng job và hàng đợi rỗng
+ */
+I2CBusManager::I2CBusManager()
+    : wire_(nullptr), sda_(-1), scl_(-1), clockHz_(0), asyncPort_(nullptr), asyncBusyMarkUs_(0), jobCount_(0), pendingCount_(0),
+      windowStartUs_(0), windowBusyUs_(0), utilization_(0.0f), inJob_(false), jobBusyUs_(0),
+      handlerCount_(0), consecutiveFailures_(0), failureReported_(false), recovering_(false),
+      recoveryCount_(0), lastRecoveryMs_(0), backoffMs_(RECOVERY_BACKOFF_MS)
+{
+}
+
+/**
+ * @brief Khởi tạo Wire trên chân chỉ định với tốc độ bus cho trước
+ *
+ * Cả MAX30102 và MPU6050 hỗ trợ Fast-mode (400 kHz).
+ */
+bool I2CBusManager::begin(int sda, int scl, uint32_t clockHz)
+{
+    wire_ = &Wire;
+    sda_ = sda;
+    scl_ = scl;
+    clockHz_ = clockHz;
+
+    if (!wire_->begin(sda, scl, clockHz))
+    {
+        Serial.println("[I2C] ERROR: Wire.begin failed");
+        return false;
+    }
+    wire_->setClock(clockHz);
+    wire_->setTimeOut(TIMEOUT_MS); // Bus treo → lỗi sau 10 ms thay vì 50 ms
+
+    windowStartUs_ = micros();
+    Serial.printf("[I2C] Bus started: SDA=%d, SCL=%d, %lu Hz (actual %lu Hz)\n",
+                  sda, scl, (unsigned long)clockHz, (unsigned long)wire_->getClock());
+    return true;
+}
+
+TwoWire &I2CBusManager::wire()
+{
+    return *wire_;
+}
+
+/**
+ * @brief Ghi một byte vào thanh ghi của thiết bị
+ */
+bool I2CBusManager::writeReg(uint8_t addr, uint8_t reg, uint8_t val)
+{
+    if (!wire_)
+        return false;
+
+    uint32_t startUs = micros();
+    wire_->beginTransmission(addr);
+    wire_->write(reg);
+    wire_->write(val);
+    bool ok = (wire_->endTransmission() == 0);
+    uint32_t elapsed = micros() - startUs;
+    accountBusy(elapsed);
+    profiler_.record(addr, reg, 1, true, startUs, elapsed, ok);
+    noteResult(ok);
+    return ok;
+}
+
+/**
+ * @brief Đọc nhiều byte bắt đầu từ một thanh ghi (repeated start)
+ */
+bool I2CBusManager::readRegs(uint8_t addr, uint8_t reg, uint8_t *buf, size_t len)
+{
+    if (!wire_)
+        return false;
+
+    uint32_t startUs = micros();
+    bool ok = false;
+    wire_->beginTransmission(addr);
+    wire_->write(reg);
+    if (wire_->endTransmission(false) == 0)
+    {
+        size_t n = wire_->requestFrom((int)addr, (int)len);
+        if (n == len)
+        {
+            for (size_t i = 0; i < len; ++i)
+            {
+                buf[i] = wire_->read();
+            }
+            ok = true;
+        }
+    }
+    uint32_t elapsed = micros() - startUs;
+    accountBusy(elapsed);
+    profiler_.record(addr, reg, (uint8_t)len, false, startUs, elapsed, ok);
+    noteResult(ok);
+    return ok;
+}
+
+/**
+ * @brief Gắn cổng bất đồng bộ; thời gian bận của cổng được cộng vào mức sử dụng
+ */
+void I2CBusManager::setAsyncPort(AsyncI2CPort *port)
+{
+    asyncPort_ = port;
+    asyncBusyMarkUs_ = port ? port->totalBusyUs() : 0;
+}
+
+/**
+ * @brief Bắt đầu giao dịch bất đồng bộ
+ *
+ * Có cổng: giao dịch chạy trong task I2C, người gọi kiểm tra finished() ở
+ * lần gọi sau. Không có cổng: thực thi đồng bộ để driver vẫn hoạt động.
+ */
+bool I2CBusManager::startTransfer(I2CTransfer &xfer)
+{
+    if (!wire_ || xfer.busy())
+        return false;
+
+    if (asyncPort_)
+        return asyncPort_->start(xfer);
+
+    I2CTransaction t = {xfer.addr, xfer.reg, xfer.data, xfer.len, xfer.write,
+                        (uint32_t)millis(), I2C_PRIO_NORMAL, nullptr, nullptr};
+    uint32_t startUs = micros();
+    bool ok = execute(t);
+    xfer.durationUs = micros() - startUs;
+    xfer.state = ok ? I2C_XFER_DONE : I2C_XFER_ERROR;
+    if (xfer.done)
+    {
+        xfer.done(xfer);
+    }
+    return true;
+}
+
+/**
+ * @brief Đưa một giao dịch vào hàng đợi để service() thực thi theo hạn chót
+ */
+bool I2CBusManager::submit(const I2CTransaction &t)
+{
+    if (pendingCount_ >= MAX_PENDING)
+    {
+        Serial.printf("[I2C] Queue full - dropped transaction to 0x%02X\n", t.addr);
+        return false;
+    }
+    pending_[pendingCount_++] = t;
+    return true;
+}
+
+/**
+ * @brief Đăng ký job định kỳ
+ *
+ * Ví dụ: FIFO MAX30102 có 32 mẫu, ở 400 Hz sẽ tràn sau 80 ms → deadline 80 ms,
+ * chu kỳ 40 ms để luôn còn dư một nửa FIFO.
+ */
+int8_t I2CBusManager::addJob(const char *name, uint32_t periodMs, uint32_t deadlineMs,
+                             I2CPriority priority, I2CJobFn fn, void *ctx, uint8_t opaqueAddr)
+{
+    if (jobCount_ >= MAX_JOBS)
+        return -1;
+
+    Job &j = jobs_[jobCount_];
+    j.name = name;
+    j.periodMs = periodMs;
+    j.deadlineMs = (deadlineMs >= periodMs) ? deadlineMs : periodMs;
+    j.priority = priority;
+    j.fn = fn;
+    j.ctx = ctx;
+    j.opaqueAddr = opaqueAddr;
+    j.lastRunMs = millis() - periodMs; // Đến hạn ngay lần service() đầu tiên
+    j.enabled = true;
+    j.stats.runs = 0;
+    j.stats.deadlineMiss = 0;
+    j.stats.maxLatencyMs = 0;
+
+    Serial.printf("[I2C] Job '%s': period=%lums, deadline=%lums\n",
+                  name, (unsigned long)periodMs, (unsigned long)j.deadlineMs);
+    return (int8_t)jobCount_++;
+}
+
+/**
+ * @brief Bật/tắt một job; khi bật lại, job đến hạn ngay
+ */
+void I2CBusManager::setJobEnabled(int8_t job, bool enabled)
+{
+    if (job < 0 || job >= jobCount_)
+        return;
+
+    Job &j = jobs_[job];
+    if (enabled && !j.enabled)
+    {
+        j.lastRunMs = millis() - j.periodMs;
+    }
+    j.enabled = enabled;
+}
+
+/**
+ * @brief Chạy các job và giao dịch đã đến hạn
+ *
+ * Lặp chọn việc có hạn chót tuyệt đối sớm nhất (EDF):
+ * - Job định kỳ: đến hạn khi now - lastRun ≥ period, hạn chót = lastRun + deadline
+ * - Giao dịch một lần: luôn đến hạn, hạn chót do người gửi đặt
+ * Cùng hạn chót → ưu tiên cao hơn chạy trước. Mỗi job chạy tối đa một lần
+ * trong một lần gọi service() để không job nào chiếm bus liên tục.
+ */
+void I2CBusManager::service()
+{
+    if (!wire_)
+        return;
+
+    if (needsRecovery() && (millis() - lastRecoveryMs_) >= backoffMs_)
+    {
+        recover();
+    }
+
+    bool ran[MAX_JOBS] = {false};
+
+    while (true)
+    {
+        uint32_t now = millis();
+        int8_t bestJob = -1;
+        int8_t bestTx = -1;
+        uint32_t bestDeadline = 0;
+        I2CPriority bestPrio = I2C_PRIO_LOW;
+
+        for (uint8_t i = 0; i < jobCount_; i++)
+        {
+            const Job &j = jobs_[i];
+            if (!j.enabled || ran[i] || (now - j.lastRunMs) < j.periodMs)
+                continue;
+
+            uint32_t deadline = j.lastRunMs + j.deadlineMs;
+            bool better = (bestJob < 0 && bestTx < 0) ||
+                          (int32_t)(deadline - bestDeadline) < 0 ||
+                          (deadline == bestDeadline && j.priority < bestPrio);
+            if (better)
+            {
+                bestJob = i;
+                bestTx = -1;
+                bestDeadline = deadline;
+                bestPrio = j.priority;
+            }
+        }
+
+        for (uint8_t i = 0; i < pendingCount_; i++)
+        {
+            const I2CTransaction &t = pending_[i];
+            bool better = (bestJob < 0 && bestTx < 0) ||
+                          (int32_t)(t.deadlineMs - bestDeadline) < 0 ||
+                          (t.deadlineMs == bestDeadline && t.priority < bestPrio);
+            if (better)
+            {
+                bestJob = -1;
+                bestTx = i;
+                bestDeadline = t.deadlineMs;
+                bestPrio = t.priority;
+            }
+        }
+
+        if (bestJob >= 0)
+        {
+            Job &j = jobs_[bestJob];
+            uint32_t latency = now - (j.lastRunMs + j.periodMs);
+            if (latency > j.stats.maxLatencyMs)
+                j.stats.maxLatencyMs = latency;
+            if ((now - j.lastRunMs) > j.deadlineMs)
+                j.stats.deadlineMiss++;
+
+            // Thời gian bus của job: các giao dịch bọc bên trong (readRegs/writeReg),
+            // hoặc toàn bộ thời gian job nếu driver tự gọi Wire (thư viện MAX30105).
+            // Job chỉ bắt đầu giao dịch bất đồng bộ không chiếm bus trong loop().
+            inJob_ = true;
+            jobBusyUs_ = 0;
+            uint32_t startUs = micros();
+            j.fn(j.ctx);
+            uint32_t jobUs = micros() - startUs;
+            inJob_ = false;
+            if (j.opaqueAddr != 0)
+            {
+                accountBusy(jobUs);
+                profiler_.record(j.opaqueAddr, I2C_REG_OPAQUE, 0, false, startUs, jobUs, true);
+            }
+            else
+            {
+                accountBusy(jobBusyUs_);
+            }
+
+            j.lastRunMs = now;
+            j.stats.runs++;
+            ran[bestJob] = true;
+        }
+        else if (bestTx >= 0)
+        {
+            I2CTransaction t = pending_[bestTx];
+            pending_[bestTx] = pending_[--pendingCount_];
+
+            bool ok = execute(t);
+            if (t.done)
+            {
+                t.done(t.ctx, ok);
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Mức sử dụng bus (%) trong cửa sổ 1 giây gần nhất
+ */
+float I2CBusManager::getUtilization() const
+{
+    return utilization_;
+}
+
+I2CJobStats I2CBusManager::getJobStats(int8_t job) const
+{
+    if (job < 0 || job >= jobCount_)
+    {
+        I2CJobStats empty = {0, 0, 0};
+        return empty;
+    }
+    return jobs_[job].stats;
+}
+
+/**
+ * @brief In mức sử dụng bus và thống kê từng job
+ */
+void I2CBusManager::printStats() const
+{
+    Serial.printf("[I2C] Bus utilization: %.1f%% @ %lu Hz (actual %lu Hz), pending=%d, recoveries=%lu\n",
+                  utilization_, (unsigned long)clockHz_,
+                  (unsigned long)(wire_ ? wire_->getClock() : 0), pendingCount_,
+                  (unsigned long)recoveryCount_);
+    for (uint8_t i = 0; i < jobCount_; i++)
+    {
+        const Job &j = jobs_[i];
+        Serial.printf("[I2C]   %s: runs=%u, missed=%u, maxLatency=%ums\n",
+                      j.name, j.stats.runs, j.stats.deadlineMiss, j.stats.maxLatencyMs);
+    }
+}
+
+I2CProfiler &I2CBusManager::profiler()
+{
+    return profiler_;
+}
+
+/**
+ * @brief Đăng ký hàm cấu hình lại cảm biến
+ *
+ * Hàm được gọi sau mỗi lần khôi phục bus, theo thứ tự đăng ký. Cảm biến có
+ * thể đã mất nguồn (brown-out) nên cần ghi lại toàn bộ cấu hình.
+ */
+bool I2CBusManager::addRecoveryHandler(const char *name, I2CRecoveryFn fn, void *ctx)
+{
+    if (handlerCount_ >= MAX_RECOVERY_HANDLERS)
+        return false;
+
+    RecoveryHandler &h = handlers_[handlerCount_++];
+    h.name = name;
+    h.fn = fn;
+    h.ctx = ctx;
+    return true;
+}
+
+/**
+ * @brief Driver báo thiết bị ngừng phản hồi
+ *
+ * Dùng cho driver tự gọi Wire (thư viện MAX30105) vì thư viện nuốt lỗi I2C:
+ * bus treo chỉ biểu hiện là FIFO không còn mẫu mới.
+ */
+void I2CBusManager::reportFailure(uint8_t addr)
+{
+    if (!failureReported_ && !recovering_)
+    {
+        Serial.printf("[I2C] Device 0x%02X stopped responding\n", addr);
+        failureReported_ = true;
+    }
+}
+
+/**
+ * @brief Khôi phục bus mà không khởi động lại
+ *
+ * Quy trình:
+ * 1. Chờ task I2C bất đồng bộ rảnh (không khởi tạo lại Wire giữa giao dịch)
+ * 2. Giải phóng Wire, tạo tối đa 9 xung SCL để thiết bị đang giữ SDA hoàn
+ *    tất byte dở dang, rồi tạo điều kiện STOP
+ * 3. Khởi tạo lại Wire với tốc độ và timeout cũ
+ * 4. Gọi các hàm cấu hình lại cảm biến
+ *
+ * Toàn bộ mất vài ms (xung SCL ~100 µs, cấu hình lại vài giao dịch).
+ */
+bool I2CBusManager::recover()
+{
+    if (!wire_ || recovering_)
+        return false;
+
+    recovering_ = true;
+    uint32_t startUs = micros();
+
+    if (asyncPort_)
+    {
+        uint32_t waitStart = millis();
+        while (!asyncPort_->idle() && (millis() - waitStart) < 2u * TIMEOUT_MS)
+        {
+            delay(1);
+        }
+    }
+
+    wire_->end();
+    bool released = clockOutBus();
+    wire_->begin(sda_, scl_, clockHz_);
+    wire_->setClock(clockHz_);
+    wire_->setTimeOut(TIMEOUT_MS);
+
+    consecutiveFailures_ = 0;
+    if (asyncPort_)
+    {
+        asyncPort_->clearErrors();
+    }
+
+    uint8_t reinitOk = 0;
+    for (uint8_t i = 0; i < handlerCount_; i++)
+    {
+        bool ok = handlers_[i].fn(handlers_[i].ctx);
+        if (ok)
+        {
+            reinitOk++;
+        }
+        else
+        {
+            Serial.printf("[I2C] Recovery: %s did not respond\n", handlers_[i].name);
+        }
+    }
+
+    // Lỗi trong lúc cấu hình lại không kích hoạt khôi phục tiếp ngay lập tức.
+    // Cảm biến vẫn không phản hồi (tuột dây) → giãn dần các lần thử để không
+    // làm gián đoạn cảm biến còn lại trên bus.
+    bool allOk = released && reinitOk == handlerCount_;
+    backoffMs_ = allOk ? RECOVERY_BACKOFF_MS
+                       : ((backoffMs_ * 2 < MAX_BACKOFF_MS) ? backoffMs_ * 2 : MAX_BACKOFF_MS);
+    consecutiveFailures_ = 0;
+    failureReported_ = false;
+    recoveryCount_++;
+    lastRecoveryMs_ = millis();
+    recovering_ = false;
+
+    Serial.printf("[I2C] Bus recovered #%lu in %luus: lines %s, %u/%u sensors reconfigured\n",
+                  (unsigned long)recoveryCount_, (unsigned long)(micros() - startUs),
+                  released ? "free" : "STUCK", reinitOk, handlerCount_);
+    return released;
+}
+
+uint32_t I2CBusManager::getRecoveryCount() const { return recoveryCount_; }
+
+/**
+ * @brief Cộng thời gian bận; khi hết cửa sổ 1 giây thì chốt mức sử dụng
+ */
+void I2CBusManager::accountBusy(uint32_t busyUs)
+{
+    if (inJob_)
+    {
+        jobBusyUs_ += busyUs;
+        return;
+    }
+
+    windowBusyUs_ += busyUs;
+
+    uint32_t nowUs = micros();
+    uint32_t elapsed = nowUs - windowStartUs_;
+    if (elapsed >= UTIL_WINDOW_US)
+    {
+        if (asyncPort_)
+        {
+            uint32_t portBusy = asyncPort_->totalBusyUs();
+            windowBusyUs_ += portBusy - asyncBusyMarkUs_;
+            asyncBusyMarkUs_ = portBusy;
+        }
+        utilization_ = 100.0f * (float)windowBusyUs_ / (float)elapsed;
+        windowBusyUs_ = 0;
+        windowStartUs_ = nowUs;
+    }
+}
+
+/**
+ * @brief Thực thi một giao dịch một lần
+ */
+bool I2CBusManager::execute(const I2CTransaction &t)
+{
+    if (t.write)
+    {
+        uint32_t startUs = micros();
+        wire_->beginTransmission(t.addr);
+        wire_->write(t.reg);
+        wire_->write(t.data, t.len);
+        bool ok = (wire_->endTransmission() == 0);
+        uint32_t elapsed = micros() - startUs;
+        accountBusy(elapsed);
+        profiler_.record(t.addr, t.reg, t.len, true, startUs, elapsed, ok);
+        noteResult(ok);
+        return ok;
+    }
+    return readRegs(t.addr, t.reg, t.data, t.len);
+}
+
+/**
+ * @brief Đếm giao dịch đồng bộ lỗi liên tiếp (timeout, NACK)
+ */
+void I2CBusManager::noteResult(bool ok)
+{
+    if (ok)
+    {
+        consecutiveFailures_ = 0;
+    }
+    else if (consecutiveFailures_ < 255)
+    {
+        consecutiveFailures_++;
+    }
+}
+
+/**
+ * @brief Bus cần khôi phục khi có đủ lỗi liên tiếp (đồng bộ hoặc bất đồng bộ)
+ * hoặc khi driver báo thiết bị ngừng phản hồi
+ */
+bool I2CBusManager::needsRecovery() const
+{
+    if (recovering_)
+        return false;
+    if (failureReported_ || consecutiveFailures_ >= FAIL_THRESHOLD)
+        return true;
+    return asyncPort_ && asyncPort_->consecutiveErrors() >= FAIL_THRESHOLD;
+}
+
+/**
+ * @brief Giải phóng bus bị thiết bị giữ SDA ở mức thấp
+ *
+ * Thiết bị bị ngắt giữa byte (brown-out của master, nhiễu) vẫn chờ xung
+ * clock để gửi nốt các bit và kéo SDA xuống. Tạo tối đa 9 xung SCL (~100 kHz)
+ * đến khi SDA lên cao, sau đó tạo STOP (SDA lên khi SCL cao) để mọi thiết bị
+ * quay về trạng thái chờ START.
+ */
+bool I2CBusManager::clockOutBus()
+{
+    pinMode(sda_, INPUT_PULLUP);
+    pinMode(scl_, INPUT_PULLUP);
+    delayMicroseconds(5);
+
+    if (digitalRead(scl_) == LOW)
+    {
+        // SCL bị giữ thấp (clock stretching vô hạn) - xung clock không giúp được
+        Serial.println("[I2C] Recovery: SCL held low");
+        return false;
+    }
+
+    pinMode(scl_, OUTPUT_OPEN_DRAIN);
+    digitalWrite(scl_, HIGH);
+    for (uint8_t i = 0; i < 9 && digitalRead(sda_) == LOW; i++)
+    {
+        digitalWrite(scl_, LOW);
+        delayMicroseconds(5);
+        digitalWrite(scl_, HIGH);
+        delayMicroseconds(5);
+    }
+
+    // Điều kiện STOP: SDA thấp → cao trong khi SCL cao
+    pinMode(sda_, OUTPUT_OPEN_DRAIN);
+    digitalWrite(scl_, LOW);
+    digitalWrite(sda_, LOW);
+    delayMicroseconds(5);
+    digitalWrite(scl_, HIGH);
+    delayMicroseconds(5);
+    digitalWrite(sda_, HIGH);
+    delayMicroseconds(5);
+
+    pinMode(sda_, INPUT_PULLUP);
+    pinMode(scl_, INPUT_PULLUP);
+    return digitalRead(sda_) == HIGH && digitalRead(scl_) == HIGH;
+}
@@ -0,0 +1,251 @@
+/**
+ * @file i2c_bus_manager.h
+ * @brief Quản lý bus I2C dùng chung và lập lịch giao dịch cho MAX30102 và MPU6050
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - Sở hữu đối tượng Wire (khởi tạo chân, tốc độ bus)
+ * - Cung cấp thao tác đọc/ghi thanh ghi cho các driver tự viết (MPU6050)
+ * - Nhận mô tả giao dịch một lần (địa chỉ, thanh ghi, độ dài, hạn chót, ưu tiên)
+ * - Lập lịch các job định kỳ (xả FIFO cảm biến) theo hạn chót sớm nhất (EDF)
+ *   để FIFO của từng cảm biến được đọc trước khi tràn
+ * - Báo cáo mức sử dụng bus và số lần trễ hạn
+ * - Ghi mọi giao dịch vào I2CProfiler (thống kê theo thiết bị, vết giao dịch)
+ * - Phát hiện bus bị treo (lỗi liên tiếp, timeout, driver báo mất dữ liệu),
+ *   khôi phục bằng xung SCL và gọi lại cấu hình của từng cảm biến
+ * - Chuyển giao dịch bất đồng bộ sang AsyncI2CPort (nếu có) để loop()
+ *   không phải chờ bus
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+#include "i2c_async.h"
+#include "i2c_profiler.h"
+
+/**
+ * @enum I2CPriority
+ * @brief Mức ưu tiên khi hai giao dịch có cùng hạn chót
+ */
+enum I2CPriority
+{
+    I2C_PRIO_HIGH = 0,
+    I2C_PRIO_NORMAL = 1,
+    I2C_PRIO_LOW = 2
+};
+
+/// @brief Callback hoàn tất giao dịch một lần
+/// @param ctx Con trỏ ngữ cảnh do người gửi cung cấp
+/// @param ok true nếu giao dịch thành công
+typedef void (*I2CDoneCallback)(void *ctx, bool ok);
+
+/// @brief Hàm thực thi của job định kỳ (có thể gọi thư viện driver dùng Wire)
+typedef void (*I2CJobFn)(void *ctx);
+
+/// @brief Hàm ghi lại cấu hình cảm biến sau khi khôi phục bus
+/// @return true nếu cảm biến phản hồi và đã được cấu hình lại
+typedef bool (*I2CRecoveryFn)(void *ctx);
+
+/**
+ * @struct I2CTransaction
+ * @brief Mô tả một giao dịch đọc/ghi thanh ghi
+ */
+struct I2CTransaction
+{
+    uint8_t addr;         ///< Địa chỉ I2C 7-bit
+    uint8_t reg;          ///< Thanh ghi bắt đầu
+    uint8_t *data;        ///< Bộ đệm dữ liệu (đọc vào hoặc ghi ra)
+    uint8_t len;          ///< Số byte
+    bool write;           ///< true = ghi, false = đọc
+    uint32_t deadlineMs;  ///< Hạn chót tuyệt đối (millis)
+    I2CPriority priority; ///< Ưu tiên khi cùng hạn chót
+    I2CDoneCallback done; ///< Callback hoàn tất (có thể nullptr)
+    void *ctx;            ///< Ngữ cảnh cho callback
+};
+
+/**
+ * @struct I2CJobStats
+ * @brief Thống kê của một job định kỳ
+ */
+struct I2CJobStats
+{
+    uint32_t runs;         ///< Số lần chạy
+    uint32_t deadlineMiss; ///< Số lần chạy sau hạn chót (FIFO có thể đã tràn)
+    uint32_t maxLatencyMs; ///< Độ trễ lớn nhất so với thời điểm đến hạn
+};
+
+/**
+ * @class I2CBusManager
+ * @brief Sở hữu Wire và lập lịch mọi giao dịch trên bus dùng chung
+ *
+ * Hoạt động:
+ * 1. Các cảm biến đăng ký job định kỳ với chu kỳ và hạn chót suy ra từ
+ *    dung lượng FIFO / tần số lấy mẫu
+ * 2. Các giao dịch một lần được đưa vào hàng đợi có giới hạn
+ * 3. service() (gọi trong loop) chạy mọi việc đã đến hạn theo thứ tự
+ *    hạn chót sớm nhất, cùng hạn chót thì ưu tiên cao hơn chạy trước
+ * 4. Thời gian bus bận được cộng dồn để tính mức sử dụng mỗi giây
+ */
+class I2CBusManager
+{
+public:
+    /// @brief Constructor
+    I2CBusManager();
+
+    /// @brief Khởi tạo bus I2C
+    /// @param sda Chân SDA
+    /// @param scl Chân SCL
+    /// @param clockHz Tốc độ bus (Hz)
+    /// @return true nếu khởi tạo thành công
+    bool begin(int sda, int scl, uint32_t clockHz = 400000);
+
+    /// @brief Lấy Wire cho các thư viện driver cần TwoWire (MAX30105)
+    /// Chỉ nên dùng bên trong job đã đăng ký để bus vẫn được lập lịch.
+    TwoWire &wire();
+
+    /// @brief Ghi một byte vào thanh ghi (blocking, có tính thời gian bus)
+    bool writeReg(uint8_t addr, uint8_t reg, uint8_t val);
+
+    /// @brief Đọc nhiều byte từ thanh ghi (blocking, có tính thời gian bus)
+    bool readRegs(uint8_t addr, uint8_t reg, uint8_t *buf, size_t len);
+
+    /// @brief Gắn cổng bất đồng bộ (nullptr = thực thi đồng bộ)
+    void setAsyncPort(AsyncI2CPort *port);
+
+    /// @brief Bắt đầu giao dịch bất đồng bộ, trả về ngay
+    /// Không có cổng bất đồng bộ: thực thi ngay và xfer đã finished() khi trả về.
+    /// @param xfer Giao dịch (phải còn sống đến khi finished())
+    /// @return false nếu không nhận được giao dịch
+    bool startTransfer(I2CTransfer &xfer);
+
+    /// @brief Gửi một giao dịch một lần vào hàng đợi
+    /// @return false nếu hàng đợi đầy
+    bool submit(const I2CTransaction &t);
+
+    /// @brief Đăng ký job định kỳ
+    /// @param name Tên job (để log)
+    /// @param periodMs Chu kỳ chạy mong muốn (ms)
+    /// @param deadlineMs Thời gian tối đa giữa hai lần chạy trước khi FIFO tràn (ms)
+    /// @param priority Ưu tiên khi cùng hạn chót
+    /// @param fn Hàm thực thi
+    /// @param ctx Ngữ cảnh truyền cho fn
+    /// @param opaqueAddr Địa chỉ thiết bị nếu fn gọi thư viện driver tự dùng Wire
+    ///        (toàn bộ thời gian job được tính là thời gian bus của thiết bị đó);
+    ///        0 nếu fn chỉ dùng readRegs/writeReg/startTransfer
+    /// @return Chỉ số job (≥ 0) hoặc -1 nếu bảng job đầy
+    int8_t addJob(const char *name, uint32_t periodMs, uint32_t deadlineMs,
+                  I2CPriority priority, I2CJobFn fn, void *ctx, uint8_t opaqueAddr = 0);
+
+    /// @brief Bật/tắt một job (ví dụ khi tắt đếm bước)
+    void setJobEnabled(int8_t job, bool enabled);
+
+    /// @brief Chạy các job và giao dịch đã đến hạn - gọi trong loop()
+    void service();
+
+    /// @brief Mức sử dụng bus trong cửa sổ 1 giây gần nhất (0-100%)
+    float getUtilization() const;
+
+    /// @brief Lấy thống kê của một job
+    I2CJobStats getJobStats(int8_t job) const;
+
+    /// @brief In thống kê bus và các job qua Serial
+    void printStats() const;
+
+    /// @brief Bộ đo thời gian bus theo thiết bị và vết giao dịch
+    I2CProfiler &profiler();
+
+    /// @brief Đăng ký hàm cấu hình lại một cảm biến sau khi khôi phục bus
+    /// @param name Tên cảm biến (để log)
+    /// @param fn Hàm ghi lại cấu hình đã lưu
+    /// @param ctx Ngữ cảnh truyền cho fn
+    /// @return false nếu bảng đầy
+    bool addRecoveryHandler(const char *name, I2CRecoveryFn fn, void *ctx);
+
+    /// @brief Driver báo thiết bị ngừng phản hồi (ví dụ FIFO không có mẫu mới)
+    /// Bus được khôi phục ở lần service() kế tiếp.
+    void reportFailure(uint8_t addr);
+
+    /// @brief Khôi phục bus ngay: giải phóng SDA bằng xung SCL, khởi tạo lại
+    /// Wire và cấu hình lại các cảm biến
+    /// @return true nếu bus rảnh (SDA, SCL cao) sau khôi phục
+    bool recover();
+
+    /// @brief Số lần đã khôi phục bus
+    uint32_t getRecoveryCount() const;
+
+private:
+    /// @brief Cộng thời gian bận vào cửa sổ đo mức sử dụng
+    void accountBusy(uint32_t busyUs);
+
+    /// @brief Thực thi một giao dịch một lần
+    bool execute(const I2CTransaction &t);
+
+    /// @brief Cập nhật bộ đếm lỗi liên tiếp sau một giao dịch đồng bộ
+    void noteResult(bool ok);
+
+    /// @brief Cần khôi phục bus chưa (lỗi liên tiếp hoặc driver báo lỗi)
+    bool needsRecovery() const;
+
+    /// @brief Tạo xung SCL đến khi thiết bị nhả SDA, rồi tạo điều kiện STOP
+    /// @return true nếu cả SDA và SCL đều cao sau khi giải phóng
+    bool clockOutBus();
+
+    static const uint8_t MAX_JOBS = 4;               ///< Số job định kỳ tối đa
+    static const uint8_t MAX_PENDING = 8;            ///< Số giao dịch một lần chờ tối đa
+    static const uint32_t UTIL_WINDOW_US = 1000000;  ///< Cửa sổ đo mức sử dụng (µs)
+    static const uint8_t MAX_RECOVERY_HANDLERS = 4;  ///< Số cảm biến cấu hình lại tối đa
+    static const uint16_t TIMEOUT_MS = 10;           ///< Timeout một giao dịch Wire (mặc định 50 ms)
+    static const uint8_t FAIL_THRESHOLD = 3;         ///< Số lỗi liên tiếp coi là bus treo
+    static const uint32_t RECOVERY_BACKOFF_MS = 100; ///< Khoảng cách tối thiểu giữa hai lần khôi phục
+    static const uint32_t MAX_BACKOFF_MS = 5000;     ///< Khoảng cách tối đa khi cảm biến vẫn không phản hồi
+
+    struct Job
+    {
+        const char *name;
+        uint32_t periodMs;
+        uint32_t deadlineMs;
+        I2CPriority priority;
+        I2CJobFn fn;
+        void *ctx;
+        uint8_t opaqueAddr;
+        uint32_t lastRunMs;
+        bool enabled;
+        I2CJobStats stats;
+    };
+
+    struct RecoveryHandler
+    {
+        const char *name;
+        I2CRecoveryFn fn;
+        void *ctx;
+    };
+
+    TwoWire *wire_;            ///< Bus I2C được quản lý
+    int sda_, scl_;            ///< Chân SDA/SCL (dùng khi khôi phục)
+    uint32_t clockHz_;         ///< Tốc độ bus
+    AsyncI2CPort *asyncPort_;  ///< Cổng bất đồng bộ (có thể nullptr)
+    uint32_t asyncBusyMarkUs_; ///< totalBusyUs() của cổng ở lần chốt cửa sổ trước
+    I2CProfiler profiler_;     ///< Thống kê theo thiết bị và vết giao dịch
+
+    Job jobs_[MAX_JOBS]; ///< Bảng job định kỳ
+    uint8_t jobCount_;   ///< Số job đã đăng ký
+
+    I2CTransaction pending_[MAX_PENDING]; ///< Giao dịch một lần đang chờ
+    uint8_t pendingCount_;                ///< Số giao dịch đang chờ
+
+    uint32_t windowStartUs_; ///< Thời điểm bắt đầu cửa sổ đo hiện tại
+    uint32_t windowBusyUs_;  ///< Thời gian bận trong cửa sổ hiện tại
+    float utilization_;      ///< Mức sử dụng của cửa sổ vừa kết thúc (%)
+    bool inJob_;             ///< Đang chạy job
+    uint32_t jobBusyUs_;     ///< Thời gian bus của các giao dịch bọc trong job hiện tại
+
+    RecoveryHandler handlers_[MAX_RECOVERY_HANDLERS]; ///< Hàm cấu hình lại cảm biến
+    uint8_t handlerCount_;                            ///< Số hàm đã đăng ký
+    uint8_t consecutiveFailures_;                     ///< Giao dịch đồng bộ lỗi liên tiếp
+    bool failureReported_;                            ///< Driver đã báo thiết bị ngừng phản hồi
+    bool recovering_;                                 ///< Đang khôi phục (chặn đệ quy từ handler)
+    uint32_t recoveryCount_;                          ///< Số lần khôi phục
+    uint32_t lastRecoveryMs_;                         ///< Thời điểm khôi phục gần nhất
+    uint32_t backoffMs_;                              ///< Khoảng chờ hiện tại trước lần khôi phục kế tiếp
+};
@@ -0,0 +1,214 @@
+/**
+ * @file i2c_profiler.cpp
+ * @brief Triển khai đo thời gian bus I2C và ghi vết giao dịch
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#include "i2c_profiler.h"
+
+static constexpr uint8_t TRACE_FLAG_WRITE = 0x01; ///< Giao dịch ghi
+static constexpr uint8_t TRACE_FLAG_ERROR = 0x02; ///< Giao dịch lỗi
+
+/**
+ * @brief Constructor - thống kê rỗng, vết tắt
+ */
+I2CProfiler::I2CProfiler()
+    : deviceCount_(0), untracked_(0), traceEnabled_(false)
+{
+    portMUX_TYPE init = portMUX_INITIALIZER_UNLOCKED;
+    mux_ = init;
+    reset();
+}
+
+/**
+ * @brief Ghi nhận một giao dịch vào thống kê và (nếu bật) vào vết
+ */
+void I2CProfiler::record(uint8_t addr, uint8_t reg, uint8_t len, bool write,
+                         uint32_t startUs, uint32_t durationUs, bool ok)
+{
+    portENTER_CRITICAL(&mux_);
+
+    int8_t slot = slotFor(addr);
+    if (slot >= 0)
+    {
+        I2CDeviceStats &d = devices_[slot];
+        d.transactions++;
+        if (!ok)
+            d.errors++;
+        d.bytes += len;
+        d.totalUs += durationUs;
+        if (durationUs > d.maxUs)
+            d.maxUs = durationUs;
+        d.histogram[bucketFor(durationUs)]++;
+    }
+    else
+    {
+        untracked_++;
+    }
+
+    if (traceEnabled_)
+    {
+        I2CTraceEntry e;
+        e.startUs = startUs;
+        e.durationUs = (durationUs > 0xFFFF) ? 0xFFFF : (uint16_t)durationUs;
+        e.addr = addr;
+        e.reg = reg;
+        e.len = len;
+        e.flags = (write ? TRACE_FLAG_WRITE : 0) | (ok ? 0 : TRACE_FLAG_ERROR);
+        trace_.push(e);
+    }
+
+    portEXIT_CRITICAL(&mux_);
+}
+
+void I2CProfiler::setTraceEnabled(bool enabled)
+{
+    traceEnabled_ = enabled;
+}
+
+bool I2CProfiler::isTraceEnabled() const { return traceEnabled_; }
+
+bool I2CProfiler::getDeviceStats(uint8_t addr, I2CDeviceStats &out) const
+{
+    for (uint8_t i = 0; i < deviceCount_; i++)
+    {
+        if (devices_[i].addr == addr)
+        {
+            portENTER_CRITICAL(&mux_);
+            out = devices_[i];
+            portEXIT_CRITICAL(&mux_);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Sao chép vết mới nhất vừa với bộ đệm, theo thứ tự thời gian
+ *
+ * Thuộc tính BLE tối đa 512 byte nên bộ đệm nhỏ hơn toàn bộ vết sẽ chỉ
+ * nhận các bản ghi mới nhất.
+ */
+size_t I2CProfiler::copyTrace(uint8_t *buf, size_t maxLen) const
+{
+    portENTER_CRITICAL(&mux_);
+
+    uint32_t count = maxLen / sizeof(I2CTraceEntry);
+    if (count > trace_.size())
+        count = trace_.size();
+
+    RingSpan<I2CTraceEntry> spans[2];
+    uint8_t n = trace_.spans(spans, trace_.size() - count);
+    size_t offset = 0;
+    for (uint8_t i = 0; i < n; i++)
+    {
+        size_t bytes = spans[i].count * sizeof(I2CTraceEntry);
+        memcpy(buf + offset, spans[i].data, bytes);
+        offset += bytes;
+    }
+
+    portEXIT_CRITICAL(&mux_);
+    return offset;
+}
+
+/**
+ * @brief In thống kê theo thiết bị
+ *
+ * Mỗi thiết bị: số giao dịch, lỗi, byte, % thời gian bus, trung bình/lớn nhất
+ * và histogram. Giao dịch có reg = I2C_REG_OPAQUE là cả một lượt của thư
+ * viện driver (ví dụ xả FIFO MAX30105), nên thời gian của nó gồm nhiều giao dịch.
+ */
+void I2CProfiler::printReport(uint32_t elapsedMs) const
+{
+    Serial.println("[I2C] Per-device profile (hist: <64/<128/<256/<512/<1k/<2k/<4k/>=4k us)");
+    for (uint8_t i = 0; i < deviceCount_; i++)
+    {
+        I2CDeviceStats d;
+        if (!getDeviceStats(devices_[i].addr, d))
+            continue;
+
+        float busPct = elapsedMs ? (float)d.totalUs / (10.0f * (float)elapsedMs) : 0.0f;
+        uint32_t avgUs = d.transactions ? d.totalUs / d.transactions : 0;
+        Serial.printf("[I2C]   0x%02X: tx=%lu, err=%lu, bytes=%lu, bus=%.2f%%, avg=%luus, max=%luus\n",
+                      d.addr, (unsigned long)d.transactions, (unsigned long)d.errors,
+                      (unsigned long)d.bytes, busPct, (unsigned long)avgUs, (unsigned long)d.maxUs);
+        Serial.printf("[I2C]         hist=%lu/%lu/%lu/%lu/%lu/%lu/%lu/%lu\n",
+                      (unsigned long)d.histogram[0], (unsigned long)d.histogram[1],
+                      (unsigned long)d.histogram[2], (unsigned long)d.histogram[3],
+                      (unsigned long)d.histogram[4], (unsigned long)d.histogram[5],
+                      (unsigned long)d.histogram[6], (unsigned long)d.histogram[7]);
+    }
+    if (untracked_ > 0)
+    {
+        Serial.printf("[I2C]   untracked: %lu\n", (unsigned long)untracked_);
+    }
+}
+
+/**
+ * @brief In vết giao dịch qua Serial
+ */
+void I2CProfiler::dumpTrace() const
+{
+    uint8_t buf[TRACE_SIZE * sizeof(I2CTraceEntry)];
+    size_t n = copyTrace(buf, sizeof(buf)) / sizeof(I2CTraceEntry);
+
+    Serial.printf("[I2C] Trace: %u entries\n", (unsigned)n);
+    for (size_t i = 0; i < n; i++)
+    {
+        I2CTraceEntry e;
+        memcpy(&e, buf + i * sizeof(I2CTraceEntry), sizeof(e));
+        Serial.printf("[I2C]   t=%lu 0x%02X %c reg=0x%02X len=%u %uus%s\n",
+                      (unsigned long)e.startUs, e.addr, (e.flags & TRACE_FLAG_WRITE) ? 'W' : 'R',
+                      e.reg, e.len, e.durationUs, (e.flags & TRACE_FLAG_ERROR) ? " ERR" : "");
+    }
+}
+
+/**
+ * @brief Xóa thống kê và vết; danh sách địa chỉ thiết bị được giữ lại
+ */
+void I2CProfiler::reset()
+{
+    portENTER_CRITICAL(&mux_);
+    for (uint8_t i = 0; i < MAX_DEVICES; i++)
+    {
+        uint8_t addr = (i < deviceCount_) ? devices_[i].addr : 0;
+        memset(&devices_[i], 0, sizeof(I2CDeviceStats));
+        devices_[i].addr = addr;
+    }
+    untracked_ = 0;
+    trace_.clear();
+    portEXIT_CRITICAL(&mux_);
+}
+
+/**
+ * @brief Tìm chỗ của thiết bị, cấp chỗ mới nếu chưa có (gọi trong critical section)
+ */
+int8_t I2CProfiler::slotFor(uint8_t addr)
+{
+    for (uint8_t i = 0; i < deviceCount_; i++)
+    {
+        if (devices_[i].addr == addr)
+            return i;
+    }
+    if (deviceCount_ >= MAX_DEVICES)
+        return -1;
+
+    devices_[deviceCount_].addr = addr;
+    return (int8_t)deviceCount_++;
+}
+
+/**
+ * @brief Ô histogram: 0 cho < 64 µs, tăng gấp đôi mỗi ô, ô cuối cho ≥ 4096 µs
+ */
+uint8_t I2CProfiler::bucketFor(uint32_t durationUs)
+{
+    uint8_t b = 0;
+    uint32_t limit = 64;
+    while (b < I2C_HIST_BUCKETS - 1 && durationUs >= limit)
+    {
+        limit <<= 1;
+        b++;
+    }
+    return b;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file i2c_profiler.h
+ * @brief Đo thời gian bus I2C theo từng thiết bị và ghi vết giao dịch
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - Ghi nhận mọi giao dịch: địa chỉ, thanh ghi, số byte, thời gian, kết quả
+ * - Thống kê theo thiết bị: số giao dịch, lỗi, byte, tổng/lớn nhất thời gian
+ *   và histogram thời gian giao dịch (thang log2)
+ * - Vết giao dịch xoay vòng (tùy chọn) để in qua Serial hoặc đọc qua BLE
+ *
+ * Số liệu dùng để chọn tốc độ bus và chu kỳ xả FIFO.
+ * record() an toàn khi gọi từ task I2C và loop() cùng lúc (critical section).
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "ring_buffer.h"
+
+/// @brief Thanh ghi giả cho giao dịch do thư viện driver tự gọi Wire (không rõ thanh ghi)
+static constexpr uint8_t I2C_REG_OPAQUE = 0xFF;
+
+/// @brief Số ô histogram thời gian giao dịch
+static constexpr uint8_t I2C_HIST_BUCKETS = 8;
+
+/**
+ * @struct I2CTraceEntry
+ * @brief Một bản ghi trong vết giao dịch (10 byte, little-endian khi gửi BLE)
+ */
+struct __attribute__((packed)) I2CTraceEntry
+{
+    uint32_t startUs;    ///< Thời điểm bắt đầu (micros)
+    uint16_t durationUs; ///< Thời gian giao dịch (µs, bão hòa 65535)
+    uint8_t addr;        ///< Địa chỉ I2C 7-bit
+    uint8_t reg;         ///< Thanh ghi bắt đầu (I2C_REG_OPAQUE nếu không rõ)
+    uint8_t len;         ///< Số byte dữ liệu
+    uint8_t flags;       ///< bit0 = ghi, bit1 = lỗi
+};
+
+/**
+ * @struct I2CDeviceStats
+ * @brief Thống kê giao dịch của một thiết bị
+ */
+struct I2CDeviceStats
+{
+    uint8_t addr;                         ///< Địa chỉ I2C 7-bit
+    uint32_t transactions;                ///< Số giao dịch
+    uint32_t errors;                      ///< Số giao dịch lỗi (NACK, timeout)
+    uint32_t bytes;                       ///< Tổng số byte dữ liệu
+    uint32_t totalUs;                     ///< Tổng thời gian chiếm bus (µs)
+    uint32_t maxUs;                       ///< Giao dịch dài nhất (µs)
+    uint32_t histogram[I2C_HIST_BUCKETS]; ///< Số giao dịch theo thời gian: <64, <128, ..., <4096, ≥4096 µs
+};
+
+/**
+ * @class I2CProfiler
+ * @brief Thu thập thống kê và vết giao dịch I2C
+ */
+class I2CProfiler
+{
+public:
+    static const uint8_t MAX_DEVICES = 4; ///< Số thiết bị theo dõi tối đa
+    static const uint8_t TRACE_SIZE = 64; ///< Số bản ghi vết (lũy thừa của 2)
+
+    /// @brief Constructor
+    I2CProfiler();
+
+    /// @brief Ghi nhận một giao dịch
+    /// @param addr Địa chỉ thiết bị
+    /// @param reg Thanh ghi (I2C_REG_OPAQUE nếu không rõ)
+    /// @param len Số byte dữ liệu
+    /// @param write true = ghi
+    /// @param startUs Thời điểm bắt đầu (micros)
+    /// @param durationUs Thời gian giao dịch (µs)
+    /// @param ok true nếu thành công
+    void record(uint8_t addr, uint8_t reg, uint8_t len, bool write,
+                uint32_t startUs, uint32_t durationUs, bool ok);
+
+    /// @brief Bật/tắt ghi vết (thống kê luôn được thu thập)
+    void setTraceEnabled(bool enabled);
+
+    /// @brief Ghi vết có đang bật không
+    bool isTraceEnabled() const;
+
+    /// @brief Lấy thống kê của một thiết bị
+    /// @return false nếu thiết bị chưa có giao dịch nào
+    bool getDeviceStats(uint8_t addr, I2CDeviceStats &out) const;
+
+    /// @brief Sao chép các bản ghi vết mới nhất (cũ → mới) vào bộ đệm
+    /// @param buf Bộ đệm đích
+    /// @param maxLen Dung lượng bộ đệm (byte)
+    /// @return Số byte đã ghi (bội số của sizeof(I2CTraceEntry))
+    size_t copyTrace(uint8_t *buf, size_t maxLen) const;
+
+    /// @brief In thống kê theo thiết bị qua Serial
+    /// @param elapsedMs Khoảng thời gian từ lần reset thống kê (để tính % bus)
+    void printReport(uint32_t elapsedMs) const;
+
+    /// @brief In vết giao dịch qua Serial (cũ → mới)
+    void dumpTrace() const;
+
+    /// @brief Xóa thống kê (giữ danh sách thiết bị) và vết
+    void reset();
+
+private:
+    /// @brief Tìm hoặc cấp chỗ cho thiết bị; -1 nếu bảng đầy
+    int8_t slotFor(uint8_t addr);
+
+    /// @brief Chỉ số ô histogram cho một thời gian giao dịch
+    static uint8_t bucketFor(uint32_t durationUs);
+
+    I2CDeviceStats devices_[MAX_DEVICES]; ///< Thống kê theo thiết bị
+    uint8_t deviceCount_;                 ///< Số thiết bị đã thấy
+    uint32_t untracked_;                  ///< Giao dịch bị bỏ do bảng thiết bị đầy
+
+    RingBuffer<I2CTraceEntry, TRACE_SIZE> trace_; ///< Vết xoay vòng
+    bool traceEnabled_;                           ///< Cờ ghi vết
+
+    mutable portMUX_TYPE mux_; ///< Bảo vệ khi task I2C và loop() cùng ghi
+};
@@ -0,0 +1,83 @@
+/**
+ * @file i2c_transfer.h
+ * @brief Giao dịch I2C bất đồng bộ và giao diện cổng (không phụ thuộc Arduino)
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Tách riêng để driver cảm biến và bus giả trên host dùng chung các kiểu
+ * này; WireAsyncPort (i2c_async.h) là triển khai AsyncI2CPort trên ESP32,
+ * mock trên host triển khai cùng giao diện.
+ */
+
+#pragma once
+#include <stdint.h>
+
+/**
+ * @enum I2CTransferState
+ * @brief Trạng thái của một giao dịch bất đồng bộ
+ */
+enum I2CTransferState
+{
+    I2C_XFER_IDLE = 0,    ///< Chưa bắt đầu / đã xử lý xong kết quả
+    I2C_XFER_PENDING = 1, ///< Đang chờ hoặc đang truyền trên bus
+    I2C_XFER_DONE = 2,    ///< Hoàn tất thành công
+    I2C_XFER_ERROR = 3    ///< Lỗi (NACK, timeout)
+};
+
+struct I2CTransfer;
+
+/// @brief Callback hoàn tất (chạy trong ngữ cảnh của task I2C, không phải loop())
+typedef void (*I2CTransferCallback)(I2CTransfer &xfer);
+
+/**
+ * @struct I2CTransfer
+ * @brief Giao dịch bất đồng bộ - bộ nhớ do người gọi sở hữu, sống đến khi hoàn tất
+ */
+struct I2CTransfer
+{
+    uint8_t addr;                 ///< Địa chỉ I2C 7-bit
+    uint8_t reg;                  ///< Thanh ghi bắt đầu
+    uint8_t *data;                ///< Bộ đệm dữ liệu
+    uint8_t len;                  ///< Số byte
+    bool write;                   ///< true = ghi, false = đọc
+    I2CTransferCallback done;     ///< Callback hoàn tất (có thể nullptr)
+    void *ctx;                    ///< Ngữ cảnh cho callback
+    volatile uint8_t state;       ///< I2CTransferState
+    volatile uint32_t durationUs; ///< Thời gian chiếm bus (µs)
+
+    /// @brief Giao dịch đã kết thúc (thành công hoặc lỗi) chưa
+    bool finished() const { return state == I2C_XFER_DONE || state == I2C_XFER_ERROR; }
+
+    /// @brief Giao dịch thành công
+    bool ok() const { return state == I2C_XFER_DONE; }
+
+    /// @brief Đang chờ hoặc đang truyền
+    bool busy() const { return state == I2C_XFER_PENDING; }
+};
+
+/**
+ * @class AsyncI2CPort
+ * @brief Giao diện cổng I2C bất đồng bộ
+ */
+class AsyncI2CPort
+{
+public:
+    virtual ~AsyncI2CPort() {}
+
+    /// @brief Bắt đầu một giao dịch; trả về ngay
+    /// @param xfer Giao dịch (phải còn sống đến khi finished())
+    /// @return false nếu không nhận được (hàng đợi đầy, giao dịch đang bận)
+    virtual bool start(I2CTransfer &xfer) = 0;
+
+    /// @brief Tổng thời gian bus bận (µs, tăng đơn điệu, cho phép tràn số)
+    virtual uint32_t totalBusyUs() const = 0;
+
+    /// @brief Không còn giao dịch chờ hoặc đang truyền (an toàn để khởi tạo lại bus)
+    virtual bool idle() const = 0;
+
+    /// @brief Số giao dịch lỗi liên tiếp gần nhất (về 0 khi có giao dịch thành công)
+    virtual uint32_t consecutiveErrors() const = 0;
+
+    /// @brief Xóa bộ đếm lỗi liên tiếp (sau khi khôi phục bus)
+    virtual void clearErrors() = 0;
+};
@@ -10,33 +10,67 @@
  * - Phân tích ML liên tục với dữ liệu HR/SpO2 mới nhất
  * - Theo dõi và gửi mức pin
  * - Đếm bước chân liên tục
+ * - Ước lượng cadence, quãng đường và năng lượng tiêu hao trên thiết bị
+ * - Tổng hợp HR/SpO2/bước theo phút và giờ, gửi khi ứng dụng yêu cầu
+ * - Đồng bộ batch có số thứ tự: giữ mẫu đến khi ứng dụng ack, gửi tiếp sau khi kết nối lại
  */
 
 #include "board_config.h"
 #include "max30102_manager.h"
 #include "ml_model.h"
-#include <Wire.h>
+#include "i2c_bus_manager.h"
 #include "mpu6050_manager.h"
 #include "ble_service_manager.h"
 #include "power_manager.h"
 #include "data_buffer.h"
+#include "flash_log.h"
+#include "batch_codec.h"
+#include "spsc_queue.h"
+#include "activity_estimator.h"
 #include <time.h>
 
 // === Global Objects ===
+I2CBusManager i2cBus;
+WireAsyncPort i2cAsync;
 Max30102Manager max30102Manager;
 MLModel mlModel;
 MPU6050Manager mpuManager;
 BLEServiceManager bleManager;
 PowerManager powerManager;
 DataBuffer dataBuffer;
+HistoryReader historyReader(dataBuffer.history()); // Vị trí gửi bù lịch sử
+HistoryReader historySent(dataBuffer.history());   // Vị trí sau khung gửi bù đang chờ gửi hết
+FlashLog flashLog;
+ActivityEstimator activityEstimator;
 
 // === Timing variables ===
 static unsigned long lastHrReadMs = 0;
 static unsigned long lastBatteryReadMs = 0;
+static unsigned long lastBusStatsMs = 0;
+static unsigned long lastHistorySendMs = 0;
+static int8_t mpuJob = -1; // Job đọc MPU6050 trên bus I2C
 static bool mlInitialized = false;
-static bool max30102Ready = false; // Cờ kiểm tra MAX30102 đã khởi tạo chưa
-static bool isSending = false;     // Cờ đang gửi dữ liệu - tránh gửi lặp
-static int lastDayProcessed = -1;  // Lưu ngày đã xử lý để reset steps
+static bool max30102Ready = false;  // Cờ kiểm tra MAX30102 đã khởi tạo chưa
+static bool isSending = false;      // Cờ đang gửi dữ liệu - tránh gửi lặp
+static bool wasConnected = false;   // Trạng thái kết nối ở lần kiểm tra lịch sử trước
+static bool syncConnected = false;  // Trạng thái kết nối ở lần xử lý đồng bộ trước
+static bool historyBacklog = false; // Đang gửi bù lịch sử sau khi kết nối lại
+static bool historyQueued = false;  // Khung gửi bù đang nằm trong hàng đợi notification
+static uint32_t historyTicket = 0;  // Ticket của khung gửi bù đang chờ
+static int lastDayProcessed = -1;   // Lưu ngày đã xử lý để reset steps
+static uint32_t lastStepCount = 0;  // Số bước đã chuyển cho ActivityEstimator
+
+/**
+ * @brief Mẫu chuyển từ ngữ cảnh thu thập sang ngữ cảnh lưu trữ
+ */
+struct QueuedSample
+{
+  HealthDataPacket packet; // Mẫu đã đóng timestamp lúc đo
+  bool batch;              // true = vào buffer batch, false = chỉ ghi lịch sử
+};
+
+// Hàng đợi không khóa: readAndBufferHR() ghi, storeQueuedSamples() đọc
+static SpscQueue<QueuedSample, SAMPLE_QUEUE_SIZE> sampleQueue;
 
 struct AlertData
 {
@@ -71,10 +105,34 @@ void checkNewDay()
     Serial.printf("[System] New day detected: %d -> %d. Resetting steps.\n",
                   lastDayProcessed, timeinfo->tm_mday);
     mpuManager.resetStepCount();
+    activityEstimator.reset();
+    lastStepCount = 0;
     lastDayProcessed = timeinfo->tm_mday;
   }
 }
 
+/**
+ * @brief Chuyển các bước mới từ MPU6050Manager cho ActivityEstimator
+ *
+ * Gọi sau mpuManager.update(). Số bước mới = chênh lệch so với lần trước
+ * (có thể > 1 nếu bộ phát hiện bước đếm theo đợt).
+ */
+void updateActivity()
+{
+  uint32_t now = millis();
+  uint32_t steps = mpuManager.getStepCount();
+
+  if (steps > lastStepCount)
+  {
+    UserProfile &profile = bleManager.getUserProfile();
+    activityEstimator.setBodyMetrics(profile.height_m, profile.bmi);
+    activityEstimator.onSteps(steps - lastStepCount, now);
+  }
+  lastStepCount = steps;
+
+  activityEstimator.update(now);
+}
+
 /**
  * @brief Xử lý ML với dữ liệu HR/SpO2 mới nhất từ buffer
  * @param hr Nhịp tim mới đọc được
@@ -137,18 +195,22 @@ void sendBatchData()
   Serial.println("[Main] ========== SENDING BATCH DATA ==========");
   Serial.printf("[Main] Buffer has %d samples ready to send\n", dataBuffer.getCount());
 
-  // Chuẩn bị buffer để gửi
-  uint8_t binaryBuffer[4096];
-  size_t len = dataBuffer.getBinaryData(binaryBuffer, sizeof(binaryBuffer));
+  // Mã hóa các mẫu chưa gửi thẳng từ buffer vào khung tĩnh (không dùng stack 4 KB)
+  static uint8_t frame[BATCH_FRAME_CAPACITY(SYNC_BATCH_SAMPLES)];
+  uint16_t encoded = 0;
+  // Kèm cadence/quãng đường/năng lượng hiện tại: ứng dụng không cần chế độ Realtime để có số liệu hoạt động
+  ActivityFields activity = activityEstimator.getCompactFields();
+  size_t len = dataBuffer.getEncodedData(frame, sizeof(frame), &encoded, &activity);
 
   if (len > 0)
   {
-    Serial.printf("[Main] Binary data generated: %d bytes\n", len);
-    if (bleManager.notifyHealthDataBatch(binaryBuffer, len))
+    Serial.printf("[Main] Encoded frame generated: %d bytes\n", len);
+    if (bleManager.notifyHealthDataBatch(frame, len))
     {
+      // Notify không được xác nhận: mẫu chỉ được giải phóng khi ứng dụng ack
       Serial.println("[Main] Batch data sent successfully");
-      dataBuffer.clear();
-      Serial.println("[Main] Buffer cleared");
+      dataBuffer.markSent(encoded);
+      Serial.printf("[Main] %d samples awaiting ack\n", dataBuffer.getCount() - dataBuffer.getUnsentCount());
     }
     else
     {
@@ -163,7 +225,191 @@ void sendBatchData()
 }
 
 /**
- * @brief Đọc HR liên tục và lưu vào buffer mỗi giây
+ * @brief Xử lý giao thức đồng bộ batch
+ *
+ * - Ack từ ứng dụng giải phóng các mẫu đã nhận
+ * - Kết nối lại hoặc quá SYNC_ACK_TIMEOUT_MS không có ack: gửi lại từ mẫu
+ *   chưa xác nhận cũ nhất (ứng dụng bỏ các số thứ tự đã có)
+ * - Giá trị đọc của characteristic đồng bộ phản ánh khoảng số thứ tự còn giữ
+ */
+void serviceSync()
+{
+  uint32_t ack;
+  if (bleManager.takeSyncAck(ack))
+  {
+    dataBuffer.acknowledge(ack);
+  }
+
+  bool connected = bleManager.isClientConnected();
+  if (connected && (!syncConnected || dataBuffer.ackTimedOut()))
+  {
+    dataBuffer.rewindUnacked();
+  }
+  syncConnected = connected;
+
+  static uint32_t lastFirstSeq = 0;
+  static uint32_t lastNextSeq = 0;
+  uint32_t firstSeq = dataBuffer.firstSequence();
+  uint32_t nextSeq = dataBuffer.nextSequence();
+  if (firstSeq != lastFirstSeq || nextSeq != lastNextSeq)
+  {
+    bleManager.updateSyncState(dataBuffer.epoch(), firstSeq, nextSeq);
+    lastFirstSeq = firstSeq;
+    lastNextSeq = nextSeq;
+  }
+}
+
+/**
+ * @brief Gửi bù lịch sử tích lũy trong lúc mất kết nối
+ *
+ * Khi đang kết nối, reader bám theo mẫu mới nhất (dữ liệu đã được gửi trực
+ * tiếp hoặc qua batch). Khi mất kết nối, reader đứng yên; lúc kết nối lại,
+ * phần lịch sử từ vị trí đó được gửi thành các khung nén HISTORY_FRAME_BYTES
+ * qua characteristic batch (BLE chia mảnh theo MTU). Sau khi khởi động, reader
+ * đứng ở mẫu cũ nhất nạp lại từ nhật ký flash: không biết phần nào đã tới
+ * điện thoại trước reset nên cả phần đó được gửi lại; mẫu lịch sử mang
+ * timestamp tuyệt đối nên bên nhận gộp được phần trùng.
+ *
+ * Mỗi lần chỉ một khung nằm trong hàng đợi. Reader chỉ tiến khi hàng đợi báo
+ * khung đã gửi hết mảnh; khung bị bỏ sau khi vào hàng đợi (mất kết nối, điện
+ * thoại tắt notify, hết thời gian gửi) thì reader đứng yên và phần đó được
+ * mã hóa, gửi lại.
+ */
+void sendHistoryBacklog()
+{
+  bool connected = bleManager.isClientConnected();
+  if (!connected)
+  {
+    wasConnected = false;
+    return;
+  }
+
+  if (historyQueued)
+  {
+    NotifyFrameStatus status = bleManager.getBatchFrameStatus(historyTicket);
+    if (status == NOTIFY_FRAME_QUEUED)
+      return; // Chờ khung trước gửi hết hoặc bị bỏ
+    historyQueued = false;
+    if (status == NOTIFY_FRAME_DELIVERED)
+      historyReader = historySent;
+  }
+
+  if (!wasConnected)
+  {
+    wasConnected = true;
+    historyBacklog = historyReader.pending() > 0;
+    bleManager.setBulkTransfer(historyBacklog);
+    if (historyBacklog)
+    {
+      Serial.printf("[Main] History backlog: %u samples (%u lost)\n",
+                    (unsigned)historyReader.pending(), (unsigned)historyReader.lost());
+    }
+  }
+
+  if (!historyBacklog)
+  {
+    historyReader.seekEnd();
+    return;
+  }
+
+  if (millis() - lastHistorySendMs < HISTORY_SEND_INTERVAL_MS)
+    return;
+  lastHistorySendMs = millis();
+
+  // Chỉ mã hóa khung mới khi hàng đợi notification có chỗ cho cả khung
+  if (!bleManager.canQueueBatch(HISTORY_FRAME_BYTES))
+    return;
+
+  static uint8_t frame[HISTORY_FRAME_BYTES]; // Khung lớn: BLE chia mảnh theo MTU
+  BatchEncoder encoder;
+  encoder.begin(frame, sizeof(frame));
+
+  HistoryReader probe = historyReader;
+  HealthDataPacket sample;
+  while (true)
+  {
+    HistoryReader before = probe;
+    if (!probe.next(sample))
+      break;
+    if (!encoder.add(sample))
+    {
+      probe = before; // Mẫu không vừa khung: để dành cho khung sau
+      break;
+    }
+  }
+
+  size_t len = encoder.finish();
+  if (len == 0)
+  {
+    if (!bleManager.isNotifyQueueEmpty())
+      return; // Chờ các khung cuối rời hàng đợi rồi mới trả tham số kết nối
+    historyBacklog = false;
+    bleManager.setBulkTransfer(false);
+    const BleTransferStats &stats = bleManager.getTransferStats();
+    const BleLinkParams &link = bleManager.getLinkParams();
+    Serial.printf("[Main] History backlog sent (MTU %u, PHY %s, PDU %u B, %u B/s, %u congestion waits)\n",
+                  (unsigned)stats.mtu, link.txPhy == ESP_BLE_GAP_PHY_2M ? "2M" : "1M", (unsigned)link.txOctets,
+                  (unsigned)stats.bytesPerSec, (unsigned)stats.congestionWaits);
+    return;
+  }
+
+  if (bleManager.notifyHealthDataBatch(frame, len, &historyTicket))
+  {
+    historySent = probe;
+    historyQueued = true;
+  }
+}
+
+/**
+ * @brief Gửi khung tổng hợp phút/giờ khi ứng dụng yêu cầu
+ */
+void sendRollups()
+{
+  RollupLevel level;
+  if (!bleManager.canQueueBatch(ROLLUP_FRAME_BYTES))
+    return; // Giữ yêu cầu đến khi hàng đợi notification có chỗ
+  if (!bleManager.takeRollupRequest(level))
+    return;
+
+  static uint8_t frame[ROLLUP_FRAME_BYTES];
+  size_t len = dataBuffer.getRollups(level, frame, sizeof(frame));
+  if (len == 0)
+  {
+    // Chưa có dữ liệu: gửi header rỗng để ứng dụng không phải chờ
+    rollupPutHeader(frame, level, 0, 0);
+    len = ROLLUP_HEADER_SIZE;
+  }
+  bleManager.notifyRollups(frame, len);
+}
+
+/**
+ * @brief Job I2C: xả FIFO MAX30102 và cập nhật HR/SpO2
+ */
+void max30102Job(void *)
+{
+  max30102Manager.readSensorData();
+
+  // Thư viện MAX30105 nuốt lỗi I2C: bus treo chỉ thấy qua việc FIFO không có mẫu mới
+  if (max30102Manager.msSinceLastSample() > MAX30102_STALL_TIMEOUT_MS)
+  {
+    i2cBus.reportFailure(MAX30105_ADDRESS);
+  }
+}
+
+/**
+ * @brief Job I2C: đọc gia tốc MPU6050, đếm bước và cập nhật hoạt động
+ */
+void mpu6050Job(void *)
+{
+  mpuManager.setStepDetectorMode(bleManager.getStepDetectorMode());
+  mpuManager.update();
+  updateActivity();
+}
+
+/**
+ * @brief Lưu HR vào buffer mỗi HR_SAMPLE_INTERVAL_MS
+ *
+ * Việc đọc cảm biến do job I2C đảm nhiệm (xem max30102Job).
  */
 void readAndBufferHR()
 {
@@ -171,9 +417,6 @@ void readAndBufferHR()
   if (!max30102Ready)
     return;
 
-  // Đọc dữ liệu từ cảm biến liên tục (mỗi vòng loop)
-  max30102Manager.readSensorData();
-
   // Chỉ lưu vào buffer mỗi 1 giây
   if (millis() - lastHrReadMs < HR_SAMPLE_INTERVAL_MS)
     return;
@@ -182,11 +425,7 @@ void readAndBufferHR()
   if (max30102Manager.hasValidData())
   {
     Max30102Data data = max30102Manager.getCurrentData();
-
-    // Thêm vào buffer
-    // bool bufferFull = dataBuffer.addSample(data.hr, data.spo2);
-    // Tạm thời disable buffer để gửi realtime
-    bool bufferFull = false;
+    activityEstimator.setHeartRate(data.hr);
 
     // Chạy ML với dữ liệu mới nhất (đồng bộ với việc đọc HR)
     // Chỉ chạy nếu được enable qua BLE
@@ -197,25 +436,44 @@ void readAndBufferHR()
 
     // Xử lý gửi dữ liệu dựa trên chế độ
     DataTransmissionMode mode = bleManager.getDataTransmissionMode();
+    uint32_t steps = mpuManager.getStepCount();
+
+    // Đóng timestamp ngay lúc đo rồi chuyển sang ngữ cảnh lưu trữ qua hàng đợi
+    // Realtime: chỉ ghi lịch sử; Batch: lưu vào buffer, KHÔNG gửi ngay
+    QueuedSample queued;
+    queued.packet = dataBuffer.makeSample(data.hr, data.spo2, steps);
+    queued.batch = (mode == MODE_BATCH);
+    if (!sampleQueue.push(queued))
+    {
+      Serial.println("[Main] Sample queue full - sample dropped");
+    }
+
+    if (mode == MODE_REALTIME && bleManager.isClientConnected())
+    {
+      // Chế độ Realtime: Gửi ngay lập tức
+      bleManager.notifyHealthData(data.hr, data.spo2, steps);
+    }
+  }
+}
 
-    if (mode == MODE_REALTIME)
+/**
+ * @brief Chuyển các mẫu trong hàng đợi vào DataBuffer (bên đọc duy nhất)
+ */
+void storeQueuedSamples()
+{
+  // Cấu hình deadband có thể đổi qua BLE
+  dataBuffer.setDeadband(bleManager.getDeadbandConfig());
+
+  QueuedSample queued;
+  while (sampleQueue.pop(queued))
+  {
+    if (!queued.batch)
     {
-      // Chế độ Realtime: Gửi ngay lập tức, KHÔNG lưu buffer
-      if (bleManager.isClientConnected())
-      {
-        uint32_t steps = mpuManager.getStepCount();
-        bleManager.notifyHealthData(data.hr, data.spo2, steps);
-      }
+      dataBuffer.recordHistory(queued.packet);
     }
-    else // MODE_BATCH
+    else if (dataBuffer.addSample(queued.packet))
     {
-      // Chế độ Batch: Lưu vào buffer, KHÔNG gửi ngay
-      uint32_t currentSteps = mpuManager.getStepCount();
-      bool bufferFull = dataBuffer.addSample(data.hr, data.spo2, currentSteps);
-      if (bufferFull)
-      {
-        Serial.println("[Main] Buffer full - ready to send batch");
-      }
+      Serial.println("[Main] Buffer full - ready to send batch");
     }
   }
 }
@@ -250,21 +508,62 @@ void setup()
   // Khởi tạo BLE
   bleManager.begin("Last Dance");
 
-  // ESP32-C3: Tất cả dùng chung Wire
-  Wire.begin(I2C_SDA_MAX30102, I2C_SCL_MAX30102);
+  // ESP32-C3: Tất cả dùng chung một bus I2C (Fast-mode 400 kHz)
+  i2cBus.begin(I2C_SDA_MAX30102, I2C_SCL_MAX30102, I2C_BUS_CLOCK_HZ);
 
-  if (!mpuManager.begin(Wire, 0x68))
+  // Đọc gia tốc bất đồng bộ qua task I2C; lỗi thì bus manager tự đọc đồng bộ
+#if I2C_TRACE_ENABLED
+  i2cBus.profiler().setTraceEnabled(true);
+#endif
+  if (i2cAsync.begin(i2cBus.wire(), &i2cBus.profiler()))
+  {
+    i2cBus.setAsyncPort(&i2cAsync);
+  }
+
+  if (!mpuManager.begin(i2cBus, 0x68))
   {
     Serial.println("[MPU6050] Init failed");
   }
 
-  // MAX30102 cũng dùng Wire (không phải Wire1)
-  max30102Ready = max30102Manager.beginOnWire(Wire);
+  // MAX30102 dùng thư viện SparkFun nên nhận Wire từ bus manager
+  max30102Ready = max30102Manager.beginOnWire(i2cBus.wire());
   if (!max30102Ready)
   {
     Serial.println("[Main] WARNING: MAX30102 not available - HR readings disabled");
   }
 
+  // Lập lịch đọc cảm biến trên bus chung
+  // MAX30102: FIFO 32 mẫu ở 400 Hz → tràn sau 80 ms
+  if (max30102Ready)
+  {
+    i2cBus.addJob("MAX30102", MAX30102_DRAIN_PERIOD_MS, MAX30102_FIFO_DEADLINE_MS,
+                  I2C_PRIO_HIGH, max30102Job, nullptr, MAX30105_ADDRESS);
+  }
+  // Khôi phục bus treo: cấu hình lại từng cảm biến mà không cần khởi động lại
+  i2cBus.addRecoveryHandler("MPU6050", MPU6050Manager::recoveryHandler, &mpuManager);
+  if (max30102Ready)
+  {
+    i2cBus.addRecoveryHandler("MAX30102", Max30102Manager::recoveryHandler, &max30102Manager);
+  }
+
+  // MPU6050: đọc thanh ghi mẫu mới nhất ở ~100 Hz
+  mpuJob = i2cBus.addJob("MPU6050", MPU6050_SAMPLE_PERIOD_MS, MPU6050_SAMPLE_DEADLINE_MS,
+                         I2C_PRIO_NORMAL, mpu6050Job, nullptr);
+
+  // Nhật ký flash: khôi phục vị trí ghi sau reset/mất điện, nạp lại lịch sử
+  // để phần đã ghi được gửi bù ở lần kết nối đầu tiên
+  if (flashLog.begin())
+  {
+    uint32_t restored = dataBuffer.restoreHistory(flashLog);
+    dataBuffer.attachFlashLog(&flashLog);
+    historyReader.rewind();
+    Serial.printf("[Main] Flash log: %u samples restored to history\n", (unsigned)restored);
+  }
+  else
+  {
+    Serial.println("[Main] WARNING: flash log unavailable - history kept in RAM only");
+  }
+
   // Reset buffer timer
   dataBuffer.resetSendTimer();
 
@@ -275,28 +574,58 @@ void setup()
 
 void loop()
 {
-  // 1. Đọc HR mỗi 1 giây và lưu vào buffer
-  readAndBufferHR();
+  // 1. Chạy các giao dịch I2C đã đến hạn (xả FIFO MAX30102, đọc MPU6050)
+  //    Job đếm bước chỉ chạy nếu được bật
+  i2cBus.setJobEnabled(mpuJob, bleManager.isStepCountEnabled());
+  i2cBus.service();
 
-  // 2. Cập nhật step counter nếu được bật
-  if (bleManager.isStepCountEnabled())
-  {
-    mpuManager.update();
-  }
+  // 2. Lưu HR vào buffer mỗi 0.5 giây (thu thập → hàng đợi → DataBuffer)
+  readAndBufferHR();
+  storeQueuedSamples();
 
   // 2.5 Kiểm tra ngày mới để reset bước chân
   checkNewDay();
 
-  // 3. Gửi batch data khi đủ điều kiện
+  // 3. Gửi batch data khi đủ điều kiện (sau khi xử lý ack/gửi lại)
   // Chỉ gửi nếu đang ở chế độ Batch
+  serviceSync();
   if (bleManager.getDataTransmissionMode() == MODE_BATCH)
   {
     sendBatchData();
   }
 
+  // 3.5 Gửi bù lịch sử sau khi kết nối lại
+  sendHistoryBacklog();
+
+  // 3.6 Trả lời yêu cầu tổng hợp phút/giờ
+  sendRollups();
+
+  // 3.7 Đẩy notification đang chờ theo nhịp của stack BLE
+  bleManager.service();
+
   // 4. Cập nhật mức pin
   updateBattery();
 
+  // 4.5 Xóa trước sector flash kế tiếp (ngoài đường ghi mẫu)
+  flashLog.service();
+
+  // 5. In thống kê bus I2C
+  if (millis() - lastBusStatsMs >= I2C_STATS_INTERVAL_MS)
+  {
+    uint32_t elapsedMs = millis() - lastBusStatsMs;
+    lastBusStatsMs = millis();
+    i2cBus.printStats();
+    i2cBus.profiler().printReport(elapsedMs);
+#if I2C_TRACE_ENABLED
+    i2cBus.profiler().dumpTrace();
+    static uint8_t traceBuf[48 * sizeof(I2CTraceEntry)]; // Vừa giới hạn 512 byte của thuộc tính BLE
+    size_t traceLen = i2cBus.profiler().copyTrace(traceBuf, sizeof(traceBuf));
+    bleManager.updateI2CTrace(traceBuf, traceLen);
+#endif
+    i2cBus.profiler().reset();
+    flashLog.printStats();
+  }
+
   // Feed watchdog để tránh timeout
   yield();
 
@@ -6,6 +6,9 @@
 #include "max30102_manager.h"
 #include <Arduino.h>
 
+// Chặn DC cho PPG: fc = 0.5 Hz ở 400 Hz (giữ được nhịp tim từ ~30 BPM)
+static constexpr double PPG_DC_ALPHA = dsp::designDcBlocker(0.5, 400.0);
+
 /**
  * @brief Constructor - khởi tạo các biến thành viên
  *
@@ -15,8 +18,11 @@
  * - currentSPO2 = 98.0: giá trị mặc định
  * - sensorStatus = 1: ban đầu là lỗi (chưa khởi tạo)
  */
-Max30102Manager::Max30102Manager()
-    : rateSpot(0), lastBeat(0), currentHR(0.0), currentSPO2(98.0), sensorStatus(1)
+Max30102Manager::Max30102Manager(hal::Clock &clock, hal::Logger &log)
+    : clock_(clock), log_(log), wirePort(nullptr), lastSampleMs(0),
+      rateSpot(0), lastBeat(0), currentHR(0.0), currentSPO2(98.0), sensorStatus(1),
+      irAcFilter(PPG_DC_ALPHA), redAcFilter(PPG_DC_ALPHA),
+      irAcBlock(0), redAcBlock(0), acBlockCount(0), ppgPrimed(false)
 {
     // Khởi tạo bộ đệm nhịp tim với giá trị 0
     for (byte i = 0; i < RATE_SIZE; i++)
@@ -37,13 +43,27 @@ bool Max30102Manager::beginOnWire(TwoWire &wire)
     // Không cần khởi tạo Wire1 riêng - dùng Wire đã có sẵn
     if (!particleSensor.begin(wire, I2C_SPEED_FAST))
     {
-        Serial.println("[MAX30102] ERROR: Sensor not found!");
+        log_.println("[MAX30102] ERROR: Sensor not found!");
         sensorStatus = 1;
         return false; // Không treo thiết bị, trả về false
     }
 
-    Serial.println("[MAX30102] Initialized on shared Wire bus.");
+    log_.println("[MAX30102] Initialized on shared Wire bus.");
+
+    wirePort = &wire;
+    configure();
+    lastSampleMs = clock_.millis();
+
+    clock_.delayMs(50); // Giảm delay
+    log_.println("[MAX30102] Ready (Fast mode: 400Hz, no averaging).");
+    return true;
+}
 
+/**
+ * @brief Cấu hình cảm biến cho chế độ đọc nhanh và xóa FIFO
+ */
+void Max30102Manager::configure()
+{
     // Cấu hình cảm biến cho chế độ đọc NHANH
     // ledBrightness: 0x3F (tăng lên để bù pulse width ngắn)
     // sampleAverage: 1 (không average - đọc nhanh nhất)
@@ -60,12 +80,38 @@ bool Max30102Manager::beginOnWire(TwoWire &wire)
 
     // Xóa FIFO để bắt đầu sạch
     particleSensor.clearFIFO();
+}
+
+/**
+ * @brief Khởi tạo lại cảm biến sau khi bus được khôi phục
+ *
+ * Cảm biến có thể đã mất nguồn nên ghi lại toàn bộ cấu hình; bộ lọc PPG
+ * được khởi tạo lại từ mẫu đầu tiên sau khôi phục.
+ */
+bool Max30102Manager::reinit()
+{
+    if (!wirePort || !particleSensor.begin(*wirePort, I2C_SPEED_FAST))
+    {
+        sensorStatus = 1;
+        return false;
+    }
 
-    delay(50); // Giảm delay
-    Serial.println("[MAX30102] Ready (Fast mode: 400Hz, no averaging).");
+    configure();
+    ppgPrimed = false;
+    lastSampleMs = clock_.millis();
     return true;
 }
 
+bool Max30102Manager::recoveryHandler(void *ctx)
+{
+    return static_cast<Max30102Manager *>(ctx)->reinit();
+}
+
+uint32_t Max30102Manager::msSinceLastSample() const
+{
+    return clock_.millis() - lastSampleMs;
+}
+
 /**
  * @brief Đọc dữ liệu từ cảm biến MAX30102 và cập nhật nhịp tim, SpO2
  *
@@ -74,14 +120,22 @@ bool Max30102Manager::beginOnWire(TwoWire &wire)
  * 2. Kiểm tra xem ngón tay có trên cảm biến không (IR > 50000)
  * 3. Phát hiện nhịp tim từ tín hiệu IR
  * 4. Tính toán nhịp tim trung bình từ 4 lần phát hiện gần đây
- * 5. Ước tính SpO2 dựa trên nhịp tim
+ * 5. Ước tính SpO2 từ tỉ lệ của tỉ lệ R = (AC_red/DC_red) / (AC_ir/DC_ir)
+ *    - AC: bộ chặn DC (dsp::DcBlocker), biên độ = tổng |AC| trên cửa sổ 2.56 s
+ *      (≥ 1.5 nhịp từ ~35 BPM, nên biên độ không dao động theo pha nhịp)
+ *    - DC: giá trị thô (thành phần DC chiếm ~99% tín hiệu)
+ *    Tỉ lệ thô Red/IR trước đây chủ yếu phản ánh dòng LED và mô da (phần DC),
+ *    không phải độ bão hòa; R chuẩn hóa mỗi kênh theo DC của chính nó.
  *
  * Ghi chú: Công thức SpO2 là ước tính đơn giản, không phải đo chính xác
  */
 void Max30102Manager::readSensorData()
 {
     // Kiểm tra và đọc tất cả samples có sẵn trong FIFO
-    particleSensor.check();
+    if (particleSensor.check() > 0)
+    {
+        lastSampleMs = clock_.millis();
+    }
 
     // Debug: Đếm số samples có sẵn
     static unsigned long lastDebugMs = 0;
@@ -102,23 +156,47 @@ void Max30102Manager::readSensorData()
         {
             sensorStatus = 1;
             lowIrCount++;
+            ppgPrimed = false;
             continue; // Bỏ qua sample này, đọc tiếp
         }
 
         processedCount++;
 
+        // Tách AC của hai kênh và cộng dồn biên độ cho tính SpO2
+        if (!ppgPrimed)
+        {
+            irAcFilter.reset((int32_t)irValue);
+            redAcFilter.reset((int32_t)redValue);
+            irAcAbsSum.reset();
+            redAcAbsSum.reset();
+            irAcBlock = redAcBlock = 0;
+            acBlockCount = 0;
+            ppgPrimed = true;
+        }
+        int32_t irAc = irAcFilter.process((int32_t)irValue);
+        int32_t redAc = redAcFilter.process((int32_t)redValue);
+        irAcBlock += (irAc >= 0) ? irAc : -irAc;
+        redAcBlock += (redAc >= 0) ? redAc : -redAc;
+        if (++acBlockCount == AC_BLOCK)
+        {
+            irAcAbsSum.process(irAcBlock);
+            redAcAbsSum.process(redAcBlock);
+            irAcBlock = redAcBlock = 0;
+            acBlockCount = 0;
+        }
+
         // Phát hiện nhịp tim từ tín hiệu IR
         if (checkForBeat(irValue) == true)
         {
-            Serial.printf("[HR] BEAT! IR=%ld, Red=%ld\n", irValue, redValue);
+            log_.printf("[HR] BEAT! IR=%ld, Red=%ld\n", irValue, redValue);
 
             // Tính toán khoảng thời gian giữa hai nhịp tim
-            long delta = millis() - lastBeat;
-            lastBeat = millis();
+            long delta = clock_.millis() - lastBeat;
+            lastBeat = clock_.millis();
 
             // Chuyển đổi khoảng thời gian thành BPM
             float beatsPerMinute = 60.0 / (delta / 1000.0);
-            Serial.printf("[HR] Delta=%ldms, BPM=%.1f\n", delta, beatsPerMinute);
+            log_.printf("[HR] Delta=%ldms, BPM=%.1f\n", delta, beatsPerMinute);
 
             // Kiểm tra BPM hợp lệ (20-255 BPM)
             if (beatsPerMinute < 255 && beatsPerMinute > 20)
@@ -136,11 +214,14 @@ void Max30102Manager::readSensorData()
 
                 currentHR = (float)beatAvg;
 
-                // Tính SpO2 từ tỉ lệ Red/IR (đơn giản hóa)
-                if (redValue > 0 && irValue > 0)
+                // Tính SpO2 từ tỉ lệ của tỉ lệ AC/DC hai kênh
+                float ratio = 0.0f;
+                if (redValue > 0 && irValue > 0 && irAcAbsSum.full() && irAcAbsSum.sum() > 0)
                 {
-                    float ratio = (float)redValue / (float)irValue;
-                    // SpO2 ước tính: 110 - 25 * ratio (công thức đơn giản)
+                    float redPerfusion = (float)redAcAbsSum.sum() / (float)redValue;
+                    float irPerfusion = (float)irAcAbsSum.sum() / (float)irValue;
+                    ratio = redPerfusion / irPerfusion;
+                    // SpO2 ước tính: 110 - 25 * R (công thức đơn giản)
                     currentSPO2 = 110.0 - 25.0 * ratio;
                     if (currentSPO2 > 100)
                         currentSPO2 = 100;
@@ -149,27 +230,27 @@ void Max30102Manager::readSensorData()
                 }
 
                 sensorStatus = 0;
-                Serial.printf("[HR] *** VALID: HR=%d, SpO2=%.0f%%, Ratio=%.2f ***\n",
-                              beatAvg, currentSPO2, (float)redValue / (float)irValue);
+                log_.printf("[HR] *** VALID: HR=%d, SpO2=%.0f%%, Ratio=%.2f ***\n",
+                            beatAvg, currentSPO2, ratio);
             }
             else
             {
-                Serial.printf("[HR] BPM out of range: %.1f\n", beatsPerMinute);
+                log_.printf("[HR] BPM out of range: %.1f\n", beatsPerMinute);
             }
         }
     }
 
     // In debug mỗi 2 giây
-    if (millis() - lastDebugMs > 2000)
+    if (clock_.millis() - lastDebugMs > 2000)
     {
-        Serial.printf("[HR-DBG] Total: %d, Processed: %d, LowIR: %d, Status: %s, HR=%.0f\n",
-                      sampleCount, processedCount, lowIrCount,
-                      sensorStatus == 0 ? "OK" : "NO_FINGER",
-                      currentHR);
+        log_.printf("[HR-DBG] Total: %d, Processed: %d, LowIR: %d, Status: %s, HR=%.0f\n",
+                    sampleCount, processedCount, lowIrCount,
+                    sensorStatus == 0 ? "OK" : "NO_FINGER",
+                    currentHR);
         sampleCount = 0;
         processedCount = 0;
         lowIrCount = 0;
-        lastDebugMs = millis();
+        lastDebugMs = clock_.millis();
     }
 }
 
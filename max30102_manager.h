@@ -16,6 +16,9 @@
 #include "MAX30105.h"
 #include "heartRate.h"
 #include "board_config.h"
+#include "dsp_filters.h"
+#include "health_data_packet.h"
+#include "hal.h"
 
 /**
  * @struct Max30102Data
@@ -27,15 +30,6 @@ struct Max30102Data
     float spo2; ///< Độ bão hòa oxy tính bằng % (Oxygen Saturation)
 };
 
-/**
- * @struct UserProfile
- * @brief Cấu trúc lưu trữ hồ sơ người dùng để tính toán calo và BMI
- */
-struct UserProfile
-{
-    float bmi = 25.003625;
-};
-
 /**
  * @class Max30102Manager
  * @brief Quản lý cảm biến MAX30102 để đọc dữ liệu nhịp tim và SpO2
@@ -50,13 +44,29 @@ class Max30102Manager
 {
 public:
     /// @brief Constructor khởi tạo các biến với giá trị mặc định
-    Max30102Manager();
+    /// @param clock Đồng hồ (thời điểm nhịp tim, phát hiện FIFO dừng)
+    /// @param log Đầu ra log
+    explicit Max30102Manager(hal::Clock &clock = hal::defaultClock(),
+                             hal::Logger &log = hal::defaultLogger());
 
     /// @brief Khởi tạo cảm biến MAX30102 trên Wire có sẵn (cho ESP32-C3)
     /// @param wire Tham chiếu đến đối tượng TwoWire đã khởi tạo
     /// @return true nếu khởi tạo thành công, false nếu không tìm thấy cảm biến
     bool beginOnWire(TwoWire &wire);
 
+    /// @brief Ghi lại cấu hình cảm biến sau khi bus I2C được khôi phục
+    /// @return true nếu cảm biến phản hồi
+    bool reinit();
+
+    /// @brief Hàm khôi phục đăng ký với I2CBusManager::addRecoveryHandler
+    /// @param ctx Con trỏ Max30102Manager
+    static bool recoveryHandler(void *ctx);
+
+    /// @brief Thời gian (ms) từ lần cuối FIFO có mẫu mới
+    /// Ở 400 Hz FIFO luôn có mẫu (kể cả khi không đặt ngón tay), nên giá trị
+    /// lớn nghĩa là cảm biến hoặc bus ngừng phản hồi.
+    uint32_t msSinceLastSample() const;
+
     /// @brief Đọc dữ liệu từ cảm biến và cập nhật nhịp tim, SpO2
     /// Phải được gọi trong vòng lặp chính để theo dõi liên tục
     void readSensorData();
@@ -74,7 +84,14 @@ public:
     UserProfile &getUserProfile();
 
 private:
+    /// @brief Cấu hình LED, tần số lấy mẫu, độ rộng xung và xóa FIFO
+    void configure();
+
+    hal::Clock &clock_;      ///< Đồng hồ
+    hal::Logger &log_;       ///< Đầu ra log
     MAX30105 particleSensor; ///< Đối tượng cảm biến MAX30102
+    TwoWire *wirePort;       ///< Bus I2C đã dùng khi khởi tạo (để khởi tạo lại)
+    uint32_t lastSampleMs;   ///< Thời điểm FIFO có mẫu mới gần nhất
 
     static const byte RATE_SIZE = 4; ///< Kích thước bộ đệm để lưu các đợt nhịp tim gần đây
     byte rates[RATE_SIZE];           ///< Mảng lưu các giá trị BPM gần đây
@@ -86,4 +103,19 @@ private:
     volatile uint8_t sensorStatus; ///< Trạng thái cảm biến (0 = hợp lệ, 1 = lỗi)
 
     UserProfile currentUser; ///< Hồ sơ người dùng (giới tính, cân nặng, v.v.)
+
+    // Cửa sổ biên độ AC phải phủ ≥ 1.5 nhịp ở nhịp tim thấp nhất (~35 BPM):
+    // 128 khối × 8 mẫu = 1024 mẫu = 2.56 s ở 400 Hz. Cộng |AC| theo khối 8 mẫu
+    // trước khi đưa vào tổng trượt để vòng đệm chỉ tốn 512 byte mỗi kênh.
+    static const uint8_t AC_BLOCK = 8;   ///< Số mẫu 400 Hz mỗi khối
+    static const size_t AC_WINDOW = 128; ///< Số khối trong cửa sổ biên độ AC (2.56 s)
+
+    dsp::DcBlocker<int32_t> irAcFilter;             ///< Tách thành phần AC của kênh IR
+    dsp::DcBlocker<int32_t> redAcFilter;            ///< Tách thành phần AC của kênh Red
+    int32_t irAcBlock;                              ///< Tổng |AC| kênh IR của khối đang gom
+    int32_t redAcBlock;                             ///< Tổng |AC| kênh Red của khối đang gom
+    uint8_t acBlockCount;                           ///< Số mẫu trong khối đang gom
+    dsp::MovingSum<int32_t, AC_WINDOW> irAcAbsSum;  ///< Tổng |AC| kênh IR trên cửa sổ
+    dsp::MovingSum<int32_t, AC_WINDOW> redAcAbsSum; ///< Tổng |AC| kênh Red trên cửa sổ
+    bool ppgPrimed;                                 ///< Bộ lọc PPG đã khởi tạo từ mẫu đầu tiên chưa
 };
@@ -13,37 +13,74 @@ static constexpr uint8_t REG_CONFIG = 0x1A;       ///< Cấu hình DLPF (Digital
 static constexpr uint8_t REG_ACCEL_CONFIG = 0x1C; ///< Cấu hình gia tốc kế (phạm vi)
 static constexpr uint8_t REG_ACCEL_XOUT_H = 0x3B; ///< Byte cao của X acceleration
 
+// Bộ lọc high-pass trên độ lớn gia tốc: fc ≈ 0.49 Hz ở 100 Hz (α ≈ 0.97)
+static constexpr double HP_ALPHA = dsp::designDcBlocker(0.4923, 100.0);
+
 /**
  * @brief Constructor - khởi tạo các biến với giá trị mặc định
  */
-MPU6050Manager::MPU6050Manager()
-    : wire_(nullptr), addr_(0x68), ax_(0), ay_(0), az_(0),
-      mag_g_(0.0f), prevRawMag_(0.0f), hpVal_(0.0f), alphaHP_(0.97f),
+MPU6050Manager::MPU6050Manager(hal::Clock &clock, hal::Logger &log)
+    : clock_(clock), log_(log), bus_(nullptr), addr_(0x68),
+      accelXfer_(), ax_(0), ay_(0), az_(0), accelValid_(false),
+      mag_g_(0.0f), hpFilter_(HP_ALPHA), hpVal_(0.0f), prevHp_(0.0f), rising_(false),
+      detectorMode_(STEP_DETECTOR_MAGNITUDE), detectMicrosSum_(0), detectSamples_(0),
       stepCount_(0), lastStepMs_(0), minStepIntervalMs_(600), stepThreshold_(0.55f) {}
 
 /**
  * @brief Khởi tạo MPU6050 trên bus I2C được chỉ định
  *
  * Quá trình khởi tạo:
- * 1. Bật cảm biến (thoát chế độ sleep)
- * 2. Cấu hình bộ lọc low-pass số (DLPF) để ~44 Hz
- * 3. Đặt phạm vi gia tốc kế ±2g
- * 4. Đặt tần suất lấy mẫu 100 Hz
- * 5. Đọc lần đầu để khởi tạo bộ lọc high-pass
+ * 1. Ghi cấu hình (applyConfig): thoát sleep, DLPF ~44 Hz, ±2g, 100 Hz
+ * 2. Chờ cảm biến ổn định
+ * 3. Đọc lần đầu để khởi tạo bộ lọc high-pass
  *
- * @param wire Tham chiếu đến bus I2C
+ * @param bus Bus I2C dùng chung
  * @param address Địa chỉ I2C của MPU6050 (mặc định 0x68)
  * @return true nếu khởi tạo thành công
  */
-bool MPU6050Manager::begin(TwoWire &wire, uint8_t address)
+bool MPU6050Manager::begin(hal::RegisterBus &bus, uint8_t address)
 {
-    wire_ = &wire;
+    bus_ = &bus;
     addr_ = address;
 
+    if (!applyConfig())
+        return false;
+    clock_.delayMs(50); // Chờ cảm biến ổn định sau khi thoát sleep
+
+    // Đọc lần đầu để khởi tạo bộ lọc high-pass
+    accelValid_ = readAccel();
+    float m = sqrtf((float)ax_ * ax_ + (float)ay_ * ay_ + (float)az_ * az_);
+    hpFilter_.reset(m / 16384.0f); // Chuyển đổi từ thô sang g
+    hpVal_ = 0.0f;
+
+    // Mô tả giao dịch đọc gia tốc dùng lại ở mỗi update()
+    accelXfer_.addr = addr_;
+    accelXfer_.reg = REG_ACCEL_XOUT_H;
+    accelXfer_.data = accelBuf_;
+    accelXfer_.len = sizeof(accelBuf_);
+    accelXfer_.write = false;
+    accelXfer_.done = nullptr;
+    accelXfer_.ctx = nullptr;
+    accelXfer_.state = I2C_XFER_IDLE;
+
+    return true;
+}
+
+/**
+ * @brief Ghi cấu hình vào MPU6050
+ *
+ * 1. Bật cảm biến (thoát chế độ sleep)
+ * 2. Cấu hình bộ lọc low-pass số (DLPF) để ~44 Hz
+ * 3. Đặt phạm vi gia tốc kế ±2g
+ * 4. Đặt tần suất lấy mẫu 100 Hz
+ *
+ * Giao tiếp I2C hoạt động ngay cả khi đang sleep nên không cần chờ giữa các lệnh.
+ */
+bool MPU6050Manager::applyConfig()
+{
     // Bật cảm biến (thoát chế độ sleep bằng cách ghi 0 vào PWR_MGMT_1)
     if (!writeReg(REG_PWR_MGMT_1, 0x00))
         return false;
-    delay(50);
 
     // Cấu hình DLPF: CONFIG=3 → tần số cắt ~44 Hz
     if (!writeReg(REG_CONFIG, 0x03))
@@ -54,73 +91,141 @@ bool MPU6050Manager::begin(TwoWire &wire, uint8_t address)
         return false;
 
     // Tần suất lấy mẫu: SMPLRT_DIV=9 → 1000/(1+9) = 100 Hz
-    if (!writeReg(REG_SMPLRT_DIV, 9))
-        return false;
-
-    // Đọc lần đầu để khởi tạo bộ lọc high-pass
-    readAccel();
-    float m = sqrtf((float)ax_ * ax_ + (float)ay_ * ay_ + (float)az_ * az_);
-    prevRawMag_ = m / 16384.0f; // Chuyển đổi từ thô sang g
-    hpVal_ = 0.0f;
+    return writeReg(REG_SMPLRT_DIV, 9);
+}
 
-    return true;
+/**
+ * @brief Cấu hình lại sau khi bus được khôi phục
+ *
+ * Không chờ 50 ms như begin(): mẫu đầu có thể chưa ổn định nhưng bộ lọc
+ * high-pass và ngưỡng bước bỏ qua được, còn việc đếm bước tiếp tục ngay.
+ */
+bool MPU6050Manager::recoveryHandler(void *ctx)
+{
+    MPU6050Manager *self = static_cast<MPU6050Manager *>(ctx);
+    self->accelValid_ = false;
+    return self->applyConfig();
 }
 
+bool MPU6050Manager::hasValidAccel() const { return accelValid_; }
+
 /**
  * @brief Cập nhật trạng thái cảm biến và phát hiện bước chân
  *
- * Quá trình:
- * 1. Đọc gia tốc 3 chiều từ MPU6050
- * 2. Tính độ lớn gia tốc (magnitude)
- * 3. Áp dụng bộ lọc high-pass để loại bỏ trọng lực
- * 4. Phát hiện bước khi:
- *    - High-pass filtered magnitude > ngưỡng
- *    - Khoảng thời gian từ bước trước > minStepIntervalMs (để tránh nhiễu)
- * 5. Tăng bộ đếm bước
+ * Đọc gia tốc không chặn loop():
+ * 1. Nếu lần đọc trước đã xong: giải mã và xử lý mẫu đó
+ * 2. Bắt đầu lần đọc tiếp theo; task I2C truyền dữ liệu trong lúc loop()
+ *    xử lý việc khác (DSP nhịp tim, BLE)
+ * Mẫu được xử lý trễ một chu kỳ (10 ms), không ảnh hưởng việc đếm bước.
+ * Lần đọc lỗi bị bỏ qua thay vì xử lý lại mẫu cũ và đánh dấu mẫu không hợp lệ;
+ * bus manager đếm lỗi liên tiếp để khôi phục bus.
  *
  * Gọi hàm này với tần suất 50-100 Hz để có độ chính xác tốt.
  */
 void MPU6050Manager::update()
 {
-    if (!wire_)
+    if (!bus_)
         return;
 
-    // Đọc gia tốc thô từ cảm biến
-    readAccel();
+    if (accelXfer_.finished())
+    {
+        bool ok = accelXfer_.ok();
+        accelXfer_.state = I2C_XFER_IDLE;
+        accelValid_ = ok;
+        if (ok)
+        {
+            decodeAccel(accelBuf_);
+            processSample();
+        }
+    }
+
+    if (!accelXfer_.busy())
+    {
+        bus_->startTransfer(accelXfer_);
+    }
+}
+
+/**
+ * @brief Xử lý một mẫu gia tốc
+ *
+ * Quá trình:
+ * 1. Tính độ lớn gia tốc (magnitude)
+ * 2. Chạy bộ phát hiện bước đang chọn:
+ *    - STEP_DETECTOR_MAGNITUDE: đỉnh trên độ lớn đã lọc high-pass
+ *    - STEP_DETECTOR_AXIS: đỉnh trên tín hiệu chiếu lên trục chuyển động chính
+ *    - STEP_DETECTOR_AUTOCORR: số bước theo đợt khi có chu kỳ ổn định
+ * 3. Tăng bộ đếm bước
+ * 4. Cộng dồn thời gian xử lý để đo chi phí mỗi mẫu
+ */
+void MPU6050Manager::processSample()
+{
+    uint32_t startUs = clock_.micros();
+    uint32_t now = clock_.millis();
 
     // Tính độ lớn gia tốc: |a| = sqrt(ax^2 + ay^2 + az^2)
     float m = sqrtf((float)ax_ * ax_ + (float)ay_ * ay_ + (float)az_ * az_);
     mag_g_ = m / 16384.0f; // Chuyển đổi từ thô sang g
 
+    uint32_t steps = 0;
+    if (detectorMode_ == STEP_DETECTOR_AXIS)
+    {
+        steps = axisDetector_.process(ax_ / 16384.0f, ay_ / 16384.0f, az_ / 16384.0f, now) ? 1 : 0;
+    }
+    else if (detectorMode_ == STEP_DETECTOR_AUTOCORR)
+    {
+        steps = acCounter_.process(mag_g_);
+    }
+    else
+    {
+        steps = detectStepMagnitude(now) ? 1 : 0;
+    }
+
+    if (steps > 0)
+    {
+        stepCount_ += steps;
+        lastStepMs_ = now;
+    }
+
+    detectMicrosSum_ += clock_.micros() - startUs;
+    detectSamples_++;
+}
+
+/**
+ * @brief Phát hiện bước trên độ lớn gia tốc đã lọc high-pass
+ *
+ * Phát hiện đỉnh khi:
+ * - High-pass filtered magnitude > ngưỡng
+ * - Khoảng thời gian từ bước trước > minStepIntervalMs (để tránh nhiễu)
+ *
+ * @param now Thời điểm hiện tại (ms)
+ * @return true nếu phát hiện bước
+ */
+bool MPU6050Manager::detectStepMagnitude(uint32_t now)
+{
     // Lọc high-pass để loại bỏ trọng lực (phần tử DC)
-    float hp = highPass(mag_g_);
+    float hp = hpFilter_.process(mag_g_);
     hpVal_ = hp;
 
-    // Phát hiện đỉnh (peak) - bất kỳ khi nào HP magnitude vượt ngưỡng
-    // và đủ thời gian đã trôi qua kể từ bước cuối cùng (tránh nhiễu)
-    static float prevHp = 0;
-    static bool rising = false;
-
-    uint32_t now = millis();
+    bool step = false;
 
     // Phát hiện sườn lên
-    if (hp > prevHp && hp > 0)
+    if (hp > prevHp_ && hp > 0)
     {
-        rising = true;
+        rising_ = true;
     }
 
     // Phát hiện đỉnh thật sự (peak)
-    if (rising && hp < prevHp)
+    if (rising_ && hp < prevHp_)
     {
-        if (prevHp > stepThreshold_ && (now - lastStepMs_) > minStepIntervalMs_)
+        if (prevHp_ > stepThreshold_ && (now - lastStepMs_) > minStepIntervalMs_)
         {
-            stepCount_++;
-            lastStepMs_ = now;
+            step = true;
         }
-        rising = false;
+        rising_ = false;
     }
 
-    prevHp = hp;
+    prevHp_ = hp;
+    return step;
 }
 
 /**
@@ -145,23 +250,61 @@ void MPU6050Manager::resetStepCount()
 float MPU6050Manager::getAccelMagnitudeG() const { return mag_g_; }
 
 /**
- * @brief Ghi một byte vào thanh ghi I2C của MPU6050
+ * @brief Chọn thuật toán phát hiện bước
+ *
+ * Reset trạng thái của bộ phát hiện mới và bộ đo chi phí để số liệu
+ * getAvgDetectMicros() chỉ phản ánh thuật toán đang chạy.
+ *
+ * @param mode Thuật toán phát hiện bước
+ */
+void MPU6050Manager::setStepDetectorMode(StepDetectorMode mode)
+{
+    if (mode == detectorMode_)
+        return;
+
+    detectorMode_ = mode;
+    axisDetector_.reset();
+    acCounter_.reset();
+    hpFilter_.reset(mag_g_); // Bộ lọc chỉ chạy ở MAGNITUDE: bỏ trạng thái cũ từ lần dùng trước
+    hpVal_ = 0.0f;
+    prevHp_ = 0.0f;
+    rising_ = false;
+    detectMicrosSum_ = 0;
+    detectSamples_ = 0;
+
+    const char *name = (mode == STEP_DETECTOR_AXIS)       ? "AXIS"
+                       : (mode == STEP_DETECTOR_AUTOCORR) ? "AUTOCORR"
+                                                          : "MAGNITUDE";
+    log_.printf("[MPU6050] Step detector: %s\n", name);
+}
+
+StepDetectorMode MPU6050Manager::getStepDetectorMode() const { return detectorMode_; }
+
+/**
+ * @brief Thời gian xử lý trung bình mỗi mẫu (µs) của bộ phát hiện bước
+ */
+float MPU6050Manager::getAvgDetectMicros() const
+{
+    if (detectSamples_ == 0)
+        return 0.0f;
+    return (float)detectMicrosSum_ / (float)detectSamples_;
+}
+
+/**
+ * @brief Ghi một byte vào thanh ghi I2C của MPU6050 (qua bus dùng chung)
  * @param reg Số thanh ghi
  * @param val Giá trị cần ghi
  * @return true nếu thành công
  */
 bool MPU6050Manager::writeReg(uint8_t reg, uint8_t val)
 {
-    if (!wire_)
+    if (!bus_)
         return false;
-    wire_->beginTransmission(addr_);
-    wire_->write(reg);
-    wire_->write(val);
-    return (wire_->endTransmission() == 0);
+    return bus_->writeReg(addr_, reg, val);
 }
 
 /**
- * @brief Đọc nhiều byte từ thanh ghi I2C của MPU6050
+ * @brief Đọc nhiều byte từ thanh ghi I2C của MPU6050 (qua bus dùng chung)
  * @param reg Số thanh ghi bắt đầu
  * @param buf Con trỏ đến bộ đệm để lưu dữ liệu
  * @param len Số byte cần đọc
@@ -169,54 +312,36 @@ bool MPU6050Manager::writeReg(uint8_t reg, uint8_t val)
  */
 bool MPU6050Manager::readRegs(uint8_t reg, uint8_t *buf, size_t len)
 {
-    if (!wire_)
+    if (!bus_)
         return false;
-    wire_->beginTransmission(addr_);
-    wire_->write(reg);
-    if (wire_->endTransmission(false) != 0)
-        return false;
-    size_t n = wire_->requestFrom((int)addr_, (int)len);
-    if (n != len)
-        return false;
-    for (size_t i = 0; i < len; ++i)
-    {
-        buf[i] = wire_->read();
-    }
-    return true;
+    return bus_->readRegs(addr_, reg, buf, len);
 }
 
 /**
  * @brief Đọc gia tốc 3 chiều từ MPU6050
  *
- * Lưu vào: ax_, ay_, az_ (dưới dạng thô int16)
+ * Lưu vào: ax_, ay_, az_ (dưới dạng thô int16); giữ nguyên nếu đọc lỗi
+ * @return true nếu đọc thành công
  */
-void MPU6050Manager::readAccel()
+bool MPU6050Manager::readAccel()
 {
     uint8_t buf[6];
     if (!readRegs(REG_ACCEL_XOUT_H, buf, sizeof(buf)))
     {
-        return;
+        return false;
     }
-    // Tập hợp 2 byte (High byte + Low byte) thành int16
-    ax_ = (int16_t)((buf[0] << 8) | buf[1]);
-    ay_ = (int16_t)((buf[2] << 8) | buf[3]);
-    az_ = (int16_t)((buf[4] << 8) | buf[5]);
+    decodeAccel(buf);
+    return true;
 }
 
 /**
- * @brief Áp dụng bộ lọc high-pass one-pole
- *
- * Công thức: y[n] = a * (y[n-1] + x[n] - x[n-1])
- * Tác dụng: Loại bỏ trọng lực DC và các tần số thấp
- *
- * @param x Tín hiệu đầu vào hiện tại
- * @return Tín hiệu đã lọc high-pass
+ * @brief Giải mã gia tốc từ 6 byte thanh ghi (big-endian)
+ * @param buf Dữ liệu thanh ghi 0x3B-0x40
  */
-float MPU6050Manager::highPass(float x)
+void MPU6050Manager::decodeAccel(const uint8_t *buf)
 {
-    // Công thức high-pass one-pole: y[n] = a*(y[n-1] + x[n] - x[n-1])
-    // với alphaHP_ = 0.9 (loại bỏ mạnh tần số thấp)
-    float y = alphaHP_ * (hpVal_ + x - prevRawMag_);
-    prevRawMag_ = x; // Lưu lại giá trị hiện tại cho lần tiếp theo
-    return y;
+    // Tập hợp 2 byte (High byte + Low byte) thành int16
+    ax_ = (int16_t)((buf[0] << 8) | buf[1]);
+    ay_ = (int16_t)((buf[2] << 8) | buf[3]);
+    az_ = (int16_t)((buf[4] << 8) | buf[5]);
 }
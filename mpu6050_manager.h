@@ -10,11 +10,30 @@
  * - Áp dụng bộ lọc high-pass để loại bỏ trọng lực
  * - Phát hiện các bước chân dựa trên ngưỡng
  * - Đếm tổng số bước từ khi khởi động
+ * - Cho phép chọn bộ phát hiện bước (độ lớn 3 trục, chiếu lên trục chính
+ *   hoặc đếm theo chu kỳ bằng tự tương quan)
  */
 
 #pragma once
-#include <Arduino.h>
-#include <Wire.h>
+#include "hal.h"
+#include "i2c_transfer.h"
+#ifdef ARDUINO
+#include "i2c_bus_manager.h"
+#endif
+#include "axis_step_detector.h"
+#include "autocorr_step_counter.h"
+#include "dsp_filters.h"
+
+/**
+ * @enum StepDetectorMode
+ * @brief Thuật toán phát hiện bước
+ */
+enum StepDetectorMode
+{
+    STEP_DETECTOR_MAGNITUDE = 0, ///< Đỉnh trên độ lớn gia tốc đã lọc high-pass (mặc định)
+    STEP_DETECTOR_AXIS = 1,      ///< Đỉnh trên tín hiệu chiếu lên trục chuyển động chính
+    STEP_DETECTOR_AUTOCORR = 2   ///< Đếm theo chu kỳ (tự tương quan), phát bước theo đợt đi bộ
+};
 
 /**
  * @class MPU6050Manager
@@ -31,16 +50,20 @@ class MPU6050Manager
 {
 public:
     /// @brief Constructor - khởi tạo các biến
-    MPU6050Manager();
+    /// @param clock Đồng hồ (millis/micros)
+    /// @param log Đầu ra log
+    explicit MPU6050Manager(hal::Clock &clock = hal::defaultClock(),
+                            hal::Logger &log = hal::defaultLogger());
 
     /// @brief Khởi tạo MPU6050 trên bus I2C được chỉ định
-    /// @param wire Tham chiếu đến đối tượng TwoWire (I2C)
+    /// @param bus Bus I2C dùng chung (đã khởi tạo; bus giả trên host)
     /// @param address Địa chỉ I2C của MPU6050 (mặc định 0x68)
     /// @return true nếu khởi tạo thành công, false nếu không tìm thấy cảm biến
-    bool begin(TwoWire &wire, uint8_t address = 0x68);
+    bool begin(hal::RegisterBus &bus, uint8_t address = 0x68);
 
     /// @brief Cập nhật trạng thái cảm biến, phát hiện và đếm bước
-    /// Gọi hàm này 50-100 lần/giây để có độ chính xác tốt
+    /// Gọi hàm này 50-100 lần/giây để có độ chính xác tốt.
+    /// Đọc gia tốc bất đồng bộ: xử lý mẫu của lần đọc trước rồi bắt đầu lần đọc mới.
     void update();
 
     /// @brief Lấy tổng số bước đã phát hiện
@@ -50,10 +73,32 @@ public:
     /// @brief Reset số bước về 0 (dùng khi qua ngày mới)
     void resetStepCount();
 
+    /// @brief Ghi lại cấu hình cảm biến (sau khi khôi phục bus hoặc mất nguồn)
+    /// @return true nếu cảm biến phản hồi
+    bool applyConfig();
+
+    /// @brief Hàm khôi phục đăng ký với I2CBusManager::addRecoveryHandler
+    /// @param ctx Con trỏ MPU6050Manager
+    static bool recoveryHandler(void *ctx);
+
+    /// @brief Mẫu gia tốc hiện tại có hợp lệ không (false sau lần đọc lỗi)
+    bool hasValidAccel() const;
+
     /// @brief Lấy độ lớn gia tốc hiện tại
     /// @return Độ lớn gia tốc tính bằng g (gravitational acceleration)
     float getAccelMagnitudeG() const;
 
+    /// @brief Chọn thuật toán phát hiện bước
+    /// @param mode Thuật toán (STEP_DETECTOR_MAGNITUDE / _AXIS / _AUTOCORR)
+    void setStepDetectorMode(StepDetectorMode mode);
+
+    /// @brief Lấy thuật toán phát hiện bước hiện tại
+    StepDetectorMode getStepDetectorMode() const;
+
+    /// @brief Thời gian xử lý trung bình mỗi mẫu của bộ phát hiện bước (µs)
+    /// Không tính thời gian đọc I2C. Reset khi đổi thuật toán.
+    float getAvgDetectMicros() const;
+
 private:
     /// @brief Ghi một giá trị vào thanh ghi I2C của MPU6050
     bool writeReg(uint8_t reg, uint8_t val);
@@ -61,22 +106,43 @@ private:
     /// @brief Đọc nhiều byte từ thanh ghi I2C của MPU6050
     bool readRegs(uint8_t reg, uint8_t *buf, size_t len);
 
-    /// @brief Đọc giá trị gia tốc 3 chiều từ MPU6050
-    void readAccel();
+    /// @brief Đọc giá trị gia tốc 3 chiều từ MPU6050 (đồng bộ, dùng khi khởi tạo)
+    /// @return true nếu đọc thành công
+    bool readAccel();
+
+    /// @brief Giải mã 6 byte thanh ghi gia tốc vào ax_, ay_, az_
+    void decodeAccel(const uint8_t *buf);
+
+    /// @brief Tính độ lớn gia tốc và chạy bộ phát hiện bước trên mẫu hiện tại
+    void processSample();
+
+    /// @brief Phát hiện bước trên độ lớn gia tốc đã lọc high-pass
+    /// @param now Thời điểm hiện tại (ms)
+    /// @return true nếu phát hiện bước
+    bool detectStepMagnitude(uint32_t now);
+
+    hal::Clock &clock_;     ///< Đồng hồ
+    hal::Logger &log_;      ///< Đầu ra log
+    hal::RegisterBus *bus_; ///< Con trỏ đến bus I2C dùng chung
+    uint8_t addr_;          ///< Địa chỉ I2C của MPU6050
+
+    I2CTransfer accelXfer_; ///< Giao dịch đọc gia tốc bất đồng bộ
+    uint8_t accelBuf_[6];   ///< Bộ đệm thanh ghi 0x3B-0x40 của giao dịch
 
-    /// @brief Áp dụng bộ lọc high-pass one-pole
-    /// @param x Tín hiệu đầu vào
-    /// @return Tín hiệu đã lọc
-    float highPass(float x);
+    int16_t ax_, ay_, az_;           ///< Giá trị gia tốc 3 chiều (thô)
+    bool accelValid_;                ///< ax_/ay_/az_ đến từ lần đọc thành công gần nhất
+    float mag_g_;                    ///< Độ lớn gia tốc tính bằng g
+    dsp::DcBlocker<float> hpFilter_; ///< Bộ lọc high-pass one-pole loại bỏ trọng lực
+    float hpVal_;                    ///< Giá trị lọc high-pass
+    float prevHp_;                   ///< Giá trị high-pass của mẫu trước (phát hiện đỉnh)
+    bool rising_;                    ///< Đang ở sườn lên của tín hiệu high-pass
 
-    TwoWire *wire_; ///< Con trỏ đến bus I2C
-    uint8_t addr_;  ///< Địa chỉ I2C của MPU6050
 
-    int16_t ax_, ay_, az_; ///< Giá trị gia tốc 3 chiều (thô)
-    float mag_g_;          ///< Độ lớn gia tốc tính bằng g
-    float prevRawMag_;     ///< Độ lớn gia tốc từ lần đọc trước
-    float hpVal_;          ///< Giá trị lọc high-pass
-    float alphaHP_;        ///< Hệ số low-pass (0.9 = loại bỏ tần số thấp mạnh)
+    StepDetectorMode detectorMode_; ///< Thuật toán phát hiện bước đang dùng
+    AxisStepDetector axisDetector_; ///< Bộ phát hiện theo trục chính
+    AutocorrStepCounter acCounter_; ///< Bộ đếm theo chu kỳ
+    uint32_t detectMicrosSum_;      ///< Tổng thời gian xử lý (µs) để đo chi phí
+    uint32_t detectSamples_;        ///< Số mẫu đã đo
 
     uint32_t stepCount_;         ///< Tổng số bước đã phát hiện
     uint32_t lastStepMs_;        ///< Thời điểm (ms) của bước cuối cùng
@@ -0,0 +1,206 @@
+/**
+ * @file notify_pacer.cpp
+ * @brief Triển khai máy trạng thái gửi mảnh notification
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#include "notify_pacer.h"
+#include <string.h>
+
+NotifyPacer::NotifyPacer(NotifyTransport &transport, hal::Clock &clock, hal::Logger &log)
+    : transport_(transport), clock_(clock), log_(log), connected_(false), mtu_(BLE_DEFAULT_MTU), congested_(false),
+      txConfirmed_(0), connGen_(0), txGen_(0), txClass_(NOTIFY_BATCH), txTarget_(BLE_TARGET_HEALTH_DATA), txLen_(0),
+      txOffset_(0), txPayload_(0), txProgressMs_(0), txStalled_(false), txWindowed_(true), txSent_(0),
+      sessionStartMs_(0), sessionBytes_(0)
+{
+    memset(chunkSeq_, 0, sizeof(chunkSeq_));
+    memset(&stats_, 0, sizeof(stats_));
+    stats_.mtu = BLE_DEFAULT_MTU;
+}
+
+void NotifyPacer::onConnect()
+{
+    mtu_ = BLE_DEFAULT_MTU;
+    congested_ = false;
+    sessionBytes_ = 0;
+    connGen_++;
+    connected_ = true;
+}
+
+void NotifyPacer::onDisconnect()
+{
+    connected_ = false;
+    mtu_ = BLE_DEFAULT_MTU;
+    congested_ = false;
+    connGen_++;
+}
+
+void NotifyPacer::onMtuChanged(uint16_t mtu)
+{
+    if (mtu < BLE_DEFAULT_MTU)
+        mtu = BLE_DEFAULT_MTU;
+    mtu_ = mtu;
+    stats_.mtu = mtu;
+}
+
+void NotifyPacer::onCongestion(bool congested)
+{
+    congested_ = congested;
+}
+
+void NotifyPacer::onConfirm()
+{
+    txConfirmed_ = txConfirmed_ + 1;
+}
+
+/**
+ * @brief Đưa khung vào hàng đợi và đẩy mảnh ngay nếu liên kết cho phép
+ *
+ * service() chạy trước để khung còn lại từ kết nối cũ bị bỏ trước khi nhận
+ * khung mới.
+ */
+bool NotifyPacer::enqueue(NotifyClass cls, uint8_t target, const uint8_t *data, size_t len, uint32_t *ticket)
+{
+    service();
+    if (!connected_)
+        return false;
+    if (!queue_.push(cls, target, data, len, ticket))
+        return false;
+    service();
+    return true;
+}
+
+/**
+ * @brief Đẩy mảnh từ hàng đợi notification
+ *
+ * Không chờ: dừng khi stack báo nghẽn, khi đã có BLE_NOTIFY_WINDOW mảnh chưa
+ * được báo gửi xong, hoặc khi transport báo bận; vòng loop() sau tiếp tục.
+ * Khung chưa bắt đầu luôn lấy theo ưu tiên; khung đang gửi dở được gửi hết
+ * trước (điện thoại ghép mảnh theo thứ tự trên cùng characteristic). Khung
+ * không tiến triển trong BLE_CHUNK_TIMEOUT_MS bị bỏ.
+ */
+void NotifyPacer::service()
+{
+    // Kết nối mới hoặc vừa ngắt: khung cũ (kể cả khung gửi dở) không còn ý nghĩa
+    uint8_t gen = connGen_;
+    if (gen != txGen_ || !connected_)
+    {
+        if (gen != txGen_ || !queue_.empty())
+        {
+            queue_.clear();
+            txOffset_ = 0;
+            txSent_ = txConfirmed_;
+            txWindowed_ = true;
+            txGen_ = gen;
+        }
+        if (!connected_)
+            return;
+    }
+
+    uint32_t now = clock_.millis();
+    while (true)
+    {
+        if (queue_.empty())
+        {
+            txProgressMs_ = now;
+            txStalled_ = false;
+            return;
+        }
+
+        if (txOffset_ == 0)
+        {
+            queue_.front(txClass_, txTarget_, txLen_);
+            txPayload_ = mtu_ - BLE_ATT_HEADER_SIZE - BLE_CHUNK_HEADER_SIZE;
+            if (txPayload_ > sizeof(chunkBuf_) - BLE_CHUNK_HEADER_SIZE)
+                txPayload_ = sizeof(chunkBuf_) - BLE_CHUNK_HEADER_SIZE;
+        }
+
+        uint8_t inFlight = txWindowed_ ? (uint8_t)(txSent_ - txConfirmed_) : 0;
+        NotifyTxResult result = NOTIFY_TX_BUSY;
+        if (!congested_ && inFlight >= BLE_NOTIFY_WINDOW && now - txProgressMs_ >= BLE_NOTIFY_CONF_TIMEOUT_MS)
+        {
+            // Stack không báo CONF cho notification: bỏ cửa sổ đến hết kết nối, chỉ dựa vào nghẽn
+            txWindowed_ = false;
+            inFlight = 0;
+            log_.println("[BLE] No CONF events for notifications - pacing on congestion only");
+        }
+        if (!congested_ && inFlight < BLE_NOTIFY_WINDOW)
+            result = sendNextChunk();
+
+        if (result == NOTIFY_TX_OK)
+        {
+            txStalled_ = false;
+            txProgressMs_ = now;
+            continue;
+        }
+
+        if (result == NOTIFY_TX_DISABLED)
+        {
+            finishFrame(false); // Điện thoại chưa bật notify: giữ khung cũng vô ích
+            continue;
+        }
+
+        if (!txStalled_)
+        {
+            stats_.congestionWaits++;
+            txStalled_ = true;
+        }
+        if (now - txProgressMs_ >= BLE_CHUNK_TIMEOUT_MS)
+        {
+            finishFrame(false);
+            txProgressMs_ = now;
+        }
+        return;
+    }
+}
+
+/**
+ * @brief Notify mảnh {số thứ tự, cờ, dữ liệu} kế tiếp của khung đầu hàng đợi
+ */
+NotifyTxResult NotifyPacer::sendNextChunk()
+{
+    uint8_t &chunkSeq = chunkSeq_[txTarget_ == BLE_TARGET_ROLLUP ? BLE_TARGET_ROLLUP : BLE_TARGET_HEALTH_DATA];
+
+    if (txOffset_ == 0 && sessionBytes_ == 0)
+        sessionStartMs_ = clock_.millis();
+
+    uint16_t n = queue_.read(txClass_, txOffset_, chunkBuf_ + BLE_CHUNK_HEADER_SIZE, txPayload_);
+    chunkBuf_[0] = chunkSeq;
+    chunkBuf_[1] = (txOffset_ == 0 ? BLE_CHUNK_FIRST : 0) | (txOffset_ + n == txLen_ ? BLE_CHUNK_LAST : 0);
+
+    NotifyTxResult result = transport_.notifyChunk(txTarget_, chunkBuf_, n + BLE_CHUNK_HEADER_SIZE);
+    if (result != NOTIFY_TX_OK)
+        return result;
+
+    txSent_++;
+    chunkSeq++;
+    txOffset_ += n;
+    stats_.chunks++;
+    if (txOffset_ >= txLen_)
+        finishFrame(true);
+    return result;
+}
+
+/**
+ * @brief Kết thúc khung đầu hàng đợi (đã gửi hết hoặc bị bỏ)
+ */
+void NotifyPacer::finishFrame(bool delivered)
+{
+    queue_.pop(txClass_, delivered);
+    uint16_t sent = txOffset_;
+    txOffset_ = 0;
+
+    if (!delivered)
+    {
+        stats_.failedFrames++;
+        log_.printf("[BLE] Frame aborted at %u/%u bytes\n", (unsigned)sent, (unsigned)txLen_);
+        return;
+    }
+
+    stats_.frames++;
+    stats_.bytes += txLen_;
+    sessionBytes_ += txLen_;
+    uint32_t elapsed = clock_.millis() - sessionStartMs_;
+    stats_.bytesPerSec = (uint32_t)((uint64_t)sessionBytes_ * 1000 / (elapsed ? elapsed : 1));
+}
@@ -0,0 +1,157 @@
+/**
+ * @file notify_pacer.h
+ * @brief Đẩy khung từ NotifyQueue thành các mảnh notification theo nhịp của stack BLE
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - Chia khung đầu hàng đợi thành mảnh {số thứ tự, cờ đầu/cuối, dữ liệu}
+ *   theo MTU lúc bắt đầu khung (định dạng mảnh: ble_service_manager.h)
+ * - Chỉ đẩy khi stack không báo nghẽn và số mảnh chưa được báo gửi xong
+ *   (CONF) dưới BLE_NOTIFY_WINDOW; stack không báo CONF trong
+ *   BLE_NOTIFY_CONF_TIMEOUT_MS thì bỏ cửa sổ đến hết kết nối
+ * - Khung không tiến triển trong BLE_CHUNK_TIMEOUT_MS hoặc điện thoại chưa
+ *   bật notify bị bỏ; kết nối mới/ngắt bỏ mọi khung cũ
+ * - Thống kê thông lượng và số khung bỏ dở
+ *
+ * Không phụ thuộc BLE: mảnh đi qua NotifyTransport (BLEServiceManager trên
+ * thiết bị, đường truyền giả trên host). Sự kiện kết nối, MTU, nghẽn và CONF
+ * đến từ task BLE; service() và enqueue() chỉ gọi từ loop().
+ */
+
+#pragma once
+#include "hal.h"
+#include "board_config.h"
+#include "notify_queue.h"
+
+// === Truyền khung theo mảnh ===
+#define BLE_REQUESTED_MTU 512    ///< MTU đề nghị khi kết nối
+#define BLE_DEFAULT_MTU 23       ///< MTU trước khi thương lượng
+#define BLE_ATT_HEADER_SIZE 3    ///< Opcode + handle của một notification
+#define BLE_CHUNK_HEADER_SIZE 2  ///< Số thứ tự + cờ
+#define BLE_CHUNK_FIRST 0x01     ///< Mảnh đầu của khung
+#define BLE_CHUNK_LAST 0x02      ///< Mảnh cuối của khung
+#define BLE_TARGET_HEALTH_DATA 0 ///< Đích khung: HEALTH_DATA_BATCH_CHAR_UUID
+#define BLE_TARGET_ROLLUP 1      ///< Đích khung: ROLLUP_CHAR_UUID
+#define BLE_TARGET_COUNT 2       ///< Số đích (mỗi đích một bộ đếm số thứ tự mảnh)
+
+/**
+ * @struct BleTransferStats
+ * @brief Thống kê truyền theo mảnh (từ lúc khởi động, thông lượng theo kết nối)
+ */
+struct BleTransferStats
+{
+    uint32_t frames;          ///< Số khung đã gửi trọn
+    uint32_t chunks;          ///< Số mảnh đã gửi
+    uint32_t bytes;           ///< Số byte dữ liệu đã gửi (không kể header mảnh)
+    uint32_t failedFrames;    ///< Số khung bỏ dở (mất kết nối, chưa bật notify, nghẽn quá lâu)
+    uint32_t congestionWaits; ///< Số lần phải dừng chờ stack (nghẽn, cửa sổ đầy)
+    uint32_t bytesPerSec;     ///< Thông lượng của kết nối hiện tại
+    uint16_t mtu;             ///< MTU đã thương lượng
+};
+
+/// @brief Kết quả notify một mảnh
+enum NotifyTxResult : uint8_t
+{
+    NOTIFY_TX_OK = 0,      ///< Stack đã nhận mảnh
+    NOTIFY_TX_BUSY = 1,    ///< Stack tạm thời không nhận (lỗi GATT, hàng đợi đầy): thử lại sau
+    NOTIFY_TX_DISABLED = 2 ///< Điện thoại chưa bật notify hoặc không còn client: bỏ khung
+};
+
+/**
+ * @class NotifyTransport
+ * @brief Đường gửi một mảnh notification đến đích
+ */
+class NotifyTransport
+{
+public:
+    virtual ~NotifyTransport() {}
+
+    /// @brief Notify một mảnh (header mảnh + dữ liệu) lên characteristic của đích
+    /// @param target BLE_TARGET_*
+    /// @param chunk Mảnh
+    /// @param len Độ dài mảnh (<= MTU - BLE_ATT_HEADER_SIZE)
+    virtual NotifyTxResult notifyChunk(uint8_t target, const uint8_t *chunk, uint16_t len) = 0;
+};
+
+/**
+ * @class NotifyPacer
+ * @brief Máy trạng thái gửi mảnh: cửa sổ CONF, nghẽn, hết thời gian, thế hệ kết nối
+ */
+class NotifyPacer
+{
+public:
+    /// @brief Constructor
+    /// @param transport Đường gửi mảnh
+    /// @param clock Đồng hồ (hết thời gian, thông lượng)
+    /// @param log Đầu ra log
+    explicit NotifyPacer(NotifyTransport &transport,
+                         hal::Clock &clock = hal::defaultClock(),
+                         hal::Logger &log = hal::defaultLogger());
+
+    /// @brief Điện thoại kết nối (task BLE): MTU mặc định, phiên thông lượng mới
+    void onConnect();
+
+    /// @brief Điện thoại ngắt kết nối (task BLE)
+    void onDisconnect();
+
+    /// @brief MTU đã thương lượng (task BLE); mảnh của khung kế tiếp dùng kích thước mới
+    void onMtuChanged(uint16_t mtu);
+
+    /// @brief Stack báo nghẽn/hết nghẽn (ESP_GATTS_CONGEST_EVT)
+    void onCongestion(bool congested);
+
+    /// @brief Stack báo đã gửi xong một notification (ESP_GATTS_CONF_EVT)
+    void onConfirm();
+
+    /// @brief Đưa khung vào hàng đợi rồi đẩy mảnh ngay nếu liên kết cho phép
+    /// @return false nếu chưa kết nối hoặc hàng đợi không nhận khung
+    bool enqueue(NotifyClass cls, uint8_t target, const uint8_t *data, size_t len, uint32_t *ticket = nullptr);
+
+    /// @brief Đẩy mảnh đến khi hết khung, stack nghẽn hoặc cửa sổ đầy; gọi từ loop()
+    void service();
+
+    /// @brief Đang có điện thoại kết nối
+    bool connected() const { return connected_; }
+
+    /// @brief MTU hiện tại
+    uint16_t mtu() const { return mtu_; }
+
+    /// @brief Hàng đợi khung (trạng thái ticket, thống kê theo lớp)
+    const NotifyQueue &queue() const { return queue_; }
+
+    /// @brief Thống kê truyền theo mảnh
+    const BleTransferStats &stats() const { return stats_; }
+
+private:
+    /// @brief Notify mảnh kế tiếp của khung đầu hàng đợi
+    NotifyTxResult sendNextChunk();
+
+    /// @brief Kết thúc khung đầu hàng đợi (đã gửi hết hoặc bị bỏ)
+    void finishFrame(bool delivered);
+
+    NotifyTransport &transport_;                                ///< Đường gửi mảnh
+    hal::Clock &clock_;                                         ///< Đồng hồ
+    hal::Logger &log_;                                          ///< Đầu ra log
+    NotifyQueue queue_;                                         ///< Hàng đợi khung notification
+    volatile bool connected_;                                   ///< Có điện thoại kết nối
+    volatile uint16_t mtu_;                                     ///< MTU đã thương lượng
+    volatile bool congested_;                                   ///< Hàng đợi notification của stack đang nghẽn
+    volatile uint8_t txConfirmed_;                              ///< Số CONF đã nhận (chỉ task BLE ghi)
+    volatile uint8_t connGen_;                                  ///< Tăng mỗi lần kết nối/ngắt (task BLE ghi)
+    uint8_t txGen_;                                             ///< connGen_ mà hàng đợi đang phục vụ
+    uint8_t chunkSeq_[BLE_TARGET_COUNT];                        ///< Số thứ tự mảnh kế tiếp theo đích
+    uint8_t chunkBuf_[BLE_REQUESTED_MTU - BLE_ATT_HEADER_SIZE]; ///< Mảnh đang gửi
+    NotifyClass txClass_;                                       ///< Lớp của khung đang gửi
+    uint8_t txTarget_;                                          ///< Đích của khung đang gửi (BLE_TARGET_*)
+    uint16_t txLen_;                                            ///< Độ dài khung đang gửi
+    uint16_t txOffset_;                                         ///< Số byte đã gửi của khung (0 = chưa bắt đầu khung nào)
+    uint16_t txPayload_;                                        ///< Dữ liệu mỗi mảnh, theo MTU lúc bắt đầu khung
+    uint32_t txProgressMs_;                                     ///< Lần cuối gửi được mảnh (hoặc hàng đợi còn trống)
+    bool txStalled_;                                            ///< Đang chờ nghẽn (đếm congestionWaits một lần mỗi đợt)
+    bool txWindowed_;                                           ///< Giới hạn mảnh chưa CONF (tắt nếu stack không báo CONF)
+    uint8_t txSent_;                                            ///< Số mảnh đã notify (chỉ loop() ghi)
+    BleTransferStats stats_;                                    ///< Thống kê truyền
+    uint32_t sessionStartMs_;                                   ///< Thời điểm mảnh đầu tiên của kết nối hiện tại
+    uint32_t sessionBytes_;                                     ///< Số byte đã gửi trong kết nối hiện tại
+};
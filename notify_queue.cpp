@@ -0,0 +1,212 @@
+/**
+ * @file notify_queue.cpp
+ * @brief Triển khai hàng đợi khung notification theo lớp ưu tiên
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#include "notify_queue.h"
+#include <string.h>
+
+static_assert((BLE_QUEUE_ALERT_BYTES & (BLE_QUEUE_ALERT_BYTES - 1)) == 0 &&
+                  (BLE_QUEUE_REALTIME_BYTES & (BLE_QUEUE_REALTIME_BYTES - 1)) == 0 &&
+                  (BLE_QUEUE_BATCH_BYTES & (BLE_QUEUE_BATCH_BYTES - 1)) == 0 && BLE_QUEUE_BATCH_BYTES <= 32768,
+              "Notification queue sizes must be powers of two");
+static_assert(BLE_QUEUE_BATCH_BYTES >= HISTORY_FRAME_BYTES + NOTIFY_FRAME_HEADER,
+              "Batch queue must hold a full history frame");
+
+// ==================== FrameRing ====================
+
+FrameRing::FrameRing()
+    : buf_(nullptr), mask_(0), head_(0), tail_(0)
+{
+}
+
+void FrameRing::begin(uint8_t *storage, uint16_t capacity)
+{
+    buf_ = storage;
+    mask_ = capacity - 1;
+    head_ = tail_ = 0;
+}
+
+void FrameRing::copyIn(const uint8_t *data, uint16_t n)
+{
+    uint16_t pos = head_ & mask_;
+    uint16_t first = (n < mask_ + 1 - pos) ? n : (uint16_t)(mask_ + 1 - pos);
+    memcpy(buf_ + pos, data, first);
+    memcpy(buf_, data + first, n - first);
+    head_ += n;
+}
+
+void FrameRing::copyOut(uint16_t pos, uint8_t *out, uint16_t n) const
+{
+    pos &= mask_;
+    uint16_t first = (n < mask_ + 1 - pos) ? n : (uint16_t)(mask_ + 1 - pos);
+    memcpy(out, buf_ + pos, first);
+    memcpy(out + first, buf_, n - first);
+}
+
+bool FrameRing::push(uint8_t target, const uint8_t *data, uint16_t len)
+{
+    if (!fits(len))
+        return false;
+    uint8_t header[NOTIFY_FRAME_HEADER] = {(uint8_t)(len & 0xFF), (uint8_t)(len >> 8), target};
+    copyIn(header, sizeof(header));
+    copyIn(data, len);
+    return true;
+}
+
+bool FrameRing::front(uint8_t &target, uint16_t &len) const
+{
+    if (empty())
+        return false;
+    uint8_t header[NOTIFY_FRAME_HEADER];
+    copyOut(tail_, header, sizeof(header));
+    len = (uint16_t)(header[0] | (header[1] << 8));
+    target = header[2];
+    return true;
+}
+
+uint16_t FrameRing::read(uint16_t offset, uint8_t *out, uint16_t n) const
+{
+    uint8_t target;
+    uint16_t len;
+    if (!front(target, len) || offset >= len)
+        return 0;
+    if (n > len - offset)
+        n = len - offset;
+    copyOut((uint16_t)(tail_ + NOTIFY_FRAME_HEADER + offset), out, n);
+    return n;
+}
+
+void FrameRing::pop()
+{
+    uint8_t target;
+    uint16_t len;
+    if (front(target, len))
+        tail_ += NOTIFY_FRAME_HEADER + len;
+}
+
+// ==================== NotifyQueue ====================
+
+NotifyQueue::NotifyQueue()
+{
+    rings_[NOTIFY_ALERT].begin(alertBytes_, sizeof(alertBytes_));
+    rings_[NOTIFY_REALTIME].begin(realtimeBytes_, sizeof(realtimeBytes_));
+    rings_[NOTIFY_BATCH].begin(batchBytes_, sizeof(batchBytes_));
+    memset(&stats_, 0, sizeof(stats_));
+    memset(pushed_, 0, sizeof(pushed_));
+    memset(retired_, 0, sizeof(retired_));
+    memset(outcomes_, 0, sizeof(outcomes_));
+}
+
+bool NotifyQueue::push(NotifyClass cls, uint8_t target, const uint8_t *data, size_t len, uint32_t *ticket)
+{
+    FrameRing &ring = rings_[cls];
+    if (len == 0 || len + NOTIFY_FRAME_HEADER > (size_t)BLE_QUEUE_BATCH_BYTES)
+    {
+        stats_.dropped[cls]++;
+        return false;
+    }
+
+    // Thời gian thực: nhường chỗ bằng khung cũ nhất. Khung lớp này luôn vừa một
+    // mảnh nên không bao giờ bị bỏ khi đang gửi dở.
+    if (cls == NOTIFY_REALTIME)
+    {
+        while (!ring.fits((uint16_t)len) && !ring.empty())
+        {
+            ring.pop();
+            retire(cls, false);
+        }
+    }
+
+    if (!ring.push(target, data, (uint16_t)len))
+    {
+        stats_.dropped[cls]++;
+        return false;
+    }
+
+    if (ticket)
+        *ticket = pushed_[cls];
+    pushed_[cls]++;
+
+    if (ring.used() > stats_.peakBytes[cls])
+        stats_.peakBytes[cls] = ring.used();
+    return true;
+}
+
+/**
+ * @brief Trạng thái khung theo ticket
+ *
+ * Khung trong một lớp rời vòng đúng thứ tự nhận nên ticket < retired_ nghĩa
+ * là khung đã rời vòng, và độ cũ retired_ - ticket chỉ ra bit kết quả.
+ */
+NotifyFrameStatus NotifyQueue::status(NotifyClass cls, uint32_t ticket) const
+{
+    uint32_t age = retired_[cls] - ticket;
+    if (age == 0 || age > pushed_[cls] - ticket)
+        return NOTIFY_FRAME_QUEUED;
+    if (age > NOTIFY_STATUS_HISTORY)
+        return NOTIFY_FRAME_DROPPED;
+    return ((outcomes_[cls] >> (age - 1)) & 1u) ? NOTIFY_FRAME_DELIVERED : NOTIFY_FRAME_DROPPED;
+}
+
+bool NotifyQueue::canPush(NotifyClass cls, size_t len) const
+{
+    return len + NOTIFY_FRAME_HEADER <= (size_t)BLE_QUEUE_BATCH_BYTES && rings_[cls].fits((uint16_t)len);
+}
+
+bool NotifyQueue::front(NotifyClass &cls, uint8_t &target, uint16_t &len) const
+{
+    for (uint8_t i = 0; i < NOTIFY_CLASS_COUNT; i++)
+    {
+        if (rings_[i].front(target, len))
+        {
+            cls = (NotifyClass)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint16_t NotifyQueue::read(NotifyClass cls, uint16_t offset, uint8_t *out, uint16_t n) const
+{
+    return rings_[cls].read(offset, out, n);
+}
+
+void NotifyQueue::pop(NotifyClass cls, bool delivered)
+{
+    if (rings_[cls].empty())
+        return;
+    rings_[cls].pop();
+    retire(cls, delivered);
+}
+
+void NotifyQueue::retire(NotifyClass cls, bool delivered)
+{
+    retired_[cls]++;
+    outcomes_[cls] = (outcomes_[cls] << 1) | (delivered ? 1u : 0u);
+    if (delivered)
+        stats_.sent[cls]++;
+    else
+        stats_.dropped[cls]++;
+}
+
+void NotifyQueue::clear()
+{
+    for (uint8_t i = 0; i < NOTIFY_CLASS_COUNT; i++)
+    {
+        while (!rings_[i].empty())
+            pop((NotifyClass)i, false);
+    }
+}
+
+bool NotifyQueue::empty() const
+{
+    for (uint8_t i = 0; i < NOTIFY_CLASS_COUNT; i++)
+    {
+        if (!rings_[i].empty())
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file notify_queue.h
+ * @brief Hàng đợi khung notification có giới hạn bộ nhớ và lớp ưu tiên
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - Mỗi lớp ưu tiên (cảnh báo > thời gian thực > batch) có vòng byte riêng,
+ *   dung lượng cố định: lớp thấp đầy không chặn được lớp cao
+ * - Khung lưu liền nhau {độ dài u16, đích u8, dữ liệu}, đọc từng đoạn theo
+ *   offset để chia mảnh mà không sao chép cả khung
+ * - Khi đầy: lớp thời gian thực bỏ khung cũ nhất (mẫu mới có giá trị hơn),
+ *   lớp cảnh báo và batch từ chối khung mới (push() trả về false, bên gọi
+ *   vẫn giữ dữ liệu)
+ * - Khung đã nhận vẫn có thể bị bỏ sau đó (mất kết nối, điện thoại tắt
+ *   notify, hết thời gian gửi): bên gọi cần biết khung đã gửi hết thì lấy
+ *   ticket từ push() và hỏi status()
+ * - Đếm khung đã gửi/bị bỏ và mức dùng cao nhất theo từng lớp
+ *
+ * Không phụ thuộc BLE, không tự đồng bộ: chỉ dùng trong một ngữ cảnh (loop()).
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "board_config.h"
+
+/// @brief Lớp ưu tiên (số nhỏ = ưu tiên cao)
+enum NotifyClass : uint8_t
+{
+    NOTIFY_ALERT = 0,    ///< Cảnh báo ML
+    NOTIFY_REALTIME = 1, ///< Mẫu thời gian thực
+    NOTIFY_BATCH = 2,    ///< Khung batch, lịch sử, rollup
+    NOTIFY_CLASS_COUNT = 3
+};
+
+#define NOTIFY_FRAME_HEADER 3    ///< Độ dài u16 + đích u8 trước mỗi khung trong vòng
+#define NOTIFY_STATUS_HISTORY 32 ///< Số khung rời hàng đợi gần nhất còn nhớ kết quả (mỗi lớp)
+
+/// @brief Trạng thái một khung theo ticket
+enum NotifyFrameStatus : uint8_t
+{
+    NOTIFY_FRAME_QUEUED = 0,    ///< Còn trong hàng đợi (chưa gửi hoặc đang gửi dở)
+    NOTIFY_FRAME_DELIVERED = 1, ///< Đã gửi hết mảnh
+    NOTIFY_FRAME_DROPPED = 2    ///< Bị bỏ, hoặc quá cũ để còn nhớ kết quả
+};
+
+/**
+ * @struct NotifyQueueStats
+ * @brief Thống kê theo lớp ưu tiên
+ */
+struct NotifyQueueStats
+{
+    uint32_t sent[NOTIFY_CLASS_COUNT];      ///< Khung đã gửi hết
+    uint32_t dropped[NOTIFY_CLASS_COUNT];   ///< Khung bị bỏ (đầy, hủy giữa chừng, mất kết nối)
+    uint16_t peakBytes[NOTIFY_CLASS_COUNT]; ///< Mức dùng vòng cao nhất (bytes)
+};
+
+/**
+ * @class FrameRing
+ * @brief Vòng byte chứa các khung độ dài thay đổi trên bộ nhớ ngoài
+ */
+class FrameRing
+{
+public:
+    FrameRing();
+
+    /// @brief Gắn bộ nhớ (capacity lũy thừa của 2, tối đa 32768)
+    void begin(uint8_t *storage, uint16_t capacity);
+
+    uint16_t used() const { return (uint16_t)(head_ - tail_); }
+    bool empty() const { return head_ == tail_; }
+
+    /// @brief Còn chỗ cho khung len byte
+    bool fits(uint16_t len) const { return (uint32_t)used() + NOTIFY_FRAME_HEADER + len <= (uint32_t)mask_ + 1; }
+
+    /// @brief Thêm khung (false nếu không vừa)
+    bool push(uint8_t target, const uint8_t *data, uint16_t len);
+
+    /// @brief Đích và độ dài khung cũ nhất
+    bool front(uint8_t &target, uint16_t &len) const;
+
+    /// @brief Đọc tối đa n byte dữ liệu của khung cũ nhất từ offset
+    /// @return Số byte đã đọc
+    uint16_t read(uint16_t offset, uint8_t *out, uint16_t n) const;
+
+    /// @brief Bỏ khung cũ nhất
+    void pop();
+
+    void clear() { head_ = tail_ = 0; }
+
+private:
+    void copyIn(const uint8_t *data, uint16_t n);
+    void copyOut(uint16_t pos, uint8_t *out, uint16_t n) const;
+
+    uint8_t *buf_;  ///< Bộ nhớ vòng
+    uint16_t mask_; ///< capacity - 1
+    uint16_t head_; ///< Vị trí ghi, chạy tự do
+    uint16_t tail_; ///< Đầu khung cũ nhất, chạy tự do
+};
+
+/**
+ * @class NotifyQueue
+ * @brief Ba vòng khung theo lớp ưu tiên
+ */
+class NotifyQueue
+{
+public:
+    NotifyQueue();
+
+    /// @brief Thêm khung vào lớp cls (xem chính sách khi đầy ở đầu file)
+    /// @param ticket Nếu khác nullptr: nhận ticket của khung để hỏi status()
+    /// @return false nếu khung không được nhận
+    bool push(NotifyClass cls, uint8_t target, const uint8_t *data, size_t len, uint32_t *ticket = nullptr);
+
+    /// @brief Trạng thái khung có ticket trong lớp cls
+    /// @note Chỉ nhớ kết quả NOTIFY_STATUS_HISTORY khung rời hàng đợi gần nhất; cũ hơn trả về DROPPED
+    NotifyFrameStatus status(NotifyClass cls, uint32_t ticket) const;
+
+    /// @brief Lớp cls còn chỗ cho khung len byte
+    bool canPush(NotifyClass cls, size_t len) const;
+
+    /// @brief Khung cũ nhất của lớp ưu tiên cao nhất đang có khung
+    bool front(NotifyClass &cls, uint8_t &target, uint16_t &len) const;
+
+    /// @brief Đọc dữ liệu khung cũ nhất của lớp cls
+    uint16_t read(NotifyClass cls, uint16_t offset, uint8_t *out, uint16_t n) const;
+
+    /// @brief Bỏ khung cũ nhất của lớp cls (delivered = đã gửi hết hay bị bỏ)
+    void pop(NotifyClass cls, bool delivered);
+
+    /// @brief Bỏ mọi khung (mất kết nối), tính vào số bị bỏ
+    void clear();
+
+    bool empty() const;
+
+    const NotifyQueueStats &stats() const { return stats_; }
+
+private:
+    /// @brief Ghi nhận khung cũ nhất rời vòng (đã bỏ khỏi vòng)
+    void retire(NotifyClass cls, bool delivered);
+
+    FrameRing rings_[NOTIFY_CLASS_COUNT]; ///< Một vòng mỗi lớp
+
+    uint32_t pushed_[NOTIFY_CLASS_COUNT];   ///< Số khung đã nhận (ticket kế tiếp)
+    uint32_t retired_[NOTIFY_CLASS_COUNT];  ///< Số khung đã rời vòng (gửi hết hoặc bị bỏ)
+    uint32_t outcomes_[NOTIFY_CLASS_COUNT]; ///< Bit i = khung rời vòng thứ i gần nhất đã gửi hết
+
+    uint8_t alertBytes_[BLE_QUEUE_ALERT_BYTES];       ///< Bộ nhớ lớp cảnh báo
+    uint8_t realtimeBytes_[BLE_QUEUE_REALTIME_BYTES]; ///< Bộ nhớ lớp thời gian thực
+    uint8_t batchBytes_[BLE_QUEUE_BATCH_BYTES];       ///< Bộ nhớ lớp batch
+
+    NotifyQueueStats stats_; ///< Thống kê
+};
@@ -10,8 +10,8 @@
 /**
  * @brief Constructor
  */
-PowerManager::PowerManager()
-    : lastVoltage_(0.0), lastPercent_(0), lastReadMs_(0)
+PowerManager::PowerManager(hal::Adc &adc, hal::Clock &clock, hal::Logger &log)
+    : adc_(adc), clock_(clock), log_(log), lastVoltage_(0.0), lastPercent_(0), lastReadMs_(0)
 {
 }
 
@@ -20,14 +20,12 @@ PowerManager::PowerManager()
  */
 void PowerManager::begin()
 {
-    // Cấu hình ADC pin
-    pinMode(BATTERY_ADC_PIN, INPUT);
-    analogReadResolution(12);       // 12-bit resolution (0-4095)
-    analogSetAttenuation(ADC_11db); // Cho phép đọc đến ~3.3V
+    // Cấu hình ADC pin: 12-bit (0-4095), suy giảm 11 dB cho phép đọc đến ~3.3V
+    adc_.begin(BATTERY_ADC_PIN);
 
     // Đọc lần đầu
     readBatteryVoltage();
-    Serial.printf("[Power] Battery initialized: %.2fV (%d%%)\n", lastVoltage_, lastPercent_);
+    log_.printf("[Power] Battery initialized: %.2fV (%d%%)\n", lastVoltage_, lastPercent_);
 }
 
 /**
@@ -47,8 +45,8 @@ float PowerManager::readBatteryVoltage()
 
     for (int i = 0; i < numSamples; i++)
     {
-        adcSum += analogRead(BATTERY_ADC_PIN);
-        delayMicroseconds(100);
+        adcSum += adc_.read(BATTERY_ADC_PIN);
+        clock_.delayUs(100);
     }
 
     uint32_t adcAvg = adcSum / numSamples;
@@ -59,7 +57,7 @@ float PowerManager::readBatteryVoltage()
 
     // Nhân với tỉ lệ voltage divider để có điện áp thực
     lastVoltage_ = adcVoltage * VOLTAGE_DIVIDER_RATIO;
-    lastReadMs_ = millis();
+    lastReadMs_ = clock_.millis();
 
     // Tính phần trăm
     lastPercent_ = getBatteryPercent();
@@ -78,7 +76,7 @@ float PowerManager::readBatteryVoltage()
 uint8_t PowerManager::getBatteryPercent()
 {
     // Đọc lại nếu đã quá 10 giây
-    if (millis() - lastReadMs_ > 10000)
+    if (clock_.millis() - lastReadMs_ > 10000)
     {
         readBatteryVoltage();
     }
@@ -11,7 +11,7 @@
  */
 
 #pragma once
-#include <Arduino.h>
+#include "hal.h"
 #include "board_config.h"
 
 /**
@@ -22,7 +22,12 @@ class PowerManager
 {
 public:
     /// @brief Constructor
-    PowerManager();
+    /// @param adc ADC đọc điện áp pin
+    /// @param clock Đồng hồ
+    /// @param log Đầu ra log
+    explicit PowerManager(hal::Adc &adc = hal::defaultAdc(),
+                          hal::Clock &clock = hal::defaultClock(),
+                          hal::Logger &log = hal::defaultLogger());
 
     /// @brief Khởi tạo ADC để đọc pin
     void begin();
@@ -36,6 +41,9 @@ public:
     uint8_t getBatteryPercent();
 
 private:
+    hal::Adc &adc_;            ///< ADC
+    hal::Clock &clock_;        ///< Đồng hồ
+    hal::Logger &log_;         ///< Đầu ra log
     float lastVoltage_;        ///< Điện áp đọc được lần cuối
     uint8_t lastPercent_;      ///< Phần trăm pin lần cuối
     unsigned long lastReadMs_; ///< Thời điểm đọc pin lần cuối
@@ -0,0 +1,164 @@
+/**
+ * @file ring_buffer.h
+ * @brief Vòng đệm kích thước cố định dùng chung cho các kho mẫu
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - Dung lượng N lũy thừa của 2 (kiểm tra lúc biên dịch): chỉ số bằng mặt nạ,
+ *   không có phép chia lấy dư
+ * - push() ghi đè mẫu cũ nhất khi đầy; tryPush() từ chối
+ * - Thêm/lấy hàng loạt bằng memcpy, truy cập theo thứ tự thời gian (0 = cũ nhất)
+ * - Xem nội dung dưới dạng tối đa hai dãy liên tiếp (RingSpan) để truyền
+ *   hoặc mã hóa mà không sao chép
+ *
+ * Không tự đồng bộ: dùng trong một ngữ cảnh (hoặc trong critical section).
+ * Giữa hai ngữ cảnh dùng SpscQueue (spsc_queue.h).
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+
+/**
+ * @struct RingSpan
+ * @brief Dãy phần tử liên tiếp (không sở hữu dữ liệu)
+ */
+template <typename T>
+struct RingSpan
+{
+    const T *data;  ///< Phần tử đầu tiên
+    uint16_t count; ///< Số phần tử
+};
+
+/**
+ * @class RingBuffer
+ * @brief Vòng đệm N phần tử kiểu T
+ * @tparam T Kiểu phần tử (sao chép được bằng memcpy)
+ * @tparam N Dung lượng (lũy thừa của 2, tối đa 16384)
+ */
+template <typename T, uint16_t N>
+class RingBuffer
+{
+    static_assert(N >= 2 && N <= 16384 && (N & (N - 1)) == 0, "RingBuffer capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "RingBuffer elements are copied with memcpy");
+
+public:
+    RingBuffer() : head_(0), tail_(0) {}
+
+    static constexpr uint16_t capacity() { return N; }
+
+    uint16_t size() const { return (uint16_t)(head_ - tail_); }
+    bool empty() const { return head_ == tail_; }
+    bool full() const { return size() == N; }
+
+    /// @brief Xóa toàn bộ
+    void clear() { head_ = tail_ = 0; }
+
+    /// @brief Thêm một phần tử, ghi đè phần tử cũ nhất nếu đầy
+    void push(const T &item)
+    {
+        if (full())
+            tail_++;
+        items_[head_ & MASK] = item;
+        head_++;
+    }
+
+    /// @brief Thêm một phần tử nếu còn chỗ
+    bool tryPush(const T &item)
+    {
+        if (full())
+            return false;
+        items_[head_ & MASK] = item;
+        head_++;
+        return true;
+    }
+
+    /// @brief Thêm n phần tử (ghi đè phần tử cũ nhất nếu cần; chỉ giữ N phần tử cuối)
+    void pushBulk(const T *items, uint16_t n)
+    {
+        if (n > N)
+        {
+            items += n - N;
+            n = N;
+        }
+        uint16_t pos = head_ & MASK;
+        uint16_t first = (n < N - pos) ? n : (uint16_t)(N - pos);
+        memcpy(&items_[pos], items, first * sizeof(T));
+        memcpy(&items_[0], items + first, (n - first) * sizeof(T));
+        head_ += n;
+        if (size() > N)
+            tail_ = head_ - N;
+    }
+
+    /// @brief Lấy phần tử cũ nhất
+    bool pop(T &item)
+    {
+        if (empty())
+            return false;
+        item = items_[tail_ & MASK];
+        tail_++;
+        return true;
+    }
+
+    /// @brief Lấy tối đa n phần tử cũ nhất
+    /// @return Số phần tử đã lấy
+    uint16_t popBulk(T *out, uint16_t n)
+    {
+        RingSpan<T> parts[2];
+        uint8_t count = spans(parts);
+        uint16_t copied = 0;
+        for (uint8_t i = 0; i < count && copied < n; i++)
+        {
+            uint16_t take = (parts[i].count < n - copied) ? parts[i].count : (uint16_t)(n - copied);
+            memcpy(out + copied, parts[i].data, take * sizeof(T));
+            copied += take;
+        }
+        tail_ += copied;
+        return copied;
+    }
+
+    /// @brief Bỏ n phần tử cũ nhất
+    void drop(uint16_t n)
+    {
+        tail_ += (n < size()) ? n : size();
+    }
+
+    /// @brief Phần tử thứ i theo thời gian (0 = cũ nhất), i < size()
+    const T &operator[](uint16_t i) const { return items_[(uint16_t)(tail_ + i) & MASK]; }
+
+    /// @brief Phần tử mới nhất (chỉ khi !empty())
+    const T &newest() const { return items_[(uint16_t)(head_ - 1) & MASK]; }
+
+    /// @brief Nội dung từ phần tử thứ first đến mới nhất, tối đa hai dãy liên tiếp
+    /// @param out Mảng đầu ra, theo thứ tự thời gian
+    /// @param first Bỏ qua first phần tử cũ nhất
+    /// @return Số span hợp lệ (0, 1 hoặc 2)
+    uint8_t spans(RingSpan<T> out[2], uint16_t first = 0) const
+    {
+        if (first >= size())
+            return 0;
+        uint16_t n = size() - first;
+        uint16_t pos = (uint16_t)(tail_ + first) & MASK;
+        uint16_t run = N - pos;
+        out[0].data = &items_[pos];
+        if (run >= n)
+        {
+            out[0].count = n;
+            return 1;
+        }
+        out[0].count = run;
+        out[1].data = &items_[0];
+        out[1].count = n - run;
+        return 2;
+    }
+
+private:
+    static const uint16_t MASK = N - 1;
+
+    T items_[N];    ///< Bộ nhớ vòng
+    uint16_t head_; ///< Vị trí ghi, chạy tự do
+    uint16_t tail_; ///< Vị trí phần tử cũ nhất, chạy tự do
+};
@@ -0,0 +1,83 @@
+/**
+ * @file rollup.cpp
+ * @brief Triển khai cộng dồn và mã hóa khoảng tổng hợp
+ * @author Hồ Xuân Thái
+ * @date 2025
+ */
+
+#include "rollup.h"
+#include <string.h>
+
+static inline void putU16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline uint8_t average(uint32_t sum, uint16_t count)
+{
+    return count ? (uint8_t)((sum + count / 2) / count) : 0;
+}
+
+void rollupBegin(RollupBucket &bucket, uint32_t startTs)
+{
+    memset(&bucket, 0, sizeof(bucket));
+    bucket.startTs = startTs;
+    bucket.hrMin = 0xFF;
+    bucket.spo2Min = 0xFF;
+}
+
+void rollupAdd(RollupBucket &bucket, const HealthDataPacket &sample, uint32_t stepDelta)
+{
+    bucket.count++;
+    bucket.steps += stepDelta;
+    bucket.stepsLast = sample.steps;
+
+    if (sample.hr > 0)
+    {
+        bucket.hrCount++;
+        bucket.hrSum += sample.hr;
+        if (sample.hr < bucket.hrMin)
+            bucket.hrMin = sample.hr;
+        if (sample.hr > bucket.hrMax)
+            bucket.hrMax = sample.hr;
+        bucket.hrLast = sample.hr;
+    }
+
+    if (sample.spo2 > 0)
+    {
+        bucket.spo2Count++;
+        bucket.spo2Sum += sample.spo2;
+        if (sample.spo2 < bucket.spo2Min)
+            bucket.spo2Min = sample.spo2;
+        if (sample.spo2 > bucket.spo2Max)
+            bucket.spo2Max = sample.spo2;
+        bucket.spo2Last = sample.spo2;
+    }
+}
+
+void rollupPutHeader(uint8_t *out, RollupLevel level, uint8_t count, uint32_t baseTs)
+{
+    out[0] = ROLLUP_FRAME_MAGIC;
+    out[1] = (uint8_t)level;
+    out[2] = count;
+    out[3] = 0;
+    putU16(out + 4, (uint16_t)baseTs);
+    putU16(out + 6, (uint16_t)(baseTs >> 16));
+}
+
+/**
+ * @brief Ghi một bản ghi; min = 0 khi khoảng không có giá trị hợp lệ, số bước bão hòa ở 65535
+ */
+void rollupPutRecord(uint8_t *out, const RollupBucket &bucket, uint16_t offset)
+{
+    putU16(out, offset);
+    putU16(out + 2, bucket.count);
+    out[4] = bucket.hrCount ? bucket.hrMin : 0;
+    out[5] = average(bucket.hrSum, bucket.hrCount);
+    out[6] = bucket.hrMax;
+    out[7] = bucket.spo2Count ? bucket.spo2Min : 0;
+    out[8] = average(bucket.spo2Sum, bucket.spo2Count);
+    out[9] = bucket.spo2Max;
+    putU16(out + 10, (bucket.steps > 0xFFFF) ? 0xFFFF : (uint16_t)bucket.steps);
+}
@@ -0,0 +1,163 @@
+/**
+ * @file rollup.h
+ * @brief Tổng hợp nhiều độ phân giải (theo phút, theo giờ) cập nhật tăng dần
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - Mỗi mẫu được cộng dồn vào khoảng đang mở của từng tầng: số mẫu, tổng,
+ *   min, max và giá trị cuối của HR/SpO2, số bước tăng thêm
+ * - Khi sang khoảng mới, khoảng cũ được đẩy vào vòng RollupBucket cố định
+ *   (cũ nhất bị ghi đè)
+ * - Xuất một tầng thành khung nhị phân gọn để gửi trong một notification
+ *
+ * Khung rollup (little-endian):
+ * - Header 8 byte: magic 0xA6, tầng (RollupLevel), số bản ghi, dự trữ,
+ *   thời điểm đầu khoảng cũ nhất (u32)
+ * - Mỗi bản ghi 12 byte: độ lệch (u16, số chu kỳ tính từ header), số mẫu (u16),
+ *   HR min/avg/max, SpO2 min/avg/max, số bước (u16, bão hòa ở 65535)
+ * - Bản ghi cuối là khoảng đang mở (chưa kết thúc)
+ *
+ * 24 khoảng giờ = 8 + 24 × 12 = 296 byte.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "health_data_packet.h"
+#include "ring_buffer.h"
+
+#define ROLLUP_FRAME_MAGIC 0xA6 ///< Byte đầu khung rollup
+#define ROLLUP_HEADER_SIZE 8    ///< Kích thước header
+#define ROLLUP_RECORD_SIZE 12   ///< Kích thước một bản ghi
+
+/// @brief Tầng tổng hợp (giá trị ghi trong khung và trong yêu cầu từ điện thoại)
+enum RollupLevel : uint8_t
+{
+    ROLLUP_MINUTE = 0,
+    ROLLUP_HOUR = 1
+};
+
+/**
+ * @struct RollupBucket
+ * @brief Tổng hợp của một khoảng thời gian
+ *
+ * HR/SpO2 bằng 0 (chưa đo được) chỉ tính vào count, không vào thống kê.
+ */
+struct RollupBucket
+{
+    uint32_t startTs;   ///< Đầu khoảng (Unix, chia hết cho chu kỳ)
+    uint32_t hrSum;     ///< Tổng HR hợp lệ
+    uint32_t spo2Sum;   ///< Tổng SpO2 hợp lệ
+    uint16_t count;     ///< Số mẫu
+    uint16_t hrCount;   ///< Số mẫu có HR > 0
+    uint16_t spo2Count; ///< Số mẫu có SpO2 > 0
+    uint32_t steps;     ///< Số bước tăng thêm trong khoảng
+    uint32_t stepsLast; ///< Bộ đếm bước ở mẫu cuối
+    uint8_t hrMin;      ///< HR nhỏ nhất
+    uint8_t hrMax;      ///< HR lớn nhất
+    uint8_t hrLast;     ///< HR cuối
+    uint8_t spo2Min;    ///< SpO2 nhỏ nhất
+    uint8_t spo2Max;    ///< SpO2 lớn nhất
+    uint8_t spo2Last;   ///< SpO2 cuối
+};
+
+/// @brief Mở khoảng mới bắt đầu tại startTs
+void rollupBegin(RollupBucket &bucket, uint32_t startTs);
+
+/// @brief Cộng một mẫu vào khoảng
+/// @param stepDelta Số bước tăng thêm so với mẫu trước
+void rollupAdd(RollupBucket &bucket, const HealthDataPacket &sample, uint32_t stepDelta);
+
+/// @brief Ghi header khung rollup
+void rollupPutHeader(uint8_t *out, RollupLevel level, uint8_t count, uint32_t baseTs);
+
+/// @brief Ghi một bản ghi khung rollup
+void rollupPutRecord(uint8_t *out, const RollupBucket &bucket, uint16_t offset);
+
+/**
+ * @class RollupTier
+ * @brief Một tầng tổng hợp: khoảng đang mở + vòng N khoảng đã đóng
+ * @tparam N Số khoảng đã đóng giữ lại (lũy thừa của 2)
+ */
+template <uint16_t N>
+class RollupTier
+{
+public:
+    /// @param periodS Độ dài một khoảng (giây)
+    explicit RollupTier(uint32_t periodS) : periodS_(periodS), open_(false)
+    {
+        rollupBegin(current_, 0);
+    }
+
+    /// @brief Cộng mẫu vào khoảng chứa timestamp của nó
+    ///
+    /// Timestamp lùi (đồng bộ lại thời gian) được cộng vào khoảng đang mở.
+    void add(const HealthDataPacket &sample, uint32_t stepDelta)
+    {
+        uint32_t start = sample.timestamp - sample.timestamp % periodS_;
+        if (!open_ || start > current_.startTs)
+        {
+            if (open_)
+                closed_.push(current_);
+            rollupBegin(current_, start);
+            open_ = true;
+        }
+        rollupAdd(current_, sample, stepDelta);
+    }
+
+    /// @brief Xóa toàn bộ
+    void clear()
+    {
+        closed_.clear();
+        open_ = false;
+    }
+
+    /// @brief Độ dài một khoảng (giây)
+    uint32_t period() const { return periodS_; }
+
+    /// @brief Số khoảng (kể cả khoảng đang mở)
+    uint16_t size() const { return closed_.size() + (open_ ? 1 : 0); }
+
+    /// @brief Khoảng thứ i theo thời gian (0 = cũ nhất, size()-1 = đang mở)
+    const RollupBucket &operator[](uint16_t i) const
+    {
+        return (i < closed_.size()) ? closed_[i] : current_;
+    }
+
+    /// @brief Xuất các khoảng mới nhất vừa với bộ đệm thành khung rollup
+    /// @return Độ dài khung (0 nếu chưa có khoảng nào hoặc bộ đệm quá nhỏ)
+    size_t encode(RollupLevel level, uint8_t *out, size_t maxLen) const
+    {
+        if (size() == 0 || maxLen < ROLLUP_HEADER_SIZE + ROLLUP_RECORD_SIZE)
+            return 0;
+
+        // Chọn từ mới nhất về cũ: giới hạn bởi bộ đệm, số bản ghi u8 và độ lệch u16
+        size_t fit = (maxLen - ROLLUP_HEADER_SIZE) / ROLLUP_RECORD_SIZE;
+        uint32_t newest = (*this)[size() - 1].startTs;
+        uint16_t n = 0;
+        while (n < size() && n < fit && n < 0xFF)
+        {
+            if ((newest - (*this)[size() - 1 - n].startTs) / periodS_ > 0xFFFF)
+                break;
+            n++;
+        }
+
+        uint16_t first = size() - n;
+        uint32_t baseTs = (*this)[first].startTs;
+        rollupPutHeader(out, level, (uint8_t)n, baseTs);
+        for (uint16_t i = 0; i < n; i++)
+        {
+            const RollupBucket &b = (*this)[first + i];
+            rollupPutRecord(out + ROLLUP_HEADER_SIZE + i * ROLLUP_RECORD_SIZE, b,
+                            (uint16_t)((b.startTs - baseTs) / periodS_));
+        }
+        return ROLLUP_HEADER_SIZE + n * ROLLUP_RECORD_SIZE;
+    }
+
+private:
+    uint32_t periodS_;                   ///< Độ dài một khoảng (giây)
+    RollupBucket current_;               ///< Khoảng đang mở
+    bool open_;                          ///< Đã có khoảng đang mở
+    RingBuffer<RollupBucket, N> closed_; ///< Các khoảng đã đóng
+};
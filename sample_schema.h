@@ -0,0 +1,262 @@
+/**
+ * @file sample_schema.h
+ * @brief Bảng trường mẫu (schema) dùng chung cho bộ mã hóa và bộ giải mã khung
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - SAMPLE_SCHEMA là nguồn duy nhất mô tả các trường của HealthDataPacket:
+ *   cách mã hóa (tuyệt đối, delta, delta-of-delta), độ rộng bit của giá trị
+ *   tuyệt đối và của giá trị delta
+ * - Độ rộng tuyệt đối được kiểm tra lúc biên dịch với kiểu của trường trong
+ *   HealthDataPacket, nên đổi kiểu trường mà quên bảng sẽ không biên dịch được
+ * - Bảng được ghi vào header mỗi khung, bộ giải mã phía điện thoại đọc bảng
+ *   từ header thay vì tự giả định định dạng
+ * - BitWriter/BitReader: ghi/đọc số nguyên nhiều bit liên tiếp (LSB trước)
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "health_data_packet.h"
+
+#define SAMPLE_SCHEMA_VERSION 1    ///< Tăng khi đổi SAMPLE_SCHEMA
+#define SAMPLE_SCHEMA_MAX_FIELDS 8 ///< Số trường tối đa bộ giải mã chấp nhận
+
+/// @brief Mã trường (4 bit trong header khung)
+enum SampleFieldId : uint8_t
+{
+    FIELD_TIMESTAMP = 0,
+    FIELD_STEPS = 1,
+    FIELD_HR = 2,
+    FIELD_SPO2 = 3
+};
+
+/// @brief Cách mã hóa trường trong bản ghi thường (4 bit trong header khung)
+enum FieldCoding : uint8_t
+{
+    CODING_ABSOLUTE = 0, ///< Giá trị tuyệt đối (bits = baseBits)
+    CODING_DELTA = 1,    ///< Chênh lệch có dấu so với bản ghi trước
+    CODING_DELTA2 = 2    ///< Chênh lệch của chênh lệch (delta-of-delta), có dấu
+};
+
+/**
+ * @struct FieldSpec
+ * @brief Mô tả một trường (3 byte trong header khung)
+ */
+struct FieldSpec
+{
+    uint8_t id;       ///< SampleFieldId
+    uint8_t coding;   ///< FieldCoding
+    uint8_t baseBits; ///< Độ rộng giá trị tuyệt đối (bản ghi đầy đủ)
+    uint8_t bits;     ///< Độ rộng giá trị mã hóa trong bản ghi thường
+};
+
+/// @brief Bảng trường hiện hành (thứ tự = thứ tự trong bản ghi)
+static constexpr FieldSpec SAMPLE_SCHEMA[] = {
+    {FIELD_TIMESTAMP, CODING_DELTA2, 32, 3}, // Lấy mẫu đều: delta-of-delta -1/0/+1
+    {FIELD_STEPS, CODING_DELTA, 32, 5},      // Tối đa 15 bước giữa hai mẫu
+    {FIELD_HR, CODING_DELTA, 8, 5},          // -16..15 BPM
+    {FIELD_SPO2, CODING_DELTA, 8, 3},        // -4..3 %
+};
+
+static constexpr uint8_t SAMPLE_SCHEMA_FIELDS = sizeof(SAMPLE_SCHEMA) / sizeof(SAMPLE_SCHEMA[0]);
+
+/**
+ * @brief Truy cập trường theo mã (một đặc tả cho mỗi trường)
+ */
+template <uint8_t Id>
+struct SampleField;
+
+template <>
+struct SampleField<FIELD_TIMESTAMP>
+{
+    typedef decltype(HealthDataPacket::timestamp) type;
+    static uint32_t get(const HealthDataPacket &p) { return p.timestamp; }
+    static void set(HealthDataPacket &p, uint32_t v) { p.timestamp = (type)v; }
+};
+
+template <>
+struct SampleField<FIELD_STEPS>
+{
+    typedef decltype(HealthDataPacket::steps) type;
+    static uint32_t get(const HealthDataPacket &p) { return p.steps; }
+    static void set(HealthDataPacket &p, uint32_t v) { p.steps = (type)v; }
+};
+
+template <>
+struct SampleField<FIELD_HR>
+{
+    typedef decltype(HealthDataPacket::hr) type;
+    static uint32_t get(const HealthDataPacket &p) { return p.hr; }
+    static void set(HealthDataPacket &p, uint32_t v) { p.hr = (type)v; }
+};
+
+template <>
+struct SampleField<FIELD_SPO2>
+{
+    typedef decltype(HealthDataPacket::spo2) type;
+    static uint32_t get(const HealthDataPacket &p) { return p.spo2; }
+    static void set(HealthDataPacket &p, uint32_t v) { p.spo2 = (type)v; }
+};
+
+/// @brief Độ rộng (bit) của trường trong HealthDataPacket, 0 nếu mã lạ
+constexpr uint8_t sampleFieldWidth(uint8_t id)
+{
+    return id == FIELD_TIMESTAMP ? 8 * sizeof(SampleField<FIELD_TIMESTAMP>::type)
+           : id == FIELD_STEPS   ? 8 * sizeof(SampleField<FIELD_STEPS>::type)
+           : id == FIELD_HR      ? 8 * sizeof(SampleField<FIELD_HR>::type)
+           : id == FIELD_SPO2    ? 8 * sizeof(SampleField<FIELD_SPO2>::type)
+                                 : 0;
+}
+
+/// @brief Đọc trường theo mã lúc chạy
+inline uint32_t sampleFieldGet(const HealthDataPacket &p, uint8_t id)
+{
+    switch (id)
+    {
+    case FIELD_TIMESTAMP:
+        return SampleField<FIELD_TIMESTAMP>::get(p);
+    case FIELD_STEPS:
+        return SampleField<FIELD_STEPS>::get(p);
+    case FIELD_HR:
+        return SampleField<FIELD_HR>::get(p);
+    case FIELD_SPO2:
+        return SampleField<FIELD_SPO2>::get(p);
+    default:
+        return 0;
+    }
+}
+
+/// @brief Ghi trường theo mã lúc chạy (mã lạ bị bỏ qua)
+inline void sampleFieldSet(HealthDataPacket &p, uint8_t id, uint32_t v)
+{
+    switch (id)
+    {
+    case FIELD_TIMESTAMP:
+        SampleField<FIELD_TIMESTAMP>::set(p, v);
+        break;
+    case FIELD_STEPS:
+        SampleField<FIELD_STEPS>::set(p, v);
+        break;
+    case FIELD_HR:
+        SampleField<FIELD_HR>::set(p, v);
+        break;
+    case FIELD_SPO2:
+        SampleField<FIELD_SPO2>::set(p, v);
+        break;
+    default:
+        break;
+    }
+}
+
+/// @brief Mọi trường trong bảng có độ rộng tuyệt đối đúng bằng kiểu trong HealthDataPacket
+constexpr bool sampleSchemaMatchesPacket(uint8_t i = 0)
+{
+    return i >= SAMPLE_SCHEMA_FIELDS ||
+           (SAMPLE_SCHEMA[i].baseBits == sampleFieldWidth(SAMPLE_SCHEMA[i].id) &&
+            SAMPLE_SCHEMA[i].bits >= 1 && SAMPLE_SCHEMA[i].bits <= SAMPLE_SCHEMA[i].baseBits &&
+            sampleSchemaMatchesPacket(i + 1));
+}
+
+/// @brief Số bit của bản ghi (cờ đầy đủ + các trường)
+constexpr uint16_t sampleRecordBits(bool full, uint8_t i = 0)
+{
+    return i >= SAMPLE_SCHEMA_FIELDS ? 1
+                                     : (full ? SAMPLE_SCHEMA[i].baseBits : SAMPLE_SCHEMA[i].bits) +
+                                           sampleRecordBits(full, i + 1);
+}
+
+static_assert(SAMPLE_SCHEMA_FIELDS <= SAMPLE_SCHEMA_MAX_FIELDS, "Too many schema fields");
+static_assert(sampleSchemaMatchesPacket(), "SAMPLE_SCHEMA widths must match HealthDataPacket");
+
+/**
+ * @class BitWriter
+ * @brief Ghi số nguyên n bit liên tiếp vào bộ đệm (LSB trước)
+ */
+class BitWriter
+{
+public:
+    BitWriter() : out_(nullptr), capacityBits_(0), pos_(0) {}
+
+    /// @brief Bắt đầu ghi tại bit đầu của out
+    void begin(uint8_t *out, size_t capacityBytes)
+    {
+        out_ = out;
+        capacityBits_ = capacityBytes * 8;
+        pos_ = 0;
+    }
+
+    /// @brief Còn đủ chỗ cho n bit
+    bool fits(size_t bits) const { return pos_ + bits <= capacityBits_; }
+
+    /// @brief Ghi n bit thấp của value (1..32; gọi fits() trước)
+    void write(uint32_t value, uint8_t bits)
+    {
+        while (bits > 0)
+        {
+            size_t byte = pos_ >> 3;
+            uint8_t shift = pos_ & 7;
+            uint8_t take = (uint8_t)(8 - shift) < bits ? (uint8_t)(8 - shift) : bits;
+            uint8_t mask = (uint8_t)(((1u << take) - 1) << shift);
+            uint8_t kept = shift ? (uint8_t)(out_[byte] & ((1u << shift) - 1)) : 0; // Bit phía trên vị trí ghi luôn là 0
+            out_[byte] = (uint8_t)(kept | ((value << shift) & mask));
+            value >>= take;
+            bits -= take;
+            pos_ += take;
+        }
+    }
+
+    /// @brief Số bit đã ghi
+    size_t bitCount() const { return pos_; }
+
+    /// @brief Số byte đã dùng (làm tròn lên)
+    size_t byteCount() const { return (pos_ + 7) >> 3; }
+
+private:
+    uint8_t *out_;        ///< Bộ đệm
+    size_t capacityBits_; ///< Dung lượng (bit)
+    size_t pos_;          ///< Vị trí ghi (bit)
+};
+
+/**
+ * @class BitReader
+ * @brief Đọc số nguyên n bit liên tiếp (LSB trước)
+ */
+class BitReader
+{
+public:
+    BitReader() : data_(nullptr), lenBits_(0), pos_(0) {}
+
+    void begin(const uint8_t *data, size_t lenBytes)
+    {
+        data_ = data;
+        lenBits_ = lenBytes * 8;
+        pos_ = 0;
+    }
+
+    /// @brief Đọc n bit (1..32)
+    /// @return false nếu hết dữ liệu
+    bool read(uint32_t &value, uint8_t bits)
+    {
+        if (pos_ + bits > lenBits_)
+            return false;
+        value = 0;
+        uint8_t got = 0;
+        while (got < bits)
+        {
+            uint8_t shift = pos_ & 7;
+            uint8_t take = (uint8_t)(8 - shift) < (uint8_t)(bits - got) ? (uint8_t)(8 - shift) : (uint8_t)(bits - got);
+            uint32_t chunk = (data_[pos_ >> 3] >> shift) & ((1u << take) - 1);
+            value |= chunk << got;
+            got += take;
+            pos_ += take;
+        }
+        return true;
+    }
+
+private:
+    const uint8_t *data_; ///< Dữ liệu
+    size_t lenBits_;      ///< Độ dài (bit)
+    size_t pos_;          ///< Vị trí đọc (bit)
+};
@@ -0,0 +1,139 @@
+/**
+ * @file spsc_queue.h
+ * @brief Hàng đợi vòng một-ghi-một-đọc (SPSC) không khóa
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chức năng:
+ * - Chuyển mẫu từ ngữ cảnh thu thập (task/ngắt) sang ngữ cảnh lưu trữ/truyền
+ *   mà không cần mutex hay tắt ngắt
+ * - Chỉ số head/tail chạy tự do (uint32_t), dung lượng N lũy thừa của 2 nên
+ *   chỉ cần AND với mặt nạ; dùng được đủ N phần tử
+ * - head_ (bên ghi) và tail_ (bên đọc) nằm trên các cache line khác nhau;
+ *   mỗi bên giữ bản sao chỉ số của bên kia để hạn chế đọc chéo
+ *
+ * Quy tắc: chỉ MỘT ngữ cảnh gọi push*(), chỉ MỘT ngữ cảnh gọi pop*().
+ * Trên ESP32-C3 (RV32IMC, không có lệnh AMO) chỉ cần load/store 32-bit
+ * có thứ tự acquire/release, không dùng compare-exchange.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#ifndef SPSC_CACHE_LINE
+#define SPSC_CACHE_LINE 64 ///< Khoảng cách giữa chỉ số hai bên (bytes)
+#endif
+
+/**
+ * @class SpscQueue
+ * @brief Vòng SPSC không khóa, dung lượng N (lũy thừa của 2)
+ * @tparam T Kiểu phần tử (sao chép được bằng phép gán)
+ * @tparam N Dung lượng
+ */
+template <typename T, uint32_t N>
+class SpscQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : head_(0), tailCache_(0), tail_(0), headCache_(0) {}
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    /// @brief Dung lượng
+    static constexpr uint32_t capacity() { return N; }
+
+    /// @brief (Bên ghi) Thêm một phần tử
+    /// @return false nếu hàng đợi đầy
+    bool push(const T &item)
+    {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head - tailCache_ == N)
+        {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head - tailCache_ == N)
+                return false;
+        }
+        buf_[head & MASK] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief (Bên ghi) Thêm tối đa n phần tử
+    /// @return Số phần tử đã thêm
+    uint32_t pushBulk(const T *items, uint32_t n)
+    {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t space = N - (head - tailCache_);
+        if (space < n)
+        {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            space = N - (head - tailCache_);
+        }
+        if (n > space)
+            n = space;
+        for (uint32_t i = 0; i < n; i++)
+            buf_[(head + i) & MASK] = items[i];
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    /// @brief (Bên đọc) Lấy một phần tử
+    /// @return false nếu hàng đợi rỗng
+    bool pop(T &item)
+    {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == headCache_)
+        {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail == headCache_)
+                return false;
+        }
+        item = buf_[tail & MASK];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief (Bên đọc) Lấy tối đa n phần tử
+    /// @return Số phần tử đã lấy
+    uint32_t popBulk(T *items, uint32_t n)
+    {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t avail = headCache_ - tail;
+        if (avail < n)
+        {
+            headCache_ = head_.load(std::memory_order_acquire);
+            avail = headCache_ - tail;
+        }
+        if (n > avail)
+            n = avail;
+        for (uint32_t i = 0; i < n; i++)
+            items[i] = buf_[(tail + i) & MASK];
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    /// @brief Số phần tử hiện có (xấp xỉ nếu gọi từ ngữ cảnh thứ ba)
+    uint32_t size() const
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    static const uint32_t MASK = N - 1;
+
+    // Bên ghi: head_ và bản sao tail
+    alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> head_;
+    uint32_t tailCache_;
+
+    // Bên đọc: tail_ và bản sao head
+    alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> tail_;
+    uint32_t headCache_;
+
+    alignas(SPSC_CACHE_LINE) T buf_[N];
+};
@@ -0,0 +1,119 @@
+/**
+ * @file bench_batch_codec.cpp
+ * @brief Đo tỉ lệ nén và tốc độ mã hóa/giải mã khung batch trên host
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Luồng 2 triệu mẫu tổng hợp (sample_stream.h), chia khung theo kích thước
+ * notification (244 byte) và khung lớn (4096 byte). In byte/mẫu và MB/s theo
+ * dữ liệu đã mã hóa (tốc độ bên nhận phải theo kịp).
+ *
+ * So sánh bố cục hàng (BatchEncoder) với bố cục cột (BatchColumnEncoder,
+ * tối đa BATCH_COLUMN_MAX_SAMPLES mẫu/khung): giải mã cả mẫu qua next() và
+ * chỉ một cột HR qua decodeColumn() (trường hợp biểu đồ một đại lượng).
+ */
+
+#include "host_test.h"
+#include "sample_stream.h"
+#include "../batch_codec.h"
+
+static const size_t SAMPLES = 2000000;
+static const uint32_t REPEAT = 10;
+
+static volatile uint32_t g_sink; ///< Chặn trình biên dịch bỏ vòng giải mã
+
+/// @brief Cách giải mã khi đo
+enum DecodeMode
+{
+    DECODE_SAMPLES,  ///< Cả mẫu qua next()
+    DECODE_HR_COLUMN ///< Một cột HR qua decodeColumn()
+};
+
+/// @brief Mã hóa toàn bộ luồng, trả về các khung và thời gian mã hóa
+template <typename Encoder>
+static std::vector<std::vector<uint8_t>> encodeAll(const std::vector<HealthDataPacket> &v, size_t frameBytes,
+                                                   double &seconds)
+{
+    std::vector<std::vector<uint8_t>> frames;
+    auto t0 = std::chrono::steady_clock::now();
+    size_t i = 0;
+    while (i < v.size())
+    {
+        std::vector<uint8_t> f(frameBytes);
+        Encoder enc;
+        enc.begin(f.data(), f.size(), (uint32_t)i);
+        while (i < v.size() && enc.add(v[i]))
+            i++;
+        f.resize(enc.finish());
+        frames.push_back(std::move(f));
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return frames;
+}
+
+/// @brief Vị trí trường id trong header khung (fieldCount() nếu không có)
+static uint8_t findField(const BatchDecoder &dec, uint8_t id)
+{
+    uint8_t i = 0;
+    while (i < dec.fieldCount() && dec.fieldId(i) != id)
+        i++;
+    return i;
+}
+
+/// @brief Thời gian giải mã trung bình một lượt qua mọi khung
+static double decodeAll(const std::vector<std::vector<uint8_t>> &frames, DecodeMode mode)
+{
+    uint32_t sum = 0;
+    uint32_t column[BATCH_COLUMN_MAX_SAMPLES];
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t rep = 0; rep < REPEAT; rep++)
+    {
+        for (const std::vector<uint8_t> &f : frames)
+        {
+            BatchDecoder dec;
+            dec.begin(f.data(), f.size());
+            if (mode == DECODE_HR_COLUMN)
+            {
+                uint16_t n = dec.decodeColumn(findField(dec, FIELD_HR), column, BATCH_COLUMN_MAX_SAMPLES);
+                for (uint16_t k = 0; k < n; k++)
+                    sum += column[k];
+                continue;
+            }
+            HealthDataPacket out;
+            while (dec.next(out))
+                sum += out.hr;
+        }
+    }
+    g_sink = sum;
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / REPEAT;
+}
+
+template <typename Encoder>
+static void benchLayout(const char *name, const std::vector<HealthDataPacket> &v, size_t frameBytes, DecodeMode mode)
+{
+    double encodeS;
+    std::vector<std::vector<uint8_t>> frames = encodeAll<Encoder>(v, frameBytes, encodeS);
+    size_t encoded = 0;
+    for (const std::vector<uint8_t> &f : frames)
+        encoded += f.size();
+    double decodeS = decodeAll(frames, mode);
+
+    printf("%-8s %6zu %8zu %10.2f %10.2f %12.1f %12.1f %12.1f\n", name, frameBytes, frames.size(),
+           (double)encoded / v.size(), (double)v.size() * sizeof(HealthDataPacket) / encoded,
+           encoded / encodeS / 1e6, encoded / decodeS / 1e6, v.size() / decodeS / 1e6);
+}
+
+int main()
+{
+    std::vector<HealthDataPacket> v = makeSampleStream(SAMPLES);
+    printf("%zu samples, %zu bytes raw\n", v.size(), v.size() * sizeof(HealthDataPacket));
+    printf("%-8s %6s %8s %10s %10s %12s %12s %12s\n", "layout", "frame", "frames", "B/sample", "ratio",
+           "enc MB/s", "dec MB/s", "dec Msmp/s");
+    for (size_t frameBytes : {(size_t)244, (size_t)4096})
+    {
+        benchLayout<BatchEncoder>("rows", v, frameBytes, DECODE_SAMPLES);
+        benchLayout<BatchColumnEncoder>("cols", v, frameBytes, DECODE_SAMPLES);
+        benchLayout<BatchColumnEncoder>("cols:hr", v, frameBytes, DECODE_HR_COLUMN);
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file bench_dsp_filters.cpp
+ * @brief Đo chi phí mỗi mẫu của các kernel trong dsp_filters.h theo kiểu mẫu
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Số đo trên host chỉ dùng để so sánh tương đối giữa các kernel/kiểu và phát
+ * hiện hồi quy; trên ESP32-C3 (không FPU) đường float chậm hơn số nguyên
+ * nhiều lần, ngược với host.
+ */
+
+#include "host_test.h"
+#include "../dsp_filters.h"
+#include <vector>
+
+static const uint32_t SAMPLES = 1u << 20;
+
+static constexpr dsp::BiquadCoeffs kLp = dsp::designLowPass(5.0f, 100.0f);
+static constexpr dsp::BiquadCoeffs kHp = dsp::designHighPass(0.5f, 100.0f);
+static constexpr dsp::FirCoeffs<15> kFir = dsp::designLowPassFir<15>(8.0f, 100.0f);
+static constexpr double kDcAlpha = dsp::designDcBlocker(0.5, 400.0);
+
+/// @brief Tín hiệu vào: sin + nhiễu, chuyển sang kiểu T
+template <typename T>
+static std::vector<T> makeInput(float scale)
+{
+    host_test::Rng rng(7);
+    std::vector<T> in(SAMPLES);
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        float v = 0.6f * sinf(0.05f * i) + 0.2f * rng.uniform();
+        in[i] = (T)(v * scale);
+    }
+    return in;
+}
+
+template <>
+std::vector<dsp::q15_t> makeInput<dsp::q15_t>(float)
+{
+    std::vector<int16_t> raw = makeInput<int16_t>(32767.0f);
+    std::vector<dsp::q15_t> in(SAMPLES);
+    for (uint32_t i = 0; i < SAMPLES; i++)
+        in[i].raw = raw[i];
+    return in;
+}
+
+static int64_t toSink(float v) { return (int64_t)v; }
+static int64_t toSink(int64_t v) { return v; }
+static int64_t toSink(int32_t v) { return v; }
+static int64_t toSink(int16_t v) { return v; }
+static int64_t toSink(dsp::q15_t v) { return v.raw; }
+
+static volatile int64_t g_sink; ///< Chặn trình biên dịch bỏ vòng lặp
+
+/// @brief Đo một bộ lọc: ns/mẫu trên cùng dữ liệu vào
+template <typename Filter, typename T>
+static double measure(Filter &filter, const std::vector<T> &in)
+{
+    int64_t acc = 0;
+    double ns = host_test::benchNsPerOp(SAMPLES, [&](uint32_t i) { acc += toSink(filter.process(in[i])); });
+    g_sink = acc;
+    return ns;
+}
+
+template <typename T>
+static void benchType(const char *name, float scale)
+{
+    std::vector<T> in = makeInput<T>(scale);
+
+    dsp::Biquad<T> biquad(kLp);
+    dsp::BiquadCascade<T, 4> cascade;
+    const dsp::BiquadCoeffs stages[4] = {kHp, kLp, kHp, kLp};
+    cascade.setCoeffs(stages);
+    dsp::Fir<T, 15> fir(kFir);
+    dsp::MovingSum<T, 128> sum;
+    dsp::DcBlocker<T> dc(kDcAlpha);
+
+    printf("%-8s %10.2f %12.2f %10.2f %12.2f %10.2f\n", name, measure(biquad, in), measure(cascade, in),
+           measure(fir, in), measure(sum, in), measure(dc, in));
+}
+
+int main()
+{
+    printf("ns/sample (%u samples)\n", SAMPLES);
+    printf("%-8s %10s %12s %10s %12s %10s\n", "type", "Biquad", "Cascade<4>", "Fir<15>", "MovingSum", "DcBlocker");
+    benchType<float>("float", 1.0f);
+    benchType<int32_t>("int32", 100000.0f);
+    benchType<int16_t>("int16", 16000.0f);
+    benchType<dsp::q15_t>("q15", 0.0f);
+    return 0;
+}
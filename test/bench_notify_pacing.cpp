@@ -0,0 +1,99 @@
+/**
+ * @file bench_notify_pacing.cpp
+ * @brief Đo thông lượng và số khung bị bỏ của NotifyPacer trên các mô hình liên kết
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Mỗi kịch bản chạy 60 giây giả lập trên FakeLink (fake_notify_link.h) với
+ * tải giống thiết bị: mẫu thời gian thực 12 byte mỗi 200 ms, cảnh báo 20 byte
+ * mỗi 5 s, khung tổng hợp 600 byte mỗi 10 s và gửi bù lịch sử liên tục
+ * (khung HISTORY_FRAME_BYTES mỗi khi lớp batch còn chỗ). In byte dữ liệu/s
+ * (không kể header mảnh và ATT), số mảnh, số lần chờ stack, số khung bỏ dở
+ * và số khung đã gửi/bị bỏ theo từng lớp ưu tiên.
+ */
+
+#include "host_test.h"
+#include "fake_notify_link.h"
+#include <vector>
+
+static const uint32_t SIM_MS = 60000;
+
+/**
+ * @struct Scenario
+ * @brief Mô hình liên kết
+ */
+struct Scenario
+{
+    const char *name;        ///< Tên in ra
+    uint16_t mtu;            ///< MTU đã thương lượng
+    uint32_t intervalMs;     ///< Khoảng kết nối
+    uint16_t chunksPerEvent; ///< Số notification radio gửi mỗi sự kiện
+    bool confEvents;         ///< Stack báo CONF cho notification
+    uint32_t stallMs;        ///< Điện thoại bận (radio không gửi) stallMs đầu mỗi 10 s
+    uint32_t reconnectMs;    ///< Kết nối lại theo chu kỳ (0 = không)
+};
+
+static void run(const Scenario &sc)
+{
+    PacerRig rig(sc.mtu);
+    FakeLink &link = rig.link;
+    link.stackSlots = 24;
+    link.congestAt = 16;
+    link.intervalMs = sc.intervalMs;
+    link.chunksPerEvent = sc.chunksPerEvent;
+    link.confEvents = sc.confEvents;
+
+    std::vector<uint8_t> realtime(12, 0x11), alert(20, 0x22), rollup(600, 0x33), history(HISTORY_FRAME_BYTES, 0x44);
+    for (uint32_t t = 1; t <= SIM_MS; t++)
+    {
+        link.chunksPerEvent = (t % 10000) < sc.stallMs ? 0 : sc.chunksPerEvent;
+        if (sc.reconnectMs && t % sc.reconnectMs == 0)
+        {
+            rig.pacer.onDisconnect();
+            rig.pacer.service();
+            link.drop();
+            rig.pacer.onConnect();
+            rig.pacer.onMtuChanged(sc.mtu);
+        }
+        link.advance(1);
+
+        if (t % 200 == 0)
+            rig.pacer.enqueue(NOTIFY_REALTIME, BLE_TARGET_HEALTH_DATA, realtime.data(), realtime.size());
+        if (t % 5000 == 0)
+            rig.pacer.enqueue(NOTIFY_ALERT, BLE_TARGET_HEALTH_DATA, alert.data(), alert.size());
+        if (t % 10000 == 0)
+            rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_ROLLUP, rollup.data(), rollup.size());
+        if (rig.queue().canPush(NOTIFY_BATCH, history.size() + rollup.size() + NOTIFY_FRAME_HEADER))
+            rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, history.data(), history.size());
+        rig.pacer.service();
+    }
+
+    const BleTransferStats &st = rig.pacer.stats();
+    const NotifyQueueStats &q = rig.queue().stats();
+    printf("%-26s %8u %8u %7u %7u %6u %7u/%-3u %7u/%-3u %7u/%-3u %6u\n", sc.name,
+           (unsigned)((uint64_t)st.bytes * 1000 / SIM_MS), (unsigned)((uint64_t)link.chunkBytes * 1000 / SIM_MS),
+           (unsigned)st.chunks, (unsigned)st.congestionWaits, (unsigned)st.failedFrames,
+           (unsigned)q.sent[NOTIFY_ALERT], (unsigned)q.dropped[NOTIFY_ALERT],
+           (unsigned)q.sent[NOTIFY_REALTIME], (unsigned)q.dropped[NOTIFY_REALTIME],
+           (unsigned)q.sent[NOTIFY_BATCH], (unsigned)q.dropped[NOTIFY_BATCH], (unsigned)link.seqErrors);
+}
+
+int main()
+{
+    const Scenario scenarios[] = {
+        {"mtu 23, 30ms x6, CONF", BLE_DEFAULT_MTU, 30, 6, true, 0, 0},
+        {"mtu 247, 15ms x6, CONF", 247, 15, 6, true, 0, 0},
+        {"mtu 512, 15ms x3, CONF", BLE_REQUESTED_MTU, 15, 3, true, 0, 0},
+        {"mtu 247, 15ms x6, no CONF", 247, 15, 6, false, 0, 0},
+        {"mtu 247, stall 1.5s/10s", 247, 15, 6, true, 1500, 0},
+        {"mtu 247, reconnect /20s", 247, 15, 6, true, 0, 20000},
+    };
+
+    printf("%u s simulated per scenario; stack %u slots, congestion at %u, window %u\n", (unsigned)(SIM_MS / 1000),
+           24u, 16u, (unsigned)BLE_NOTIFY_WINDOW);
+    printf("%-26s %8s %8s %7s %7s %6s %11s %11s %11s %6s\n", "link", "data B/s", "air B/s", "chunks", "waits",
+           "failed", "alert s/d", "rt s/d", "batch s/d", "seqErr");
+    for (const Scenario &sc : scenarios)
+        run(sc);
+    return 0;
+}
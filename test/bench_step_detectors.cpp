@@ -0,0 +1,198 @@
+/**
+ * @file bench_step_detectors.cpp
+ * @brief So sánh các bộ phát hiện bước trên tín hiệu gia tốc tổng hợp
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Chạy MPU6050Manager qua bus thanh ghi giả với từng chế độ phát hiện bước
+ * trên cùng các đoạn tín hiệu 100 Hz (đi bộ, chạy, cổ tay nghiêng/xoay,
+ * đi từng đợt ngắn xen nghỉ, đứng yên có cử động tay) và in:
+ * - Số bước phát hiện so với số bước thật, sai số (%)
+ * - Chi phí mỗi mẫu (ns, đo cả update() nên gồm giải mã thanh ghi như nhau
+ *   cho mọi chế độ; chênh lệch giữa các chế độ là chi phí bộ phát hiện)
+ */
+
+#include "host_test.h"
+#include "../mpu6050_manager.h"
+#include <math.h>
+#include <vector>
+
+static const float FS = 100.0f; ///< Tần số lấy mẫu MPU6050 (Hz)
+
+/// @brief Một mẫu gia tốc thô (±2g, 16384 LSB/g)
+struct AccelSample
+{
+    int16_t x, y, z;
+};
+
+/// @brief Mô tả một đoạn tín hiệu tổng hợp
+struct Scenario
+{
+    const char *name;  ///< Tên đoạn
+    float cadenceHz;   ///< Tần số bước (Hz)
+    float stepAmpG;    ///< Biên độ gia tốc bước theo phương đứng (g, 0 = không đi)
+    float swingAmpG;   ///< Biên độ vung tay (g, tần số cadence/2, phương ngang)
+    float tiltRad;     ///< Góc nghiêng cổ tay cố định quanh trục Y
+    float rollAmpRad;  ///< Biên độ xoay cổ tay theo nhịp vung tay
+    float noiseG;      ///< Nhiễu đều (g)
+    float seconds;     ///< Độ dài đoạn
+    float boutSeconds; ///< Đi boutSeconds rồi nghỉ boutSeconds (0 = đi liên tục)
+};
+
+static int16_t toRaw(float g)
+{
+    float v = g * 16384.0f;
+    if (v > 32767.0f)
+        v = 32767.0f;
+    if (v < -32768.0f)
+        v = -32768.0f;
+    return (int16_t)lrintf(v);
+}
+
+/**
+ * @brief Sinh tín hiệu gia tốc trong hệ tọa độ cảm biến
+ *
+ * Hệ tọa độ thế giới: Z hướng lên. Gia tốc bước (sóng sin + hài bậc 2) theo Z,
+ * vung tay theo X ở nửa tần số bước. Cảm biến nghiêng tiltRad và xoay thêm
+ * rollAmpRad theo nhịp vung tay, nên trọng lực và gia tốc động trộn vào cả 3 trục.
+ */
+static std::vector<AccelSample> generate(const Scenario &sc, uint32_t seed, uint32_t &truth)
+{
+    host_test::Rng rng(seed);
+    uint32_t n = (uint32_t)(sc.seconds * FS);
+    std::vector<AccelSample> out(n);
+    truth = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        float t = i / FS;
+        float phase = 2.0f * (float)M_PI * sc.cadenceHz * t;
+        bool walking = sc.stepAmpG > 0 &&
+                       (sc.boutSeconds == 0 || ((uint32_t)(t / sc.boutSeconds) & 1) == 0);
+        float step = walking ? sc.stepAmpG : 0.0f;
+        float wz = 1.0f + step * (sinf(phase) + 0.3f * sinf(2.0f * phase + 0.7f));
+
+        // Mỗi chu kỳ sóng bước đầy đủ trong lúc đi là một bước thật
+        if (walking && (uint32_t)(sc.cadenceHz * (t + 1.0f / FS)) > (uint32_t)(sc.cadenceHz * t))
+            truth++;
+        float wx = sc.swingAmpG * sinf(0.5f * phase);
+        float wy = 0.0f;
+
+        // Xoay quanh Y (nghiêng + xoay theo vung tay), rồi quanh X cố định 20°
+        float a = sc.tiltRad + sc.rollAmpRad * sinf(0.5f * phase);
+        float sx = cosf(a) * wx - sinf(a) * wz;
+        float sz = sinf(a) * wx + cosf(a) * wz;
+        const float b = 0.35f;
+        float sy = cosf(b) * wy - sinf(b) * sz;
+        sz = sinf(b) * wy + cosf(b) * sz;
+
+        out[i].x = toRaw(sx + sc.noiseG * rng.uniform());
+        out[i].y = toRaw(sy + sc.noiseG * rng.uniform());
+        out[i].z = toRaw(sz + sc.noiseG * rng.uniform());
+    }
+    return out;
+}
+
+/// @brief Ghi một mẫu vào thanh ghi ACCEL_XOUT_H..ZOUT_L (big-endian)
+static void loadSample(hal::RegisterBus &bus, const AccelSample &s)
+{
+    const int16_t v[3] = {s.x, s.y, s.z};
+    for (uint8_t k = 0; k < 3; k++)
+    {
+        bus.setReg(0x3B + 2 * k, (uint8_t)((uint16_t)v[k] >> 8));
+        bus.setReg(0x3C + 2 * k, (uint8_t)(v[k] & 0xFF));
+    }
+}
+
+/// @brief Kết quả chạy một chế độ trên một đoạn
+struct RunResult
+{
+    uint32_t steps;     ///< Số bước phát hiện
+    double nsPerSample; ///< Chi phí mỗi mẫu (ns)
+};
+
+static RunResult run(StepDetectorMode mode, const std::vector<AccelSample> &trace)
+{
+    hal::Clock clock;
+    hal::Logger log;
+    log.setEnabled(false);
+    hal::RegisterBus bus;
+    MPU6050Manager mpu(clock, log);
+
+    loadSample(bus, trace[0]);
+    mpu.begin(bus);
+    mpu.setStepDetectorMode(mode);
+
+    // Mỗi update() xử lý mẫu đọc ở lần gọi trước rồi bắt đầu lần đọc mới
+    double ns = host_test::benchNsPerOp((uint32_t)trace.size(), [&](uint32_t i) {
+        loadSample(bus, trace[i]);
+        mpu.update();
+        clock.advanceMs(10);
+    });
+    mpu.update();
+
+    RunResult r = {mpu.getStepCount(), ns};
+    return r;
+}
+
+int main()
+{
+    const float DEG = (float)M_PI / 180.0f;
+    const Scenario scenarios[] = {
+        {"walk 1.8Hz upright", 1.8f, 0.60f, 0.10f, 0.0f, 0.0f, 0.03f, 120.0f, 0.0f},
+        {"walk 1.8Hz tilted 60deg", 1.8f, 0.60f, 0.10f, 60 * DEG, 0.0f, 0.03f, 120.0f, 0.0f},
+        {"walk 1.6Hz wrist roll", 1.6f, 0.55f, 0.25f, 30 * DEG, 35 * DEG, 0.03f, 120.0f, 0.0f},
+        {"slow walk 1.2Hz", 1.2f, 0.45f, 0.08f, 20 * DEG, 10 * DEG, 0.03f, 120.0f, 0.0f},
+        {"run 2.8Hz", 2.8f, 0.90f, 0.30f, 40 * DEG, 20 * DEG, 0.05f, 120.0f, 0.0f},
+        {"bouts 12s walk/12s rest", 1.8f, 0.60f, 0.10f, 20 * DEG, 0.0f, 0.03f, 120.0f, 12.0f},
+        {"rest + arm gestures", 0.4f, 0.0f, 0.35f, 45 * DEG, 60 * DEG, 0.03f, 120.0f, 0.0f},
+    };
+    const StepDetectorMode modes[] = {STEP_DETECTOR_MAGNITUDE, STEP_DETECTOR_AXIS, STEP_DETECTOR_AUTOCORR};
+    const char *modeNames[] = {"magnitude", "axis", "autocorr"};
+    const size_t MODE_COUNT = sizeof(modes) / sizeof(modes[0]);
+
+    double errSum[MODE_COUNT] = {0};
+    double nsSum[MODE_COUNT] = {0};
+    uint32_t falseSteps[MODE_COUNT] = {0};
+    uint32_t walkCount = 0;
+
+    printf("%-26s %8s", "scenario", "truth");
+    for (size_t m = 0; m < MODE_COUNT; m++)
+        printf(" %10s %7s", modeNames[m], "err%");
+    printf("\n");
+
+    uint32_t seed = 1;
+    for (const Scenario &sc : scenarios)
+    {
+        uint32_t truth;
+        std::vector<AccelSample> trace = generate(sc, seed++, truth);
+        printf("%-26s %8u", sc.name, truth);
+        for (size_t m = 0; m < MODE_COUNT; m++)
+        {
+            RunResult r = run(modes[m], trace);
+            if (truth)
+            {
+                double err = 100.0 * fabs((double)r.steps - truth) / truth;
+                printf(" %10u %7.1f", r.steps, err);
+                errSum[m] += err;
+            }
+            else
+            {
+                printf(" %10u %7s", r.steps, "-");
+                falseSteps[m] += r.steps;
+            }
+            nsSum[m] += r.nsPerSample;
+        }
+        if (truth)
+            walkCount++;
+        printf("\n");
+    }
+
+    // Đoạn không đi bộ: mọi bước phát hiện được đều là bước giả
+    printf("\n%-12s %18s %12s %10s\n", "detector", "mean err% (walk)", "false steps", "ns/sample");
+    for (size_t m = 0; m < MODE_COUNT; m++)
+    {
+        printf("%-12s %18.1f %12u %10.1f\n", modeNames[m], errSum[m] / walkCount, falseSteps[m],
+               nsSum[m] / (sizeof(scenarios) / sizeof(scenarios[0])));
+    }
+    return 0;
+}
@@ -0,0 +1,215 @@
+/**
+ * @file fake_notify_link.h
+ * @brief Đường truyền BLE giả cho NotifyPacer: stack, radio và điện thoại ghép mảnh
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Mô phỏng những gì NotifyPacer thấy từ stack ESP32:
+ * - Hàng đợi notification của stack có stackSlots chỗ; đầy thì notifyChunk()
+ *   trả về BUSY, từ congestAt chỗ trở lên thì báo nghẽn (ESP_GATTS_CONGEST_EVT)
+ * - Mỗi sự kiện kết nối (intervalMs) radio gửi tối đa chunksPerEvent mảnh;
+ *   mỗi mảnh gửi xong báo CONF nếu confEvents (stack không báo CONF cho
+ *   notification thì tắt)
+ * - stackSlots = 0: stack lý tưởng, mảnh đến điện thoại và báo CONF ngay
+ * - budget giới hạn số mảnh được nhận trước khi trả về BUSY, disabled giả
+ *   lập điện thoại chưa bật notify
+ * Phía điện thoại ghép mảnh theo từng đích như ứng dụng: thiếu số thứ tự mảnh
+ * thì bỏ khung đang ghép. PacerRig gói đồng hồ, FakeLink và NotifyPacer đã
+ * kết nối cho từng kiểm thử.
+ */
+
+#pragma once
+#include "host_test.h"
+#include "../notify_pacer.h"
+#include <deque>
+#include <vector>
+
+/// @brief Khung điện thoại nhận được sau khi ghép mảnh
+struct Received
+{
+    uint8_t target;            ///< Đích
+    std::vector<uint8_t> data; ///< Dữ liệu đã ghép
+};
+
+/**
+ * @class FakeLink
+ * @brief NotifyTransport giả: stack có giới hạn, radio theo sự kiện kết nối, điện thoại ghép mảnh
+ */
+class FakeLink : public NotifyTransport
+{
+public:
+    uint16_t stackSlots = 0;     ///< Chỗ trong hàng đợi stack (0 = gửi ngay)
+    uint16_t congestAt = 0;      ///< Báo nghẽn khi số mảnh trong stack đạt ngưỡng (0 = không báo)
+    uint16_t chunksPerEvent = 4; ///< Số mảnh radio gửi mỗi sự kiện kết nối
+    uint32_t intervalMs = 15;    ///< Khoảng kết nối
+    bool confEvents = true;      ///< Stack báo CONF khi gửi xong một mảnh
+    int32_t budget = -1;         ///< Số mảnh còn nhận trước khi trả về BUSY (-1 = không giới hạn)
+    bool disabled = false;       ///< Điện thoại chưa bật notify
+
+    std::vector<Received> frames; ///< Khung đã ghép xong theo thứ tự nhận
+    uint32_t chunks = 0;          ///< Số mảnh đến điện thoại
+    uint32_t chunkBytes = 0;      ///< Số byte mảnh (kể cả header mảnh) đến điện thoại
+    uint32_t seqErrors = 0;       ///< Số lần thiếu số thứ tự mảnh
+    uint32_t maxInStack = 0;      ///< Số mảnh trong stack cao nhất
+
+    explicit FakeLink(hal::Clock &clock) : clock_(clock), pacer_(nullptr), congested_(false), nextEventMs_(0)
+    {
+        for (uint8_t t = 0; t < BLE_TARGET_COUNT; t++)
+        {
+            expectSeq_[t] = -1;
+            assembling_[t] = false;
+        }
+    }
+
+    /// @brief Gắn bộ gửi nhận sự kiện nghẽn/CONF
+    void attach(NotifyPacer &pacer) { pacer_ = &pacer; }
+
+    NotifyTxResult notifyChunk(uint8_t target, const uint8_t *chunk, uint16_t len) override
+    {
+        if (disabled)
+            return NOTIFY_TX_DISABLED;
+        if (budget == 0 || (stackSlots && stack_.size() >= stackSlots))
+            return NOTIFY_TX_BUSY;
+        if (budget > 0)
+            budget--;
+
+        Chunk c = {target, std::vector<uint8_t>(chunk, chunk + len)};
+        if (!stackSlots)
+        {
+            deliver(c);
+            return NOTIFY_TX_OK;
+        }
+        stack_.push_back(c);
+        if (stack_.size() > maxInStack)
+            maxInStack = stack_.size();
+        if (congestAt && !congested_ && stack_.size() >= congestAt)
+            setCongested(true);
+        return NOTIFY_TX_OK;
+    }
+
+    /// @brief Một sự kiện kết nối: radio gửi tối đa chunksPerEvent mảnh từ stack
+    void connectionEvent()
+    {
+        for (uint16_t i = 0; i < chunksPerEvent && !stack_.empty(); i++)
+        {
+            deliver(stack_.front());
+            stack_.pop_front();
+        }
+        if (congested_ && stack_.size() < congestAt)
+            setCongested(false);
+    }
+
+    /// @brief Tiến đồng hồ ms, chạy các sự kiện kết nối đến hạn
+    void advance(uint32_t ms)
+    {
+        uint32_t end = clock_.millis() + ms;
+        while ((int32_t)(nextEventMs_ - end) <= 0)
+        {
+            if ((int32_t)(nextEventMs_ - clock_.millis()) > 0)
+                clock_.advanceMs(nextEventMs_ - clock_.millis());
+            connectionEvent();
+            nextEventMs_ += intervalMs;
+        }
+        if ((int32_t)(end - clock_.millis()) > 0)
+            clock_.advanceMs(end - clock_.millis());
+    }
+
+    /// @brief Mất kết nối: mảnh còn trong stack bị bỏ, điện thoại bỏ khung đang ghép và bộ đếm mảnh
+    void drop()
+    {
+        stack_.clear();
+        congested_ = false;
+        for (uint8_t t = 0; t < BLE_TARGET_COUNT; t++)
+        {
+            expectSeq_[t] = -1;
+            assembling_[t] = false;
+        }
+    }
+
+    size_t inStack() const { return stack_.size(); }
+
+private:
+    struct Chunk
+    {
+        uint8_t target;
+        std::vector<uint8_t> bytes;
+    };
+
+    void setCongested(bool congested)
+    {
+        congested_ = congested;
+        if (pacer_)
+            pacer_->onCongestion(congested);
+    }
+
+    /// @brief Mảnh đến điện thoại: báo CONF rồi ghép như ứng dụng
+    void deliver(const Chunk &c)
+    {
+        chunks++;
+        chunkBytes += c.bytes.size();
+        if (confEvents && pacer_)
+            pacer_->onConfirm();
+
+        std::vector<uint8_t> &partial = partial_[c.target];
+        int16_t &expect = expectSeq_[c.target];
+        bool &assembling = assembling_[c.target];
+        if (expect >= 0 && c.bytes[0] != (uint8_t)expect)
+        {
+            seqErrors++;
+            assembling = false;
+        }
+        expect = (uint8_t)(c.bytes[0] + 1);
+        if (c.bytes[1] & BLE_CHUNK_FIRST)
+        {
+            partial.clear();
+            assembling = true;
+        }
+        if (!assembling)
+            return; // Bỏ phần còn lại của khung thiếu mảnh
+        partial.insert(partial.end(), c.bytes.begin() + BLE_CHUNK_HEADER_SIZE, c.bytes.end());
+        if (c.bytes[1] & BLE_CHUNK_LAST)
+        {
+            frames.push_back(Received{c.target, partial});
+            assembling = false;
+        }
+    }
+
+    hal::Clock &clock_;                              ///< Đồng hồ dùng chung với NotifyPacer
+    NotifyPacer *pacer_;                             ///< Nhận sự kiện nghẽn/CONF
+    bool congested_;                                 ///< Đã báo nghẽn
+    uint32_t nextEventMs_;                           ///< Sự kiện kết nối kế tiếp
+    std::deque<Chunk> stack_;                        ///< Hàng đợi notification của stack
+    std::vector<uint8_t> partial_[BLE_TARGET_COUNT]; ///< Khung đang ghép theo đích
+    int16_t expectSeq_[BLE_TARGET_COUNT];            ///< Số thứ tự mảnh kế tiếp theo đích (-1 = chưa có)
+    bool assembling_[BLE_TARGET_COUNT];              ///< Đang ghép khung (đã nhận FIRST, chưa thiếu mảnh)
+};
+
+/**
+ * @struct PacerRig
+ * @brief NotifyPacer thật nối với FakeLink (mặc định lý tưởng: mảnh đến ngay), đã kết nối
+ */
+struct PacerRig
+{
+    hal::Clock clock;  ///< Đồng hồ giả
+    hal::Logger log;   ///< Log (tắt)
+    FakeLink link;     ///< Đường truyền giả
+    NotifyPacer pacer; ///< Bộ gửi đang kiểm thử (chứa NotifyQueue)
+
+    /// @param mtu MTU đã thương lượng (dữ liệu mỗi mảnh = MTU - 5)
+    explicit PacerRig(uint16_t mtu) : link(clock), pacer(link, clock, log)
+    {
+        log.setEnabled(false);
+        link.attach(pacer);
+        pacer.onConnect();
+        pacer.onMtuChanged(mtu);
+    }
+
+    const NotifyQueue &queue() const { return pacer.queue(); }
+
+    /// @brief Gửi hết những gì link cho phép
+    void drain()
+    {
+        link.budget = -1;
+        pacer.service();
+    }
+};
@@ -0,0 +1,95 @@
+/**
+ * @file host_test.h
+ * @brief Tiện ích tối thiểu cho kiểm thử và đo hiệu năng trên host
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Mỗi file test_*.cpp / bench_*.cpp là một chương trình riêng có main():
+ * - CHECK / CHECK_NEAR ghi lỗi kèm vị trí, không dừng chương trình
+ * - TEST_EXIT() trả mã thoát khác 0 nếu có kiểm tra thất bại
+ * - benchNsPerOp() đo thời gian trung bình mỗi lần gọi bằng đồng hồ thật
+ *
+ * Biên dịch và chạy tất cả bằng test/run_host_tests.sh.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+
+namespace host_test
+{
+    /// @brief Số kiểm tra thất bại trong chương trình
+    inline uint32_t &failures()
+    {
+        static uint32_t count = 0;
+        return count;
+    }
+
+    /// @brief Số kiểm tra đã chạy
+    inline uint32_t &checks()
+    {
+        static uint32_t count = 0;
+        return count;
+    }
+
+    /// @brief Thời gian trung bình (ns) mỗi lần gọi fn(i), i = 0..iterations-1
+    template <typename Fn>
+    double benchNsPerOp(uint32_t iterations, Fn fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < iterations; i++)
+            fn(i);
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    }
+
+    /// @brief Bộ sinh số giả ngẫu nhiên cố định (LCG) để kết quả lặp lại được
+    class Rng
+    {
+    public:
+        explicit Rng(uint32_t seed = 1) : state_(seed) {}
+
+        uint32_t next()
+        {
+            state_ = state_ * 1664525u + 1013904223u;
+            return state_;
+        }
+
+        /// @brief Số thực đều trong [-1, 1)
+        float uniform() { return (float)(next() >> 8) / (float)(1u << 23) - 1.0f; }
+
+    private:
+        uint32_t state_;
+    };
+}
+
+#define CHECK(cond)                                                           \
+    do                                                                        \
+    {                                                                         \
+        host_test::checks()++;                                                \
+        if (!(cond))                                                          \
+        {                                                                     \
+            host_test::failures()++;                                          \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);            \
+        }                                                                     \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tol)                                                 \
+    do                                                                        \
+    {                                                                         \
+        host_test::checks()++;                                                \
+        double va_ = (double)(a), vb_ = (double)(b);                          \
+        if (fabs(va_ - vb_) > (double)(tol))                                  \
+        {                                                                     \
+            host_test::failures()++;                                          \
+            printf("FAIL %s:%d: %s = %g, %s = %g (tol %g)\n", __FILE__,       \
+                   __LINE__, #a, va_, #b, vb_, (double)(tol));                \
+        }                                                                     \
+    } while (0)
+
+#define TEST_EXIT()                                                           \
+    (printf("%u/%u checks passed\n", host_test::checks() - host_test::failures(), \
+            host_test::checks()),                                             \
+     host_test::failures() ? 1 : 0)
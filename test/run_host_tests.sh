@@ -0,0 +1,50 @@
+#!/bin/bash
+# Biên dịch và chạy kiểm thử / đo hiệu năng trên host (HAL giả lập, không cần phần cứng)
+#
+# Dùng: test/run_host_tests.sh [tên ...]    (mặc định: tất cả)
+# - test_*: bật ASan/UBSan (TSan cho test đa luồng), thoát khác 0 nếu có kiểm tra thất bại
+# - bench_*: -O2 không sanitizer để số đo có ý nghĩa
+set -u
+cd "$(dirname "$0")/.."
+
+CXX=${CXX:-g++}
+OUT=test/build
+COMMON="-std=gnu++17 -Wall -Wextra -Wno-unused-parameter -I. -g"
+SAN="-O1 -fsanitize=address,undefined -fno-omit-frame-pointer"
+TSAN="-O1 -fsanitize=thread"
+BENCH="-O2"
+
+# tên|cờ|nguồn firmware cần liên kết
+TARGETS="
+test_dsp_filters|SAN|
+bench_dsp_filters|BENCH|
+test_flash_log|SAN|flash_log.cpp data_buffer.cpp history_store.cpp rollup.cpp deadband.cpp batch_codec.cpp
+test_batch_codec|SAN|batch_codec.cpp
+bench_batch_codec|BENCH|batch_codec.cpp
+test_notify_queue|SAN|notify_queue.cpp notify_pacer.cpp
+test_notify_pacer|SAN|notify_queue.cpp notify_pacer.cpp
+bench_notify_pacing|BENCH|notify_queue.cpp notify_pacer.cpp
+test_spsc_queue|TSAN|
+bench_step_detectors|BENCH|mpu6050_manager.cpp axis_step_detector.cpp autocorr_step_counter.cpp
+"
+
+mkdir -p "$OUT"
+rc=0
+while IFS='|' read -r name mode srcs; do
+    [ -z "$name" ] && continue
+    if [ $# -gt 0 ] && [[ " $* " != *" $name "* ]]; then
+        continue
+    fi
+    flags=${!mode}
+    echo "=== $name"
+    if ! $CXX $COMMON $flags "test/$name.cpp" $srcs -o "$OUT/$name" -lpthread; then
+        echo "BUILD FAILED: $name"
+        rc=1
+        continue
+    fi
+    if ! "$OUT/$name"; then
+        echo "FAILED: $name"
+        rc=1
+    fi
+done <<< "$TARGETS"
+exit $rc
@@ -0,0 +1,48 @@
+/**
+ * @file sample_stream.h
+ * @brief Luồng HealthDataPacket tổng hợp cho kiểm thử và đo codec
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Giống dữ liệu thật của DataBuffer: mẫu mỗi 2 giây, thỉnh thoảng lệch 1 giây
+ * hoặc nhảy thời gian (mất nguồn, đồng bộ NTP); nhịp tim trôi chậm với vài
+ * giá trị nhảy; SpO2 gần như hằng; bước chân tăng theo từng đợt đi bộ và
+ * reset về 0 (qua ngày mới).
+ */
+
+#pragma once
+#include "host_test.h"
+#include "../health_data_packet.h"
+#include <string.h>
+#include <vector>
+
+/// @brief Sinh n mẫu xác định theo seed
+inline std::vector<HealthDataPacket> makeSampleStream(size_t n, uint32_t seed = 3)
+{
+    host_test::Rng rng(seed);
+    std::vector<HealthDataPacket> out(n);
+    HealthDataPacket p;
+    memset(&p, 0, sizeof(p));
+    p.timestamp = 1700000000;
+    p.steps = 100;
+    p.hr = 70;
+    p.spo2 = 97;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t r = rng.next() % 1000;
+        p.timestamp += (r < 990) ? 2 : ((r < 999) ? 3 : 100000);
+        if (rng.next() % 3 == 0)
+            p.hr = (uint8_t)(p.hr + (int)(rng.next() % 5) - 2);
+        if (rng.next() % 1000 == 0)
+            p.hr = (uint8_t)rng.next();
+        if (rng.next() % 50 == 0)
+            p.spo2 = (uint8_t)(rng.next() % 101);
+        if ((i / 5000) % 2)
+            p.steps += rng.next() % 6;
+        if (i == n / 2)
+            p.steps = 0;
+        out[i] = p;
+    }
+    return out;
+}
@@ -0,0 +1,284 @@
+/**
+ * @file test_batch_codec.cpp
+ * @brief Kiểm thử mã hóa/giải mã khung batch: khứ hồi, khung cắt cụt, khung hỏng
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * - Khứ hồi: mọi mẫu giải mã khớp từng byte với mẫu gốc, kể cả số thứ tự,
+ *   khối hoạt động và các giá trị biên (nhảy thời gian, reset bước, HR 0/255)
+ * - Cắt cụt tại mọi độ dài: begin() từ chối, hoặc các mẫu giải mã được là
+ *   tiền tố đúng của khung gốc và bộ giải mã báo lỗi trước khi hết count()
+ * - Lật bit ngẫu nhiên: không đọc ngoài bộ đệm (chạy dưới ASan)
+ * - Bố cục cột: các kiểm tra trên cho BatchColumnEncoder, thêm decodeColumn()
+ *   khớp từng cột với luồng gốc
+ */
+
+#include "host_test.h"
+#include "sample_stream.h"
+#include "../batch_codec.h"
+
+static bool sameSample(const HealthDataPacket &a, const HealthDataPacket &b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+/// @brief Mã hóa toàn bộ luồng thành các khung tối đa frameBytes byte
+template <typename Encoder = BatchEncoder>
+static std::vector<std::vector<uint8_t>> encodeFrames(const std::vector<HealthDataPacket> &v, size_t frameBytes,
+                                                      bool withSeq)
+{
+    std::vector<std::vector<uint8_t>> frames;
+    size_t i = 0;
+    while (i < v.size())
+    {
+        std::vector<uint8_t> f(frameBytes);
+        Encoder enc;
+        if (withSeq)
+            enc.begin(f.data(), f.size(), (uint32_t)i);
+        else
+            enc.begin(f.data(), f.size());
+        while (i < v.size() && enc.add(v[i]))
+            i++;
+        f.resize(enc.finish());
+        frames.push_back(f);
+    }
+    return frames;
+}
+
+static void testRoundTrip()
+{
+    std::vector<HealthDataPacket> v = makeSampleStream(200000);
+    const size_t sizes[] = {BATCH_FRAME_CAPACITY(1), 64, 244, 4096};
+    for (size_t frameBytes : sizes)
+    {
+        for (int withSeq = 0; withSeq < 2; withSeq++)
+        {
+            std::vector<std::vector<uint8_t>> frames = encodeFrames(v, frameBytes, withSeq);
+            size_t k = 0;
+            bool ok = true;
+            for (const std::vector<uint8_t> &f : frames)
+            {
+                BatchDecoder dec;
+                CHECK(dec.begin(f.data(), f.size()));
+                CHECK(dec.hasSequence() == (bool)withSeq);
+                if (withSeq)
+                    CHECK(dec.sequence() == k);
+                else
+                    CHECK(dec.epoch() == 0);
+                CHECK(!dec.hasActivity());
+                HealthDataPacket out;
+                uint16_t n = 0;
+                while (dec.next(out))
+                {
+                    ok = ok && k < v.size() && sameSample(out, v[k]);
+                    k++;
+                    n++;
+                }
+                CHECK(!dec.error());
+                CHECK(n == dec.count() && n > 0);
+            }
+            CHECK(ok);
+            CHECK(k == v.size());
+        }
+    }
+}
+
+static void testEdgeValues()
+{
+    // Mọi trường ở giá trị biên, delta lớn nhất theo cả hai chiều
+    HealthDataPacket seq[8];
+    memset(seq, 0, sizeof(seq));
+    const uint32_t ts[8] = {0, 2, 0xFFFFFFFFu, 0, 4, 6, 8, 0x80000000u};
+    const uint32_t steps[8] = {0xFFFFFFFFu, 0, 1, 0x7FFFFFFFu, 0x80000000u, 5, 0, 0xFFFFFFFFu};
+    const uint8_t hr[8] = {0, 255, 0, 128, 127, 255, 1, 254};
+    const uint8_t spo2[8] = {100, 0, 255, 99, 98, 0, 100, 100};
+    for (int i = 0; i < 8; i++)
+    {
+        seq[i].timestamp = ts[i];
+        seq[i].steps = steps[i];
+        seq[i].hr = hr[i];
+        seq[i].spo2 = spo2[i];
+    }
+
+    uint8_t frame[BATCH_FRAME_CAPACITY(8)];
+    BatchEncoder enc;
+    enc.begin(frame, sizeof(frame), 0xFFFFFFF0u, 0x8BADF00Du);
+    ActivityFields act = {250, 123, 65535, 40000};
+    enc.setActivity(act);
+    for (const HealthDataPacket &p : seq)
+        CHECK(enc.add(p));
+    size_t len = enc.finish();
+
+    BatchDecoder dec;
+    CHECK(dec.begin(frame, len));
+    CHECK(dec.sequence() == 0xFFFFFFF0u && dec.epoch() == 0x8BADF00Du);
+    CHECK(dec.hasActivity() && memcmp(&dec.activity(), &act, sizeof(act)) == 0);
+    HealthDataPacket out;
+    for (int i = 0; i < 8; i++)
+    {
+        CHECK(dec.next(out));
+        CHECK(sameSample(out, seq[i]));
+    }
+    CHECK(!dec.next(out));
+    CHECK(!dec.error());
+
+    // Khung rỗng không được tạo
+    BatchEncoder empty;
+    empty.begin(frame, sizeof(frame));
+    CHECK(empty.finish() == 0);
+
+    // Bộ đệm không đủ cho một bản ghi đầy đủ: từ chối mẫu
+    BatchEncoder tiny;
+    tiny.begin(frame, BATCH_HEADER_SIZE + 2);
+    CHECK(!tiny.add(seq[0]));
+}
+
+/// @brief Mọi độ dài cắt cụt của khung đều được từ chối hoặc báo lỗi
+static void checkTruncations(const std::vector<uint8_t> &f, const std::vector<HealthDataPacket> &ref, size_t first)
+{
+    bool ok = true;
+    for (size_t cut = 0; cut < f.size(); cut++)
+    {
+        // Sao chép đúng cut byte để ASan bắt mọi lần đọc vượt độ dài
+        std::vector<uint8_t> part(f.begin(), f.begin() + cut);
+        BatchDecoder dec;
+        if (!dec.begin(part.data(), part.size()))
+            continue;
+        HealthDataPacket out;
+        uint16_t n = 0;
+        while (dec.next(out))
+        {
+            ok = ok && sameSample(out, ref[first + n]);
+            n++;
+        }
+        ok = ok && dec.error() && n < dec.count();
+    }
+    CHECK(ok);
+}
+
+static void testTruncated()
+{
+    std::vector<HealthDataPacket> v = makeSampleStream(3000, 11);
+    for (size_t frameBytes : {(size_t)64, (size_t)244, (size_t)1024})
+    {
+        std::vector<std::vector<uint8_t>> frames = encodeFrames(v, frameBytes, true);
+        size_t first = 0;
+        for (size_t i = 0; i < frames.size() && i < 20; i++)
+        {
+            checkTruncations(frames[i], v, first);
+            BatchDecoder dec;
+            dec.begin(frames[i].data(), frames[i].size());
+            first += dec.count();
+        }
+    }
+}
+
+template <typename Encoder>
+static void testCorrupted(const char *layout)
+{
+    std::vector<HealthDataPacket> v = makeSampleStream(500, 5);
+    std::vector<std::vector<uint8_t>> frames = encodeFrames<Encoder>(v, 244, true);
+    host_test::Rng rng(9);
+    uint32_t decoded = 0;
+    for (uint32_t trial = 0; trial < 20000; trial++)
+    {
+        std::vector<uint8_t> f = frames[trial % frames.size()];
+        uint32_t flips = 1 + rng.next() % 4;
+        for (uint32_t k = 0; k < flips; k++)
+            f[rng.next() % f.size()] ^= (uint8_t)(1u << (rng.next() % 8));
+        BatchDecoder dec;
+        if (!dec.begin(f.data(), f.size()))
+            continue;
+        uint32_t column[BATCH_COLUMN_MAX_SAMPLES];
+        for (uint8_t c = 0; c < dec.fieldCount(); c++)
+            CHECK(dec.decodeColumn(c, column, BATCH_COLUMN_MAX_SAMPLES) <= dec.count());
+        HealthDataPacket out;
+        uint16_t n = 0;
+        while (dec.next(out))
+            n++;
+        CHECK(n <= dec.count());
+        decoded += n;
+    }
+    printf("corrupted %s frames: %u samples decoded without out-of-bounds reads\n", layout, decoded);
+}
+
+/// @brief Giá trị trường id của mẫu (như decodeColumn() trả về)
+static uint32_t fieldValue(const HealthDataPacket &p, uint8_t id)
+{
+    switch (id)
+    {
+    case FIELD_TIMESTAMP:
+        return p.timestamp;
+    case FIELD_STEPS:
+        return p.steps;
+    case FIELD_HR:
+        return p.hr;
+    default:
+        return p.spo2;
+    }
+}
+
+static void testColumnar()
+{
+    std::vector<HealthDataPacket> v = makeSampleStream(50000, 13);
+    for (size_t frameBytes : {(size_t)64, (size_t)244, (size_t)4096})
+    {
+        std::vector<std::vector<uint8_t>> frames = encodeFrames<BatchColumnEncoder>(v, frameBytes, true);
+        size_t k = 0;
+        bool samplesOk = true, columnsOk = true;
+        for (const std::vector<uint8_t> &f : frames)
+        {
+            BatchDecoder dec;
+            CHECK(dec.begin(f.data(), f.size()));
+            CHECK(dec.columnar() && dec.sequence() == k);
+            CHECK(dec.count() > 0 && dec.count() <= BATCH_COLUMN_MAX_SAMPLES);
+            if (k + dec.count() > v.size())
+            {
+                CHECK(false);
+                break;
+            }
+
+            uint32_t column[BATCH_COLUMN_MAX_SAMPLES];
+            for (uint8_t c = 0; c < dec.fieldCount(); c++)
+            {
+                uint16_t n = dec.decodeColumn(c, column, BATCH_COLUMN_MAX_SAMPLES);
+                columnsOk = columnsOk && n == dec.count();
+                for (uint16_t j = 0; j < n; j++)
+                    columnsOk = columnsOk && column[j] == fieldValue(v[k + j], dec.fieldId(c));
+            }
+
+            HealthDataPacket out;
+            uint16_t n = 0;
+            while (dec.next(out))
+            {
+                samplesOk = samplesOk && sameSample(out, v[k + n]);
+                n++;
+            }
+            CHECK(!dec.error() && n == dec.count());
+            k += n;
+        }
+        CHECK(samplesOk);
+        CHECK(columnsOk);
+        CHECK(k == v.size());
+
+        size_t first = 0;
+        for (size_t i = 0; i < frames.size() && i < 20; i++)
+        {
+            checkTruncations(frames[i], v, first);
+            BatchDecoder dec;
+            dec.begin(frames[i].data(), frames[i].size());
+            first += dec.count();
+        }
+    }
+}
+
+int main()
+{
+    testRoundTrip();
+    testEdgeValues();
+    testTruncated();
+    testCorrupted<BatchEncoder>("row");
+    testColumnar();
+    testCorrupted<BatchColumnEncoder>("columnar");
+    return TEST_EXIT();
+}
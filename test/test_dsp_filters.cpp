@@ -0,0 +1,350 @@
+/**
+ * @file test_dsp_filters.cpp
+ * @brief Kiểm thử dsp_filters.h: hệ số constexpr, đáp ứng xung và đáp ứng bậc
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * So sánh mỗi kernel với phương trình sai phân tính bằng double:
+ * - Hệ số RBJ / chặn DC / FIR thiết kế lúc biên dịch khớp công thức <math.h>
+ * - Kiểu float khớp tham chiếu gần như tuyệt đối
+ * - Kiểu số nguyên (Q28, tích lũy 64-bit) khớp trong sai số làm tròn
+ */
+
+#include "host_test.h"
+#include "../dsp_filters.h"
+#include <math.h>
+
+static const double PI_D = 3.14159265358979323846;
+
+// Hệ số phải tính được lúc biên dịch
+static constexpr dsp::BiquadCoeffs kLp = dsp::designLowPass(5.0f, 100.0f);
+static constexpr dsp::BiquadCoeffs kHp = dsp::designHighPass(0.5f, 100.0f);
+static constexpr dsp::BiquadCoeffs kBp = dsp::designBandPass(2.0f, 50.0f, 1.5f);
+static constexpr double kDcAlpha = dsp::designDcBlocker(0.4923, 100.0);
+static constexpr dsp::FirCoeffs<15> kFir = dsp::designLowPassFir<15>(8.0f, 100.0f);
+static_assert(kLp.b0 > 0.0f && kHp.b0 > 0.0f && kBp.b1 == 0.0f, "RBJ coefficients must be constexpr");
+static_assert(kDcAlpha > 0.96f && kDcAlpha < 0.98f, "DC blocker alpha ~0.97 at 0.49 Hz / 100 Hz");
+
+/// @brief Tham chiếu double cho một biquad
+struct RefBiquad
+{
+    double b0, b1, b2, a1, a2;
+    double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+    explicit RefBiquad(const dsp::BiquadCoeffs &c) : b0(c.b0), b1(c.b1), b2(c.b2), a1(c.a1), a2(c.a2) {}
+
+    /// @brief Tham chiếu với hệ số đã lượng tử hóa Q28 (tách sai số hệ số khỏi sai số làm tròn)
+    static RefBiquad quantized(const dsp::BiquadCoeffs &c)
+    {
+        RefBiquad r(c);
+        double *k[5] = {&r.b0, &r.b1, &r.b2, &r.a1, &r.a2};
+        const double f[5] = {c.b0, c.b1, c.b2, c.a1, c.a2};
+        for (int i = 0; i < 5; i++)
+            *k[i] = dsp::SampleTraits<int32_t>::coeff(f[i]) / (double)(1L << dsp::COEFF_SHIFT);
+        // Như Biquad::setCoeffs: b1 giữ tổng tử số đã lượng tử hóa
+        r.b1 = dsp::SampleTraits<int32_t>::coeff(c.b0 + c.b1 + c.b2) / (double)(1L << dsp::COEFF_SHIFT) - r.b0 - r.b2;
+        return r;
+    }
+
+    double process(double x)
+    {
+        double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        return y;
+    }
+};
+
+/// @brief Công thức RBJ bằng double (kind: 0 = LP, 1 = HP, 2 = BP)
+static void rbjReference(int kind, double fc, double fs, double q, double out[5])
+{
+    double w0 = 2 * PI_D * fc / fs;
+    double cw = cos(w0), alpha = sin(w0) / (2 * q), a0 = 1 + alpha;
+    if (kind == 0)
+    {
+        out[0] = (1 - cw) / 2 / a0;
+        out[1] = (1 - cw) / a0;
+        out[2] = (1 - cw) / 2 / a0;
+    }
+    else if (kind == 1)
+    {
+        out[0] = (1 + cw) / 2 / a0;
+        out[1] = -(1 + cw) / a0;
+        out[2] = (1 + cw) / 2 / a0;
+    }
+    else
+    {
+        out[0] = alpha / a0;
+        out[1] = 0;
+        out[2] = -alpha / a0;
+    }
+    out[3] = -2 * cw / a0;
+    out[4] = (1 - alpha) / a0;
+}
+
+static void testCoefficients()
+{
+    const dsp::BiquadCoeffs designs[3] = {kLp, kHp, kBp};
+    const double params[3][3] = {{5, 100, 0.7071067811865476}, {0.5, 100, 0.7071067811865476}, {2, 50, 1.5}};
+    for (int kind = 0; kind < 3; kind++)
+    {
+        double ref[5];
+        rbjReference(kind, params[kind][0], params[kind][1], params[kind][2], ref);
+        // Thiết kế bằng double: sai số nhỏ hơn nhiều so với 1 LSB của Q28 (3.7e-9)
+        const dsp::BiquadCoeffs &c = designs[kind];
+        const double got[5] = {c.b0, c.b1, c.b2, c.a1, c.a2};
+        for (int i = 0; i < 5; i++)
+        {
+            CHECK_NEAR(got[i], ref[i], 1e-12);
+            CHECK(dsp::SampleTraits<int32_t>::coeff(got[i]) == dsp::SampleTraits<int32_t>::coeff(ref[i]));
+        }
+    }
+
+    // Độ lợi DC: LP = 1, HP = 0, BP = 0
+    CHECK_NEAR((kLp.b0 + kLp.b1 + kLp.b2) / (1 + kLp.a1 + kLp.a2), 1.0, 1e-5);
+    CHECK_NEAR(kHp.b0 + kHp.b1 + kHp.b2, 0.0, 1e-6);
+    CHECK_NEAR(kBp.b0 + kBp.b1 + kBp.b2, 0.0, 1e-6);
+
+    double rc = 1 / (2 * PI_D * 0.4923);
+    CHECK_NEAR(kDcAlpha, rc / (rc + 0.01), 1e-12);
+
+    // FIR: độ lợi DC = 1, đối xứng (pha tuyến tính), khớp sinc·Hamming
+    double sum = 0, ref[15], refSum = 0;
+    for (int i = 0; i < 15; i++)
+    {
+        double m = i - 7.0, wc = 2 * PI_D * 8.0 / 100.0;
+        double sinc = (m == 0) ? wc / PI_D : sin(wc * m) / (PI_D * m);
+        ref[i] = sinc * (0.54 - 0.46 * cos(2 * PI_D * i / 14.0));
+        refSum += ref[i];
+        sum += kFir.h[i];
+    }
+    CHECK_NEAR(sum, 1.0, 1e-5);
+    for (int i = 0; i < 15; i++)
+    {
+        CHECK_NEAR(kFir.h[i], kFir.h[14 - i], 1e-12);
+        CHECK_NEAR(kFir.h[i], ref[i] / refSum, 1e-12);
+    }
+}
+
+static void testBiquad()
+{
+    // float: đáp ứng xung khớp tham chiếu
+    {
+        dsp::Biquad<float> f(kLp);
+        RefBiquad r(kLp);
+        for (int n = 0; n < 200; n++)
+        {
+            double x = (n == 0) ? 1.0 : 0.0;
+            CHECK_NEAR(f.process((float)x), r.process(x), 1e-6);
+        }
+    }
+
+    // int32: đáp ứng bậc trong sai số làm tròn, hội tụ đúng về độ lợi DC
+    // (HP 0.5 Hz có cực rất gần 1: không có error feedback sẽ kẹt ở ~-500)
+    {
+        const int32_t STEP = 1 << 20;
+        dsp::Biquad<int32_t> lp(kLp);
+        dsp::Biquad<int32_t> hp(kHp);
+        RefBiquad rl = RefBiquad::quantized(kLp), rh = RefBiquad::quantized(kHp);
+        int32_t yl = 0, yh = 0;
+        for (int n = 0; n < 2000; n++)
+        {
+            yl = lp.process(STEP);
+            yh = hp.process(STEP);
+            // Nhiễu làm tròn qua cực HP gần 1 được khuếch đại (~15 lần), vẫn < 1e-5 bậc
+            CHECK_NEAR(yl, rl.process(STEP), 2);
+            CHECK_NEAR(yh, rh.process(STEP), 10);
+        }
+        CHECK_NEAR(yl, STEP, 1);
+        CHECK_NEAR(yh, 0, 1);
+    }
+
+    // Tần số cắt thấp: 1 + a1 + a2 ≈ 1.6e-4 (~42000 LSB Q28). Hệ số thiết kế bằng
+    // float (sai số ~1e-7 ≈ 30 LSB ở a1) lệch độ lợi DC ~0.04%, thiết kế double < 0.01%
+    {
+        static constexpr dsp::BiquadCoeffs kSlow = dsp::designLowPass(0.2, 100.0);
+        dsp::Biquad<int32_t> lp(kSlow);
+        const int32_t STEP = 1 << 20;
+        int32_t y = 0;
+        for (int n = 0; n < 20000; n++)
+            y = lp.process(STEP);
+        CHECK_NEAR(y, STEP, STEP * 1e-4);
+    }
+
+    // int16 và q15: đáp ứng xung và bậc theo tham chiếu (sai số vài LSB do làm tròn từng mẫu)
+    {
+        dsp::Biquad<int16_t> s16(kLp);
+        dsp::Biquad<dsp::q15_t> q15(kLp);
+        RefBiquad r = RefBiquad::quantized(kLp);
+        double maxErr16 = 0, maxErrQ15 = 0;
+        for (int n = 0; n < 500; n++)
+        {
+            double x = (n == 0) ? 16384 : 0;
+            double ref = r.process(x);
+            maxErr16 = fmax(maxErr16, fabs(s16.process((int16_t)x) - ref));
+            maxErrQ15 = fmax(maxErrQ15, fabs(q15.process(dsp::q15_t{(int16_t)x}).raw - ref));
+        }
+        CHECK(maxErr16 <= 2);
+        CHECK(maxErrQ15 <= 2);
+
+        s16.reset();
+        int16_t y = 0;
+        for (int n = 0; n < 500; n++)
+            y = s16.process(10000);
+        CHECK_NEAR(y, 10000, 2);
+    }
+
+    // Vọt lố của sóng vuông biên độ tối đa bị bão hòa, không quay vòng sang dấu ngược
+    {
+        dsp::Biquad<int16_t> lp(kLp);
+        RefBiquad r = RefBiquad::quantized(kLp);
+        bool saturated = false, wrapped = false;
+        for (int n = 0; n < 400; n++)
+        {
+            int16_t x = ((n / 50) % 2) ? INT16_MAX : INT16_MIN;
+            double ref = r.process(x);
+            int16_t y = lp.process(x);
+            if (ref > INT16_MAX)
+            {
+                saturated = saturated || y == INT16_MAX;
+                wrapped = wrapped || y < 0;
+            }
+            r.y1 = y; // Tham chiếu theo đúng trạng thái đã bão hòa
+        }
+        CHECK(saturated);
+        CHECK(!wrapped);
+    }
+}
+
+static void testCascade()
+{
+    const dsp::BiquadCoeffs stages[2] = {kHp, kLp};
+    dsp::BiquadCascade<float, 2> f;
+    f.setCoeffs(stages);
+    dsp::BiquadCascade<int32_t, 2> i32;
+    i32.setCoeffs(stages);
+    RefBiquad r0(kHp), r1(kLp);
+    RefBiquad q0 = RefBiquad::quantized(kHp), q1 = RefBiquad::quantized(kLp);
+    const int32_t AMP = 1 << 20;
+    for (int n = 0; n < 300; n++)
+    {
+        double x = (n == 0) ? 1.0 : 0.0;
+        CHECK_NEAR(f.process((float)x), r1.process(r0.process(x)), 1e-5);
+        CHECK_NEAR(i32.process((int32_t)(x * AMP)), q1.process(q0.process(x * AMP)), 6);
+    }
+
+    // Đáp ứng bậc của HP·LP về 0
+    i32.reset();
+    int32_t y = 0;
+    for (int n = 0; n < 3000; n++)
+        y = i32.process(AMP);
+    CHECK_NEAR(y, 0, 1);
+}
+
+static void testFir()
+{
+    // Đáp ứng xung = dãy hệ số (đã lượng tử hóa)
+    dsp::Fir<float, 15> f(kFir);
+    dsp::Fir<int16_t, 15> s16(kFir);
+    for (int n = 0; n < 20; n++)
+    {
+        double h = (n < 15) ? kFir.h[n] : 0.0;
+        CHECK_NEAR(f.process(n == 0 ? 1.0f : 0.0f), h, 1e-7);
+        CHECK_NEAR(s16.process(n == 0 ? 16384 : 0), h * 16384, 1);
+    }
+
+    // Đáp ứng bậc: tổng tích lũy hệ số, ổn định sau N mẫu ở độ lợi DC
+    dsp::Fir<int32_t, 15> i32(kFir);
+    double acc = 0;
+    for (int n = 0; n < 30; n++)
+    {
+        acc += (n < 15) ? kFir.h[n] : 0.0;
+        CHECK_NEAR(i32.process(1000000), acc * 1000000, 2);
+    }
+}
+
+static void testMovingSum()
+{
+    dsp::MovingSum<int32_t, 8> ms;
+    CHECK(!ms.full());
+    CHECK(ms.mean() == 0);
+
+    // Xung: có mặt trong tổng đúng N mẫu
+    for (int n = 0; n < 20; n++)
+    {
+        int64_t s = ms.process(n == 0 ? 1000 : 0);
+        CHECK(s == (n < 8 ? 1000 : 0));
+    }
+    CHECK(ms.full());
+
+    // Bậc: tổng tăng tuyến tính rồi giữ N·x; trung bình trên số mẫu đã nhận
+    ms.reset();
+    for (int n = 0; n < 20; n++)
+    {
+        int64_t s = ms.process(-250);
+        CHECK(s == -250 * (n < 8 ? n + 1 : 8));
+        CHECK(ms.mean() == -250);
+    }
+
+    // int16: tổng 64-bit không tràn khi mọi mẫu là giá trị lớn nhất
+    dsp::MovingSum<int16_t, 256> wide;
+    for (int n = 0; n < 300; n++)
+        wide.process(INT16_MAX);
+    CHECK(wide.sum() == (int64_t)INT16_MAX * 256);
+
+    dsp::MovingSum<float, 4> mf;
+    for (int n = 0; n < 6; n++)
+        mf.process(0.5f);
+    CHECK_NEAR(mf.sum(), 2.0, 1e-6);
+    CHECK_NEAR(mf.mean(), 0.5, 1e-6);
+}
+
+static void testDcBlocker()
+{
+    // Bậc đơn vị từ trạng thái 0: y[n] = α^(n+1)
+    dsp::DcBlocker<float> f(kDcAlpha);
+    for (int n = 0; n < 300; n++)
+        CHECK_NEAR(f.process(1.0f), pow((double)kDcAlpha, n + 1), 1e-5);
+
+    // Xung: y[0] = α, y[n] = α^(n+1) - α^n
+    f.reset();
+    for (int n = 0; n < 100; n++)
+    {
+        double ref = (n == 0) ? kDcAlpha : pow((double)kDcAlpha, n + 1) - pow((double)kDcAlpha, n);
+        CHECK_NEAR(f.process(n == 0 ? 1.0f : 0.0f), ref, 1e-6);
+    }
+
+    // int32 với reset(x0): không có bước nhảy khởi động, DC bị loại bỏ
+    dsp::DcBlocker<int32_t> i32(kDcAlpha);
+    i32.reset(120000);
+    int32_t maxAbs = 0;
+    for (int n = 0; n < 500; n++)
+    {
+        int32_t y = i32.process(120000);
+        maxAbs = (y > maxAbs) ? y : ((-y > maxAbs) ? -y : maxAbs);
+    }
+    CHECK(maxAbs == 0);
+
+    // int32 bậc 100000 theo tham chiếu và về đúng 0 (không kẹt ở vùng chết ~1/(2(1-α)))
+    i32.reset(0);
+    int32_t y = 0;
+    for (int n = 0; n < 1000; n++)
+    {
+        y = i32.process(100000);
+        CHECK_NEAR(y, 100000 * pow((double)kDcAlpha, n + 1), 1);
+    }
+    CHECK(y == 0);
+}
+
+int main()
+{
+    testCoefficients();
+    testBiquad();
+    testCascade();
+    testFir();
+    testMovingSum();
+    testDcBlocker();
+    return TEST_EXIT();
+}
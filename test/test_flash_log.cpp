@@ -0,0 +1,249 @@
+/**
+ * @file test_flash_log.cpp
+ * @brief Kiểm thử mất điện cho FlashLog: cắt nguồn tại mọi byte ghi/xóa
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Với mỗi vị trí cắt n (0, 1, 2, ... cho đến khi kịch bản chạy hết mà không
+ * mất điện), hal::Flash::cutPowerAfter(n) làm thao tác ghi/xóa đang dở chỉ có
+ * n byte đầu có hiệu lực. Sau đó cấp điện lại, begin() lần nữa và kiểm tra:
+ * - Mọi trang đã ghi xong (write() trả về true) đều được khôi phục
+ * - Không trả về mẫu rách: mỗi mẫu đọc được khớp đúng dữ liệu đã ghi
+ * - Chỉ số liên tục, nextIndex() tiếp nối mẫu cuối cùng
+ * - Nhật ký vẫn ghi tiếp được sau khi khôi phục
+ *
+ * Ngoài ra: sau khi khởi động lại, DataBuffer::restoreHistory() nạp lại đúng
+ * lịch sử và tầng tổng hợp như trước reset.
+ */
+
+#include "host_test.h"
+#include "../flash_log.h"
+#include "../data_buffer.h"
+#include "../batch_codec.h"
+
+/// @brief Mẫu xác định theo chỉ số để kiểm tra nội dung sau khi đọc lại
+static HealthDataPacket makeSample(uint32_t i)
+{
+    HealthDataPacket p;
+    memset(&p, 0, sizeof(p));
+    p.timestamp = 1000 + 2 * i;
+    p.steps = i / 3;
+    p.hr = (uint8_t)(60 + i % 40);
+    p.spo2 = (uint8_t)(90 + i % 10);
+    return p;
+}
+
+static bool sameSample(const HealthDataPacket &a, const HealthDataPacket &b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+/// @brief Kịch bản ghi: append + service mỗi mẫu, flush định kỳ (pin yếu)
+struct Workload
+{
+    uint16_t sectors;    ///< Kích thước phân vùng (sector)
+    uint32_t samples;    ///< Số mẫu ghi
+    uint32_t flushEvery; ///< flush() sau mỗi bấy nhiêu mẫu (trang lẻ)
+    bool expectFromZero; ///< Không quay vòng: phải đọc lại được từ mẫu 0
+};
+
+/// @brief Kết quả đọc lại sau khi khôi phục
+struct Readback
+{
+    uint32_t count; ///< Số mẫu đọc được
+    uint32_t first; ///< Chỉ số mẫu đầu
+    uint32_t last;  ///< Chỉ số mẫu cuối
+    bool intact;    ///< Liên tục và khớp nội dung
+};
+
+static Readback readAll(FlashLog &log)
+{
+    Readback r = {0, 0, 0, true};
+    FlashLogReader reader(log);
+    HealthDataPacket p;
+    uint32_t idx;
+    while (reader.next(p, &idx))
+    {
+        if (r.count == 0)
+            r.first = idx;
+        else if (idx != r.last + 1)
+            r.intact = false;
+        if (!sameSample(p, makeSample(idx)))
+            r.intact = false;
+        r.last = idx;
+        r.count++;
+    }
+    return r;
+}
+
+/**
+ * @brief Chạy kịch bản với nguồn bị cắt sau cut byte
+ * @param committed Số mẫu đã nằm trong trang ghi xong trước khi mất điện
+ * @return true nếu mất điện xảy ra (false = kịch bản chạy hết)
+ */
+static bool runUntilCut(hal::Flash &flash, hal::Logger &log, const Workload &w, uint32_t cut, uint32_t &committed)
+{
+    FlashLog fl(flash, log);
+    committed = 0;
+    flash.cutPowerAfter(cut);
+    if (!fl.begin())
+        return flash.powerLost();
+
+    for (uint32_t i = 0; i < w.samples && !flash.powerLost(); i++)
+    {
+        fl.append(makeSample(i));
+        if ((i + 1) % w.flushEvery == 0)
+            fl.flush();
+        fl.service();
+        if (!flash.powerLost())
+            committed = fl.nextIndex() - fl.pendingSamples();
+    }
+    return flash.powerLost();
+}
+
+/// @brief Cắt nguồn tại mọi byte của kịch bản, trả về số vị trí đã thử
+static uint32_t cutAtEveryByte(const Workload &w)
+{
+    hal::Logger log;
+    log.setEnabled(false);
+    uint32_t failures = host_test::failures();
+
+    uint32_t cut = 0;
+    for (;; cut++)
+    {
+        hal::Flash flash(w.sectors * hal::Flash::SECTOR_SIZE);
+        flash.begin();
+        uint32_t committed;
+        bool lost = runUntilCut(flash, log, w, cut, committed);
+        flash.powerCycle();
+
+        FlashLog fl(flash, log);
+        CHECK(fl.begin());
+        Readback r = readAll(fl);
+
+        CHECK(r.intact);
+        if (committed > 0)
+        {
+            // Trang đang ghi lúc mất điện có thể đã đủ dữ liệu + CRC (chỉ thiếu pad)
+            CHECK(r.count > 0 && r.last + 1 >= committed);
+            CHECK(r.last < committed + FlashLog::SAMPLES_PER_PAGE);
+        }
+        if (w.expectFromZero && committed > 0)
+            CHECK(r.first == 0);
+        CHECK(fl.nextIndex() == (r.count ? r.last + 1 : 0));
+
+        // Ghi tiếp sau khi khôi phục
+        uint32_t resume = fl.nextIndex();
+        for (uint32_t i = resume; i < resume + 30; i++)
+            fl.append(makeSample(i));
+        CHECK(fl.flush());
+        Readback after = readAll(fl);
+        CHECK(after.intact && after.last == resume + 29);
+
+        if (host_test::failures() != failures)
+        {
+            printf("  cut at byte %u: committed=%u read=[%u..%u] count=%u\n", cut, committed, r.first, r.last,
+                   r.count);
+            break;
+        }
+        if (!lost)
+            break;
+    }
+    return cut;
+}
+
+/// @brief Ghi nhiều vòng: hao mòn đều và đọc lại đúng phần còn giữ
+static void testWrapAndWear()
+{
+    hal::Logger log;
+    log.setEnabled(false);
+    hal::Flash flash(8 * hal::Flash::SECTOR_SIZE);
+    flash.begin();
+    FlashLog fl(flash, log);
+    CHECK(fl.begin());
+    for (uint32_t i = 0; i < 20000; i++)
+    {
+        fl.append(makeSample(i));
+        if (i % 7 == 0)
+            fl.service();
+    }
+    Readback r = readAll(fl);
+    CHECK(r.intact);
+    CHECK(r.last + 1 == 20000u - fl.pendingSamples());
+    CHECK(r.count >= 6u * 15 * FlashLog::SAMPLES_PER_PAGE);
+
+    // Mọi sector bị xóa gần như đều nhau
+    uint32_t avg = flash.eraseCount() / 8;
+    CHECK(fl.getStats().maxEraseCount <= avg + 2);
+}
+
+/// @brief Ghi lịch sử qua DataBuffer, khởi động lại, nạp lại từ flash
+static void testRestoreHistory()
+{
+    hal::Clock clock;
+    hal::Logger log;
+    log.setEnabled(false);
+    hal::Flash flash(8 * hal::Flash::SECTOR_SIZE);
+    flash.begin();
+
+    const uint32_t N = 2000; // Vừa 6 sector: không có phần bị vòng ghi đè
+    static DataBuffer before(clock, log);
+    FlashLog fl(flash, log);
+    CHECK(fl.begin());
+    before.attachFlashLog(&fl);
+    for (uint32_t i = 0; i < N; i++)
+        before.recordHistory(makeSample(i));
+    CHECK(fl.flush());
+    flash.powerCycle();
+
+    static DataBuffer after(clock, log);
+    FlashLog fl2(flash, log);
+    CHECK(fl2.begin());
+    CHECK(after.restoreHistory(fl2) == N);
+    after.attachFlashLog(&fl2);
+
+    HistoryReader reader(after.history());
+    HealthDataPacket p;
+    uint32_t n = 0;
+    bool same = true;
+    while (reader.next(p))
+        same = same && sameSample(p, makeSample(n++));
+    CHECK(same && n == N);
+
+    static uint8_t a[1024], b[1024];
+    const RollupLevel levels[2] = {ROLLUP_MINUTE, ROLLUP_HOUR};
+    for (RollupLevel level : levels)
+    {
+        size_t la = before.getRollups(level, a, sizeof(a));
+        size_t lb = after.getRollups(level, b, sizeof(b));
+        CHECK(la > 0 && la == lb && memcmp(a, b, la) == 0);
+    }
+
+    // Mẫu nạp lại không bị ghi xuống flash lần nữa
+    CHECK(fl2.nextIndex() == N);
+
+    // Số thứ tự đồng bộ lại bắt đầu từ 1 sau khi khởi động, epoch khác cho điện thoại biết
+    CHECK(before.epoch() != 0 && after.epoch() != 0 && after.epoch() != before.epoch());
+    after.addSample(makeSample(N));
+    uint8_t frame[BATCH_FRAME_CAPACITY(1)];
+    size_t len = after.getEncodedData(frame, sizeof(frame));
+    BatchDecoder dec;
+    CHECK(len > 0 && dec.begin(frame, len));
+    CHECK(dec.sequence() == 1 && dec.epoch() == after.epoch());
+}
+
+int main()
+{
+    testWrapAndWear();
+    testRestoreHistory();
+
+    const Workload noWrap = {4, 700, 50, true};
+    uint32_t n = cutAtEveryByte(noWrap);
+    printf("no wrap: power cut at each of %u byte offsets\n", n);
+
+    const Workload wrap = {3, 900, 50, false};
+    n = cutAtEveryByte(wrap);
+    printf("wrap-around: power cut at each of %u byte offsets\n", n);
+
+    return TEST_EXIT();
+}
@@ -0,0 +1,222 @@
+/**
+ * @file test_notify_pacer.cpp
+ * @brief Kiểm thử máy trạng thái gửi mảnh NotifyPacer trên đường truyền giả
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * FakeLink (fake_notify_link.h) giả lập hàng đợi stack, sự kiện kết nối,
+ * CONF và nghẽn. Kiểm tra:
+ * - Cửa sổ CONF: không quá BLE_NOTIFY_WINDOW mảnh chưa được báo gửi xong
+ * - Nghẽn: dừng khi stack báo nghẽn, tiếp tục khi hết nghẽn, mỗi đợt chờ
+ *   chỉ đếm một lần
+ * - Stack không báo CONF: giữ cửa sổ đến BLE_NOTIFY_CONF_TIMEOUT_MS rồi chỉ
+ *   dựa vào nghẽn; kết nối mới bật lại cửa sổ
+ * - Không tiến triển trong BLE_CHUNK_TIMEOUT_MS: bỏ khung, khung sau vẫn đi
+ * - Điện thoại chưa bật notify: bỏ khung ngay
+ * - Kết nối lại bỏ khung cũ; MTU mới chỉ áp dụng từ khung kế tiếp; số thứ
+ *   tự mảnh liên tục theo từng đích
+ */
+
+#include "host_test.h"
+#include "fake_notify_link.h"
+#include <vector>
+
+/// @brief Khung xác định theo id
+static std::vector<uint8_t> makeFrame(uint8_t id, uint16_t len)
+{
+    std::vector<uint8_t> f(len);
+    for (uint16_t i = 0; i < len; i++)
+        f[i] = (uint8_t)(id * 13 + i * 5);
+    f[0] = id;
+    return f;
+}
+
+/// @brief Chạy link và service() đến khi hàng đợi và stack rỗng (tối đa limitMs)
+static void runUntilEmpty(PacerRig &rig, uint32_t limitMs = 10000)
+{
+    for (uint32_t t = 0; t < limitMs && (!rig.queue().empty() || rig.link.inStack()); t++)
+    {
+        rig.link.advance(1);
+        rig.pacer.service();
+    }
+}
+
+static void testConfWindow()
+{
+    PacerRig rig(247);
+    rig.link.stackSlots = 64;
+    std::vector<uint8_t> f = makeFrame(1, 4000);
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, f.data(), f.size()));
+
+    // Stack còn chỗ nhưng cửa sổ đầy: chờ CONF
+    CHECK(rig.link.inStack() == BLE_NOTIFY_WINDOW);
+    CHECK(rig.pacer.stats().congestionWaits == 1);
+    rig.pacer.service();
+    CHECK(rig.link.inStack() == BLE_NOTIFY_WINDOW && rig.pacer.stats().congestionWaits == 1);
+
+    // Một sự kiện kết nối gửi chunksPerEvent mảnh, CONF mở lại chừng đó chỗ
+    rig.link.connectionEvent();
+    CHECK(rig.link.inStack() == (size_t)(BLE_NOTIFY_WINDOW - rig.link.chunksPerEvent));
+    rig.pacer.service();
+    CHECK(rig.link.inStack() == BLE_NOTIFY_WINDOW);
+
+    runUntilEmpty(rig);
+    CHECK(rig.link.frames.size() == 1 && rig.link.frames[0].data == f);
+    CHECK(rig.link.maxInStack == BLE_NOTIFY_WINDOW && rig.link.seqErrors == 0);
+    CHECK(rig.pacer.stats().frames == 1 && rig.pacer.stats().failedFrames == 0);
+    CHECK(rig.pacer.stats().bytes == f.size());
+}
+
+static void testCongestion()
+{
+    PacerRig rig(247);
+    rig.link.stackSlots = 64;
+    rig.link.congestAt = 5; // Nghẽn trước khi cửa sổ đầy
+    std::vector<uint8_t> f = makeFrame(2, 6000);
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, f.data(), f.size()));
+    CHECK(rig.link.inStack() == 5);
+    CHECK(rig.pacer.stats().congestionWaits == 1);
+
+    // Hết nghẽn sau sự kiện kết nối: gửi tiếp đến ngưỡng, đợt chờ mới được đếm
+    rig.link.connectionEvent();
+    rig.pacer.service();
+    CHECK(rig.link.inStack() == 5);
+    CHECK(rig.pacer.stats().congestionWaits == 2);
+
+    runUntilEmpty(rig);
+    CHECK(rig.link.frames.size() == 1 && rig.link.frames[0].data == f);
+    CHECK(rig.link.maxInStack == 5);
+}
+
+static void testNoConfFallback()
+{
+    PacerRig rig(247);
+    rig.link.stackSlots = 64;
+    rig.link.congestAt = 20;
+    rig.link.confEvents = false;
+    std::vector<uint8_t> f = makeFrame(3, 8000);
+    uint32_t ticket;
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, f.data(), f.size(), &ticket));
+    CHECK(rig.link.inStack() == BLE_NOTIFY_WINDOW);
+
+    // Radio vẫn gửi nhưng không có CONF: cửa sổ giữ nguyên đến hết thời gian chờ
+    for (uint32_t t = 1; t < BLE_NOTIFY_CONF_TIMEOUT_MS; t++)
+    {
+        rig.link.advance(1);
+        rig.pacer.service();
+    }
+    CHECK(rig.link.chunks + rig.link.inStack() == BLE_NOTIFY_WINDOW);
+
+    // Quá thời gian: bỏ cửa sổ, chỉ dựa vào nghẽn
+    rig.link.advance(1);
+    rig.pacer.service();
+    CHECK(rig.link.inStack() == rig.link.congestAt);
+    runUntilEmpty(rig);
+    CHECK(rig.queue().status(NOTIFY_BATCH, ticket) == NOTIFY_FRAME_DELIVERED);
+    CHECK(rig.link.frames.size() == 1 && rig.link.frames[0].data == f);
+    CHECK(rig.pacer.stats().failedFrames == 0);
+
+    // Kết nối mới: cửa sổ bật lại
+    rig.pacer.onDisconnect();
+    rig.pacer.service();
+    rig.link.drop();
+    rig.pacer.onConnect();
+    rig.pacer.onMtuChanged(247);
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, f.data(), f.size()));
+    CHECK(rig.link.inStack() == BLE_NOTIFY_WINDOW);
+}
+
+static void testChunkTimeout()
+{
+    PacerRig rig(247);
+    rig.link.stackSlots = 4;
+    rig.link.chunksPerEvent = 0; // Radio không gửi được gì (điện thoại bận)
+    std::vector<uint8_t> a = makeFrame(4, 3000), b = makeFrame(5, 700);
+    uint32_t ta, tb;
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, a.data(), a.size(), &ta));
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, b.data(), b.size(), &tb));
+    CHECK(rig.link.inStack() == 4);
+
+    rig.link.advance(BLE_CHUNK_TIMEOUT_MS - 1);
+    rig.pacer.service();
+    CHECK(rig.queue().status(NOTIFY_BATCH, ta) == NOTIFY_FRAME_QUEUED);
+    rig.link.advance(1);
+    rig.pacer.service();
+    CHECK(rig.queue().status(NOTIFY_BATCH, ta) == NOTIFY_FRAME_DROPPED);
+    CHECK(rig.queue().status(NOTIFY_BATCH, tb) == NOTIFY_FRAME_QUEUED);
+    CHECK(rig.pacer.stats().failedFrames == 1);
+
+    // Radio hoạt động lại: phần đầu khung a trong stack đến điện thoại nhưng bị bỏ, khung b nguyên vẹn
+    rig.link.chunksPerEvent = 4;
+    runUntilEmpty(rig);
+    CHECK(rig.queue().status(NOTIFY_BATCH, tb) == NOTIFY_FRAME_DELIVERED);
+    CHECK(rig.link.frames.size() == 1 && rig.link.frames[0].data == b);
+    CHECK(rig.link.seqErrors == 0);
+}
+
+static void testNotifyDisabled()
+{
+    PacerRig rig(247);
+    rig.link.disabled = true;
+    std::vector<uint8_t> f = makeFrame(6, 600);
+    uint32_t t1, t2;
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, f.data(), f.size(), &t1));
+    CHECK(rig.pacer.enqueue(NOTIFY_REALTIME, BLE_TARGET_HEALTH_DATA, f.data(), 12, &t2));
+    CHECK(rig.queue().empty());
+    CHECK(rig.queue().status(NOTIFY_BATCH, t1) == NOTIFY_FRAME_DROPPED);
+    CHECK(rig.queue().status(NOTIFY_REALTIME, t2) == NOTIFY_FRAME_DROPPED);
+    CHECK(rig.pacer.stats().failedFrames == 2);
+
+    rig.link.disabled = false;
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, f.data(), f.size(), &t1));
+    CHECK(rig.queue().status(NOTIFY_BATCH, t1) == NOTIFY_FRAME_DELIVERED);
+}
+
+static void testReconnectAndMtu()
+{
+    PacerRig rig(BLE_DEFAULT_MTU);
+    const uint16_t small = BLE_DEFAULT_MTU - BLE_ATT_HEADER_SIZE - BLE_CHUNK_HEADER_SIZE;
+    std::vector<uint8_t> a = makeFrame(7, 1000), b = makeFrame(8, 1000), r = makeFrame(9, 300);
+
+    // MTU đổi giữa khung: khung đang gửi giữ kích thước mảnh cũ
+    rig.link.budget = 10;
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, a.data(), a.size()));
+    rig.pacer.onMtuChanged(247);
+    rig.drain();
+    CHECK(rig.link.chunks == (a.size() + small - 1) / small);
+    uint32_t before = rig.link.chunks;
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, b.data(), b.size()));
+    CHECK(rig.link.chunks - before == (b.size() + 241) / 242);
+
+    // Hai đích xen kẽ: mỗi đích một bộ đếm mảnh, không thiếu số thứ tự
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_ROLLUP, r.data(), r.size()));
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, a.data(), a.size()));
+    CHECK(rig.link.frames.size() == 4 && rig.link.seqErrors == 0);
+    CHECK(rig.link.frames[2].target == BLE_TARGET_ROLLUP && rig.link.frames[2].data == r);
+
+    // Mất kết nối giữa khung: không nhận khung mới, kết nối lại bỏ khung cũ
+    uint32_t ticket;
+    rig.link.budget = 1;
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, a.data(), a.size(), &ticket));
+    rig.pacer.onDisconnect();
+    CHECK(!rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, b.data(), b.size()));
+    CHECK(rig.queue().status(NOTIFY_BATCH, ticket) == NOTIFY_FRAME_DROPPED);
+    rig.link.drop();
+    rig.pacer.onConnect();
+    CHECK(rig.pacer.mtu() == BLE_DEFAULT_MTU);
+    rig.link.frames.clear();
+    rig.link.budget = -1;
+    CHECK(rig.pacer.enqueue(NOTIFY_BATCH, BLE_TARGET_HEALTH_DATA, b.data(), b.size()));
+    CHECK(rig.link.frames.size() == 1 && rig.link.frames[0].data == b);
+}
+
+int main()
+{
+    testConfWindow();
+    testCongestion();
+    testNoConfFallback();
+    testChunkTimeout();
+    testNotifyDisabled();
+    testReconnectAndMtu();
+    return TEST_EXIT();
+}
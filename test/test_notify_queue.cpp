@@ -0,0 +1,228 @@
+/**
+ * @file test_notify_queue.cpp
+ * @brief Kiểm thử NotifyQueue qua NotifyPacer và đường truyền giả
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Khung đi qua đúng đường của thiết bị: NotifyPacer chia mảnh {số thứ tự,
+ * cờ đầu/cuối, dữ liệu}, FakeLink (fake_notify_link.h) đóng vai stack lý
+ * tưởng và điện thoại ghép mảnh lại. Kiểm tra:
+ * - Thứ tự ưu tiên: cảnh báo > thời gian thực > batch, khung đang gửi dở
+ *   được gửi hết trước
+ * - Thời gian thực đầy: bỏ khung cũ nhất, giữ khung mới nhất
+ * - Cảnh báo/batch đầy: từ chối khung mới, khung đã nhận còn nguyên
+ * - Khung nhiều mảnh (qua điểm quay vòng của vòng byte) ghép lại đúng từng byte
+ * - Ticket: khung chỉ báo DELIVERED khi gửi hết; hết thời gian giữa chừng,
+ *   mất kết nối và bỏ khung cũ nhất đều báo DROPPED
+ */
+
+#include "host_test.h"
+#include "fake_notify_link.h"
+#include <string.h>
+#include <vector>
+
+/// @brief Khung xác định theo id: byte đầu là id, phần còn lại suy ra từ id
+static std::vector<uint8_t> makeFrame(uint8_t id, uint16_t len)
+{
+    std::vector<uint8_t> f(len);
+    for (uint16_t i = 0; i < len; i++)
+        f[i] = (uint8_t)(id * 31 + i * 7);
+    f[0] = id;
+    return f;
+}
+
+static bool push(PacerRig &rig, NotifyClass cls, uint8_t id, uint16_t len, uint32_t *ticket = nullptr)
+{
+    std::vector<uint8_t> f = makeFrame(id, len);
+    return rig.pacer.enqueue(cls, cls == NOTIFY_BATCH ? 1 : 0, f.data(), f.size(), ticket);
+}
+
+static void testPriority()
+{
+    PacerRig rig(25);
+    FakeLink &link = rig.link;
+
+    // Link chưa nhận mảnh nào: mọi khung vào hàng đợi trước khi gửi
+    link.budget = 0;
+    push(rig, NOTIFY_BATCH, 1, 100);
+    push(rig, NOTIFY_REALTIME, 2, 10);
+    push(rig, NOTIFY_ALERT, 3, 14);
+    push(rig, NOTIFY_BATCH, 4, 30);
+    push(rig, NOTIFY_REALTIME, 5, 10);
+    rig.drain();
+    CHECK(link.frames.size() == 5);
+    const uint8_t order1[] = {3, 2, 5, 1, 4};
+    for (size_t i = 0; i < 5 && i < link.frames.size(); i++)
+        CHECK(link.frames[i].data == makeFrame(order1[i], link.frames[i].data.size()));
+
+    // Mảnh đầu của khung batch đã đi: khung đó được gửi hết trước cảnh báo mới
+    link.frames.clear();
+    link.budget = 1;
+    push(rig, NOTIFY_BATCH, 6, 100);
+    CHECK(link.budget == 0);
+    push(rig, NOTIFY_ALERT, 7, 14);
+    push(rig, NOTIFY_REALTIME, 8, 10);
+    rig.drain();
+    CHECK(link.frames.size() == 3);
+    const uint8_t order2[] = {6, 7, 8};
+    for (size_t i = 0; i < 3 && i < link.frames.size(); i++)
+        CHECK(link.frames[i].data[0] == order2[i]);
+
+    CHECK(rig.queue().empty() && link.seqErrors == 0);
+    const NotifyQueueStats &st = rig.queue().stats();
+    CHECK(st.sent[NOTIFY_ALERT] == 2 && st.sent[NOTIFY_REALTIME] == 3 && st.sent[NOTIFY_BATCH] == 3);
+}
+
+static void testRealtimeDropOldest()
+{
+    PacerRig rig(25);
+    FakeLink &link = rig.link;
+
+    // 128 byte, mỗi khung 10 + 3 byte: giữ được 9 khung
+    const uint8_t total = 20;
+    uint32_t tickets[total];
+    link.budget = 0;
+    for (uint8_t i = 0; i < total; i++)
+        CHECK(push(rig, NOTIFY_REALTIME, i, 10, &tickets[i]));
+    uint32_t kept = BLE_QUEUE_REALTIME_BYTES / (10 + NOTIFY_FRAME_HEADER);
+    CHECK(rig.queue().stats().dropped[NOTIFY_REALTIME] == total - kept);
+    CHECK(rig.queue().status(NOTIFY_REALTIME, tickets[0]) == NOTIFY_FRAME_DROPPED);
+    CHECK(rig.queue().status(NOTIFY_REALTIME, tickets[total - 1]) == NOTIFY_FRAME_QUEUED);
+
+    rig.drain();
+    CHECK(link.frames.size() == kept);
+    for (size_t i = 0; i < link.frames.size(); i++)
+        CHECK(link.frames[i].data == makeFrame((uint8_t)(total - kept + i), 10));
+    CHECK(rig.queue().status(NOTIFY_REALTIME, tickets[total - 1]) == NOTIFY_FRAME_DELIVERED);
+    CHECK(rig.queue().status(NOTIFY_REALTIME, tickets[total - kept - 1]) == NOTIFY_FRAME_DROPPED);
+}
+
+static void testRejectWhenFull()
+{
+    PacerRig rig(105);
+    FakeLink &link = rig.link;
+    link.budget = 0;
+
+    // Batch: 8192 byte giữ được 3 khung 2048 byte, khung thứ tư bị từ chối
+    uint8_t accepted = 0;
+    for (uint8_t i = 0; i < 5; i++)
+        accepted += push(rig, NOTIFY_BATCH, i, 2048) ? 1 : 0;
+    CHECK(accepted == 3);
+    CHECK(!rig.queue().canPush(NOTIFY_BATCH, 2048));
+    CHECK(rig.queue().stats().dropped[NOTIFY_BATCH] == 2);
+
+    // Cảnh báo: 64 byte giữ được 3 khung 18 byte
+    accepted = 0;
+    for (uint8_t i = 10; i < 15; i++)
+        accepted += push(rig, NOTIFY_ALERT, i, 18) ? 1 : 0;
+    CHECK(accepted == 3);
+
+    // Khung quá lớn cho mọi lớp
+    std::vector<uint8_t> huge(BLE_QUEUE_BATCH_BYTES);
+    CHECK(!rig.pacer.enqueue(NOTIFY_BATCH, 1, huge.data(), huge.size()));
+    CHECK(!rig.pacer.enqueue(NOTIFY_BATCH, 1, huge.data(), 0));
+
+    // Các khung đã nhận còn nguyên, theo đúng thứ tự
+    rig.drain();
+    CHECK(link.frames.size() == 6);
+    const uint8_t order[] = {10, 11, 12, 0, 1, 2};
+    for (size_t i = 0; i < 6 && i < link.frames.size(); i++)
+        CHECK(link.frames[i].data == makeFrame(order[i], link.frames[i].data.size()));
+    CHECK(rig.queue().canPush(NOTIFY_BATCH, 2048));
+}
+
+static void testReassembly()
+{
+    host_test::Rng rng(21);
+    bool ok = true;
+    uint32_t frames = 0;
+    for (uint16_t mtu : {(uint16_t)25, (uint16_t)102, (uint16_t)249, (uint16_t)BLE_REQUESTED_MTU})
+    {
+        PacerRig rig(mtu);
+        FakeLink &link = rig.link;
+        for (uint32_t round = 0; round < 300; round++)
+        {
+            // Vài khung độ dài ngẫu nhiên mỗi lượt: vị trí đầu khung trôi qua điểm quay vòng
+            uint8_t n = 1 + rng.next() % 3;
+            std::vector<std::vector<uint8_t>> sent;
+            link.budget = 0;
+            for (uint8_t k = 0; k < n; k++)
+            {
+                uint16_t len = 1 + rng.next() % 2600;
+                std::vector<uint8_t> f = makeFrame((uint8_t)rng.next(), len);
+                if (rig.pacer.enqueue(NOTIFY_BATCH, 1, f.data(), f.size()))
+                    sent.push_back(f);
+            }
+            link.frames.clear();
+            rig.drain();
+            ok = ok && link.frames.size() == sent.size();
+            for (size_t k = 0; k < sent.size() && k < link.frames.size(); k++)
+                ok = ok && link.frames[k].data == sent[k] && link.frames[k].target == 1;
+            frames += sent.size();
+        }
+        CHECK(rig.queue().empty() && link.seqErrors == 0);
+    }
+    CHECK(ok);
+    printf("reassembled %u multi-chunk frames\n", frames);
+}
+
+static void testTickets()
+{
+    PacerRig rig(105);
+    FakeLink &link = rig.link;
+
+    uint32_t a, b, c;
+    link.budget = 0;
+    CHECK(push(rig, NOTIFY_BATCH, 1, 500, &a));
+    CHECK(push(rig, NOTIFY_BATCH, 2, 500, &b));
+    CHECK(push(rig, NOTIFY_BATCH, 3, 500, &c));
+    CHECK(b == a + 1 && c == b + 1);
+
+    // Đang gửi dở vẫn là QUEUED; hết thời gian giữa chừng là DROPPED
+    link.budget = 1;
+    rig.pacer.service();
+    CHECK(rig.queue().status(NOTIFY_BATCH, a) == NOTIFY_FRAME_QUEUED);
+    rig.clock.advanceMs(BLE_CHUNK_TIMEOUT_MS);
+    rig.pacer.service();
+    CHECK(rig.queue().status(NOTIFY_BATCH, a) == NOTIFY_FRAME_DROPPED);
+
+    // Gửi hết mọi mảnh mới là DELIVERED
+    link.budget = 4;
+    rig.pacer.service();
+    CHECK(rig.queue().status(NOTIFY_BATCH, b) == NOTIFY_FRAME_QUEUED);
+    link.budget = 1;
+    rig.pacer.service();
+    CHECK(rig.queue().status(NOTIFY_BATCH, b) == NOTIFY_FRAME_DELIVERED);
+
+    // Mất kết nối: khung đã nhận nhưng chưa gửi bị bỏ
+    rig.pacer.onDisconnect();
+    rig.pacer.service();
+    CHECK(rig.queue().status(NOTIFY_BATCH, c) == NOTIFY_FRAME_DROPPED);
+    CHECK(rig.queue().status(NOTIFY_BATCH, b) == NOTIFY_FRAME_DELIVERED);
+    rig.pacer.onConnect();
+    rig.link.drop();
+
+    // Ticket quá cũ: không còn nhớ kết quả, báo DROPPED để bên gọi gửi lại
+    link.budget = -1;
+    for (uint32_t i = 0; i < NOTIFY_STATUS_HISTORY; i++)
+        push(rig, NOTIFY_BATCH, 4, 10);
+    CHECK(rig.queue().status(NOTIFY_BATCH, b) == NOTIFY_FRAME_DROPPED);
+
+    // Ticket của lớp khác không ảnh hưởng nhau
+    uint32_t alert;
+    link.budget = 0;
+    CHECK(push(rig, NOTIFY_ALERT, 5, 14, &alert));
+    CHECK(rig.queue().status(NOTIFY_ALERT, alert) == NOTIFY_FRAME_QUEUED);
+    rig.drain();
+    CHECK(rig.queue().status(NOTIFY_ALERT, alert) == NOTIFY_FRAME_DELIVERED);
+}
+
+int main()
+{
+    testPriority();
+    testRealtimeDropOldest();
+    testRejectWhenFull();
+    testReassembly();
+    testTickets();
+    return TEST_EXIT();
+}
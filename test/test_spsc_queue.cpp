@@ -0,0 +1,148 @@
+/**
+ * @file test_spsc_queue.cpp
+ * @brief Kiểm thử SpscQueue: ngữ nghĩa đơn luồng và stress hai luồng (chạy dưới TSan)
+ * @author Hồ Xuân Thái
+ * @date 2025
+ *
+ * Một luồng ghi, một luồng đọc trên std::thread, hàng đợi nhỏ để liên tục
+ * chạm trạng thái đầy/rỗng. Mỗi phần tử mang số thứ tự và giá trị kiểm tra
+ * suy ra từ số thứ tự, bên đọc kiểm tra:
+ * - Đúng thứ tự (phần tử thứ k có số thứ tự k)
+ * - Không mất, không lặp (đếm đủ tổng số)
+ * - Không rách (giá trị kiểm tra khớp số thứ tự)
+ * cho mọi tổ hợp push/pushBulk × pop/popBulk.
+ *
+ * Dùng: test_spsc_queue [số phần tử mỗi tổ hợp]   (mặc định 4 triệu)
+ */
+
+#include "host_test.h"
+#include "../spsc_queue.h"
+#include <stdlib.h>
+#include <thread>
+
+/// @brief Phần tử có số thứ tự và giá trị kiểm tra để phát hiện đọc rách
+struct Item
+{
+    uint64_t seq;   ///< Số thứ tự
+    uint64_t check; ///< Hàm của seq
+};
+
+static uint64_t checkOf(uint64_t seq) { return seq * 0x9E3779B97F4A7C15ull ^ 0xA5A5A5A5A5A5A5A5ull; }
+
+static void testSingleThread()
+{
+    SpscQueue<uint32_t, 8> q;
+    uint32_t v;
+    CHECK(q.empty());
+    CHECK(!q.pop(v));
+
+    // Dùng được đủ N phần tử
+    for (uint32_t i = 0; i < 8; i++)
+        CHECK(q.push(i));
+    CHECK(!q.push(99));
+    CHECK(q.size() == 8);
+
+    for (uint32_t i = 0; i < 8; i++)
+        CHECK(q.pop(v) && v == i);
+    CHECK(!q.pop(v));
+
+    // Bulk qua điểm quay vòng, bị cắt theo chỗ trống / số phần tử có
+    uint32_t in[12], out[12];
+    for (uint32_t i = 0; i < 12; i++)
+        in[i] = 100 + i;
+    CHECK(q.pushBulk(in, 5) == 5);
+    CHECK(q.popBulk(out, 3) == 3 && out[0] == 100 && out[2] == 102);
+    CHECK(q.pushBulk(in + 5, 7) == 6);
+    CHECK(q.size() == 8);
+    CHECK(q.popBulk(out, 12) == 8);
+    for (uint32_t i = 0; i < 8; i++)
+        CHECK(out[i] == 103 + i);
+    CHECK(q.popBulk(out, 12) == 0);
+    CHECK(q.pushBulk(in, 0) == 0);
+}
+
+/**
+ * @brief Một tổ hợp ghi/đọc trên hai luồng
+ * @param bulkPush Bên ghi dùng pushBulk (kích thước lô thay đổi)
+ * @param bulkPop Bên đọc dùng popBulk
+ */
+static void stress(uint64_t total, bool bulkPush, bool bulkPop)
+{
+    static SpscQueue<Item, 16> q;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]() {
+        Item batch[7];
+        uint64_t next = 0;
+        uint32_t round = 0;
+        while (next < total)
+        {
+            if (bulkPush)
+            {
+                uint32_t want = 1 + round++ % 7;
+                uint32_t n = 0;
+                for (; n < want && next + n < total; n++)
+                    batch[n] = Item{next + n, checkOf(next + n)};
+                uint32_t pushed = q.pushBulk(batch, n);
+                next += pushed;
+                if (pushed == 0)
+                    std::this_thread::yield();
+            }
+            else if (q.push(Item{next, checkOf(next)}))
+            {
+                next++;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint64_t expected = 0, outOfOrder = 0, torn = 0;
+    Item batch[5];
+    uint32_t round = 0;
+    while (expected < total)
+    {
+        uint32_t n;
+        if (bulkPop)
+            n = q.popBulk(batch, 1 + round++ % 5);
+        else
+            n = q.pop(batch[0]) ? 1 : 0;
+        if (n == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (batch[i].seq != expected)
+                outOfOrder++;
+            if (batch[i].check != checkOf(batch[i].seq))
+                torn++;
+            expected++;
+        }
+    }
+    producer.join();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Item extra;
+    CHECK(outOfOrder == 0);
+    CHECK(torn == 0);
+    CHECK(expected == total);
+    CHECK(!q.pop(extra));
+    printf("%-9s -> %-8s %llu items, %.1f Mitems/s\n", bulkPush ? "pushBulk" : "push", bulkPop ? "popBulk" : "pop",
+           (unsigned long long)total, total / s / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t total = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 4000000ull;
+
+    testSingleThread();
+    stress(total, false, false);
+    stress(total, true, true);
+    stress(total, false, true);
+    stress(total, true, false);
+    return TEST_EXIT();
+}